@@ -0,0 +1,139 @@
+//go:build !go1.19
+// +build !go1.19
+
+/*
+ *    Copyright (C) 2015 juztamau5
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *    The above copyright notice and this permission notice shall be included in
+ *    all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+package main
+
+import (
+	"runtime"
+	"runtime/debug"
+	"sync"
+	"time"
+)
+
+const (
+	memoryLimitInterval = 100 * time.Millisecond
+
+	// Collections are never triggered by less than this much heap growth
+	memoryLimitMinGCPercent = 10
+
+	// Forced collections back off up to this interval while the heap stays
+	// over the limit, so a live heap above it doesn't collect continuously
+	memoryLimitMaxBackoff = 10 * time.Second
+)
+
+var (
+	memoryLimitMutex   sync.Mutex
+	memoryLimit        uint64
+	memoryLimitStarted bool
+	baseGCPercent      = -1 // Unknown until the watchdog starts
+)
+
+// The collector runs at the configured percentage, which the watchdog
+// lowers as the heap approaches the limit
+func setGCPercent(percent int) {
+	memoryLimitMutex.Lock()
+	defer memoryLimitMutex.Unlock()
+
+	if memoryLimitStarted {
+		baseGCPercent = percent
+	}
+	debug.SetGCPercent(percent)
+}
+
+// Runtimes without a native limit get a watchdog that scales GOGC down as
+// the heap grows toward the limit, and forces collections with a back-off
+// when it's over the limit anyway
+func setMemoryLimit(limit int64) bool {
+	memoryLimitMutex.Lock()
+	defer memoryLimitMutex.Unlock()
+
+	memoryLimit = uint64(limit)
+
+	if !memoryLimitStarted {
+		memoryLimitStarted = true
+
+		// SetGCPercent returns the previous setting
+		baseGCPercent = debug.SetGCPercent(100)
+		debug.SetGCPercent(baseGCPercent)
+
+		go watchMemoryLimit()
+	}
+
+	return true
+}
+
+func watchMemoryLimit() {
+	var mem runtime.MemStats
+
+	appliedPercent := 0
+	backoff := memoryLimitInterval
+	var nextForced time.Time
+
+	for now := range time.Tick(memoryLimitInterval) {
+		memoryLimitMutex.Lock()
+		limit := memoryLimit
+		base := baseGCPercent
+
+		runtime.ReadMemStats(&mem)
+
+		// Collect once the heap grows into the headroom left under the limit,
+		// unless the configured percentage collects sooner. A disabled
+		// collector is left alone.
+		percent := base
+		if base >= 0 && mem.HeapAlloc > 0 {
+			headroom := 0
+			if mem.HeapAlloc < limit {
+				headroom = int((limit - mem.HeapAlloc) * 100 / mem.HeapAlloc)
+			}
+			if headroom < memoryLimitMinGCPercent {
+				headroom = memoryLimitMinGCPercent
+			}
+			if headroom < percent {
+				percent = headroom
+			}
+		}
+
+		if percent != appliedPercent {
+			debug.SetGCPercent(percent)
+			appliedPercent = percent
+		}
+		memoryLimitMutex.Unlock()
+
+		if mem.HeapAlloc <= limit {
+			backoff = memoryLimitInterval
+			continue
+		}
+
+		if now.After(nextForced) {
+			debug.FreeOSMemory()
+
+			nextForced = now.Add(backoff)
+			if backoff *= 2; backoff > memoryLimitMaxBackoff {
+				backoff = memoryLimitMaxBackoff
+			}
+		}
+	}
+}
@@ -0,0 +1,114 @@
+/*
+ *    Copyright (C) 2015 juztamau5
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *    The above copyright notice and this permission notice shall be included in
+ *    all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+// Exports for libipfs, copied into the IPFS command package before it is
+// built as a C archive.
+
+package main
+
+/*
+#include <stdint.h>
+*/
+import "C"
+
+import (
+	"runtime"
+	"unsafe"
+)
+
+// Order of the values written by ipfsRuntimeStats()
+const (
+	statHeapAlloc = iota
+	statHeapSys
+	statHeapObjects
+	statTotalAlloc
+	statSys
+	statNextGC
+	statNumGC
+	statPauseTotalNs
+	statPauseLastNs
+	statPauseMaxNs
+	statGoroutines
+	statMaxProcs
+	statCount
+)
+
+//export ipfsRuntimeConfigure
+func ipfsRuntimeConfigure(maxProcs C.int, gcPercent C.int, memoryLimit C.int64_t) C.int {
+	if maxProcs > 0 {
+		runtime.GOMAXPROCS(int(maxProcs))
+	}
+
+	// A negative percentage turns the collector off
+	if gcPercent != 0 {
+		setGCPercent(int(gcPercent))
+	}
+
+	if memoryLimit > 0 && !setMemoryLimit(int64(memoryLimit)) {
+		return 0
+	}
+
+	return 1
+}
+
+//export ipfsRuntimeStats
+func ipfsRuntimeStats(stats *C.uint64_t, count C.int) C.int {
+	if stats == nil || count <= 0 {
+		return 0
+	}
+
+	var mem runtime.MemStats
+	runtime.ReadMemStats(&mem)
+
+	var values [statCount]uint64
+	values[statHeapAlloc] = mem.HeapAlloc
+	values[statHeapSys] = mem.HeapSys
+	values[statHeapObjects] = mem.HeapObjects
+	values[statTotalAlloc] = mem.TotalAlloc
+	values[statSys] = mem.Sys
+	values[statNextGC] = mem.NextGC
+	values[statNumGC] = uint64(mem.NumGC)
+	values[statPauseTotalNs] = mem.PauseTotalNs
+	if mem.NumGC > 0 {
+		values[statPauseLastNs] = mem.PauseNs[(mem.NumGC+255)%256]
+	}
+	for _, pause := range mem.PauseNs {
+		if pause > values[statPauseMaxNs] {
+			values[statPauseMaxNs] = pause
+		}
+	}
+	values[statGoroutines] = uint64(runtime.NumGoroutine())
+	values[statMaxProcs] = uint64(runtime.GOMAXPROCS(0))
+
+	n := int(count)
+	if n > statCount {
+		n = statCount
+	}
+
+	out := (*[statCount]C.uint64_t)(unsafe.Pointer(stats))[:n:n]
+	for i := range out {
+		out[i] = C.uint64_t(values[i])
+	}
+
+	return C.int(n)
+}
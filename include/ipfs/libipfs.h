@@ -24,6 +24,7 @@
 #define __IPSF_EMBEDDED_H__
 
 #include <stdbool.h>
+#include <stddef.h>
 
 #ifdef __cplusplus
 extern "C"
@@ -42,6 +43,113 @@ extern "C"
    */
   void ipfs_init(unsigned int bits, const char* passphrase, bool force);
 
+  /*!
+   * \brief How ipfs_open() runs commands
+   */
+  typedef enum
+  {
+    IPFS_OPEN_DEFAULT, ///< Every command runs through go-ipfs
+    IPFS_OPEN_LOCAL,   ///< Serve local commands from the repo, start the network on first use
+  } ipfs_open_mode_t;
+
+  /*!
+   * \brief Choose the repo used by all commands
+   *
+   * \param repo_path The repo, or NULL for $IPFS_PATH (default ~/.ipfs)
+   * \param mode How commands are run
+   *
+   * \return false if the repo can't be used in the requested mode
+   *
+   * Calling this is optional. Without it, commands use the default repo as
+   * go-ipfs would.
+   *
+   * In local mode, block commands (ipfs_block_put(), ipfs_block_get(),
+   * ipfs_block_stat(), ipfs_block_put_data(), ipfs_block_get_data()) and
+   * object reads (ipfs_object_data(), ipfs_object_links(), ipfs_object_stat())
+   * read and write the repo's blockstore directly, without starting go-ipfs.
+   * The first command that needs the network starts a daemon for the repo,
+   * which brings up the swarm, DHT and bootstrap connections. Reading a block
+   * that isn't in the repo needs the network too, so it starts the daemon and
+   * fetches the block through it. From then on, and whenever another process
+   * runs a daemon on the repo, all commands go through the daemon.
+   */
+  bool ipfs_open(const char* repo_path, ipfs_open_mode_t mode);
+
+  /*!
+   * \brief Stop a daemon started by local mode and return to the default repo
+   *
+   * The daemon is asked to shut down through its API and given a few seconds
+   * to exit. go-ipfs versions without a shutdown command, which include the
+   * one libipfs is built with, keep the daemon running and its repo locked
+   * until the process exits, and no other daemon can be started meanwhile.
+   */
+  void ipfs_close(void);
+
+  /*!
+   * \brief A node with its own repo, next to the one chosen by ipfs_open()
+   *
+   * Nodes let one process work on several repos, e.g. for tests or to keep
+   * tenants apart. Each thread chooses the node its calls work on with
+   * ipfs_node_use(). The Go runtime and the worker pool are shared.
+   *
+   * go-ipfs keeps the state of its commands in process globals, so only one
+   * node, the default one included, can run a daemon in the process. The
+   * other nodes run commands that need no daemon, or use a daemon another
+   * process runs on their repo, found through the repo's "api" file. To run
+   * several peers, run a daemon per repo in its own process.
+   */
+  typedef struct ipfs_node ipfs_node_t;
+
+  /*!
+   * \brief Create a node for a repo
+   *
+   * \param repo_path The repo (required). Only one node can use a repo.
+   * \param mode How commands are run (see ipfs_open())
+   *
+   * \return The node, or NULL if the repo can't be used in the requested mode
+   *
+   * Local mode needs an initialized repo. To create one, open the node in
+   * default mode and call ipfs_init() after ipfs_node_use().
+   */
+  ipfs_node_t* ipfs_node_new(const char* repo_path, ipfs_open_mode_t mode);
+
+  /*!
+   * \brief Stop the node's daemon and free the node
+   *
+   * Threads still using the node fall back to the default node. A daemon
+   * that doesn't shut down outlives the node, see ipfs_close().
+   */
+  void ipfs_node_free(ipfs_node_t* node);
+
+  /*!
+   * \brief Set the ports the node's daemon listens on
+   *
+   * \param swarm_port Port for peers on all interfaces, or 0 to keep the config
+   * \param api_port Port for the API on localhost, or 0 to keep the config
+   * \param gateway_port Port for the gateway on localhost, or 0 to keep the config
+   *
+   * Daemons on one host need distinct ports. Call this before the daemon
+   * starts.
+   */
+  bool ipfs_node_set_ports(ipfs_node_t* node, unsigned short swarm_port, unsigned short api_port, unsigned short gateway_port);
+
+  /*!
+   * \brief Start the node's daemon now instead of on first use
+   *
+   * \return true once the daemon's API answers, false if another node of the
+   *         process runs a daemon
+   */
+  bool ipfs_node_start(ipfs_node_t* node);
+
+  /*!
+   * \brief Choose the node used by the calling thread's calls
+   *
+   * \param node The node, or NULL for the default node
+   *
+   * Work the library does in the background for a call stays on its node.
+   */
+  void ipfs_node_use(ipfs_node_t* node);
+
   /*!
    * \brief Add an object to IPFS
    *
@@ -53,12 +161,114 @@ extern "C"
    * \param trickle Use trickle-DAG format for DAG generation
    *
    * Adds contents of <path> to IPFS. Use recursion to add directories. Note
-   * that directories are added recursively, to form the IPFS merkle-DAG. A
-   * smarter partial add with a staging area (like git) remains to be
-   * implemented.
+   * that directories are added recursively, to form the IPFS merkle-DAG. To
+   * re-add a tree without re-hashing unchanged files, use
+   * ipfs_add_incremental().
    */
   void ipfs_add(const char* path, bool recursive, bool quiet, bool progress, bool wrap_with_directory, bool trickle);
 
+  /*!
+   * \brief Strategies for splitting files into blocks
+   */
+  typedef enum
+  {
+    IPFS_CHUNKER_FIXED, ///< Blocks of <chunk_size> bytes
+    IPFS_CHUNKER_RABIN, ///< Content-defined blocks cut by a Rabin fingerprint
+  } ipfs_chunker_t;
+
+  /*!
+   * \brief Options for ipfs_add_ex()
+   *
+   * Initialize with ipfs_add_options_init() so that new fields get defaults.
+   */
+  typedef struct
+  {
+    bool           recursive;           ///< Add directory paths recursively
+    bool           quiet;               ///< Write minimal output
+    bool           progress;            ///< Stream progress data
+    bool           wrap_with_directory; ///< Wrap files with a directory object
+    bool           trickle;             ///< Use trickle-DAG format for DAG generation
+    ipfs_chunker_t chunker;             ///< Chunking strategy
+    unsigned int   chunk_size;          ///< Block size for IPFS_CHUNKER_FIXED, or 0 for the default
+    unsigned int   chunk_min;           ///< Minimum block size for IPFS_CHUNKER_RABIN
+    unsigned int   chunk_avg;           ///< Average block size for IPFS_CHUNKER_RABIN
+    unsigned int   chunk_max;           ///< Maximum block size for IPFS_CHUNKER_RABIN
+    bool           only_hash;           ///< Only chunk and hash, don't write blocks to the repo
+  } ipfs_add_options_t;
+
+  /*!
+   * \brief Fill <options> with the defaults used by ipfs_add()
+   */
+  void ipfs_add_options_init(ipfs_add_options_t* options);
+
+  /*!
+   * \brief Add an object to IPFS with extended options
+   *
+   * \param path The path to a file to be added to IPSF
+   * \param options The add options, or NULL for defaults
+   *
+   * \return false if <options> are invalid, true otherwise
+   *
+   * Fixed-size chunking shifts every block after an insertion, so edited
+   * files share almost nothing with earlier versions. Content-defined
+   * chunking cuts blocks where the content matches a rolling hash, so an edit
+   * only changes the blocks around it and re-adding writes only those.
+   *
+   * For IPFS_CHUNKER_RABIN, set all of <chunk_min>, <chunk_avg> and
+   * <chunk_max> (with min <= avg <= max), only <chunk_avg>, or none of them
+   * for the go-ipfs defaults.
+   */
+  bool ipfs_add_ex(const char* path, const ipfs_add_options_t* options);
+
+  /*!
+   * \brief Compute the root key <path> would get, without adding it
+   *
+   * \param path The path to a file or directory
+   * \param options The add options, or NULL for defaults. <only_hash> and
+   *                <quiet> are implied.
+   * \param cid Buffer that receives the NUL-terminated base58 root key
+   * \param cid_size The size of <cid> in bytes
+   *
+   * \return true if the key was computed and fits in <cid>
+   *
+   * Files are chunked and hashed exactly as ipfs_add_ex() would, but no
+   * blocks are written to the blockstore. With IPFS_CHUNKER_FIXED the DAG is
+   * built in the library, and SHA-256 uses the x86 SHA extensions, or AVX2
+   * over eight leaves at a time, where the CPU has them. Rabin chunking runs
+   * `ipfs add --only-hash` in go-ipfs.
+   */
+  bool ipfs_add_hash(const char* path, const ipfs_add_options_t* options, char* cid, size_t cid_size);
+
+  /*!
+   * \brief Re-add a tree, only re-hashing files that changed since last time
+   *
+   * \param path The path to a file or directory
+   * \param index_path The index file, created on the first add
+   * \param options The add options, or NULL for defaults. Directories are
+   *                always added recursively.
+   * \param cid Buffer that receives the NUL-terminated base58 root key
+   * \param cid_size The size of <cid> in bytes
+   *
+   * \return true if the tree was added, the index updated and the key fits
+   *         in <cid>
+   *
+   * The index acts as a staging area (like git): it maps each path and its
+   * (size, mtime, inode) to the key it was added as. Files with a matching
+   * entry keep their key, and only new or modified files are chunked and
+   * hashed. Files and directories are encoded in the library with the
+   * layouts go-ipfs uses, so paths may contain any character, and only the
+   * nodes that changed are written. The root is pinned recursively, and the
+   * root of the previous add is unpinned. If unpinning fails, false is
+   * returned but the index already refers to the new, pinned root.
+   *
+   * Only IPFS_CHUNKER_FIXED is supported; other chunkers return false.
+   * Changing the chunk size, layout or <only_hash> invalidates the index.
+   * Reused keys assume their blocks are still in the repo, which holds as
+   * long as the root the index recorded stays pinned. Hidden files are
+   * skipped, as by ipfs_add().
+   */
+  bool ipfs_add_incremental(const char* path, const char* index_path, const ipfs_add_options_t* options, char* cid, size_t cid_size);
+
   /*!
    * \brief Show IPFS object data
    *
@@ -68,11 +278,92 @@ extern "C"
    */
   void ipfs_cat(const char* ipfs_path);
 
+  /*!
+   * \brief Memory provided by the caller for data returned by the library
+   *
+   * The *_alloc() calls take their result memory from <alloc>, so results can
+   * land in a per-request arena and be released with it. Each call allocates
+   * at most once, and only for the size of the result. Memory handed out in
+   * a successful call belongs to the caller, the library keeps no reference
+   * to it. If the call fails after allocating, the memory is passed to
+   * <free> (if set), so arenas that release in bulk can leave it NULL.
+   *
+   * Empty results don't allocate, the returned pointer is NULL.
+   */
+  typedef struct
+  {
+    void* (*alloc)(size_t size, void* context); ///< Returns NULL on failure
+    void  (*free)(void* ptr, size_t size, void* context);
+    void* context;
+  } ipfs_allocator_t;
+
+  /*!
+   * \brief Read IPFS object data into memory
+   *
+   * \param ipfs_path The path to the IPFS object
+   * \param allocator Provides the memory for the data
+   * \param data Receives the data
+   * \param size Receives the size of the data
+   *
+   * The data is read through go-ipfs into library memory first and then
+   * copied, so it's briefly held twice. Use ipfs_cat_view() to avoid the
+   * copy for files stored locally.
+   *
+   * \return false if the object couldn't be read
+   */
+  bool ipfs_cat_alloc(const char* ipfs_path, const ipfs_allocator_t* allocator, void** data, size_t* size);
+
+  /*!
+   * \brief A piece of data borrowed from the library
+   */
+  typedef struct
+  {
+    const void* data;
+    size_t      size;
+  } ipfs_piece_t;
+
+  /*!
+   * \brief Data borrowed from the library until ipfs_view_release()
+   *
+   * Views point into the read-only memory mapping of the repo's block pack
+   * (see ipfs_repo_pack()). Once its pages are cached, reading packed blocks
+   * takes no system calls. Blocks that are only in the blockstore are read
+   * into memory the view owns, as a mapping per block would soon exceed the
+   * process's limit on mappings. Data that isn't stored locally is fetched
+   * through go-ipfs into memory the view owns as well.
+   *
+   * The data must not be written to.
+   */
+  typedef struct
+  {
+    const ipfs_piece_t* pieces;
+    size_t              piece_count;
+    unsigned long long  size;   ///< Total size of the pieces
+    void*               handle; ///< Owned by the library
+  } ipfs_view_t;
+
+  /*!
+   * \brief Borrow the contents of a file
+   *
+   * \param ipfs_path The path to the file, /ipfs/<key>[/<name>...] or
+   *                  <key>[/<name>...]. Other paths go through go-ipfs.
+   * \param view Receives the contents, one piece per block that holds some
+   *
+   * \return false if the file couldn't be read
+   */
+  bool ipfs_cat_view(const char* ipfs_path, ipfs_view_t* view);
+
+  /*!
+   * \brief Give back the data of a view
+   */
+  void ipfs_view_release(ipfs_view_t* view);
+
   /*!
    * \brief Download IPFS objects
    *
    * \param ipfs_path The path to the IPFS object(s) to be output
    * \param output The path where output should be stored
+   * \param archive Output a TAR archive
    * \param compress Compress the output with GZIP compression
    * \param compression_level The level of compression (1-9)
    *
@@ -85,6 +376,10 @@ extern "C"
    *
    * To compress the output with GZIP compression, set <compress> to true. You
    * may also specify the level of compression in the range 1-9.
+   *
+   * Unpacked trees are written by a pool of worker threads, and compressed
+   * archives are deflated in independent blocks on all cores. The result is
+   * still a single, standard GZIP stream.
    */
   void ipfs_get(const char* ipfs_path, const char* output, bool archive, bool compress, unsigned int compression_level);
 
@@ -159,6 +454,85 @@ extern "C"
    */
   void ipfs_block_get(const char* key);
 
+  /*!
+   * \brief Store a block from memory
+   *
+   * \param data The contents of the block
+   * \param size The size of the block in bytes
+   * \param key Receives the base58 multihash of the block
+   * \param key_size The size of the <key> buffer
+   *
+   * \return false if the block couldn't be stored or <key> is too small
+   */
+  bool ipfs_block_put_data(const void* data, size_t size, char* key, size_t key_size);
+
+  /*!
+   * \brief Read a block into memory
+   *
+   * \param key The base58 multihash of the block
+   * \param buffer Receives the contents of the block
+   * \param buffer_size The size of <buffer>
+   * \param size Receives the size of the block, also when <buffer> is too
+   *             small
+   *
+   * \return false if the block couldn't be read or doesn't fit in <buffer>
+   */
+  bool ipfs_block_get_data(const char* key, void* buffer, size_t buffer_size, size_t* size);
+
+  /*!
+   * \brief Read a block into memory provided by <allocator>
+   *
+   * \param key The base58 multihash of the block
+   * \param allocator Provides the memory for the block (see ipfs_cat_alloc())
+   * \param data Receives the contents of the block
+   * \param size Receives the size of the block
+   *
+   * Unlike ipfs_block_get_data(), the size doesn't need to be known in
+   * advance. In local mode (see ipfs_open()) the block is read from disk
+   * straight into the memory. Otherwise it's read through go-ipfs and
+   * copied.
+   *
+   * \return false if the block couldn't be read
+   */
+  bool ipfs_block_get_alloc(const char* key, const ipfs_allocator_t* allocator, void** data, size_t* size);
+
+  /*!
+   * \brief Borrow the contents of a block
+   *
+   * \param key The base58 multihash of the block
+   * \param view Receives the block as one piece, or none if it's empty (see
+   *             ipfs_cat_view())
+   *
+   * \return false if the block couldn't be read
+   */
+  bool ipfs_block_get_view(const char* key, ipfs_view_t* view);
+
+  /*!
+   * \brief Check whether the repo holds a block, without asking the network
+   *
+   * \param key The base58 multihash of the block
+   *
+   * Most blocks that aren't in the repo are ruled out by an in-memory filter
+   * of the repo's keys without touching the disk. The others are confirmed
+   * against the blockstore. Only repos with a flatfs blockstore are
+   * supported.
+   *
+   * \return true if the block is stored in the repo
+   */
+  bool ipfs_block_has(const char* key);
+
+  /*!
+   * \brief Check whether the repo holds each of a list of blocks
+   *
+   * \param keys The base58 multihashes of the blocks
+   * \param count The number of <keys>
+   * \param results Receives for each key whether the block is stored in the
+   *                repo
+   *
+   * \return The number of blocks stored in the repo
+   */
+  size_t ipfs_block_has_many(const char* const* keys, size_t count, bool* results);
+
   /*!
    * \brief Outputs the raw bytes in an IPFS object
    *
@@ -169,6 +543,18 @@ extern "C"
    */
   void ipfs_object_data(const char* key);
 
+  /*!
+   * \brief Read the data of a DAG node into memory provided by <allocator>
+   *
+   * \param key Key of the object, in base58-encoded multihash format
+   * \param allocator Provides the memory for the data (see ipfs_cat_alloc())
+   * \param data Receives the data
+   * \param size Receives the size of the data
+   *
+   * \return false if the object couldn't be read or isn't a DAG node
+   */
+  bool ipfs_object_data_alloc(const char* key, const ipfs_allocator_t* allocator, void** data, size_t* size);
+
   /*!
    * \brief Outputs the links pointed to by the specified object
    *
@@ -190,6 +576,22 @@ extern "C"
    */
   void ipfs_object_get(const char* key);
 
+  /*!
+   * \brief Get the DAG node named by <key> as JSON, in memory provided by
+   *        <allocator>
+   *
+   * \param key Key of the object, in base58-encoded multihash format
+   * \param allocator Provides the memory for the JSON (see ipfs_cat_alloc())
+   * \param json Receives the JSON text, which isn't null-terminated
+   * \param size Receives the size of the JSON text
+   *
+   * The JSON is read through go-ipfs into library memory first and then
+   * copied, so it's briefly held twice.
+   *
+   * \return false if the object couldn't be read
+   */
+  bool ipfs_object_get_alloc(const char* key, const ipfs_allocator_t* allocator, void** json, size_t* size);
+
   /*!
    * \brief Stores input as a DAG object, outputs its key
    *
@@ -215,6 +617,102 @@ extern "C"
    *    CumulativeSize  int cumulative size of object and its references
    */
   void ipfs_object_stat(const char* key);
+
+  /*!
+   * \brief Write a whole DAG to a file descriptor as a CAR archive
+   *
+   * \param root The base58 multihash of the root of the DAG
+   * \param fd Where to write the archive (a file, pipe or socket)
+   *
+   * \return false if a block of the DAG is missing or <fd> can't be written
+   *
+   * The archive is a CARv1 stream naming <root>, followed by every block of
+   * the DAG once. It's the fastest way to move a dataset between nodes.
+   * Blocks are read from the repo's blockstore directly, and blocks it
+   * doesn't have from the daemon, if one is running. Without a daemon, blocks
+   * aren't fetched from the network and the whole DAG must be in the repo.
+   */
+  bool ipfs_dag_export(const char* root, int fd);
+
+  /*!
+   * \brief Read a CAR archive from a file descriptor into the repo
+   *
+   * \param fd The archive, e.g. written by ipfs_dag_export()
+   * \param roots Receives the base58 multihashes of the roots named by the
+   *              archive, one per line, or NULL
+   * \param roots_size The size of <roots>
+   *
+   * \return The number of roots, or -1 if the archive is invalid, a block
+   *         doesn't match its key, or the blocks couldn't be stored
+   *
+   * Blocks are verified and written in large batches. They go straight to
+   * the blockstore unless a daemon serves the repo, so importing is limited
+   * by disk and input bandwidth, and are uploaded to the daemon's API in
+   * parallel otherwise. Roots contained in the archive are pinned
+   * recursively. Keys must be sha2-256 dag-pb (CIDv0, or CIDv1 with the same
+   * multihash).
+   */
+  int ipfs_dag_import(int fd, char* roots, size_t roots_size);
+
+  /*!
+   * \brief Builds DAG nodes in memory and stores them with one call
+   *
+   * Where ipfs_object_put() stores one serialized node per call, a builder
+   * collects nodes with binary data and links, and ipfs_dag_builder_flush()
+   * encodes them in parallel and stores them in one batch. A builder must not
+   * be used by several threads at once.
+   */
+  typedef struct ipfs_dag_builder ipfs_dag_builder_t;
+
+  /*!
+   * \brief Create an empty builder. Free it with ipfs_dag_builder_free().
+   */
+  ipfs_dag_builder_t* ipfs_dag_builder_new(void);
+
+  void ipfs_dag_builder_free(ipfs_dag_builder_t* builder);
+
+  /*!
+   * \brief Add an empty node
+   *
+   * \return The ID of the node, or -1 on error. IDs count up from 0 in the
+   *         order nodes are added.
+   */
+  int ipfs_dag_node_new(ipfs_dag_builder_t* builder);
+
+  /*!
+   * \brief Set the data of a node (e.g. unixfs metadata)
+   */
+  bool ipfs_dag_node_set_data(ipfs_dag_builder_t* builder, int node, const void* data, size_t size);
+
+  /*!
+   * \brief Link a node to an existing block
+   *
+   * \param key The base58 multihash of the block
+   * \param name The name of the link (e.g. a file name in a directory)
+   * \param size The cumulative size of the block and everything below it
+   */
+  bool ipfs_dag_node_add_link(ipfs_dag_builder_t* builder, int node, const char* key, const char* name, unsigned long long size);
+
+  /*!
+   * \brief Link a node to another node in the builder
+   *
+   * \param child A node added before <node>. Its key and cumulative size are
+   *              filled in when the builder is flushed.
+   */
+  bool ipfs_dag_node_add_child(ipfs_dag_builder_t* builder, int node, int child, const char* name);
+
+  /*!
+   * \brief Encode and store every node in the builder, then empty it
+   *
+   * \param root The node whose key is returned
+   * \param key Receives the base58 multihash of <root>, or NULL
+   * \param key_size The size of <key>
+   *
+   * Nodes are encoded on the worker pool, one level of the DAG at a time, and
+   * written in one batch: to the blockstore directly unless a daemon serves
+   * the repo, and uploaded to the daemon's API in parallel otherwise.
+   */
+  bool ipfs_dag_builder_flush(ipfs_dag_builder_t* builder, int root, char* key, size_t key_size);
   ///}
 
   /// @name Advanced commands
@@ -267,9 +765,62 @@ extern "C"
    * \brief Get the value currently published at an IPNS name
    *
    * \param name The IPNS name to resolve. Defaults to your node's peerID
+   *
+   * Names other than the node's own are answered from the name cache, see
+   * ipfs_name_resolve_path().
    */
   void ipfs_name_resolve(const char* name);
 
+  /*!
+   * \brief Resolve an IPNS name through the name cache
+   *
+   * \param name The IPNS name, with or without the /ipns/ prefix
+   * \param path Receives the path published at <name>
+   * \param path_size The size of the <path> buffer
+   *
+   * \return false if the name couldn't be resolved or <path> is too small
+   *
+   * Resolutions are cached for a TTL, 60 seconds by default. Names in use are
+   * refreshed in the background before they expire, and an expired entry is
+   * still answered for one more TTL while it's refreshed. Concurrent lookups
+   * of the same name share one resolution, and failures are remembered for
+   * 5 seconds. Publishing with ipfs_name_publish() drops the cached value of
+   * the name.
+   */
+  bool ipfs_name_resolve_path(const char* name, char* path, size_t path_size);
+
+  /*!
+   * \brief Configure the name cache
+   *
+   * \param ttl_ms How long resolutions stay fresh, or 0 to disable the cache.
+   *               go-ipfs doesn't report the TTL of the records it resolves,
+   *               so one TTL applies to all names.
+   * \param max_entries How many names to keep. The least recently used names
+   *                    are dropped first.
+   */
+  void ipfs_name_cache_configure(unsigned int ttl_ms, unsigned int max_entries);
+
+  /*!
+   * \brief Statistics of the name cache
+   */
+  typedef struct
+  {
+    unsigned long long hits;       ///< Lookups answered from a fresh entry
+    unsigned long long stale_hits; ///< Lookups answered from an expired entry being refreshed
+    unsigned long long misses;     ///< Lookups that waited for a resolution
+    unsigned long long coalesced;  ///< Misses that joined a resolution already running
+    unsigned long long refreshes;  ///< Background refreshes started
+    unsigned long long failures;   ///< Resolutions that failed
+    unsigned int entries;          ///< Names in the cache
+  } ipfs_name_cache_stats_t;
+
+  /*!
+   * \brief Read the statistics of the name cache
+   *
+   * \return false if <stats> is NULL or the platform has no name cache
+   */
+  bool ipfs_name_cache_stats(ipfs_name_cache_stats_t* stats);
+
   /*!
    * \brief Unpin an object from local storage
    *
@@ -316,6 +867,28 @@ extern "C"
    * and remove ones that are not pinned in order to reclaim hard disk space.
    */
   void ipfs_repo_gc(bool quiet);
+
+  /*!
+   * \brief Pack the blocks of DAGs into one file for reading through a
+   *        memory mapping
+   *
+   * \param roots The base58 multihashes of the DAGs' roots
+   * \param count The number of <roots>
+   * \param block_count Receives the number of blocks packed, can be NULL
+   *
+   * The pack replaces the repo's previous pack, so list all DAGs worth
+   * serving from memory. Blocks are laid out in the order files are read,
+   * which turns reading a file into sequential I/O. They stay in the
+   * blockstore, as go-ipfs doesn't use the pack, so packed blocks take twice
+   * their size on disk. Garbage collection doesn't shrink the pack, repack
+   * to drop blocks from it. Views (see ipfs_view_t)
+   * are served from the pack in any mode, and notice a new pack within a
+   * second.
+   *
+   * \return false if a block isn't stored in the repo, or the repo has no
+   *         flatfs blockstore
+   */
+  bool ipfs_repo_pack(const char* const* roots, size_t count, unsigned long long* block_count);
   ///}
 
   /// @name Network commands
@@ -411,6 +984,41 @@ extern "C"
    */
   void ipfs_swarm_connect(const char* address);
 
+  /*!
+   * \brief Outcome of dialing one peer with ipfs_swarm_connect_many()
+   */
+  typedef enum
+  {
+    IPFS_CONNECT_OK,       ///< A new connection was opened
+    IPFS_CONNECT_EXISTING, ///< The peer was already connected and wasn't dialed
+    IPFS_CONNECT_FAILED,   ///< The dial failed or the address is invalid
+    IPFS_CONNECT_TIMEOUT,  ///< The dial didn't finish within the timeout
+  } ipfs_connect_status_t;
+
+  typedef struct
+  {
+    ipfs_connect_status_t status;
+    unsigned long long    latency_ns; ///< Time taken by the dial, 0 for existing connections
+  } ipfs_swarm_connect_result_t;
+
+  /*!
+   * \brief Open connections to many addresses in parallel
+   *
+   * \param addrs The peer multiaddrs, ending in /ipfs/<peerID>
+   * \param n The number of addresses
+   * \param max_concurrency The maximum number of dials in flight
+   * \param timeout_ms Timeout for each dial, or 0 for none
+   * \param results Array of <n> results, one per address
+   *
+   * \return The number of peers that are connected afterwards
+   *
+   * Requires a running daemon. The dials are sent to the daemon's HTTP API
+   * concurrently, so bringing a node into a mesh of hundreds of peers takes
+   * about as long as the slowest dial. Peers that are already connected are
+   * reported as IPFS_CONNECT_EXISTING without being dialed again.
+   */
+  unsigned int ipfs_swarm_connect_many(const char* const* addrs, unsigned int n, unsigned int max_concurrency, unsigned int timeout_ms, ipfs_swarm_connect_result_t* results);
+
   /*!
    * \brief Run a 'findClosestPeers' query through the DHT
    *
@@ -430,6 +1038,36 @@ extern "C"
    */
   void ipfs_dht_findprovs(const char* key, bool verbose);
 
+  /*!
+   * \brief Called by ipfs_dht_findprovs_stream() for each provider found
+   *
+   * \param peer_id The ID of the provider
+   * \param addrs The provider's known multiaddrs, valid for this call only
+   * \param addr_count The number of addresses in <addrs>
+   * \param context The context passed to ipfs_dht_findprovs_stream()
+   *
+   * \return true to keep searching, false to stop the query
+   */
+  typedef bool (*ipfs_provider_cb)(const char* peer_id, const char* const* addrs, unsigned int addr_count, void* context);
+
+  /*!
+   * \brief Run a 'FindProviders' query, delivering providers as they arrive
+   *
+   * \param key The key to find providers for
+   * \param max_providers Stop after this many providers, or 0 for no limit
+   * \param cb Called on the calling thread for each distinct provider
+   * \param context Passed through to <cb>
+   *
+   * \return The number of providers delivered, or -1 if the query failed
+   *         before finding any
+   *
+   * Requires a running daemon. Providers are delivered as soon as the DHT
+   * reports them instead of when the query finishes. Once <max_providers> are
+   * found, or <cb> returns false, the query is cancelled on the daemon so it
+   * sends no more DHT traffic.
+   */
+  int ipfs_dht_findprovs_stream(const char* key, unsigned int max_providers, ipfs_provider_cb cb, void* context);
+
   /*!
    * \brief Run a 'FindPeer' query through the DHT
    *
@@ -449,6 +1087,70 @@ extern "C"
    */
   void ipfs_ping(const char* peer_id, unsigned int count);
 
+  /*!
+   * \brief Summary of the probes sent by ipfs_ping_samples()
+   */
+  typedef struct
+  {
+    unsigned int       sent;     ///< Number of probes sent
+    unsigned int       received; ///< Number of probes answered
+    unsigned long long min_ns;   ///< Fastest round trip
+    unsigned long long mean_ns;  ///< Average round trip
+    unsigned long long p99_ns;   ///< 99th percentile round trip (nearest rank)
+  } ipfs_ping_stats_t;
+
+  /*!
+   * \brief Measure the latency of a connection, returning the samples
+   *
+   * \param peer_id ID of peer to be pinged
+   * \param count The number of ping messages to send, or 0 for the default
+   *              of 10
+   * \param rtts_ns Array of at least <count> entries (10 if <count> is 0) that
+   *                receives the round-trip time of each answered probe, or
+   *                NULL
+   * \param stats Receives the summary, or NULL
+   *
+   * \return The number of answered probes, or -1 if the peer couldn't be
+   *         pinged
+   *
+   * Requires a running daemon. Every sample also updates the latency table
+   * read by ipfs_ping_latency().
+   */
+  int ipfs_ping_samples(const char* peer_id, unsigned int count, unsigned long long* rtts_ns, ipfs_ping_stats_t* stats);
+
+  /*!
+   * \brief Keep the latency table up to date in the background
+   *
+   * \param peer_ids The peers to ping
+   * \param n The number of peers
+   * \param interval_ms Time between pings of the same peer
+   * \param alpha Weight of a new sample in the moving average (0 < alpha <= 1),
+   *              or 0 for the default of 0.2
+   *
+   * Each peer gets one probe per interval, and its entry in the latency table
+   * becomes an exponentially weighted moving average of the round trips.
+   * Calling this again replaces the monitored peers.
+   */
+  bool ipfs_ping_monitor_start(const char* const* peer_ids, unsigned int n, unsigned int interval_ms, double alpha);
+
+  /*!
+   * \brief Stop the background pings. The latency table is kept.
+   */
+  void ipfs_ping_monitor_stop(void);
+
+  /*!
+   * \brief Look up a peer's average latency in the latency table
+   *
+   * \param peer_id The peer to look up
+   * \param ewma_ns Receives the moving average of the round trips
+   * \param samples Receives the number of samples, or NULL
+   *
+   * \return false if the peer has never been pinged
+   *
+   * This is an in-memory lookup, cheap enough to rank peers on every fetch.
+   */
+  bool ipfs_ping_latency(const char* peer_id, unsigned long long* ewma_ns, unsigned int* samples);
+
   /*!
    * \brief Generates a network diagnostics report
    *
@@ -484,6 +1186,9 @@ extern "C"
    *
    * \param key The key of the config entry (e.g. "Addresses.API")
    * \param value The value to set the config entry to
+   *
+   * Each call rewrites the whole config file. To change many keys, stage them
+   * on a handle from ipfs_config_open() and commit them together.
    */
   void ipfs_config_set(const char* key, const char* value);
 
@@ -513,10 +1218,216 @@ extern "C"
    */
   void ipfs_config_replace(const char* file);
 
+  /*!
+   * \brief A repo's config, loaded once for many reads and writes
+   *
+   * Where ipfs_config_get() and ipfs_config_set() read and rewrite the whole
+   * config file on every call, a handle parses it once, answers gets from
+   * memory and stages sets until ipfs_config_commit(). Keys are dotted paths
+   * (e.g. "Addresses.API"). A handle must not be used by several threads at
+   * once.
+   */
+  typedef struct ipfs_config ipfs_config_t;
+
+  /*!
+   * \brief Load a repo's config
+   *
+   * \param repo_path The repo, or NULL for $IPFS_PATH (default ~/.ipfs)
+   *
+   * \return The handle, or NULL if the config couldn't be read. Free it with
+   *         ipfs_config_close().
+   */
+  ipfs_config_t* ipfs_config_open(const char* repo_path);
+
+  /*!
+   * \brief Free a config handle, discarding uncommitted changes
+   */
+  void ipfs_config_close(ipfs_config_t* config);
+
+  /*!
+   * \brief Typed reads of a config value
+   *
+   * \return false if the key doesn't exist or holds a different type. Strings
+   *         also fail if they don't fit in <value_size> bytes with the
+   *         terminating NUL.
+   */
+  bool ipfs_config_get_int(const ipfs_config_t* config, const char* key, long long* value);
+  bool ipfs_config_get_bool(const ipfs_config_t* config, const char* key, bool* value);
+  bool ipfs_config_get_string(const ipfs_config_t* config, const char* key, char* value, size_t value_size);
+
+  /*!
+   * \brief Get the number of elements in an array value, or -1 if the key
+   *        isn't an array
+   */
+  int ipfs_config_get_array_size(const ipfs_config_t* config, const char* key);
+
+  /*!
+   * \brief Read a string element of an array value (e.g. "Bootstrap")
+   */
+  bool ipfs_config_get_array_string(const ipfs_config_t* config, const char* key, unsigned int index, char* value, size_t value_size);
+
+  /*!
+   * \brief Stage a change to the config
+   *
+   * Missing parent objects are created. The change is visible to gets on the
+   * same handle immediately and is written by ipfs_config_commit().
+   *
+   * \return false if a parent of <key> isn't an object, or <json> isn't valid
+   *         JSON
+   */
+  bool ipfs_config_set_int(ipfs_config_t* config, const char* key, long long value);
+  bool ipfs_config_set_bool(ipfs_config_t* config, const char* key, bool value);
+  bool ipfs_config_set_string(ipfs_config_t* config, const char* key, const char* value);
+  bool ipfs_config_set_strings(ipfs_config_t* config, const char* key, const char* const* values, unsigned int n);
+  bool ipfs_config_set_json(ipfs_config_t* config, const char* key, const char* json);
+
+  /*!
+   * \brief Write all staged changes to the config file at once
+   *
+   * \param config The config handle
+   * \param notify_node Hand the new config to the daemon serving the repo,
+   *                    if one is running
+   *
+   * \return false if the config couldn't be written or the daemon rejected
+   *         it
+   *
+   * The file is replaced atomically, so a crash leaves either the old or the
+   * new config. Changes others made to the file since it was opened are kept.
+   * A running daemon keeps its own copy of the config and would overwrite the
+   * file with it on its next config change. Notifying it replaces its copy
+   * with one request however many keys changed. The daemon only applies most
+   * keys when it restarts.
+   */
+  bool ipfs_config_commit(ipfs_config_t* config, bool notify_node);
+
   /*!
    * \brief Show IPFS version information
    */
   void ipfs_version(void);
+
+  /*!
+   * \brief Tune the Go runtime embedded in the library
+   *
+   * \param max_procs Maximum number of threads running Go code at once, or 0
+   *                  to leave unchanged
+   * \param gc_percent Heap growth, in percent, that triggers a collection.
+   *                   Negative disables the collector, 0 leaves it unchanged.
+   * \param memory_limit_bytes Soft limit on the memory used by the Go runtime,
+   *                           or 0 to leave unchanged
+   *
+   * \return false if a setting couldn't be applied
+   *
+   * The defaults are one thread per CPU and a collection every time the heap
+   * doubles, with no memory limit. The GOMAXPROCS, GOGC and GOMEMLIMIT
+   * environment variables are read when the runtime starts and can be used to
+   * set these instead.
+   */
+  bool ipfs_runtime_configure(unsigned int max_procs, int gc_percent, unsigned long long memory_limit_bytes);
+
+  /*!
+   * \brief Memory and scheduler statistics of the embedded Go runtime
+   */
+  typedef struct
+  {
+    unsigned long long heap_alloc_bytes;  ///< Bytes of allocated heap objects
+    unsigned long long heap_sys_bytes;    ///< Bytes of heap memory obtained from the OS
+    unsigned long long heap_objects;      ///< Number of allocated heap objects
+    unsigned long long total_alloc_bytes; ///< Bytes allocated since the runtime started
+    unsigned long long sys_bytes;         ///< Total bytes of memory obtained from the OS
+    unsigned long long next_gc_bytes;     ///< Heap size that triggers the next collection
+    unsigned long long num_gc;            ///< Number of completed collections
+    unsigned long long gc_pause_total_ns; ///< Time spent stopped for collections
+    unsigned long long gc_pause_last_ns;  ///< Length of the most recent pause
+    unsigned long long gc_pause_max_ns;   ///< Longest of the last 256 pauses
+    unsigned long long goroutines;        ///< Number of goroutines
+    unsigned long long max_procs;         ///< Current GOMAXPROCS
+  } ipfs_runtime_stats_t;
+
+  /*!
+   * \brief Read the statistics of the embedded Go runtime
+   *
+   * \param stats Receives the statistics
+   *
+   * \return false if the statistics couldn't be read
+   *
+   * Reading the statistics briefly stops the Go runtime, so poll this at most
+   * a few times per second.
+   */
+  bool ipfs_runtime_stats(ipfs_runtime_stats_t* stats);
+
+  /*!
+   * \brief Priority classes of library calls
+   */
+  typedef enum
+  {
+    IPFS_PRIORITY_DEFAULT,     ///< Each call's own class
+    IPFS_PRIORITY_INTERACTIVE, ///< Latency-sensitive reads
+    IPFS_PRIORITY_NORMAL,      ///< Everything else
+    IPFS_PRIORITY_BULK,        ///< Large background jobs
+  } ipfs_priority_t;
+
+  /*!
+   * \brief Set the priority class of the library calls made by the calling
+   *        thread
+   *
+   * \param priority The class, or IPFS_PRIORITY_DEFAULT to let each call use
+   *                 its own: interactive for ipfs_cat() and block and object
+   *                 reads, bulk for adding, pinning, garbage collection and DAG
+   *                 import and export, and normal for the rest
+   *
+   * go-ipfs commands, requests to the daemon's API, which do the block
+   * fetches, and blockstore reads and writes are admitted in weighted fair
+   * order between the classes, and each class has a limit on how many run at
+   * once. Work a call hands to the library's worker threads keeps its class.
+   */
+  void ipfs_set_priority(ipfs_priority_t priority);
+
+  /*!
+   * \brief Resources shared between priority classes
+   */
+  typedef enum
+  {
+    IPFS_SCHEDULER_COMMANDS, ///< go-ipfs commands, which run one at a time
+    IPFS_SCHEDULER_DISK,     ///< Blockstore reads and writes
+    IPFS_SCHEDULER_API,      ///< Requests to the daemon's HTTP API
+  } ipfs_scheduler_t;
+
+  /*!
+   * \brief Change how a class shares a resource
+   *
+   * \param scheduler The resource
+   * \param priority The class
+   * \param weight The class's share when classes compete, relative to the
+   *               others. The defaults are 4 for interactive, 2 for normal and
+   *               1 for bulk.
+   * \param max_running How many of the class's requests may run at once. By
+   *                    default interactive requests may use the whole
+   *                    resource (one command, 16 API requests, or two disk
+   *                    requests per CPU), normal requests half of it and bulk
+   *                    requests a quarter, but at least one.
+   *
+   * \return false if an argument is invalid
+   */
+  bool ipfs_scheduler_configure(ipfs_scheduler_t scheduler, ipfs_priority_t priority, unsigned int weight, unsigned int max_running);
+
+  /*!
+   * \brief Statistics of a priority class on a resource
+   */
+  typedef struct
+  {
+    unsigned int queued;              ///< Requests waiting now
+    unsigned int running;             ///< Requests running now
+    unsigned long long admitted;      ///< Requests admitted so far
+    unsigned long long wait_total_ns; ///< Time admitted requests waited in total
+    unsigned long long wait_max_ns;   ///< Longest time a request waited
+  } ipfs_scheduler_stats_t;
+
+  /*!
+   * \brief Read the statistics of a priority class on a resource
+   *
+   * \return false if an argument is invalid
+   */
+  bool ipfs_scheduler_stats(ipfs_scheduler_t scheduler, ipfs_priority_t priority, ipfs_scheduler_stats_t* stats);
   ///}
 #ifdef __cplusplus
 }
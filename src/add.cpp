@@ -0,0 +1,96 @@
+/*
+ *    Copyright (C) 2015 juztamau5
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *    The above copyright notice and this permission notice shall be included in
+ *    all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include "add.h"
+
+#include <sstream>
+
+using namespace IPSF;
+
+namespace
+{
+  bool GetChunker(const ipfs_add_options_t& options, std::string& chunker)
+  {
+    std::stringstream value;
+
+    switch (options.chunker)
+    {
+    case IPFS_CHUNKER_FIXED:
+      if (options.chunk_size > 0)
+        value << "size-" << options.chunk_size;
+      break;
+    case IPFS_CHUNKER_RABIN:
+      value << "rabin";
+      if (options.chunk_min > 0 || options.chunk_max > 0)
+      {
+        if (options.chunk_min == 0 || options.chunk_min > options.chunk_avg || options.chunk_avg > options.chunk_max)
+          return false;
+        value << "-" << options.chunk_min << "-" << options.chunk_avg << "-" << options.chunk_max;
+      }
+      else if (options.chunk_avg > 0)
+      {
+        value << "-" << options.chunk_avg;
+      }
+      break;
+    default:
+      return false;
+    }
+
+    chunker = value.str();
+    return true;
+  }
+}
+
+bool IPSF::GetAddCommand(const std::string& path, const ipfs_add_options_t& options, std::string& cmd)
+{
+  std::string chunker;
+  if (!GetChunker(options, chunker))
+    return false;
+
+  std::stringstream args;
+
+  args << "ipfs add";
+  args << " " << path;
+  args << " -r " << (options.recursive ? "true" : "false");
+  args << " -q " << (options.quiet ? "true" : "false");
+  args << " -p " << (options.progress ? "true" : "false");
+  args << " -w " << (options.wrap_with_directory ? "true" : "false");
+  args << " -t " << (options.trickle ? "true" : "false");
+  if (!chunker.empty())
+    args << " -s " << chunker;
+  args << " -n " << (options.only_hash ? "true" : "false");
+
+  cmd = args.str();
+  return true;
+}
+
+bool IPSF::GetAddFingerprint(const ipfs_add_options_t& options, std::string& fingerprint)
+{
+  std::string chunker;
+  if (!GetChunker(options, chunker))
+    return false;
+
+  fingerprint = "chunker=" + (chunker.empty() ? std::string("default") : chunker) +
+                ",trickle=" + (options.trickle ? "true" : "false");
+  return true;
+}
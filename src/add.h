@@ -0,0 +1,49 @@
+/*
+ *    Copyright (C) 2015 juztamau5
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *    The above copyright notice and this permission notice shall be included in
+ *    all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+#ifndef __IPSF_ADD_H__
+#define __IPSF_ADD_H__
+
+#include "ipfs/libipfs.h"
+
+#include <string>
+
+namespace IPSF
+{
+  /*!
+   * \brief Build the `ipfs add` command line for <path>
+   *
+   * \return false if <options> are invalid
+   */
+  bool GetAddCommand(const std::string& path, const ipfs_add_options_t& options, std::string& cmd);
+
+  /*!
+   * \brief Describe the options that change the keys `ipfs add` produces
+   *
+   * Keys computed under one fingerprint can't be reused under another.
+   *
+   * \return false if <options> are invalid
+   */
+  bool GetAddFingerprint(const ipfs_add_options_t& options, std::string& fingerprint);
+}
+
+#endif // __IPSF_ADD_H__
@@ -0,0 +1,707 @@
+/*
+ *    Copyright (C) 2015 juztamau5
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *    The above copyright notice and this permission notice shall be included in
+ *    all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include "addindex.h"
+#include "add.h"
+#include "invoke.h"
+#include "merkledag.h"
+#include "multihash.h"
+#include "node.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace IPSF;
+
+namespace
+{
+  const char* const INDEX_HEADER = "libipfs-add-index 2";
+
+  // go-ipfs importer defaults: 256 KiB chunks, and as many links as fit in
+  // roughly 8 KiB
+  const size_t       DEFAULT_CHUNK_SIZE = 256 * 1024;
+  const size_t       LINKS_PER_NODE = 8192 / (34 + 8 + 5);
+  const unsigned int TRICKLE_LAYER_REPEAT = 4;
+
+  // Leaves are read and hashed this many at a time, side by side where the
+  // SHA-256 kernel allows
+  const size_t LEAF_GROUP_SIZE = 8;
+
+  // Queued blocks are stored in batches of about this size
+  const size_t STORE_BATCH_BYTES = 32 * 1024 * 1024;
+
+  int64_t GetMtime(const struct stat& st)
+  {
+#if defined(__APPLE__)
+    return static_cast<int64_t>(st.st_mtimespec.tv_sec) * 1000000000 + st.st_mtimespec.tv_nsec;
+#else
+    return static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+#endif
+  }
+
+  std::string GetBaseName(std::string path)
+  {
+    while (path.size() > 1 && path[path.size() - 1] == '/')
+      path.erase(path.size() - 1);
+
+    size_t pos = path.rfind('/');
+    return pos == std::string::npos ? path : path.substr(pos + 1);
+  }
+
+  /*!
+   * \brief Reads a file in fixed-size chunks, looking one chunk ahead so the
+   *        end is known before it's reached
+   */
+  class CChunkReader
+  {
+  public:
+    CChunkReader(void) : m_fd(-1), m_chunkSize(0), m_bFailed(false) { }
+    ~CChunkReader(void) { if (m_fd >= 0) close(m_fd); }
+
+    bool Open(const std::string& path, size_t chunkSize)
+    {
+      m_fd = open(path.c_str(), O_RDONLY | O_NOFOLLOW);
+      m_chunkSize = chunkSize;
+      return m_fd >= 0 && ReadAhead();
+    }
+
+    bool Done(void) const { return m_next.empty(); }
+    bool Failed(void) const { return m_bFailed; }
+
+    /*!
+     * \brief Take the next chunk, which is empty at the end of the file
+     */
+    bool Next(std::string& chunk)
+    {
+      chunk.swap(m_next);
+      return ReadAhead();
+    }
+
+  private:
+    bool ReadAhead(void)
+    {
+      m_next.resize(m_chunkSize);
+
+      size_t bytesRead = 0;
+      while (bytesRead < m_chunkSize)
+      {
+        ssize_t result = read(m_fd, &m_next[bytesRead], m_chunkSize - bytesRead);
+        if (result < 0 && errno == EINTR)
+          continue;
+        if (result < 0)
+          m_bFailed = true;
+        if (result <= 0)
+          break;
+        bytesRead += static_cast<size_t>(result);
+      }
+
+      m_next.resize(bytesRead);
+      return !m_bFailed;
+    }
+
+    int         m_fd;
+    size_t      m_chunkSize;
+    std::string m_next;
+    bool        m_bFailed;
+  };
+
+  class CIncrementalAdd
+  {
+  public:
+    CIncrementalAdd(const ipfs_add_options_t& options, const CAddIndex& previous, CAddIndex& next) :
+      m_chunkSize(options.chunk_size > 0 ? options.chunk_size : DEFAULT_CHUNK_SIZE),
+      m_bTrickle(options.trickle),
+      m_bOnlyHash(options.only_hash),
+      m_previous(previous),
+      m_next(next),
+      m_pendingBytes(0)
+    {
+    }
+
+    bool AddPath(const std::string& path, DagLink& link);
+
+    /*!
+     * \brief Encode and store a node unless its key is unchanged
+     *
+     * Nodes with an empty <path> aren't indexed.
+     */
+    bool AddNode(const std::vector<DagLink>& links, const std::string& data, const std::string& path, CAddIndex::Entry entry, DagLink& link);
+
+    /*!
+     * \brief Store the blocks that are still queued
+     */
+    bool Flush(void);
+
+  private:
+    // A unixfs file node under construction
+    struct FileNode
+    {
+      std::string           contents;
+      std::vector<DagLink>  links;
+      std::vector<uint64_t> blockSizes;
+    };
+
+    bool AddFile(const std::string& path, const struct stat& st, DagLink& link);
+    bool AddDirectory(const std::string& path, const struct stat& st, DagLink& link);
+    bool AddSymlink(const std::string& path, const struct stat& st, DagLink& link);
+
+    // File layouts, built as go-ipfs builds them so the keys match
+    bool BuildBalanced(CChunkReader& reader, DagLink& link);
+    bool FillBalanced(CChunkReader& reader, FileNode& node, unsigned int depth);
+    bool BuildTrickle(CChunkReader& reader, DagLink& link);
+    bool FillTrickle(CChunkReader& reader, FileNode& node, unsigned int depth);
+    bool FillLayer(CChunkReader& reader, FileNode& node);
+    bool AddChild(FileNode& node, const FileNode& child);
+    bool FinishFileNode(const FileNode& node, DagLink& link);
+
+    /*!
+     * \brief Queue a block to be stored, storing the queue once it's large
+     */
+    bool QueueBlock(const std::string& multihash, const std::string& block);
+
+    static bool IsUnchanged(const CAddIndex::Entry* entry, char type, const struct stat& st);
+
+    const size_t     m_chunkSize;
+    const bool       m_bTrickle;
+    const bool       m_bOnlyHash;
+    const CAddIndex& m_previous;
+    CAddIndex&       m_next;
+
+    std::vector<std::pair<std::string, std::string>> m_pending;
+    size_t                                           m_pendingBytes;
+  };
+
+  bool CIncrementalAdd::AddPath(const std::string& path, DagLink& link)
+  {
+    struct stat st;
+    if (lstat(path.c_str(), &st) != 0)
+      return false;
+
+    if (S_ISREG(st.st_mode))
+      return AddFile(path, st, link);
+    if (S_ISDIR(st.st_mode))
+      return AddDirectory(path, st, link);
+    if (S_ISLNK(st.st_mode))
+      return AddSymlink(path, st, link);
+
+    // Sockets, devices and pipes can't be added
+    return false;
+  }
+
+  bool CIncrementalAdd::AddFile(const std::string& path, const struct stat& st, DagLink& link)
+  {
+    CAddIndex::Entry entry;
+
+    const CAddIndex::Entry* previous = m_previous.Find(path);
+    if (IsUnchanged(previous, 'f', st))
+    {
+      entry = *previous;
+      if (!DecodeBase58(entry.cid, link.hash))
+        return false;
+      link.size = entry.cumulativeSize;
+    }
+    else
+    {
+      CChunkReader reader;
+      if (!reader.Open(path, m_chunkSize))
+        return false;
+
+      if (!(m_bTrickle ? BuildTrickle(reader, link) : BuildBalanced(reader, link)) || reader.Failed())
+        return false;
+
+      entry.type = 'f';
+      entry.size = static_cast<uint64_t>(st.st_size);
+      entry.mtime = GetMtime(st);
+      entry.inode = static_cast<uint64_t>(st.st_ino);
+      entry.cumulativeSize = link.size;
+      entry.cid = EncodeBase58(link.hash);
+    }
+
+    m_next.Set(path, entry);
+    return true;
+  }
+
+  bool CIncrementalAdd::BuildBalanced(CChunkReader& reader, DagLink& link)
+  {
+    // Each level's root becomes the first child of the next level's root
+    FileNode root;
+    for (unsigned int depth = 0; !reader.Done(); depth++)
+    {
+      FileNode next;
+      if (depth > 0 && !AddChild(next, root))
+        return false;
+      if (!FillBalanced(reader, next, depth))
+        return false;
+      std::swap(root, next);
+    }
+
+    return FinishFileNode(root, link);
+  }
+
+  bool CIncrementalAdd::FillBalanced(CChunkReader& reader, FileNode& node, unsigned int depth)
+  {
+    if (depth == 0)
+      return reader.Next(node.contents);
+    if (depth == 1)
+      return FillLayer(reader, node);
+
+    while (node.links.size() < LINKS_PER_NODE && !reader.Done())
+    {
+      FileNode child;
+      if (!FillBalanced(reader, child, depth - 1) || !AddChild(node, child))
+        return false;
+    }
+
+    return true;
+  }
+
+  bool CIncrementalAdd::BuildTrickle(CChunkReader& reader, DagLink& link)
+  {
+    FileNode root;
+    if (!FillLayer(reader, root))
+      return false;
+
+    for (unsigned int depth = 1; !reader.Done(); depth++)
+    {
+      for (unsigned int i = 0; i < TRICKLE_LAYER_REPEAT && !reader.Done(); i++)
+      {
+        FileNode next;
+        if (!FillTrickle(reader, next, depth) || !AddChild(root, next))
+          return false;
+      }
+    }
+
+    return FinishFileNode(root, link);
+  }
+
+  bool CIncrementalAdd::FillTrickle(CChunkReader& reader, FileNode& node, unsigned int depth)
+  {
+    if (!FillLayer(reader, node))
+      return false;
+
+    for (unsigned int i = 1; i < depth && !reader.Done(); i++)
+    {
+      for (unsigned int j = 0; j < TRICKLE_LAYER_REPEAT && !reader.Done(); j++)
+      {
+        FileNode next;
+        if (!FillTrickle(reader, next, i) || !AddChild(node, next))
+          return false;
+      }
+    }
+
+    return true;
+  }
+
+  bool CIncrementalAdd::FillLayer(CChunkReader& reader, FileNode& node)
+  {
+    while (node.links.size() < LINKS_PER_NODE && !reader.Done())
+    {
+      // Leaves have no links, so each is just its chunk
+      std::vector<std::string> blocks;
+      std::vector<uint64_t> chunkSizes;
+      while (blocks.size() < LEAF_GROUP_SIZE && node.links.size() + blocks.size() < LINKS_PER_NODE && !reader.Done())
+      {
+        std::string chunk;
+        if (!reader.Next(chunk))
+          return false;
+        chunkSizes.push_back(chunk.size());
+        blocks.push_back(EncodeDagNode(std::vector<DagLink>(), UnixfsFileData(chunk, std::vector<uint64_t>())));
+      }
+
+      std::vector<std::string> multihashes;
+      MultihashMany(blocks, multihashes);
+
+      for (size_t i = 0; i < blocks.size(); i++)
+      {
+        DagLink link;
+        link.hash = multihashes[i];
+        link.size = blocks[i].size();
+
+        node.links.push_back(link);
+        node.blockSizes.push_back(chunkSizes[i]);
+        if (!QueueBlock(link.hash, blocks[i]))
+          return false;
+      }
+    }
+
+    return true;
+  }
+
+  bool CIncrementalAdd::AddChild(FileNode& node, const FileNode& child)
+  {
+    DagLink link;
+    if (!FinishFileNode(child, link))
+      return false;
+
+    uint64_t fileSize = child.contents.size();
+    for (std::vector<uint64_t>::const_iterator it = child.blockSizes.begin(); it != child.blockSizes.end(); ++it)
+      fileSize += *it;
+
+    node.links.push_back(link);
+    node.blockSizes.push_back(fileSize);
+    return true;
+  }
+
+  bool CIncrementalAdd::FinishFileNode(const FileNode& node, DagLink& link)
+  {
+    const std::string block = EncodeDagNode(node.links, UnixfsFileData(node.contents, node.blockSizes));
+
+    link.hash = Multihash(block.data(), block.size());
+    link.size = block.size();
+    for (std::vector<DagLink>::const_iterator it = node.links.begin(); it != node.links.end(); ++it)
+      link.size += it->size;
+
+    return QueueBlock(link.hash, block);
+  }
+
+  bool CIncrementalAdd::AddDirectory(const std::string& path, const struct stat& st, DagLink& link)
+  {
+    std::vector<std::string> names;
+
+    DIR* dir = opendir(path.c_str());
+    if (dir == NULL)
+      return false;
+
+    struct dirent* dirent;
+    while ((dirent = readdir(dir)) != NULL)
+    {
+      // Hidden files are skipped, as by `ipfs add -r`
+      if (dirent->d_name[0] == '.')
+        continue;
+      names.push_back(dirent->d_name);
+    }
+    closedir(dir);
+
+    // go-ipfs keeps links sorted by name
+    std::sort(names.begin(), names.end());
+
+    std::vector<DagLink> links(names.size());
+    for (size_t i = 0; i < names.size(); i++)
+    {
+      links[i].name = names[i];
+      if (!AddPath(path + "/" + names[i], links[i]))
+        return false;
+    }
+
+    CAddIndex::Entry entry;
+    entry.type = 'd';
+    entry.size = 0;
+    entry.mtime = GetMtime(st);
+    entry.inode = static_cast<uint64_t>(st.st_ino);
+
+    return AddNode(links, UnixfsDirectoryData(), path, entry, link);
+  }
+
+  bool CIncrementalAdd::AddSymlink(const std::string& path, const struct stat& st, DagLink& link)
+  {
+    const CAddIndex::Entry* previous = m_previous.Find(path);
+    if (IsUnchanged(previous, 'l', st))
+    {
+      m_next.Set(path, *previous);
+
+      link.size = previous->cumulativeSize;
+      return DecodeBase58(previous->cid, link.hash);
+    }
+
+    std::vector<char> target(static_cast<size_t>(st.st_size) + 1);
+    ssize_t length = readlink(path.c_str(), target.data(), target.size());
+    if (length < 0 || static_cast<size_t>(length) >= target.size())
+      return false;
+
+    CAddIndex::Entry entry;
+    entry.type = 'l';
+    entry.size = static_cast<uint64_t>(st.st_size);
+    entry.mtime = GetMtime(st);
+    entry.inode = static_cast<uint64_t>(st.st_ino);
+
+    std::string data = UnixfsSymlinkData(std::string(target.data(), static_cast<size_t>(length)));
+
+    return AddNode(std::vector<DagLink>(), data, path, entry, link);
+  }
+
+  bool CIncrementalAdd::AddNode(const std::vector<DagLink>& links, const std::string& data, const std::string& path, CAddIndex::Entry entry, DagLink& link)
+  {
+    const std::string node = EncodeDagNode(links, data);
+
+    link.hash = Multihash(node.data(), node.size());
+    link.size = node.size();
+    for (std::vector<DagLink>::const_iterator it = links.begin(); it != links.end(); ++it)
+      link.size += it->size;
+
+    entry.cid = EncodeBase58(link.hash);
+    entry.cumulativeSize = link.size;
+
+    // Nodes with the key they had last time are already stored
+    const CAddIndex::Entry* previous = path.empty() ? NULL : m_previous.Find(path);
+    if (previous == NULL || previous->cid != entry.cid)
+    {
+      if (!QueueBlock(link.hash, node))
+        return false;
+    }
+
+    if (!path.empty())
+      m_next.Set(path, entry);
+
+    return true;
+  }
+
+  bool CIncrementalAdd::QueueBlock(const std::string& multihash, const std::string& block)
+  {
+    if (m_bOnlyHash)
+      return true;
+
+    m_pending.push_back(std::make_pair(multihash, block));
+    m_pendingBytes += block.size();
+
+    return m_pendingBytes < STORE_BATCH_BYTES || Flush();
+  }
+
+  bool CIncrementalAdd::Flush(void)
+  {
+    bool bOk = m_pending.empty() || PutBlocks(m_pending);
+
+    m_pending.clear();
+    m_pendingBytes = 0;
+
+    return bOk;
+  }
+
+  bool CIncrementalAdd::IsUnchanged(const CAddIndex::Entry* entry, char type, const struct stat& st)
+  {
+    return entry != NULL &&
+           entry->type == type &&
+           entry->size == static_cast<uint64_t>(st.st_size) &&
+           entry->mtime == GetMtime(st) &&
+           entry->inode == static_cast<uint64_t>(st.st_ino);
+  }
+
+  /*!
+   * \brief Add <path>, wrapped in a directory if the options ask for it, and
+   *        store what's still queued
+   */
+  bool AddRoot(CIncrementalAdd& add, const std::string& path, const ipfs_add_options_t& options, DagLink& root)
+  {
+    if (!add.AddPath(path, root))
+      return false;
+
+    if (options.wrap_with_directory)
+    {
+      std::vector<DagLink> links(1, root);
+      links[0].name = GetBaseName(path);
+
+      if (!add.AddNode(links, UnixfsDirectoryData(), "", CAddIndex::Entry(), root))
+        return false;
+    }
+
+    return add.Flush();
+  }
+}
+
+bool CAddIndex::Load(const std::string& indexPath, const std::string& fingerprint)
+{
+  m_entries.clear();
+  m_root.clear();
+
+  std::ifstream file(indexPath.c_str());
+  if (!file.is_open())
+    return access(indexPath.c_str(), F_OK) != 0;
+
+  std::string line;
+  if (!std::getline(file, line))
+    return true;
+
+  // Keys from other add options are useless
+  if (line != std::string(INDEX_HEADER) + " " + fingerprint)
+    return true;
+
+  // The root key the index was last saved with
+  if (!std::getline(file, m_root))
+    return !file.bad();
+
+  while (std::getline(file, line))
+  {
+    // <type> <size> <mtime> <inode> <cumulative size> <cid> <path>, tab-separated
+    std::vector<std::string> fields;
+    size_t pos = 0;
+    while (fields.size() < 6)
+    {
+      size_t tab = line.find('\t', pos);
+      if (tab == std::string::npos)
+        break;
+      fields.push_back(line.substr(pos, tab - pos));
+      pos = tab + 1;
+    }
+
+    if (fields.size() < 6 || fields[0].size() != 1 || pos >= line.size())
+      continue;
+
+    Entry entry;
+    entry.type = fields[0][0];
+    entry.size = std::strtoull(fields[1].c_str(), NULL, 10);
+    entry.mtime = std::strtoll(fields[2].c_str(), NULL, 10);
+    entry.inode = std::strtoull(fields[3].c_str(), NULL, 10);
+    entry.cumulativeSize = std::strtoull(fields[4].c_str(), NULL, 10);
+    entry.cid = fields[5];
+
+    m_entries[line.substr(pos)] = entry;
+  }
+
+  return !file.bad();
+}
+
+bool CAddIndex::Save(const std::string& indexPath, const std::string& fingerprint) const
+{
+  const std::string tmpPath = indexPath + ".tmp";
+
+  FILE* file = std::fopen(tmpPath.c_str(), "w");
+  if (file == NULL)
+    return false;
+
+  bool bOk = std::fprintf(file, "%s %s\n%s\n", INDEX_HEADER, fingerprint.c_str(), m_root.c_str()) > 0;
+
+  for (std::unordered_map<std::string, Entry>::const_iterator it = m_entries.begin(); bOk && it != m_entries.end(); ++it)
+  {
+    // Such paths can't be stored in a line-based index and are re-added every time
+    if (it->first.find('\n') != std::string::npos)
+      continue;
+
+    const Entry& entry = it->second;
+    bOk = std::fprintf(file, "%c\t%llu\t%lld\t%llu\t%llu\t%s\t%s\n",
+                       entry.type,
+                       static_cast<unsigned long long>(entry.size),
+                       static_cast<long long>(entry.mtime),
+                       static_cast<unsigned long long>(entry.inode),
+                       static_cast<unsigned long long>(entry.cumulativeSize),
+                       entry.cid.c_str(),
+                       it->first.c_str()) > 0;
+  }
+
+  bOk = (std::fflush(file) == 0) && bOk;
+  bOk = (fsync(fileno(file)) == 0) && bOk;
+  bOk = (std::fclose(file) == 0) && bOk;
+
+  if (!bOk || std::rename(tmpPath.c_str(), indexPath.c_str()) != 0)
+  {
+    std::remove(tmpPath.c_str());
+    return false;
+  }
+
+  return true;
+}
+
+const CAddIndex::Entry* CAddIndex::Find(const std::string& path) const
+{
+  std::unordered_map<std::string, Entry>::const_iterator it = m_entries.find(path);
+  return it != m_entries.end() ? &it->second : NULL;
+}
+
+bool IPSF::AddIncremental(const std::string& path, const std::string& indexPath, const ipfs_add_options_t& options, std::string& cid)
+{
+  std::string fingerprint;
+  if (!GetAddFingerprint(options, fingerprint))
+    return false;
+
+  // Keys from a hash-only add were never stored
+  if (options.only_hash)
+    fingerprint += ",only-hash";
+
+  CAddIndex previous;
+  if (!previous.Load(indexPath, fingerprint))
+    return false;
+
+  // The chunker runs in C++, and only fixed-size chunks are cut exactly as
+  // go-ipfs cuts them
+  if (options.chunker != IPFS_CHUNKER_FIXED)
+    return false;
+
+  CAddIndex next;
+  CIncrementalAdd add(options, previous, next);
+
+  DagLink root;
+  if (!AddRoot(add, path, options, root))
+    return false;
+
+  cid = EncodeBase58(root.hash);
+  next.SetRoot(cid);
+
+  if (!options.only_hash && cid != previous.GetRoot())
+  {
+    // Keep the new tree from being garbage collected, and let the blocks only
+    // the replaced tree used go
+    std::string output;
+    bool bError = false;
+    if (!invoke("ipfs pin add " + cid + " -r true", output, bError) || bError)
+      return false;
+
+    // The new tree is pinned either way, so the index is saved even if the
+    // replaced one stays pinned
+    if (!previous.GetRoot().empty())
+    {
+      if (!invoke("ipfs pin rm " + previous.GetRoot() + " -r true", output, bError))
+        bError = true;
+      if (bError)
+      {
+        next.Save(indexPath, fingerprint);
+        return false;
+      }
+    }
+  }
+
+  return next.Save(indexPath, fingerprint);
+}
+
+bool IPSF::AddHashOnly(const std::string& path, const ipfs_add_options_t& options, std::string& cid)
+{
+  if (options.chunker != IPFS_CHUNKER_FIXED)
+    return false;
+
+  // Directories need a recursive add, as on the command line
+  struct stat st;
+  if (stat(path.c_str(), &st) != 0 || (S_ISDIR(st.st_mode) && !options.recursive))
+    return false;
+
+  ipfs_add_options_t hashOptions = options;
+  hashOptions.only_hash = true;
+
+  // Without a previous index every node is encoded and hashed
+  const CAddIndex previous;
+  CAddIndex next;
+  CIncrementalAdd add(hashOptions, previous, next);
+
+  DagLink root;
+  if (!AddRoot(add, path, hashOptions, root))
+    return false;
+
+  cid = EncodeBase58(root.hash);
+  return true;
+}
@@ -0,0 +1,109 @@
+/*
+ *    Copyright (C) 2015 juztamau5
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *    The above copyright notice and this permission notice shall be included in
+ *    all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+#ifndef __IPSF_ADDINDEX_H__
+#define __IPSF_ADDINDEX_H__
+
+#include "ipfs/libipfs.h"
+
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+
+namespace IPSF
+{
+  /*!
+   * \brief Persistent map of local paths to the keys they were added as
+   *
+   * An entry is valid while the file's size, mtime and inode are unchanged.
+   * The index records the add options that produced its keys and is
+   * discarded when they change. It also records the root key of the last
+   * add, so the tree it replaces can be unpinned.
+   */
+  class CAddIndex
+  {
+  public:
+    struct Entry
+    {
+      char        type; ///< 'f' file, 'd' directory, 'l' symlink
+      uint64_t    size;
+      int64_t     mtime; ///< Nanoseconds since the epoch
+      uint64_t    inode;
+      uint64_t    cumulativeSize;
+      std::string cid;
+    };
+
+    /*!
+     * \brief Load the index at <indexPath>
+     *
+     * A missing index, or one written with a different <fingerprint>, loads
+     * empty.
+     *
+     * \return false if the index exists but can't be read
+     */
+    bool Load(const std::string& indexPath, const std::string& fingerprint);
+
+    /*!
+     * \brief Atomically replace the index at <indexPath>
+     */
+    bool Save(const std::string& indexPath, const std::string& fingerprint) const;
+
+    const Entry* Find(const std::string& path) const;
+    void Set(const std::string& path, const Entry& entry) { m_entries[path] = entry; }
+
+    const std::string& GetRoot(void) const { return m_root; }
+    void SetRoot(const std::string& cid) { m_root = cid; }
+
+  private:
+    std::unordered_map<std::string, Entry> m_entries;
+    std::string                            m_root;
+  };
+
+  /*!
+   * \brief Add <path> to IPFS, reusing keys from the index at <indexPath>
+   *        for files that haven't changed
+   *
+   * \param cid Receives the base58 root key
+   *
+   * Changed files are chunked and encoded locally with the layout go-ipfs
+   * uses, so only fixed-size chunking is supported. Only nodes whose keys
+   * changed are stored, in batches, and nothing is stored when hashing only.
+   * The new root is pinned and the previous one unpinned. The index is
+   * rewritten with the entries seen by this add.
+   *
+   * \return false if the new root couldn't be pinned, leaving the index as it
+   *         was, or if the previous root couldn't be unpinned. The index is
+   *         still rewritten then, because the new root is pinned.
+   */
+  bool AddIncremental(const std::string& path, const std::string& indexPath, const ipfs_add_options_t& options, std::string& cid);
+
+  /*!
+   * \brief Compute the root key <path> would be added as, without an index
+   *        and without storing anything
+   *
+   * Like AddIncremental(), only fixed-size chunking is supported. Leaves are
+   * hashed in groups with MultihashMany().
+   */
+  bool AddHashOnly(const std::string& path, const ipfs_add_options_t& options, std::string& cid);
+}
+
+#endif // __IPSF_ADDINDEX_H__
@@ -0,0 +1,627 @@
+/*
+ *    Copyright (C) 2015 juztamau5
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *    The above copyright notice and this permission notice shall be included in
+ *    all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include "api.h"
+#include "config.h"
+#include "json.h"
+#include "scheduler.h"
+
+#include <cctype>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#if !defined(MSG_NOSIGNAL)
+#define MSG_NOSIGNAL 0 // SO_NOSIGPIPE is set instead
+#endif
+
+using namespace IPSF;
+
+namespace
+{
+  const unsigned short DEFAULT_API_PORT = 5001;
+
+  std::string ReadFile(const std::string& path)
+  {
+    std::ifstream file(path.c_str());
+    std::stringstream contents;
+    contents << file.rdbuf();
+    return contents.str();
+  }
+
+  /*!
+   * \brief Parse an API multiaddr such as /ip4/127.0.0.1/tcp/5001
+   */
+  bool ParseMultiaddr(const std::string& multiaddr, ApiEndpoint& endpoint)
+  {
+    std::vector<std::string> parts;
+    std::stringstream stream(multiaddr);
+    std::string part;
+    while (std::getline(stream, part, '/'))
+    {
+      if (!part.empty())
+        parts.push_back(part);
+    }
+
+    if (parts.size() < 4 || parts[2] != "tcp")
+      return false;
+
+    if (parts[0] != "ip4" && parts[0] != "ip6" && parts[0] != "dns" && parts[0] != "dns4" && parts[0] != "dns6")
+      return false;
+
+    endpoint.host = parts[1];
+    endpoint.port = static_cast<unsigned short>(std::strtoul(parts[3].c_str(), NULL, 10));
+
+    // The daemon may listen on all interfaces
+    if (endpoint.host == "0.0.0.0")
+      endpoint.host = "127.0.0.1";
+    else if (endpoint.host == "::")
+      endpoint.host = "::1";
+
+    return endpoint.port != 0;
+  }
+
+  bool GetConfigApiAddress(const std::string& config, std::string& multiaddr)
+  {
+    CJsonValue document;
+    if (!CJsonValue::Parse(config, document))
+      return false;
+
+    // Newer configs may list several addresses
+    const CJsonValue& api = document["Addresses"]["API"];
+    if (api.GetType() == CJsonValue::TypeArray && api.Size() > 0)
+      multiaddr = api[0].AsString();
+    else if (api.GetType() == CJsonValue::TypeString)
+      multiaddr = api.AsString();
+
+    return !multiaddr.empty();
+  }
+
+  std::string UrlEncode(const std::string& str)
+  {
+    static const char hex[] = "0123456789ABCDEF";
+
+    std::string encoded;
+    for (std::string::const_iterator it = str.begin(); it != str.end(); ++it)
+    {
+      const unsigned char c = static_cast<unsigned char>(*it);
+      if (('a' <= c && c <= 'z') || ('A' <= c && c <= 'Z') || ('0' <= c && c <= '9') ||
+          c == '-' || c == '_' || c == '.' || c == '~')
+      {
+        encoded.push_back(static_cast<char>(c));
+      }
+      else
+      {
+        encoded.push_back('%');
+        encoded.push_back(hex[c >> 4]);
+        encoded.push_back(hex[c & 0xf]);
+      }
+    }
+    return encoded;
+  }
+
+  /*!
+   * \brief Extract the "Message" of an error returned by the API
+   */
+  std::string GetErrorMessage(const std::string& body)
+  {
+    size_t pos = body.find("\"Message\"");
+    if (pos != std::string::npos)
+    {
+      size_t begin = body.find('"', body.find(':', pos));
+      if (begin != std::string::npos)
+      {
+        std::string message;
+        for (size_t i = begin + 1; i < body.size() && body[i] != '"'; i++)
+        {
+          if (body[i] == '\\' && i + 1 < body.size())
+            i++;
+          message.push_back(body[i]);
+        }
+        return message;
+      }
+    }
+
+    size_t end = body.find_last_not_of(" \t\r\n");
+    return end == std::string::npos ? std::string("empty response") : body.substr(0, end + 1);
+  }
+
+  /*!
+   * \brief HTTP connection with a deadline covering the whole exchange
+   */
+  class CConnection
+  {
+  public:
+    CConnection(unsigned int timeoutMs) :
+      m_fd(-1),
+      m_bHasDeadline(timeoutMs > 0),
+      m_deadline(std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs)),
+      m_bTimedOut(false),
+      m_offset(0)
+    {
+    }
+
+    ~CConnection(void)
+    {
+      if (m_fd >= 0)
+        close(m_fd);
+    }
+
+    bool TimedOut(void) const { return m_bTimedOut; }
+
+    bool Connect(const ApiEndpoint& endpoint)
+    {
+      struct addrinfo hints;
+      std::memset(&hints, 0, sizeof(hints));
+      hints.ai_family = AF_UNSPEC;
+      hints.ai_socktype = SOCK_STREAM;
+
+      std::stringstream port;
+      port << endpoint.port;
+
+      struct addrinfo* addresses = NULL;
+      if (getaddrinfo(endpoint.host.c_str(), port.str().c_str(), &hints, &addresses) != 0)
+        return false;
+
+      for (struct addrinfo* address = addresses; address != NULL && m_fd < 0; address = address->ai_next)
+      {
+        int fd = socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+        if (fd < 0)
+          continue;
+
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+
+#if defined(SO_NOSIGPIPE)
+        int noSigPipe = 1;
+        setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &noSigPipe, sizeof(noSigPipe));
+#endif
+
+        int result = connect(fd, address->ai_addr, address->ai_addrlen);
+        if (result != 0 && errno == EINPROGRESS && Wait(fd, POLLOUT))
+        {
+          int error = 0;
+          socklen_t length = sizeof(error);
+          if (getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &length) == 0 && error == 0)
+            result = 0;
+        }
+
+        if (result == 0)
+          m_fd = fd;
+        else
+          close(fd);
+      }
+
+      freeaddrinfo(addresses);
+
+      return m_fd >= 0;
+    }
+
+    bool Send(const std::string& data)
+    {
+      size_t sent = 0;
+      while (sent < data.size())
+      {
+        if (!Wait(m_fd, POLLOUT))
+          return false;
+
+        ssize_t bytesSent = send(m_fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+        if (bytesSent < 0 && (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK))
+          continue;
+        if (bytesSent <= 0)
+          return false;
+
+        sent += static_cast<size_t>(bytesSent);
+      }
+      return true;
+    }
+
+    /*!
+     * \brief Read a CRLF-terminated line
+     */
+    bool ReadLine(std::string& line)
+    {
+      while (true)
+      {
+        size_t end = m_buffer.find("\r\n", m_offset);
+        if (end != std::string::npos)
+        {
+          line = m_buffer.substr(m_offset, end - m_offset);
+          m_offset = end + 2;
+          return true;
+        }
+
+        if (!Fill())
+          return false;
+      }
+    }
+
+    /*!
+     * \brief Pass up to <size> bytes to <sink>, or everything until the peer
+     *        closes if <size> is negative
+     */
+    bool ReadBody(long long size, const std::function<bool(const char*, size_t)>& sink, bool& bStopped)
+    {
+      bStopped = false;
+
+      while (size != 0)
+      {
+        if (m_offset == m_buffer.size() && !Fill())
+          return size < 0 && !m_bTimedOut;
+
+        size_t available = m_buffer.size() - m_offset;
+        if (size > 0 && static_cast<unsigned long long>(size) < available)
+          available = static_cast<size_t>(size);
+
+        if (!sink(m_buffer.data() + m_offset, available))
+        {
+          bStopped = true;
+          return true;
+        }
+
+        m_offset += available;
+        if (size > 0)
+          size -= static_cast<long long>(available);
+      }
+
+      return true;
+    }
+
+  private:
+    bool Fill(void)
+    {
+      // Drop consumed data before reading more
+      if (m_offset > 0)
+      {
+        m_buffer.erase(0, m_offset);
+        m_offset = 0;
+      }
+
+      char buffer[16 * 1024];
+      while (true)
+      {
+        if (!Wait(m_fd, POLLIN))
+          return false;
+
+        ssize_t bytesRead = recv(m_fd, buffer, sizeof(buffer), 0);
+        if (bytesRead < 0 && (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK))
+          continue;
+        if (bytesRead <= 0)
+          return false;
+
+        m_buffer.append(buffer, static_cast<size_t>(bytesRead));
+        return true;
+      }
+    }
+
+    bool Wait(int fd, short events)
+    {
+      int timeoutMs = -1;
+      if (m_bHasDeadline)
+      {
+        std::chrono::milliseconds remaining = std::chrono::duration_cast<std::chrono::milliseconds>(m_deadline - std::chrono::steady_clock::now());
+        if (remaining.count() <= 0)
+        {
+          m_bTimedOut = true;
+          return false;
+        }
+        timeoutMs = static_cast<int>(remaining.count());
+      }
+
+      struct pollfd pfd;
+      pfd.fd = fd;
+      pfd.events = events;
+      pfd.revents = 0;
+
+      int result;
+      do
+      {
+        result = poll(&pfd, 1, timeoutMs);
+      } while (result < 0 && errno == EINTR);
+
+      if (result == 0)
+        m_bTimedOut = true;
+
+      return result > 0;
+    }
+
+    int                                   m_fd;
+    const bool                            m_bHasDeadline;
+    std::chrono::steady_clock::time_point m_deadline;
+    bool                                  m_bTimedOut;
+    std::string                           m_buffer;
+    size_t                                m_offset;
+  };
+
+  bool ExecuteRequest(const ApiEndpoint& endpoint, const std::string& target, const std::string& contentType, const std::string& content,
+                      unsigned int timeoutMs, const std::function<bool(const char*, size_t)>& sink, std::string& error, bool& bTimedOut)
+  {
+    // The time spent waiting for a slot doesn't count against the timeout
+    CScheduledSlot slot(GetApiScheduler());
+
+    CConnection connection(timeoutMs);
+
+    std::stringstream request;
+    request << "POST " << target << " HTTP/1.1\r\n";
+    request << "Host: " << endpoint.host << ":" << endpoint.port << "\r\n";
+    if (!contentType.empty())
+      request << "Content-Type: " << contentType << "\r\n";
+    request << "Content-Length: " << content.size() << "\r\n";
+    request << "Connection: close\r\n";
+    request << "\r\n";
+    request << content;
+
+    if (!connection.Connect(endpoint))
+    {
+      bTimedOut = connection.TimedOut();
+      error = bTimedOut ? "timed out connecting to the API" : "can't connect to the API. Is the daemon running?";
+      return false;
+    }
+
+    std::string statusLine;
+    if (!connection.Send(request.str()) || !connection.ReadLine(statusLine))
+    {
+      bTimedOut = connection.TimedOut();
+      error = bTimedOut ? "timed out waiting for the API" : "no response from the API";
+      return false;
+    }
+
+    // HTTP/1.1 <code> <reason>
+    const size_t codePos = statusLine.find(' ');
+    const int status = (codePos == std::string::npos) ? 0 : std::atoi(statusLine.c_str() + codePos + 1);
+
+    bool bChunked = false;
+    long long contentLength = -1;
+
+    std::string header;
+    while (connection.ReadLine(header) && !header.empty())
+    {
+      const size_t colon = header.find(':');
+      if (colon == std::string::npos)
+        continue;
+
+      std::string name = header.substr(0, colon);
+      std::string value = header.substr(colon + 1);
+      value.erase(0, value.find_first_not_of(' '));
+
+      for (std::string::iterator it = name.begin(); it != name.end(); ++it)
+        *it = static_cast<char>(std::tolower(*it));
+
+      if (name == "transfer-encoding" && value.find("chunked") != std::string::npos)
+        bChunked = true;
+      else if (name == "content-length")
+        contentLength = std::atoll(value.c_str());
+    }
+
+    // Errors come back as a JSON message
+    std::string errorBody;
+    const std::function<bool(const char*, size_t)> errorSink = [&errorBody](const char* data, size_t size)
+    {
+      errorBody.append(data, size);
+      return true;
+    };
+    const std::function<bool(const char*, size_t)>& bodySink = (status == 200) ? sink : errorSink;
+
+    bool bOk = true;
+    bool bStopped = false;
+
+    if (bChunked)
+    {
+      std::string chunkHeader;
+      while ((bOk = connection.ReadLine(chunkHeader)))
+      {
+        const long long chunkSize = std::strtoll(chunkHeader.c_str(), NULL, 16);
+        if (chunkSize == 0)
+        {
+          // Trailers report errors that happened while streaming
+          std::string trailer;
+          while ((bOk = connection.ReadLine(trailer)) && !trailer.empty())
+          {
+            if (trailer.compare(0, 15, "X-Stream-Error:") == 0)
+            {
+              error = trailer.substr(15);
+              error.erase(0, error.find_first_not_of(' '));
+              return false;
+            }
+          }
+          break;
+        }
+
+        std::string crlf;
+        if (!(bOk = connection.ReadBody(chunkSize, bodySink, bStopped)) || bStopped || !(bOk = connection.ReadLine(crlf)))
+          break;
+      }
+    }
+    else
+    {
+      bOk = connection.ReadBody(contentLength, bodySink, bStopped);
+    }
+
+    bTimedOut = connection.TimedOut();
+
+    if (status != 200)
+    {
+      error = status == 0 ? "invalid response from the API" : GetErrorMessage(errorBody);
+      return false;
+    }
+
+    if (!bOk && !bStopped)
+    {
+      error = bTimedOut ? "timed out reading from the API" : "connection to the API was lost";
+      return false;
+    }
+
+    return true;
+  }
+}
+
+bool IPSF::GetApiEndpoint(ApiEndpoint& endpoint)
+{
+  return GetApiEndpoint(GetRepoPath(), endpoint);
+}
+
+bool IPSF::GetApiEndpoint(const std::string& repoPath, ApiEndpoint& endpoint)
+{
+  if (GetDaemonEndpoint(repoPath, endpoint))
+    return true;
+
+  std::string multiaddr;
+  if (!GetConfigApiAddress(ReadFile(repoPath + "/config"), multiaddr))
+  {
+    endpoint.host = "127.0.0.1";
+    endpoint.port = DEFAULT_API_PORT;
+    return true;
+  }
+
+  return ParseMultiaddr(multiaddr, endpoint);
+}
+
+bool IPSF::GetDaemonEndpoint(const std::string& repoPath, ApiEndpoint& endpoint)
+{
+  std::string multiaddr = ReadFile(repoPath + "/api");
+  multiaddr.erase(multiaddr.find_last_not_of(" \t\r\n") + 1);
+
+  return !multiaddr.empty() && ParseMultiaddr(multiaddr, endpoint);
+}
+
+CApiRequest::CApiRequest(const std::string& command) :
+  m_command(command),
+  m_timeoutMs(0),
+  m_bTimedOut(false)
+{
+}
+
+void CApiRequest::AddArgument(const std::string& argument)
+{
+  m_query.push_back("arg=" + UrlEncode(argument));
+}
+
+void CApiRequest::AddOption(const std::string& name, const std::string& value)
+{
+  m_query.push_back(UrlEncode(name) + "=" + UrlEncode(value));
+}
+
+void CApiRequest::AddFile(const std::string& data)
+{
+  m_files.push_back(data);
+}
+
+std::string CApiRequest::GetTarget(void) const
+{
+  std::string target = "/api/v0/" + m_command;
+
+  for (size_t i = 0; i < m_query.size(); i++)
+    target += (i == 0 ? "?" : "&") + m_query[i];
+
+  return target;
+}
+
+std::string CApiRequest::GetContent(std::string& contentType) const
+{
+  contentType.clear();
+  if (m_files.empty())
+    return "";
+
+  // The boundary can't appear in any of the files
+  std::string boundary = "libipfs-boundary";
+  for (size_t i = 0; i < m_files.size(); i++)
+  {
+    while (m_files[i].find(boundary) != std::string::npos)
+      boundary += "-";
+  }
+
+  std::string content;
+  for (size_t i = 0; i < m_files.size(); i++)
+  {
+    content += "--" + boundary + "\r\n";
+    content += "Content-Type: application/octet-stream\r\n";
+    content += "Content-Disposition: form-data; name=\"file\"; filename=\"file\"\r\n";
+    content += "\r\n";
+    content += m_files[i];
+    content += "\r\n";
+  }
+  content += "--" + boundary + "--\r\n";
+
+  contentType = "multipart/form-data; boundary=" + boundary;
+  return content;
+}
+
+bool CApiRequest::Execute(const ApiEndpoint& endpoint, std::string& body)
+{
+  body.clear();
+  m_error.clear();
+
+  std::string contentType;
+  const std::string content = GetContent(contentType);
+
+  return ExecuteRequest(endpoint, GetTarget(), contentType, content, m_timeoutMs, [&body](const char* data, size_t size)
+  {
+    body.append(data, size);
+    return true;
+  }, m_error, m_bTimedOut);
+}
+
+bool CApiRequest::Execute(const ApiEndpoint& endpoint, const std::function<bool(const std::string& line)>& onLine)
+{
+  m_error.clear();
+
+  std::string contentType;
+  const std::string content = GetContent(contentType);
+
+  std::string partial;
+  bool bStopped = false;
+
+  bool bOk = ExecuteRequest(endpoint, GetTarget(), contentType, content, m_timeoutMs, [&partial, &bStopped, &onLine](const char* data, size_t size)
+  {
+    partial.append(data, size);
+
+    size_t begin = 0;
+    size_t end;
+    while ((end = partial.find('\n', begin)) != std::string::npos)
+    {
+      if (end > begin && !onLine(partial.substr(begin, end - begin)))
+      {
+        bStopped = true;
+        return false;
+      }
+      begin = end + 1;
+    }
+
+    partial.erase(0, begin);
+    return true;
+  }, m_error, m_bTimedOut);
+
+  if (bOk && !bStopped && !partial.empty())
+    onLine(partial);
+
+  return bOk;
+}
@@ -0,0 +1,123 @@
+/*
+ *    Copyright (C) 2015 juztamau5
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *    The above copyright notice and this permission notice shall be included in
+ *    all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+#ifndef __IPSF_API_H__
+#define __IPSF_API_H__
+
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace IPSF
+{
+  /*!
+   * \brief Address of the HTTP API of a running IPFS daemon
+   */
+  struct ApiEndpoint
+  {
+    std::string    host;
+    unsigned short port;
+  };
+
+  /*!
+   * \brief Find the API of the daemon serving the repo
+   *
+   * Uses the repo's "api" file if the daemon wrote one, and
+   * Addresses.API from the config otherwise.
+   */
+  bool GetApiEndpoint(ApiEndpoint& endpoint);
+  bool GetApiEndpoint(const std::string& repoPath, ApiEndpoint& endpoint);
+
+  /*!
+   * \brief Find the API of a daemon that is serving the repo right now
+   *
+   * \return false if no daemon has published its address in the repo's "api"
+   *         file
+   */
+  bool GetDaemonEndpoint(const std::string& repoPath, ApiEndpoint& endpoint);
+
+  /*!
+   * \brief A command sent to the daemon's HTTP API (/api/v0)
+   *
+   * Unlike invoke(), requests don't share process-wide state and can run
+   * concurrently from any number of threads.
+   */
+  class CApiRequest
+  {
+  public:
+    CApiRequest(const std::string& command);
+
+    void AddArgument(const std::string& argument);
+    void AddOption(const std::string& name, const std::string& value);
+
+    /*!
+     * \brief Upload <data> as a file argument, such as the block of
+     *        block/put
+     */
+    void AddFile(const std::string& data);
+
+    /*!
+     * \brief Abort the request if it hasn't completed after <timeoutMs>
+     *
+     * 0 (the default) waits forever.
+     */
+    void SetTimeout(unsigned int timeoutMs) { m_timeoutMs = timeoutMs; }
+
+    /*!
+     * \brief Run the request and collect the whole response body
+     *
+     * \return true if the daemon returned 200 OK and the body was received
+     */
+    bool Execute(const ApiEndpoint& endpoint, std::string& body);
+
+    /*!
+     * \brief Run the request and deliver the response body line by line
+     *
+     * Stops reading and closes the connection, cancelling the command on the
+     * daemon, as soon as <onLine> returns false.
+     */
+    bool Execute(const ApiEndpoint& endpoint, const std::function<bool(const std::string& line)>& onLine);
+
+    /*!
+     * \brief The error from the last Execute()
+     */
+    const std::string& GetError(void) const { return m_error; }
+
+    /*!
+     * \brief True if the last Execute() failed by running out of time
+     */
+    bool TimedOut(void) const { return m_bTimedOut; }
+
+  private:
+    std::string GetTarget(void) const;
+    std::string GetContent(std::string& contentType) const;
+
+    const std::string        m_command;
+    std::vector<std::string> m_query;
+    std::vector<std::string> m_files;
+    unsigned int             m_timeoutMs;
+    std::string              m_error;
+    bool                     m_bTimedOut;
+  };
+}
+
+#endif // __IPSF_API_H__
@@ -0,0 +1,677 @@
+/*
+ *    Copyright (C) 2015 juztamau5
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *    The above copyright notice and this permission notice shall be included in
+ *    all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include "archive.h"
+#include "threadpool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <memory>
+#include <stdint.h>
+#include <unordered_set>
+#include <vector>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(HAVE_ZLIB)
+#include <zlib.h>
+#endif
+
+using namespace IPSF;
+
+namespace
+{
+  const uint64_t TAR_BLOCK_SIZE     = 512;
+  const uint64_t TAR_END_SIZE       = 2 * TAR_BLOCK_SIZE; // Zero blocks ending an archive
+  const uint64_t EXTRACT_RANGE_SIZE = 1024 * 1024; // Bytes written by one task
+  const uint64_t MAX_METADATA_SIZE  = 1024 * 1024; // Limit for PAX and GNU long names
+  const size_t   GZIP_BLOCK_SIZE    = 128 * 1024; // Same as pigz
+  const size_t   GZIP_DICT_SIZE     = 32 * 1024; // Size of the deflate window
+
+  /*!
+   * \brief File descriptor shared by the tasks writing to the same file,
+   *        closed when the last task finishes
+   */
+  class CFileHandle
+  {
+  public:
+    CFileHandle(int fd) : m_fd(fd) { }
+    ~CFileHandle(void) { if (m_fd >= 0) close(m_fd); }
+
+    int Get(void) const { return m_fd; }
+
+  private:
+    const int m_fd;
+  };
+
+  /*!
+   * \brief Read up to <size> bytes, stopping early only at the end of the
+   *        stream
+   */
+  size_t ReadUpTo(int fd, char* buffer, size_t size, bool& bError)
+  {
+    size_t total = 0;
+    while (total < size)
+    {
+      ssize_t bytesRead = read(fd, buffer + total, size - total);
+      if (bytesRead < 0 && errno == EINTR)
+        continue;
+      if (bytesRead < 0)
+        bError = true;
+      if (bytesRead <= 0)
+        break;
+
+      total += static_cast<size_t>(bytesRead);
+    }
+    return total;
+  }
+
+  bool ReadFull(int fd, char* buffer, size_t size)
+  {
+    bool bError = false;
+    return ReadUpTo(fd, buffer, size, bError) == size;
+  }
+
+  bool Skip(int fd, uint64_t size)
+  {
+    char buffer[64 * 1024];
+    while (size > 0)
+    {
+      const size_t chunk = static_cast<size_t>(std::min<uint64_t>(size, sizeof(buffer)));
+      if (!ReadFull(fd, buffer, chunk))
+        return false;
+      size -= chunk;
+    }
+    return true;
+  }
+
+  /*!
+   * \brief Read the rest of a stream, so the writer can finish
+   */
+  void Drain(int fd)
+  {
+    char buffer[64 * 1024];
+    bool bError = false;
+    while (ReadUpTo(fd, buffer, sizeof(buffer), bError) == sizeof(buffer))
+    {
+    }
+  }
+
+  bool WriteAt(int fd, const char* buffer, size_t size, uint64_t offset)
+  {
+    while (size > 0)
+    {
+      ssize_t bytesWritten = pwrite(fd, buffer, size, static_cast<off_t>(offset));
+      if (bytesWritten < 0 && errno == EINTR)
+        continue;
+      if (bytesWritten <= 0)
+        return false;
+
+      buffer += bytesWritten;
+      size -= bytesWritten;
+      offset += bytesWritten;
+    }
+    return true;
+  }
+
+  bool Write(int fd, const char* buffer, size_t size)
+  {
+    while (size > 0)
+    {
+      ssize_t bytesWritten = write(fd, buffer, size);
+      if (bytesWritten < 0 && errno == EINTR)
+        continue;
+      if (bytesWritten <= 0)
+        return false;
+
+      buffer += bytesWritten;
+      size -= bytesWritten;
+    }
+    return true;
+  }
+
+  uint64_t ParseNumber(const char* field, size_t size)
+  {
+    uint64_t value = 0;
+
+    // GNU base-256 encoding for values that don't fit in octal
+    if (size > 0 && (static_cast<unsigned char>(field[0]) & 0x80))
+    {
+      value = static_cast<unsigned char>(field[0]) & 0x7f;
+      for (size_t i = 1; i < size; i++)
+        value = (value << 8) | static_cast<unsigned char>(field[i]);
+      return value;
+    }
+
+    size_t i = 0;
+    while (i < size && field[i] == ' ')
+      i++;
+    for (; i < size && '0' <= field[i] && field[i] <= '7'; i++)
+      value = value * 8 + (field[i] - '0');
+
+    return value;
+  }
+
+  std::string ParseString(const char* field, size_t size)
+  {
+    return std::string(field, std::find(field, field + size, '\0'));
+  }
+
+  bool VerifyChecksum(const char* header)
+  {
+    uint64_t sum = 0;
+    for (unsigned int i = 0; i < TAR_BLOCK_SIZE; i++)
+      sum += (148 <= i && i < 156) ? ' ' : static_cast<unsigned char>(header[i]);
+
+    return sum == ParseNumber(header + 148, 8);
+  }
+
+  /*!
+   * \brief Parse PAX extended header records of the form "<len> <key>=<value>\n"
+   */
+  void ParsePax(const std::string& records, std::string& path, std::string& linkPath, uint64_t& size, bool& bHasSize)
+  {
+    size_t pos = 0;
+    while (pos < records.size())
+    {
+      size_t space = records.find(' ', pos);
+      if (space == std::string::npos)
+        break;
+
+      size_t length = static_cast<size_t>(strtoul(records.c_str() + pos, NULL, 10));
+      if (length == 0 || pos + length > records.size())
+        break;
+
+      std::string record = records.substr(space + 1, pos + length - space - 2); // Strip trailing newline
+      size_t equals = record.find('=');
+      if (equals != std::string::npos)
+      {
+        std::string key = record.substr(0, equals);
+        std::string value = record.substr(equals + 1);
+
+        if (key == "path")
+          path = value;
+        else if (key == "linkpath")
+          linkPath = value;
+        else if (key == "size")
+        {
+          size = strtoull(value.c_str(), NULL, 10);
+          bHasSize = true;
+        }
+      }
+
+      pos += length;
+    }
+  }
+
+  /*!
+   * \brief Replace the root component of an archive entry with <outPath>
+   *
+   * Returns false for entries that would escape <outPath>.
+   */
+  bool TranslatePath(const std::string& name, const std::string& outPath, std::string& result)
+  {
+    result = outPath;
+
+    bool bRoot = true;
+    size_t pos = 0;
+    while (pos <= name.size())
+    {
+      size_t end = name.find('/', pos);
+      if (end == std::string::npos)
+        end = name.size();
+
+      std::string component = name.substr(pos, end - pos);
+      pos = end + 1;
+
+      if (component.empty() || component == ".")
+        continue;
+      if (component == "..")
+        return false;
+
+      if (bRoot)
+        bRoot = false;
+      else
+        result += "/" + component;
+    }
+
+    return !bRoot;
+  }
+
+  /*!
+   * \brief Check that the directories leading to an entry are real
+   *        directories, so nothing is written through a symlink
+   *
+   * Directories that passed are remembered in <directories>.
+   */
+  bool IsSafeParent(const std::string& destPath, const std::string& outPath, std::unordered_set<std::string>& directories)
+  {
+    size_t pos = outPath.size();
+    while ((pos = destPath.find('/', pos + 1)) != std::string::npos)
+    {
+      const std::string directory = destPath.substr(0, pos);
+      if (directories.count(directory) != 0)
+        continue;
+
+      struct stat st;
+      if (lstat(directory.c_str(), &st) != 0 || !S_ISDIR(st.st_mode))
+        return false;
+
+      directories.insert(directory);
+    }
+    return true;
+  }
+
+  /*!
+   * \brief Check that a symlink at <destPath> points inside <outPath>
+   *
+   * Targets must be relative and may not climb above the root. The root
+   * entry itself can't be a symlink, there is nothing inside to point to.
+   */
+  bool IsContainedLink(const std::string& destPath, const std::string& outPath, const std::string& target)
+  {
+    if (target.empty() || target[0] == '/' || destPath.size() <= outPath.size())
+      return false;
+
+    // Depth of the directory holding the link, below the root
+    const std::string relative = destPath.substr(outPath.size());
+    int depth = static_cast<int>(std::count(relative.begin(), relative.end(), '/')) - 1;
+
+    size_t pos = 0;
+    while (pos <= target.size())
+    {
+      size_t end = target.find('/', pos);
+      if (end == std::string::npos)
+        end = target.size();
+
+      const std::string component = target.substr(pos, end - pos);
+      pos = end + 1;
+
+      if (component.empty() || component == ".")
+        continue;
+
+      depth += (component == "..") ? -1 : 1;
+      if (depth < 0)
+        return false;
+    }
+
+    return true;
+  }
+
+#if defined(HAVE_ZLIB)
+  struct GzipBlock
+  {
+    std::vector<char>          input;
+    std::vector<unsigned char> output;
+    uLong                      crc;
+    bool                       bOk;
+  };
+
+  void DeflateBlock(GzipBlock& block, const char* dictionary, size_t dictionarySize, int level, bool bLast)
+  {
+    block.bOk = false;
+    block.crc = crc32(crc32(0L, Z_NULL, 0), reinterpret_cast<const Bytef*>(block.input.data()), static_cast<uInt>(block.input.size()));
+
+    z_stream stream;
+    std::memset(&stream, 0, sizeof(stream));
+
+    // Raw deflate, the GZIP wrapper is written once for the whole stream
+    if (deflateInit2(&stream, level, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+      return;
+
+    if (dictionarySize > 0)
+      deflateSetDictionary(&stream, reinterpret_cast<const Bytef*>(dictionary), static_cast<uInt>(dictionarySize));
+
+    // Leave room for the empty stored block emitted by Z_SYNC_FLUSH
+    block.output.resize(deflateBound(&stream, static_cast<uLong>(block.input.size())) + 16);
+
+    stream.next_in = reinterpret_cast<Bytef*>(block.input.data());
+    stream.avail_in = static_cast<uInt>(block.input.size());
+    stream.next_out = block.output.data();
+    stream.avail_out = static_cast<uInt>(block.output.size());
+
+    // Byte-align non-final blocks so they can be concatenated
+    int ret = deflate(&stream, bLast ? Z_FINISH : Z_SYNC_FLUSH);
+
+    block.bOk = bLast ? (ret == Z_STREAM_END) : (ret == Z_OK && stream.avail_in == 0 && stream.avail_out > 0);
+    block.output.resize(block.output.size() - stream.avail_out);
+
+    deflateEnd(&stream);
+  }
+#endif
+}
+
+bool IPSF::ExtractTar(int tarFd, const std::string& outPath)
+{
+  std::atomic<bool> bFailed(false);
+  bool bEnded = false;
+
+  // Overrides from PAX or GNU headers, applied to the next entry
+  std::string nextPath;
+  std::string nextLinkPath;
+  uint64_t nextSize = 0;
+  bool bHasNextSize = false;
+
+  std::unordered_set<std::string> directories;
+
+  {
+    CTaskGroup tasks(GetWorkerPool());
+
+    char header[TAR_BLOCK_SIZE];
+
+    while (!bFailed)
+    {
+      if (!ReadFull(tarFd, header, sizeof(header)))
+      {
+        bFailed = true;
+        break;
+      }
+
+      // End of archive is marked by a zero block
+      if (std::count(header, header + sizeof(header), '\0') == static_cast<long>(sizeof(header)))
+      {
+        bEnded = true;
+        break;
+      }
+
+      if (!VerifyChecksum(header))
+      {
+        bFailed = true;
+        break;
+      }
+
+      std::string name = ParseString(header, 100);
+      std::string linkName = ParseString(header + 157, 100);
+      uint64_t size = ParseNumber(header + 124, 12);
+      unsigned int mode = static_cast<unsigned int>(ParseNumber(header + 100, 8)) & 0777;
+      const char type = header[156];
+
+      if (std::memcmp(header + 257, "ustar", 5) == 0)
+      {
+        std::string prefix = ParseString(header + 345, 155);
+        if (!prefix.empty())
+          name = prefix + "/" + name;
+      }
+
+      if (type != 'x' && type != 'g' && type != 'L' && type != 'K')
+      {
+        if (!nextPath.empty())
+          name = nextPath;
+        if (!nextLinkPath.empty())
+          linkName = nextLinkPath;
+        if (bHasNextSize)
+          size = nextSize;
+
+        nextPath.clear();
+        nextLinkPath.clear();
+        bHasNextSize = false;
+      }
+
+      const uint64_t padding = (TAR_BLOCK_SIZE - size % TAR_BLOCK_SIZE) % TAR_BLOCK_SIZE;
+
+      // Metadata entries
+      if (type == 'x' || type == 'g' || type == 'L' || type == 'K')
+      {
+        if (size > MAX_METADATA_SIZE)
+        {
+          bFailed = true;
+          break;
+        }
+
+        std::string data(static_cast<size_t>(size), '\0');
+        if ((!data.empty() && !ReadFull(tarFd, &data[0], data.size())) || !Skip(tarFd, padding))
+        {
+          bFailed = true;
+          break;
+        }
+
+        if (type == 'x')
+          ParsePax(data, nextPath, nextLinkPath, nextSize, bHasNextSize);
+        else if (type == 'L')
+          nextPath = ParseString(data.c_str(), data.size());
+        else if (type == 'K')
+          nextLinkPath = ParseString(data.c_str(), data.size());
+
+        continue;
+      }
+
+      std::string destPath;
+      if (!TranslatePath(name, outPath, destPath) || !IsSafeParent(destPath, outPath, directories))
+      {
+        bFailed = true;
+        break;
+      }
+
+      switch (type)
+      {
+      case '5': // Directory
+      {
+        struct stat st;
+        if ((mkdir(destPath.c_str(), mode ? mode : 0755) != 0 && errno != EEXIST) ||
+            lstat(destPath.c_str(), &st) != 0 || !S_ISDIR(st.st_mode))
+        {
+          bFailed = true;
+          break;
+        }
+
+        directories.insert(destPath);
+        if (!Skip(tarFd, size + padding))
+          bFailed = true;
+        break;
+      }
+      case '2': // Symbolic link
+      {
+        // Existing directories can't be replaced, unlink() fails on them
+        unlink(destPath.c_str());
+        if (!IsContainedLink(destPath, outPath, linkName) || symlink(linkName.c_str(), destPath.c_str()) != 0 ||
+            !Skip(tarFd, size + padding))
+          bFailed = true;
+        break;
+      }
+      case '0':
+      case '7':
+      case '\0': // Regular file
+      {
+        // Replace whatever is there instead of writing through it
+        unlink(destPath.c_str());
+
+        int fd = open(destPath.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_NOFOLLOW, mode ? mode : 0644);
+        if (fd < 0 || ftruncate(fd, static_cast<off_t>(size)) != 0)
+        {
+          if (fd >= 0)
+            close(fd);
+          bFailed = true;
+          break;
+        }
+
+        std::shared_ptr<CFileHandle> file = std::make_shared<CFileHandle>(fd);
+
+        // The pool's bounded queue limits how far reading runs ahead
+        for (uint64_t rangeOffset = 0; rangeOffset < size; rangeOffset += EXTRACT_RANGE_SIZE)
+        {
+          std::shared_ptr<std::vector<char>> range = std::make_shared<std::vector<char>>(
+            static_cast<size_t>(std::min(EXTRACT_RANGE_SIZE, size - rangeOffset)));
+          if (!ReadFull(tarFd, range->data(), range->size()))
+          {
+            bFailed = true;
+            break;
+          }
+
+          tasks.Run([file, range, rangeOffset, &bFailed]()
+          {
+            if (!WriteAt(file->Get(), range->data(), range->size(), rangeOffset))
+              bFailed = true;
+          });
+        }
+
+        if (!bFailed && !Skip(tarFd, padding))
+          bFailed = true;
+        break;
+      }
+      default: // Hard links and devices aren't produced by IPFS
+      {
+        if (!Skip(tarFd, size + padding))
+          bFailed = true;
+        break;
+      }
+      }
+    }
+
+    tasks.Wait();
+  }
+
+  Drain(tarFd);
+
+  return bEnded && !bFailed;
+}
+
+bool IPSF::GzipTar(int tarFd, const std::string& destPath, int level)
+{
+#if defined(HAVE_ZLIB)
+  if (level < 1 || level > 9)
+    level = Z_DEFAULT_COMPRESSION;
+
+  int destFd = open(destPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (destFd < 0)
+  {
+    Drain(tarFd);
+    return false;
+  }
+
+  CThreadPool& pool = GetWorkerPool();
+  const size_t batchSize = pool.ThreadCount() * 4;
+
+  // Magic, deflate, no flags, no mtime, no extra flags, Unix
+  static const char gzipHeader[] = { '\x1f', '\x8b', 8, 0, 0, 0, 0, 0, 0, 3 };
+  bool bOk = Write(destFd, gzipHeader, sizeof(gzipHeader));
+
+  uLong crc = crc32(0L, Z_NULL, 0);
+  uint64_t totalSize = 0;
+  std::vector<char> dictionary;
+  std::string tail; // Last bytes of the archive, for the end marker
+  bool bEof = false;
+
+  while (bOk && !bEof)
+  {
+    std::vector<GzipBlock> blocks;
+    blocks.reserve(batchSize);
+
+    while (bOk && !bEof && blocks.size() < batchSize)
+    {
+      GzipBlock block;
+      block.input.resize(GZIP_BLOCK_SIZE);
+
+      bool bError = false;
+      const size_t bytesRead = ReadUpTo(tarFd, block.input.data(), block.input.size(), bError);
+      block.input.resize(bytesRead);
+
+      bOk = !bError;
+      bEof = (bytesRead < GZIP_BLOCK_SIZE);
+      if (bytesRead > 0)
+        blocks.push_back(block);
+    }
+
+    if (!bOk || blocks.empty())
+      break;
+
+    // The stream is finished by an empty last block, as the end of the
+    // input is only known once it's reached
+    {
+      CTaskGroup tasks(pool);
+
+      for (size_t i = 0; i < blocks.size(); i++)
+      {
+        const std::vector<char>& previous = (i == 0) ? dictionary : blocks[i - 1].input;
+        const size_t dictionarySize = std::min(previous.size(), GZIP_DICT_SIZE);
+        const char* dictionaryData = previous.data() + previous.size() - dictionarySize;
+        GzipBlock& block = blocks[i];
+
+        tasks.Run([&block, dictionaryData, dictionarySize, level]()
+        {
+          DeflateBlock(block, dictionaryData, dictionarySize, level, false);
+        });
+      }
+
+      tasks.Wait();
+    }
+
+    for (size_t i = 0; bOk && i < blocks.size(); i++)
+    {
+      bOk = blocks[i].bOk &&
+            Write(destFd, reinterpret_cast<const char*>(blocks[i].output.data()), blocks[i].output.size());
+
+      crc = crc32_combine(crc, blocks[i].crc, static_cast<z_off_t>(blocks[i].input.size()));
+      totalSize += blocks[i].input.size();
+
+      tail.append(blocks[i].input.data(), blocks[i].input.size());
+      if (tail.size() > TAR_END_SIZE)
+        tail.erase(0, tail.size() - TAR_END_SIZE);
+    }
+
+    const std::vector<char>& last = blocks.back().input;
+    dictionary.assign(last.end() - std::min(last.size(), GZIP_DICT_SIZE), last.end());
+  }
+
+  Drain(tarFd);
+
+  // go-ipfs reports no status, an archive that was cut short has no end
+  // marker
+  bOk = bOk && totalSize % TAR_BLOCK_SIZE == 0 && tail.size() == TAR_END_SIZE &&
+        std::count(tail.begin(), tail.end(), '\0') == static_cast<long>(TAR_END_SIZE);
+
+  if (bOk)
+  {
+    GzipBlock last;
+    DeflateBlock(last, NULL, 0, level, true);
+    bOk = last.bOk && Write(destFd, reinterpret_cast<const char*>(last.output.data()), last.output.size());
+  }
+
+  if (bOk)
+  {
+    const uint32_t trailer[] = { static_cast<uint32_t>(crc), static_cast<uint32_t>(totalSize & 0xffffffff) };
+
+    unsigned char bytes[8];
+    for (unsigned int i = 0; i < 8; i++)
+      bytes[i] = static_cast<unsigned char>(trailer[i / 4] >> (8 * (i % 4)));
+
+    bOk = Write(destFd, reinterpret_cast<const char*>(bytes), sizeof(bytes));
+  }
+
+  if (close(destFd) != 0)
+    bOk = false;
+
+  if (!bOk)
+    unlink(destPath.c_str());
+
+  return bOk;
+#else
+  Drain(tarFd);
+  (void)destPath;
+  (void)level;
+  return false;
+#endif
+}
@@ -0,0 +1,70 @@
+/*
+ *    Copyright (C) 2015 juztamau5
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *    The above copyright notice and this permission notice shall be included in
+ *    all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+#ifndef __IPSF_ARCHIVE_H__
+#define __IPSF_ARCHIVE_H__
+
+#include <string>
+
+namespace IPSF
+{
+  /*!
+   * \brief Unpack a TAR archive using the shared worker pool
+   *
+   * \param tarFd The archive produced by `ipfs get -a`, read sequentially
+   * \param outPath The path that replaces the archive's root entry
+   *
+   * Entries are read as they arrive. File contents are written by the
+   * workers with positional writes in 1 MiB ranges, so large files are split
+   * across workers and small files are written concurrently.
+   *
+   * Nothing is written outside <outPath>: entries can't climb out with "..",
+   * symlinks must point inside the tree, and no entry is written through a
+   * symlink.
+   *
+   * The stream is always read to its end, so the writer never sees a broken
+   * pipe.
+   *
+   * \return true if the archive was unpacked completely, up to its
+   *         end-of-archive marker
+   */
+  bool ExtractTar(int tarFd, const std::string& outPath);
+
+  /*!
+   * \brief Compress a TAR archive to GZIP using the shared worker pool
+   *
+   * \param tarFd The archive, read sequentially
+   * \param destPath The path of the .gz file to create
+   * \param level The level of compression (1-9)
+   *
+   * The input is split into independent blocks that are deflated in parallel
+   * (like pigz). Each block is primed with the tail of the previous one, and
+   * the result is a single, standard GZIP member. The stream is always read
+   * to its end, and <destPath> is removed if it couldn't be written.
+   *
+   * \return true if the archive ended with its end-of-archive marker and the
+   *         compressed file was written completely
+   */
+  bool GzipTar(int tarFd, const std::string& destPath, int level);
+}
+
+#endif // __IPSF_ARCHIVE_H__
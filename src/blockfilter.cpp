@@ -0,0 +1,143 @@
+/*
+ *    Copyright (C) 2015 juztamau5
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *    The above copyright notice and this permission notice shall be included in
+ *    all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include "blockfilter.h"
+#include "multihash.h"
+
+#include <algorithm>
+
+using namespace IPSF;
+
+namespace
+{
+  // 512-bit blocks, one cache line each
+  const unsigned int WORDS_PER_BLOCK = 8;
+  const unsigned int BITS_PER_BLOCK = WORDS_PER_BLOCK * 64;
+
+  // About 0.5% false positives for a blocked filter at full capacity
+  const unsigned int BITS_PER_KEY = 12;
+  const unsigned int BITS_SET_PER_KEY = 8;
+
+  const uint64_t MIN_CAPACITY = 1 << 16;
+
+  uint64_t ReadUint64(const uint8_t* bytes)
+  {
+    uint64_t value = 0;
+    for (unsigned int i = 0; i < 8; i++)
+      value = (value << 8) | bytes[i];
+    return value;
+  }
+}
+
+CBlockFilter::CBlockFilter(void) :
+  m_capacity(0),
+  m_keyCount(0)
+{
+  Reset(MIN_CAPACITY);
+}
+
+void CBlockFilter::Reset(uint64_t capacity)
+{
+  m_capacity = std::max(capacity, MIN_CAPACITY);
+  m_keyCount = 0;
+
+  const uint64_t blockCount = (m_capacity * BITS_PER_KEY + BITS_PER_BLOCK - 1) / BITS_PER_BLOCK;
+  m_words.assign(static_cast<size_t>(blockCount * WORDS_PER_BLOCK), 0);
+}
+
+void CBlockFilter::GetBits(const std::string& multihash, uint64_t& block, uint16_t bits[]) const
+{
+  // Digests are random already. Anything shorter than a sha2-256 multihash
+  // is hashed first.
+  std::string hashed;
+  const uint8_t* bytes;
+  if (multihash.size() >= 2 + SHA256_DIGEST_SIZE)
+  {
+    bytes = reinterpret_cast<const uint8_t*>(multihash.data()) + 2;
+  }
+  else
+  {
+    hashed = Multihash(multihash.data(), multihash.size());
+    bytes = reinterpret_cast<const uint8_t*>(hashed.data()) + 2;
+  }
+
+  block = ReadUint64(bytes) % (m_words.size() / WORDS_PER_BLOCK);
+
+  for (unsigned int i = 0; i < BITS_SET_PER_KEY; i++)
+    bits[i] = static_cast<uint16_t>(((bytes[8 + 2 * i] << 8) | bytes[9 + 2 * i]) % BITS_PER_BLOCK);
+}
+
+void CBlockFilter::Add(const std::string& multihash)
+{
+  uint64_t block;
+  uint16_t bits[BITS_SET_PER_KEY];
+  GetBits(multihash, block, bits);
+
+  uint64_t* words = &m_words[static_cast<size_t>(block * WORDS_PER_BLOCK)];
+  for (unsigned int i = 0; i < BITS_SET_PER_KEY; i++)
+    words[bits[i] / 64] |= static_cast<uint64_t>(1) << (bits[i] % 64);
+
+  m_keyCount++;
+}
+
+bool CBlockFilter::MayContain(const std::string& multihash) const
+{
+  uint64_t block;
+  uint16_t bits[BITS_SET_PER_KEY];
+  GetBits(multihash, block, bits);
+
+  const uint64_t* words = &m_words[static_cast<size_t>(block * WORDS_PER_BLOCK)];
+  for (unsigned int i = 0; i < BITS_SET_PER_KEY; i++)
+  {
+    if ((words[bits[i] / 64] & (static_cast<uint64_t>(1) << (bits[i] % 64))) == 0)
+      return false;
+  }
+
+  return true;
+}
+
+bool CBlockFilter::Write(FILE* file) const
+{
+  const uint64_t header[3] = { m_capacity, m_keyCount, static_cast<uint64_t>(m_words.size()) };
+
+  return std::fwrite(header, sizeof(header), 1, file) == 1 &&
+         std::fwrite(m_words.data(), sizeof(uint64_t), m_words.size(), file) == m_words.size();
+}
+
+bool CBlockFilter::Read(FILE* file)
+{
+  uint64_t header[3];
+  if (std::fread(header, sizeof(header), 1, file) != 1)
+    return false;
+
+  Reset(header[0]);
+  if (header[2] != m_words.size() ||
+      std::fread(&m_words[0], sizeof(uint64_t), m_words.size(), file) != m_words.size())
+  {
+    Reset(MIN_CAPACITY);
+    return false;
+  }
+
+  m_keyCount = header[1];
+  return true;
+}
@@ -0,0 +1,74 @@
+/*
+ *    Copyright (C) 2015 juztamau5
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *    The above copyright notice and this permission notice shall be included in
+ *    all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+#ifndef __IPSF_BLOCKFILTER_H__
+#define __IPSF_BLOCKFILTER_H__
+
+#include <cstdio>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace IPSF
+{
+  /*!
+   * \brief Blocked bloom filter of block keys
+   *
+   * Each key sets a few bits inside one 64-byte block, so a lookup touches a
+   * single cache line. Keys are multihashes, whose digests are already
+   * uniformly distributed and are used as the hash directly.
+   *
+   * The filter isn't thread-safe.
+   */
+  class CBlockFilter
+  {
+  public:
+    CBlockFilter(void);
+
+    /*!
+     * \brief Empty the filter and size it for <capacity> keys
+     */
+    void Reset(uint64_t capacity);
+
+    void Add(const std::string& multihash);
+
+    /*!
+     * \return false if the key is definitely not in the filter
+     */
+    bool MayContain(const std::string& multihash) const;
+
+    uint64_t KeyCount(void) const { return m_keyCount; }
+    uint64_t Capacity(void) const { return m_capacity; }
+
+    bool Write(FILE* file) const;
+    bool Read(FILE* file);
+
+  private:
+    void GetBits(const std::string& multihash, uint64_t& block, uint16_t bits[]) const;
+
+    std::vector<uint64_t> m_words;
+    uint64_t              m_capacity;
+    uint64_t              m_keyCount;
+  };
+}
+
+#endif // __IPSF_BLOCKFILTER_H__
@@ -0,0 +1,279 @@
+/*
+ *    Copyright (C) 2015 juztamau5
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *    The above copyright notice and this permission notice shall be included in
+ *    all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include "blockpack.h"
+#include "multihash.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace IPSF;
+
+namespace
+{
+  const char     PACK_MAGIC[8] = { 'L', 'I', 'B', 'I', 'P', 'F', 'S', 'P' };
+  const uint32_t PACK_VERSION  = 1;
+
+  const size_t KEY_SIZE = 2 + SHA256_DIGEST_SIZE;
+
+  struct PackHeader
+  {
+    char     magic[8];
+    uint32_t version;
+    uint32_t entrySize;
+    uint64_t count;
+    uint64_t indexOffset;
+  };
+
+  bool IsPackable(const std::string& multihash)
+  {
+    return multihash.size() == KEY_SIZE &&
+           static_cast<uint8_t>(multihash[0]) == 0x12 &&
+           static_cast<uint8_t>(multihash[1]) == SHA256_DIGEST_SIZE;
+  }
+
+  bool CompareKeys(const BlockPackEntry& lhs, const BlockPackEntry& rhs)
+  {
+    return std::memcmp(lhs.key, rhs.key, KEY_SIZE) < 0;
+  }
+}
+
+CMappedFile::CMappedFile(void) :
+  m_data(NULL),
+  m_size(0)
+{
+}
+
+bool CMappedFile::Open(const std::string& path)
+{
+  Close();
+
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0)
+    return false;
+
+  bool bOk = false;
+
+  struct stat st;
+  if (fstat(fd, &st) == 0)
+  {
+    // Empty files can't be mapped, but have nothing to read either
+    if (st.st_size == 0)
+    {
+      bOk = true;
+    }
+    else
+    {
+      void* data = mmap(NULL, static_cast<size_t>(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+      if (data != MAP_FAILED)
+      {
+        m_data = static_cast<const char*>(data);
+        m_size = static_cast<size_t>(st.st_size);
+        bOk = true;
+      }
+    }
+  }
+
+  // The mapping outlives the descriptor
+  close(fd);
+  return bOk;
+}
+
+void CMappedFile::Close(void)
+{
+  if (m_data)
+    munmap(const_cast<char*>(m_data), m_size);
+
+  m_data = NULL;
+  m_size = 0;
+}
+
+CBlockPack::CBlockPack(void) :
+  m_index(NULL),
+  m_count(0),
+  m_dataEnd(0)
+{
+}
+
+bool CBlockPack::Open(const std::string& path)
+{
+  m_index = NULL;
+  m_count = 0;
+  m_dataEnd = 0;
+
+  if (!m_file.Open(path) || m_file.Size() < sizeof(PackHeader))
+    return false;
+
+  PackHeader header;
+  std::memcpy(&header, m_file.Data(), sizeof(header));
+
+  if (std::memcmp(header.magic, PACK_MAGIC, sizeof(PACK_MAGIC)) != 0 ||
+      header.version != PACK_VERSION ||
+      header.entrySize != sizeof(BlockPackEntry) ||
+      header.indexOffset < sizeof(PackHeader) ||
+      header.indexOffset % alignof(BlockPackEntry) != 0 ||
+      header.indexOffset > m_file.Size() ||
+      header.count != (m_file.Size() - header.indexOffset) / sizeof(BlockPackEntry) ||
+      (m_file.Size() - header.indexOffset) % sizeof(BlockPackEntry) != 0)
+  {
+    m_file.Close();
+    return false;
+  }
+
+  m_index = reinterpret_cast<const BlockPackEntry*>(m_file.Data() + header.indexOffset);
+  m_count = header.count;
+  m_dataEnd = header.indexOffset;
+
+  // Every lookup walks the index, the blocks are read as needed
+  const uintptr_t pageSize = static_cast<uintptr_t>(sysconf(_SC_PAGESIZE));
+  const uintptr_t indexStart = reinterpret_cast<uintptr_t>(m_index) & ~(pageSize - 1);
+  const uintptr_t indexEnd = reinterpret_cast<uintptr_t>(m_file.Data() + m_file.Size());
+  madvise(reinterpret_cast<void*>(indexStart), indexEnd - indexStart, MADV_WILLNEED);
+
+  return true;
+}
+
+bool CBlockPack::Find(const std::string& multihash, const char*& data, size_t& size) const
+{
+  if (!IsPackable(multihash))
+    return false;
+
+  BlockPackEntry key;
+  std::memcpy(key.key, multihash.data(), KEY_SIZE);
+
+  const BlockPackEntry* end = m_index + m_count;
+  const BlockPackEntry* entry = std::lower_bound(m_index, end, key, CompareKeys);
+  if (entry == end || std::memcmp(entry->key, key.key, KEY_SIZE) != 0)
+    return false;
+
+  if (entry->offset < sizeof(PackHeader) || entry->size > m_dataEnd - entry->offset)
+    return false;
+
+  data = m_file.Data() + entry->offset;
+  size = entry->size;
+  return true;
+}
+
+CBlockPackWriter::CBlockPackWriter(void) :
+  m_file(NULL),
+  m_offset(0)
+{
+}
+
+CBlockPackWriter::~CBlockPackWriter(void)
+{
+  if (m_file)
+  {
+    std::fclose(m_file);
+    std::remove(m_tmpPath.c_str());
+  }
+}
+
+bool CBlockPackWriter::Open(const std::string& path)
+{
+  m_path = path;
+  m_tmpPath = path + "-XXXXXX";
+
+  int fd = mkstemp(&m_tmpPath[0]);
+  if (fd < 0)
+    return false;
+
+  m_file = fdopen(fd, "wb");
+  if (m_file == NULL)
+  {
+    close(fd);
+    std::remove(m_tmpPath.c_str());
+    return false;
+  }
+
+  // The header is written last, once the index is in place
+  PackHeader header;
+  std::memset(&header, 0, sizeof(header));
+
+  m_offset = sizeof(header);
+  m_entries.clear();
+
+  return std::fwrite(&header, sizeof(header), 1, m_file) == 1;
+}
+
+bool CBlockPackWriter::Add(const std::string& multihash, const std::string& block)
+{
+  if (!m_file || !IsPackable(multihash) || block.size() > UINT32_MAX)
+    return false;
+
+  if (!block.empty() && std::fwrite(block.data(), block.size(), 1, m_file) != 1)
+    return false;
+
+  BlockPackEntry entry;
+  std::memcpy(entry.key, multihash.data(), KEY_SIZE);
+  std::memset(entry.reserved, 0, sizeof(entry.reserved));
+  entry.size = static_cast<uint32_t>(block.size());
+  entry.offset = m_offset;
+
+  m_entries.push_back(entry);
+  m_offset += block.size();
+
+  return true;
+}
+
+bool CBlockPackWriter::Commit(void)
+{
+  if (!m_file)
+    return false;
+
+  std::sort(m_entries.begin(), m_entries.end(), CompareKeys);
+
+  const uint64_t padding = (alignof(BlockPackEntry) - m_offset % alignof(BlockPackEntry)) % alignof(BlockPackEntry);
+  const char zeros[alignof(BlockPackEntry)] = { };
+
+  PackHeader header;
+  std::memcpy(header.magic, PACK_MAGIC, sizeof(PACK_MAGIC));
+  header.version = PACK_VERSION;
+  header.entrySize = sizeof(BlockPackEntry);
+  header.count = m_entries.size();
+  header.indexOffset = m_offset + padding;
+
+  bool bOk = (padding == 0 || std::fwrite(zeros, static_cast<size_t>(padding), 1, m_file) == 1);
+  bOk = bOk && (m_entries.empty() || std::fwrite(m_entries.data(), sizeof(BlockPackEntry), m_entries.size(), m_file) == m_entries.size());
+  bOk = bOk && std::fseek(m_file, 0, SEEK_SET) == 0;
+  bOk = bOk && std::fwrite(&header, sizeof(header), 1, m_file) == 1;
+
+  // Readers trust the contents, so the pack must be complete before it's
+  // moved into place
+  bOk = bOk && std::fflush(m_file) == 0 && fsync(fileno(m_file)) == 0;
+  bOk = (std::fclose(m_file) == 0) && bOk;
+  m_file = NULL;
+
+  if (!bOk || std::rename(m_tmpPath.c_str(), m_path.c_str()) != 0)
+  {
+    std::remove(m_tmpPath.c_str());
+    return false;
+  }
+
+  return true;
+}
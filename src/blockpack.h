@@ -0,0 +1,144 @@
+/*
+ *    Copyright (C) 2015 juztamau5
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *    The above copyright notice and this permission notice shall be included in
+ *    all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+#ifndef __IPSF_BLOCKPACK_H__
+#define __IPSF_BLOCKPACK_H__
+
+#include <cstdio>
+#include <memory>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace IPSF
+{
+  /*!
+   * \brief Read-only memory mapping of a whole file
+   */
+  class CMappedFile
+  {
+  public:
+    CMappedFile(void);
+    ~CMappedFile(void) { Close(); }
+
+    bool Open(const std::string& path);
+    void Close(void);
+
+    const char* Data(void) const { return m_data; }
+    size_t Size(void) const { return m_size; }
+
+  private:
+    const char* m_data;
+    size_t      m_size;
+  };
+
+  /*!
+   * \brief Borrowed contents of a block, valid for as long as <mapping> is
+   *        held
+   */
+  struct BlockRef
+  {
+    const char*                 data;
+    size_t                      size;
+    std::shared_ptr<const void> mapping;
+  };
+
+  /*!
+   * \brief Index entry of a block pack
+   */
+  struct BlockPackEntry
+  {
+    uint8_t  key[34]; // sha2-256 multihash
+    uint8_t  reserved[2];
+    uint32_t size;
+    uint64_t offset;
+  };
+
+  /*!
+   * \brief Blocks packed into one file for reading through a memory mapping
+   *
+   * Blocks are stored back to back in the order they were written, followed
+   * by an index sorted by key. Lookups binary search the mapped index, so
+   * once its pages are cached a block is found and read without a system
+   * call.
+   *
+   * Only sha2-256 keys are packed. The file is written in the host's byte
+   * order and is rejected elsewhere, like the presence filter.
+   */
+  class CBlockPack
+  {
+  public:
+    CBlockPack(void);
+
+    bool Open(const std::string& path);
+
+    /*!
+     * \return false if the pack doesn't hold the block. <data> points into the
+     *         mapping, which lives as long as the pack.
+     */
+    bool Find(const std::string& multihash, const char*& data, size_t& size) const;
+
+    uint64_t BlockCount(void) const { return m_count; }
+
+  private:
+    CMappedFile           m_file;
+    const BlockPackEntry* m_index;
+    uint64_t              m_count;
+    uint64_t              m_dataEnd;
+  };
+
+  /*!
+   * \brief Writes a pack to a temporary file and moves it into place on
+   *        Commit()
+   */
+  class CBlockPackWriter
+  {
+  public:
+    CBlockPackWriter(void);
+    ~CBlockPackWriter(void);
+
+    bool Open(const std::string& path);
+
+    /*!
+     * \return false if the key isn't a sha2-256 multihash or the block
+     *         couldn't be written
+     */
+    bool Add(const std::string& multihash, const std::string& block);
+
+    /*!
+     * \brief Write the index, sync the file and replace the pack at the path
+     *        given to Open()
+     */
+    bool Commit(void);
+
+    uint64_t BlockCount(void) const { return m_entries.size(); }
+
+  private:
+    std::string                 m_path;
+    std::string                 m_tmpPath;
+    FILE*                       m_file;
+    uint64_t                    m_offset;
+    std::vector<BlockPackEntry> m_entries;
+  };
+}
+
+#endif // __IPSF_BLOCKPACK_H__
@@ -0,0 +1,706 @@
+/*
+ *    Copyright (C) 2015 juztamau5
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *    The above copyright notice and this permission notice shall be included in
+ *    all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include "blockstore.h"
+#include "config.h"
+#include "multihash.h"
+#include "scheduler.h"
+#include "stringutils.h"
+#include "threadpool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <set>
+#include <sstream>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace IPSF;
+
+namespace
+{
+  const char* const BLOCK_EXTENSION = ".data";
+
+  // go-ipfs before blocks/SHARDING existed: hex names under their first
+  // 4 bytes
+  const unsigned int LEGACY_PREFIX_LENGTH = 8;
+
+  // Saved presence filter, next to the blocks directory
+  const char* const FILTER_FILE = "libipfs-blocks.filter";
+  const char* const FILTER_VERSION = "libipfs-block-filter 1";
+
+  std::string EncodeHex(const std::string& data)
+  {
+    static const char hex[] = "0123456789abcdef";
+
+    std::string str;
+    str.reserve(data.size() * 2);
+    for (std::string::const_iterator it = data.begin(); it != data.end(); ++it)
+    {
+      const uint8_t byte = static_cast<uint8_t>(*it);
+      str.push_back(hex[byte >> 4]);
+      str.push_back(hex[byte & 0xf]);
+    }
+    return str;
+  }
+
+  bool DecodeHex(const std::string& str, std::string& data)
+  {
+    if (str.size() % 2 != 0)
+      return false;
+
+    data.clear();
+    data.reserve(str.size() / 2);
+    for (size_t i = 0; i < str.size(); i += 2)
+    {
+      int byte = 0;
+      for (size_t j = i; j < i + 2; j++)
+      {
+        const char c = str[j];
+        if (c >= '0' && c <= '9')
+          byte = (byte << 4) | (c - '0');
+        else if (c >= 'a' && c <= 'f')
+          byte = (byte << 4) | (c - 'a' + 10);
+        else
+          return false;
+      }
+      data.push_back(static_cast<char>(byte));
+    }
+    return true;
+  }
+
+  bool ReadLine(FILE* file, std::string& line)
+  {
+    char buffer[256];
+    if (std::fgets(buffer, sizeof(buffer), file) == NULL)
+      return false;
+
+    line = buffer;
+    if (line.empty() || line[line.size() - 1] != '\n')
+      return false;
+
+    line.erase(line.size() - 1);
+    return true;
+  }
+
+  bool WriteAll(int fd, const char* data, size_t size)
+  {
+    while (size > 0)
+    {
+      ssize_t result = write(fd, data, size);
+      if (result < 0 && errno == EINTR)
+        continue;
+      if (result <= 0)
+        return false;
+      data += result;
+      size -= static_cast<size_t>(result);
+    }
+    return true;
+  }
+}
+
+CBlockstore::CBlockstore(void) :
+  m_bBase32(false),
+  m_shardFunction(ShardPrefix),
+  m_shardLength(LEGACY_PREFIX_LENGTH),
+  m_bSync(true),
+  m_bFilterChanged(false),
+  m_bRebuilding(false),
+  m_bConfirmMisses(false)
+{
+}
+
+bool CBlockstore::Open(const std::string& repoPath)
+{
+  m_path = repoPath + "/blocks";
+
+  struct stat st;
+  if (stat(m_path.c_str(), &st) != 0 || !S_ISDIR(st.st_mode))
+    return false;
+
+  if (!ReadSharding())
+    return false;
+
+  // Follow the repo's choice of durability
+  CConfig config;
+  if (config.Load(repoPath))
+  {
+    const CJsonValue* noSync = config.Get("Datastore.NoSync");
+    m_bSync = !(noSync && noSync->AsBool());
+  }
+
+  m_filterPath = repoPath + "/" + FILTER_FILE;
+
+  return LoadFilter();
+}
+
+void CBlockstore::Close(void)
+{
+  std::unique_lock<std::mutex> refreshLock(m_refreshMutex);
+
+  if (m_bFilterChanged)
+    SaveFilter();
+}
+
+bool CBlockstore::ReadSharding(void)
+{
+  std::ifstream file((m_path + "/SHARDING").c_str());
+  if (!file)
+  {
+    m_bBase32 = false;
+    m_shardFunction = ShardPrefix;
+    m_shardLength = LEGACY_PREFIX_LENGTH;
+    return true;
+  }
+
+  // /repo/flatfs/shard/v1/<function>/<length>
+  std::string spec;
+  std::getline(file, spec);
+
+  const std::string version = "/repo/flatfs/shard/v1/";
+  if (spec.compare(0, version.size(), version) != 0)
+    return false;
+
+  std::stringstream fields(spec.substr(version.size()));
+  std::string function;
+  std::string length;
+  if (!std::getline(fields, function, '/') || !std::getline(fields, length))
+    return false;
+
+  if (function == "prefix")
+    m_shardFunction = ShardPrefix;
+  else if (function == "suffix")
+    m_shardFunction = ShardSuffix;
+  else if (function == "next-to-last")
+    m_shardFunction = ShardNextToLast;
+  else
+    return false;
+
+  m_shardLength = static_cast<unsigned int>(std::strtoul(length.c_str(), NULL, 10));
+  m_bBase32 = true;
+
+  return m_shardLength > 0;
+}
+
+std::string CBlockstore::GetDirectory(const std::string& name) const
+{
+  // Short names are padded with '_' as go-ipfs does
+  switch (m_shardFunction)
+  {
+  case ShardSuffix:
+  {
+    const std::string padded = std::string(m_shardLength, '_') + name;
+    return padded.substr(padded.size() - m_shardLength);
+  }
+  case ShardNextToLast:
+  {
+    const std::string padded = std::string(m_shardLength + 1, '_') + name;
+    return padded.substr(padded.size() - m_shardLength - 1, m_shardLength);
+  }
+  case ShardPrefix:
+  default:
+    return (name + std::string(m_shardLength, '_')).substr(0, m_shardLength);
+  }
+}
+
+std::string CBlockstore::GetPath(const std::string& multihash) const
+{
+  const std::string name = m_bBase32 ? EncodeBase32(multihash) : EncodeHex(multihash);
+  return m_path + "/" + GetDirectory(name) + "/" + name + BLOCK_EXTENSION;
+}
+
+bool CBlockstore::Has(const std::string& multihash) const
+{
+  if (!MayContain(multihash))
+    return false;
+
+  struct stat st;
+  return stat(GetPath(multihash).c_str(), &st) == 0;
+}
+
+bool CBlockstore::GetSize(const std::string& multihash, uint64_t& size) const
+{
+  struct stat st;
+  if (stat(GetPath(multihash).c_str(), &st) != 0)
+    return false;
+
+  size = static_cast<uint64_t>(st.st_size);
+  return true;
+}
+
+bool CBlockstore::Get(const std::string& multihash, std::string& block) const
+{
+  return Get(multihash, [&block](size_t size)
+  {
+    block.resize(size);
+    return &block[0];
+  });
+}
+
+bool CBlockstore::Get(const std::string& multihash, const BlockAllocator& allocate) const
+{
+  CScheduledSlot slot(GetDiskScheduler());
+
+  int fd = open(GetPath(multihash).c_str(), O_RDONLY);
+  if (fd < 0)
+    return false;
+
+  bool bOk = false;
+
+  struct stat st;
+  if (fstat(fd, &st) == 0)
+  {
+    const size_t size = static_cast<size_t>(st.st_size);
+    char* buffer = allocate(size);
+
+    size_t bytesRead = 0;
+    while (buffer && bytesRead < size)
+    {
+      ssize_t result = read(fd, buffer + bytesRead, size - bytesRead);
+      if (result < 0 && errno == EINTR)
+        continue;
+      if (result <= 0)
+        break;
+      bytesRead += static_cast<size_t>(result);
+    }
+
+    bOk = (bytesRead == size);
+  }
+
+  close(fd);
+  return bOk;
+}
+
+bool CBlockstore::Put(const std::string& block, std::string& multihash)
+{
+  multihash = Multihash(block.data(), block.size());
+
+  const std::string path = GetPath(multihash);
+
+  // Blocks are immutable, so an existing file is already correct
+  struct stat st;
+  if (stat(path.c_str(), &st) != 0)
+  {
+    const std::string directory = path.substr(0, path.rfind('/'));
+    if (mkdir(directory.c_str(), 0755) != 0 && errno != EEXIST)
+      return false;
+
+    if (!WriteBlock(path, block))
+      return false;
+  }
+
+  if (AddToFilter(multihash))
+    RefreshFilter(true);
+
+  return true;
+}
+
+bool CBlockstore::PutMany(const std::vector<std::pair<std::string, std::string>>& blocks)
+{
+  std::vector<std::pair<std::string, size_t>> pending;
+  pending.reserve(blocks.size());
+  for (size_t i = 0; i < blocks.size(); i++)
+    pending.push_back(std::make_pair(GetPath(blocks[i].first), i));
+
+  std::sort(pending.begin(), pending.end());
+  pending.erase(std::unique(pending.begin(), pending.end(),
+    [](const std::pair<std::string, size_t>& a, const std::pair<std::string, size_t>& b)
+    {
+      return a.first == b.first;
+    }), pending.end());
+
+  std::set<std::string> directories;
+  for (std::vector<std::pair<std::string, size_t>>::const_iterator it = pending.begin(); it != pending.end(); ++it)
+  {
+    const std::string directory = it->first.substr(0, it->first.rfind('/'));
+    if (directories.insert(directory).second && mkdir(directory.c_str(), 0755) != 0 && errno != EEXIST)
+      return false;
+  }
+
+  std::atomic<bool> bFailed(false);
+
+  {
+    CTaskGroup tasks(GetWorkerPool());
+
+    for (std::vector<std::pair<std::string, size_t>>::const_iterator it = pending.begin(); it != pending.end(); ++it)
+    {
+      const std::string& path = it->first;
+      const std::string& block = blocks[it->second].second;
+
+      tasks.Run([this, &path, &block, &bFailed]()
+      {
+        struct stat st;
+        if (!bFailed && stat(path.c_str(), &st) != 0 && !WriteBlock(path, block))
+          bFailed = true;
+      });
+    }
+  }
+
+  // Make the renames durable
+  if (m_bSync)
+  {
+    for (std::set<std::string>::const_iterator it = directories.begin(); it != directories.end(); ++it)
+    {
+      CScheduledSlot slot(GetDiskScheduler());
+
+      int dirFd = open(it->c_str(), O_RDONLY);
+      if (dirFd >= 0)
+      {
+        fsync(dirFd);
+        close(dirFd);
+      }
+    }
+  }
+
+  bool bFull = false;
+  for (std::vector<std::pair<std::string, std::string>>::const_iterator it = blocks.begin(); it != blocks.end(); ++it)
+    bFull = AddToFilter(it->first) || bFull;
+
+  if (bFull)
+    RefreshFilter(true);
+
+  return !bFailed;
+}
+
+bool CBlockstore::WriteBlock(const std::string& path, const std::string& block) const
+{
+  CScheduledSlot slot(GetDiskScheduler());
+
+  std::string tmpPath = path.substr(0, path.rfind('/')) + "/put-XXXXXX";
+  int fd = mkstemp(&tmpPath[0]);
+  if (fd < 0)
+    return false;
+
+  bool bOk = WriteAll(fd, block.data(), block.size());
+  if (m_bSync)
+    bOk = (fsync(fd) == 0) && bOk;
+  bOk = (close(fd) == 0) && bOk;
+
+  if (!bOk || std::rename(tmpPath.c_str(), path.c_str()) != 0)
+  {
+    std::remove(tmpPath.c_str());
+    return false;
+  }
+
+  return true;
+}
+
+bool CBlockstore::AddToFilter(const std::string& multihash)
+{
+  std::unique_lock<std::mutex> lock(m_filterMutex);
+
+  m_filter.Add(multihash);
+  m_bFilterChanged = true;
+
+  // A rebuild may have scanned the directory before the block was written
+  if (m_bRebuilding)
+    m_rebuildAdded.push_back(multihash);
+
+  return !m_bRebuilding && m_filter.KeyCount() > m_filter.Capacity();
+}
+
+bool CBlockstore::MayContain(const std::string& multihash) const
+{
+  if (m_bConfirmMisses)
+    return true;
+
+  std::unique_lock<std::mutex> lock(m_filterMutex);
+  return m_filter.MayContain(multihash);
+}
+
+bool CBlockstore::RefreshFilter(bool bRebuild)
+{
+  std::unique_lock<std::mutex> refreshLock(m_refreshMutex);
+
+  // Directory times have a resolution of a second. A directory changed in
+  // the second the scan started could change again without getting a new
+  // time, so it isn't trusted and gets scanned again next time.
+  const int64_t scanStart = static_cast<int64_t>(std::time(NULL));
+
+  // Blocks put from here on are kept aside, even those in directories that
+  // don't exist yet when they are listed
+  if (bRebuild)
+  {
+    std::unique_lock<std::mutex> lock(m_filterMutex);
+    m_bRebuilding = true;
+    m_rebuildAdded.clear();
+  }
+
+  DirectoryTimes directories;
+  if (!ListDirectories(directories))
+  {
+    std::unique_lock<std::mutex> lock(m_filterMutex);
+    m_bRebuilding = false;
+    m_rebuildAdded.clear();
+    return false;
+  }
+
+  std::vector<std::string> changed;
+  {
+    std::unique_lock<std::mutex> lock(m_filterMutex);
+
+    for (DirectoryTimes::const_iterator it = directories.begin(); it != directories.end(); ++it)
+    {
+      DirectoryTimes::const_iterator known = m_directoryTimes.find(it->first);
+      if (bRebuild || known == m_directoryTimes.end() || known->second != it->second)
+        changed.push_back(it->first);
+    }
+
+    if (!bRebuild && changed.empty() && directories.size() == m_directoryTimes.size())
+      return true;
+  }
+
+  std::vector<std::vector<std::string>> keys(changed.size());
+  std::vector<char> scanned(changed.size(), 0);
+  {
+    CTaskGroup tasks(GetWorkerPool());
+
+    for (size_t i = 0; i < changed.size(); i++)
+    {
+      tasks.Run([this, &changed, &keys, &scanned, i]()
+      {
+        scanned[i] = ScanDirectory(changed[i], keys[i]);
+      });
+    }
+  }
+
+  uint64_t keyCount = 0;
+  for (size_t i = 0; i < keys.size(); i++)
+    keyCount += keys[i].size();
+
+  // Build a new filter aside so lookups keep working meanwhile
+  CBlockFilter filter;
+  if (bRebuild)
+  {
+    filter.Reset(keyCount * 2);
+    for (size_t i = 0; i < keys.size(); i++)
+    {
+      for (std::vector<std::string>::const_iterator it = keys[i].begin(); it != keys[i].end(); ++it)
+        filter.Add(*it);
+    }
+  }
+
+  std::unique_lock<std::mutex> lock(m_filterMutex);
+
+  if (bRebuild)
+  {
+    for (std::vector<std::string>::const_iterator it = m_rebuildAdded.begin(); it != m_rebuildAdded.end(); ++it)
+      filter.Add(*it);
+
+    std::swap(m_filter, filter);
+    m_directoryTimes.clear();
+    m_rebuildAdded.clear();
+    m_bRebuilding = false;
+  }
+  else if (m_filter.KeyCount() + keyCount > m_filter.Capacity())
+  {
+    // Keys can't be moved to a bigger filter, it has to be built again
+    lock.unlock();
+    refreshLock.unlock();
+    return RefreshFilter(true);
+  }
+  else
+  {
+    for (size_t i = 0; i < keys.size(); i++)
+    {
+      for (std::vector<std::string>::const_iterator it = keys[i].begin(); it != keys[i].end(); ++it)
+        m_filter.Add(*it);
+    }
+  }
+
+  // Forget removed directories
+  for (DirectoryTimes::iterator it = m_directoryTimes.begin(); it != m_directoryTimes.end(); )
+  {
+    if (directories.find(it->first) == directories.end())
+      m_directoryTimes.erase(it++);
+    else
+      ++it;
+  }
+
+  for (size_t i = 0; i < changed.size(); i++)
+  {
+    const int64_t modified = directories[changed[i]];
+    if (scanned[i] && modified < scanStart)
+      m_directoryTimes[changed[i]] = modified;
+    else
+      m_directoryTimes[changed[i]] = -1;
+  }
+
+  m_bFilterChanged = true;
+  return true;
+}
+
+bool CBlockstore::ListDirectories(DirectoryTimes& directories) const
+{
+  DIR* dir = opendir(m_path.c_str());
+  if (dir == NULL)
+    return false;
+
+  struct dirent* entry;
+  while ((entry = readdir(dir)) != NULL)
+  {
+    const std::string name = entry->d_name;
+    if (name.empty() || name[0] == '.')
+      continue;
+
+    struct stat st;
+    if (stat((m_path + "/" + name).c_str(), &st) == 0 && S_ISDIR(st.st_mode))
+      directories[name] = static_cast<int64_t>(st.st_mtime);
+  }
+
+  closedir(dir);
+  return true;
+}
+
+bool CBlockstore::ScanDirectory(const std::string& directory, std::vector<std::string>& multihashes) const
+{
+  CScheduledSlot slot(GetDiskScheduler());
+
+  DIR* dir = opendir((m_path + "/" + directory).c_str());
+  if (dir == NULL)
+    return false;
+
+  struct dirent* entry;
+  std::string multihash;
+  while ((entry = readdir(dir)) != NULL)
+  {
+    if (DecodeName(entry->d_name, multihash))
+      multihashes.push_back(multihash);
+  }
+
+  closedir(dir);
+  return true;
+}
+
+bool CBlockstore::DecodeName(const std::string& name, std::string& multihash) const
+{
+  if (name.size() <= std::strlen(BLOCK_EXTENSION) || !StringUtils::EndsWith(name, BLOCK_EXTENSION))
+    return false;
+
+  const std::string key = name.substr(0, name.size() - std::strlen(BLOCK_EXTENSION));
+  return m_bBase32 ? DecodeBase32(key, multihash) : DecodeHex(key, multihash);
+}
+
+bool CBlockstore::LoadFilter(void)
+{
+  // Layout the saved directory names belong to
+  std::stringstream layout;
+  layout << m_bBase32 << " " << m_shardFunction << " " << m_shardLength;
+
+  m_directoryTimes.clear();
+
+  bool bLoaded = false;
+
+  FILE* file = std::fopen(m_filterPath.c_str(), "rb");
+  if (file != NULL)
+  {
+    std::string line;
+    unsigned long directoryCount = 0;
+
+    bLoaded = ReadLine(file, line) && line == FILTER_VERSION &&
+              ReadLine(file, line) && line == layout.str() &&
+              ReadLine(file, line) && std::sscanf(line.c_str(), "%lu", &directoryCount) == 1;
+
+    for (unsigned long i = 0; bLoaded && i < directoryCount; i++)
+    {
+      bLoaded = ReadLine(file, line);
+
+      const size_t separator = line.find(' ');
+      if (bLoaded && separator != std::string::npos)
+        m_directoryTimes[line.substr(separator + 1)] = std::strtoll(line.c_str(), NULL, 10);
+      else
+        bLoaded = false;
+    }
+
+    bLoaded = bLoaded && m_filter.Read(file);
+
+    std::fclose(file);
+  }
+
+  if (!bLoaded)
+    m_directoryTimes.clear();
+
+  m_bFilterChanged = false;
+
+  if (!RefreshFilter(!bLoaded))
+    return false;
+
+  if (m_bFilterChanged)
+  {
+    SaveFilter();
+    m_bFilterChanged = false;
+  }
+
+  return true;
+}
+
+bool CBlockstore::SaveFilter(void)
+{
+  std::stringstream layout;
+  layout << m_bBase32 << " " << m_shardFunction << " " << m_shardLength;
+
+  std::string tmpPath = m_filterPath + "-XXXXXX";
+  int fd = mkstemp(&tmpPath[0]);
+  if (fd < 0)
+    return false;
+
+  FILE* file = fdopen(fd, "wb");
+  if (file == NULL)
+  {
+    close(fd);
+    std::remove(tmpPath.c_str());
+    return false;
+  }
+
+  std::unique_lock<std::mutex> lock(m_filterMutex);
+
+  bool bOk = std::fprintf(file, "%s\n%s\n%lu\n", FILTER_VERSION, layout.str().c_str(),
+                          static_cast<unsigned long>(m_directoryTimes.size())) > 0;
+
+  for (DirectoryTimes::const_iterator it = m_directoryTimes.begin(); bOk && it != m_directoryTimes.end(); ++it)
+    bOk = std::fprintf(file, "%lld %s\n", static_cast<long long>(it->second), it->first.c_str()) > 0;
+
+  bOk = bOk && m_filter.Write(file);
+
+  m_bFilterChanged = false;
+  lock.unlock();
+
+  // The filter is a cache, a torn file is rebuilt on the next open
+  bOk = (std::fclose(file) == 0) && bOk;
+  if (!bOk || std::rename(tmpPath.c_str(), m_filterPath.c_str()) != 0)
+  {
+    std::remove(tmpPath.c_str());
+    return false;
+  }
+
+  return true;
+}
@@ -0,0 +1,164 @@
+/*
+ *    Copyright (C) 2015 juztamau5
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *    The above copyright notice and this permission notice shall be included in
+ *    all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+#ifndef __IPSF_BLOCKSTORE_H__
+#define __IPSF_BLOCKSTORE_H__
+
+#include "blockfilter.h"
+
+#include <atomic>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <stdint.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace IPSF
+{
+  /*!
+   * \brief Provides the memory a block is read into, given its size
+   *
+   * Returns NULL if the memory can't be provided, which is no failure for
+   * empty blocks. Called at most once per read.
+   */
+  typedef std::function<char*(size_t size)> BlockAllocator;
+
+  /*!
+   * \brief Direct access to the flatfs block directory of a repo
+   *
+   * Blocks are files named after their key, so single blocks can be read and
+   * written without starting go-ipfs. Both layouts go-ipfs has used are
+   * supported: hex names in 8-character prefix directories, and base32 names
+   * sharded as described by blocks/SHARDING.
+   *
+   * A bloom filter of the stored keys answers most misses without touching
+   * the disk. It's saved in the repo with the modification times of the shard
+   * directories, so reopening only scans directories that changed since.
+   *
+   * Keys are binary multihashes. All methods are thread-safe.
+   */
+  class CBlockstore
+  {
+  public:
+    CBlockstore(void);
+
+    bool Open(const std::string& repoPath);
+
+    /*!
+     * \brief Save the presence filter if it changed since it was loaded
+     */
+    void Close(void);
+
+    /*!
+     * \brief Check the presence filter, then the store
+     */
+    bool Has(const std::string& multihash) const;
+    bool GetSize(const std::string& multihash, uint64_t& size) const;
+    bool Get(const std::string& multihash, std::string& block) const;
+    bool Get(const std::string& multihash, const BlockAllocator& allocate) const;
+
+    /*!
+     * \brief Store a block under the key computed from its contents
+     *
+     * The block is written to a temporary file and renamed into place, so
+     * readers never see partial blocks.
+     */
+    bool Put(const std::string& block, std::string& multihash);
+
+    /*!
+     * \brief Store many blocks whose keys are already known
+     *
+     * Keys must match the contents, callers verify them. Blocks are written
+     * in directory order on the worker pool, and each directory is synced
+     * once for the whole batch instead of once per block.
+     */
+    bool PutMany(const std::vector<std::pair<std::string, std::string>>& blocks);
+
+    /*!
+     * \brief Confirm filter misses with a stat of the block file
+     *
+     * Set while someone else may be writing blocks the filter doesn't know
+     * about yet, such as a daemon serving the repo.
+     */
+    void SetConfirmMisses(bool bConfirm) { m_bConfirmMisses = bConfirm; }
+
+    /*!
+     * \brief Add blocks written by someone else to the presence filter
+     *
+     * \param bRebuild Scan every directory into a new filter, dropping keys
+     *                 of removed blocks, instead of scanning the directories
+     *                 that changed
+     *
+     * \return false if the block directory couldn't be listed
+     */
+    bool RefreshFilter(bool bRebuild);
+
+  private:
+    bool WriteBlock(const std::string& path, const std::string& block) const;
+
+    enum ShardFunction
+    {
+      ShardPrefix,
+      ShardSuffix,
+      ShardNextToLast,
+    };
+
+    bool ReadSharding(void);
+
+    std::string GetDirectory(const std::string& name) const;
+    std::string GetPath(const std::string& multihash) const;
+
+    // Presence filter
+    typedef std::map<std::string, int64_t> DirectoryTimes;
+
+    bool LoadFilter(void);
+    bool SaveFilter(void);
+    bool ListDirectories(DirectoryTimes& directories) const;
+    bool ScanDirectory(const std::string& directory, std::vector<std::string>& multihashes) const;
+    bool DecodeName(const std::string& name, std::string& multihash) const;
+
+    // Returns true once the filter holds more keys than it was sized for
+    bool AddToFilter(const std::string& multihash);
+
+    bool MayContain(const std::string& multihash) const;
+
+    std::string              m_path;
+    bool                     m_bBase32;
+    ShardFunction            m_shardFunction;
+    unsigned int             m_shardLength;
+    bool                     m_bSync;
+
+    std::string              m_filterPath;
+    CBlockFilter             m_filter;
+    DirectoryTimes           m_directoryTimes;
+    bool                     m_bFilterChanged;
+    bool                     m_bRebuilding;
+    std::vector<std::string> m_rebuildAdded;
+    mutable std::mutex       m_filterMutex;
+    std::mutex               m_refreshMutex;
+    std::atomic<bool>        m_bConfirmMisses;
+  };
+}
+
+#endif // __IPSF_BLOCKSTORE_H__
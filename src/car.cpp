@@ -0,0 +1,558 @@
+/*
+ *    Copyright (C) 2015 juztamau5
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *    The above copyright notice and this permission notice shall be included in
+ *    all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include "car.h"
+#include "blockstore.h"
+#include "config.h"
+#include "invoke.h"
+#include "merkledag.h"
+#include "multihash.h"
+#include "node.h"
+#include "scheduler.h"
+#include "threadpool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <stdint.h>
+#include <thread>
+#include <unordered_set>
+#include <utility>
+
+#include <unistd.h>
+
+using namespace IPSF;
+
+namespace
+{
+  const size_t IO_BUFFER_SIZE = 1024 * 1024;
+
+  // Larger sections are rejected instead of being buffered
+  const uint64_t MAX_HEADER_SIZE = 1024 * 1024;
+  const uint64_t MAX_SECTION_SIZE = 16 * 1024 * 1024;
+
+  // Blocks are verified and stored in batches of this many blocks or bytes
+  const size_t BATCH_BLOCKS = 4096;
+  const size_t BATCH_BYTES = 64 * 1024 * 1024;
+
+  const uint8_t MULTIHASH_SHA2_256 = 0x12;
+  const uint64_t CODEC_DAG_PB = 0x70;
+  const uint64_t CBOR_TAG_CID = 42;
+
+  typedef std::vector<std::pair<std::string, std::string>> BlockBatch;
+
+  void AppendVarint(std::string& buffer, uint64_t value)
+  {
+    while (value >= 0x80)
+    {
+      buffer.push_back(static_cast<char>((value & 0x7f) | 0x80));
+      value >>= 7;
+    }
+    buffer.push_back(static_cast<char>(value));
+  }
+
+  bool ReadVarint(const std::string& buffer, size_t& pos, uint64_t& value)
+  {
+    value = 0;
+    for (unsigned int shift = 0; shift < 64 && pos < buffer.size(); shift += 7)
+    {
+      const uint8_t byte = static_cast<uint8_t>(buffer[pos++]);
+      value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+      if ((byte & 0x80) == 0)
+        return true;
+    }
+    return false;
+  }
+
+  class CFdWriter
+  {
+  public:
+    CFdWriter(int fd) : m_fd(fd) { m_buffer.reserve(IO_BUFFER_SIZE); }
+
+    bool Write(const std::string& data)
+    {
+      m_buffer.append(data);
+      return m_buffer.size() < IO_BUFFER_SIZE || Flush();
+    }
+
+    bool Flush(void)
+    {
+      size_t written = 0;
+      while (written < m_buffer.size())
+      {
+        ssize_t result = write(m_fd, m_buffer.data() + written, m_buffer.size() - written);
+        if (result < 0 && errno == EINTR)
+          continue;
+        if (result <= 0)
+          return false;
+        written += static_cast<size_t>(result);
+      }
+      m_buffer.clear();
+      return true;
+    }
+
+  private:
+    const int   m_fd;
+    std::string m_buffer;
+  };
+
+  class CFdReader
+  {
+  public:
+    CFdReader(int fd) : m_fd(fd), m_pos(0) { }
+
+    /*!
+     * \return false at the end of the input or on error. <bEof> tells them
+     *         apart when nothing was read.
+     */
+    bool ReadVarint(uint64_t& value, bool& bEof)
+    {
+      value = 0;
+      bEof = false;
+      for (unsigned int shift = 0; shift < 64; shift += 7)
+      {
+        if (m_pos == m_buffer.size() && !Fill())
+        {
+          bEof = (shift == 0);
+          return false;
+        }
+
+        const uint8_t byte = static_cast<uint8_t>(m_buffer[m_pos++]);
+        value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0)
+          return true;
+      }
+      return false;
+    }
+
+    bool Read(size_t size, std::string& data)
+    {
+      data.clear();
+      data.reserve(size);
+      while (data.size() < size)
+      {
+        if (m_pos == m_buffer.size() && !Fill())
+          return false;
+
+        const size_t count = std::min(size - data.size(), m_buffer.size() - m_pos);
+        data.append(m_buffer, m_pos, count);
+        m_pos += count;
+      }
+      return true;
+    }
+
+  private:
+    bool Fill(void)
+    {
+      m_buffer.resize(IO_BUFFER_SIZE);
+      m_pos = 0;
+      while (true)
+      {
+        ssize_t result = read(m_fd, &m_buffer[0], m_buffer.size());
+        if (result < 0 && errno == EINTR)
+          continue;
+
+        m_buffer.resize(result > 0 ? static_cast<size_t>(result) : 0);
+        return result > 0;
+      }
+    }
+
+    const int   m_fd;
+    std::string m_buffer;
+    size_t      m_pos;
+  };
+
+  bool IsSha256Multihash(const std::string& multihash)
+  {
+    return multihash.size() == 2 + SHA256_DIGEST_SIZE &&
+           static_cast<uint8_t>(multihash[0]) == MULTIHASH_SHA2_256 &&
+           static_cast<uint8_t>(multihash[1]) == SHA256_DIGEST_SIZE;
+  }
+
+  /*!
+   * \brief Get the length of the CID at the start of <data>
+   *
+   * Keys in the repo are multihashes, so only CIDv0 and CIDv1 dag-pb sha2-256
+   * are accepted. <multihash> receives the multihash of the CID.
+   */
+  bool ParseCid(const std::string& data, size_t& length, std::string& multihash)
+  {
+    // CIDv0 is a bare multihash
+    if (!data.empty() && static_cast<uint8_t>(data[0]) == MULTIHASH_SHA2_256)
+    {
+      length = 2 + SHA256_DIGEST_SIZE;
+      multihash = data.substr(0, length);
+      return IsSha256Multihash(multihash);
+    }
+
+    size_t pos = 0;
+    uint64_t version;
+    uint64_t codec;
+    if (!ReadVarint(data, pos, version) || version != 1 ||
+        !ReadVarint(data, pos, codec) || codec != CODEC_DAG_PB)
+      return false;
+
+    length = pos + 2 + SHA256_DIGEST_SIZE;
+    multihash = data.substr(pos, 2 + SHA256_DIGEST_SIZE);
+    return IsSha256Multihash(multihash);
+  }
+
+  /*!
+   * \brief Minimal reader for the dag-cbor CAR header
+   */
+  class CCborReader
+  {
+  public:
+    CCborReader(const std::string& data) : m_data(data), m_pos(0) { }
+
+    bool AtEnd(void) const { return m_pos == m_data.size(); }
+
+    bool ReadHead(unsigned int& majorType, uint64_t& value)
+    {
+      if (m_pos >= m_data.size())
+        return false;
+
+      const uint8_t initial = static_cast<uint8_t>(m_data[m_pos++]);
+      majorType = initial >> 5;
+
+      const unsigned int info = initial & 0x1f;
+      if (info < 24)
+      {
+        value = info;
+        return true;
+      }
+      if (info > 27)
+        return false;
+
+      const size_t size = static_cast<size_t>(1) << (info - 24);
+      if (m_data.size() - m_pos < size)
+        return false;
+
+      value = 0;
+      for (size_t i = 0; i < size; i++)
+        value = (value << 8) | static_cast<uint8_t>(m_data[m_pos++]);
+      return true;
+    }
+
+    bool ReadBytes(uint64_t size, std::string& bytes)
+    {
+      if (m_data.size() - m_pos < size)
+        return false;
+
+      bytes = m_data.substr(m_pos, static_cast<size_t>(size));
+      m_pos += static_cast<size_t>(size);
+      return true;
+    }
+
+    bool Skip(unsigned int depth)
+    {
+      unsigned int majorType;
+      uint64_t value;
+      if (depth > 16 || !ReadHead(majorType, value))
+        return false;
+
+      std::string bytes;
+      switch (majorType)
+      {
+      case 2: // Byte string
+      case 3: // Text string
+        return ReadBytes(value, bytes);
+      case 4: // Array
+        for (uint64_t i = 0; i < value; i++)
+        {
+          if (!Skip(depth + 1))
+            return false;
+        }
+        return true;
+      case 5: // Map
+        for (uint64_t i = 0; i < value * 2; i++)
+        {
+          if (!Skip(depth + 1))
+            return false;
+        }
+        return true;
+      case 6: // Tag
+        return Skip(depth + 1);
+      default:
+        return true;
+      }
+    }
+
+  private:
+    const std::string& m_data;
+    size_t             m_pos;
+  };
+
+  bool ParseHeader(const std::string& header, std::vector<std::string>& roots)
+  {
+    CCborReader reader(header);
+
+    unsigned int majorType;
+    uint64_t count;
+    if (!reader.ReadHead(majorType, count) || majorType != 5)
+      return false;
+
+    uint64_t version = 0;
+    for (uint64_t i = 0; i < count; i++)
+    {
+      std::string key;
+      uint64_t value;
+      if (!reader.ReadHead(majorType, value) || majorType != 3 || !reader.ReadBytes(value, key))
+        return false;
+
+      if (key == "version")
+      {
+        if (!reader.ReadHead(majorType, version) || majorType != 0)
+          return false;
+      }
+      else if (key == "roots")
+      {
+        uint64_t rootCount;
+        if (!reader.ReadHead(majorType, rootCount) || majorType != 4)
+          return false;
+
+        for (uint64_t j = 0; j < rootCount; j++)
+        {
+          // CIDs are tag 42 around the CID bytes with a leading 0x00
+          uint64_t tag;
+          uint64_t size;
+          std::string bytes;
+          if (!reader.ReadHead(majorType, tag) || majorType != 6 || tag != CBOR_TAG_CID ||
+              !reader.ReadHead(majorType, size) || majorType != 2 || !reader.ReadBytes(size, bytes) ||
+              bytes.empty() || bytes[0] != '\0')
+            return false;
+
+          size_t length;
+          std::string multihash;
+          if (!ParseCid(bytes.substr(1), length, multihash) || length != bytes.size() - 1)
+            return false;
+
+          roots.push_back(multihash);
+        }
+      }
+      else if (!reader.Skip(0))
+      {
+        return false;
+      }
+    }
+
+    return version == 1 && reader.AtEnd();
+  }
+
+  std::string EncodeHeader(const std::string& rootMultihash)
+  {
+    // {"roots": [CID(root)], "version": 1} with keys in dag-cbor order
+    std::string header;
+    header.push_back(static_cast<char>(0xa2));
+    header.push_back(static_cast<char>(0x65));
+    header.append("roots");
+    header.push_back(static_cast<char>(0x81));
+    header.push_back(static_cast<char>(0xd8));
+    header.push_back(static_cast<char>(CBOR_TAG_CID));
+    header.push_back(static_cast<char>(0x58));
+    header.push_back(static_cast<char>(rootMultihash.size() + 1));
+    header.push_back('\0');
+    header.append(rootMultihash);
+    header.push_back(static_cast<char>(0x67));
+    header.append("version");
+    header.push_back(static_cast<char>(0x01));
+    return header;
+  }
+
+  bool StoreBatch(const BlockBatch& batch)
+  {
+    std::atomic<bool> bValid(true);
+
+    {
+      CTaskGroup tasks(GetWorkerPool());
+
+      const size_t chunkSize = 64;
+      for (size_t begin = 0; begin < batch.size(); begin += chunkSize)
+      {
+        const size_t end = std::min(begin + chunkSize, batch.size());
+        tasks.Run([&batch, &bValid, begin, end]()
+        {
+          for (size_t i = begin; i < end && bValid; i++)
+          {
+            if (Multihash(batch[i].second.data(), batch[i].second.size()) != batch[i].first)
+              bValid = false;
+          }
+        });
+      }
+    }
+
+    if (!bValid)
+      return false;
+
+    return PutBlocks(batch);
+  }
+}
+
+bool IPSF::ExportCar(const std::string& rootMultihash, int fd)
+{
+  BlockBatch root(1, std::make_pair(rootMultihash, std::string()));
+  if (!GetBlocks(root))
+    return false;
+
+  CFdWriter writer(fd);
+
+  const std::string header = EncodeHeader(rootMultihash);
+  std::string section;
+  AppendVarint(section, header.size());
+  section.append(header);
+  if (!writer.Write(section))
+    return false;
+
+  std::unordered_set<std::string> visited;
+  visited.insert(rootMultihash);
+
+  BlockBatch stack;
+  stack.push_back(std::pair<std::string, std::string>());
+  stack.back().swap(root[0]);
+
+  while (!stack.empty())
+  {
+    std::pair<std::string, std::string> node;
+    node.swap(stack.back());
+    stack.pop_back();
+
+    section.clear();
+    AppendVarint(section, node.first.size() + node.second.size());
+    section.append(node.first);
+    section.append(node.second);
+    if (!writer.Write(section))
+      return false;
+
+    std::vector<DagLink> links;
+    std::string data;
+    if (!DecodeDagNode(node.second, links, data))
+      continue;
+
+    BlockBatch children;
+    for (std::vector<DagLink>::const_iterator it = links.begin(); it != links.end(); ++it)
+    {
+      if (visited.insert(it->hash).second)
+        children.push_back(std::make_pair(it->hash, std::string()));
+    }
+
+    if (!GetBlocks(children))
+      return false;
+
+    // Children are visited in link order
+    for (BlockBatch::reverse_iterator it = children.rbegin(); it != children.rend(); ++it)
+    {
+      stack.push_back(std::pair<std::string, std::string>());
+      stack.back().swap(*it);
+    }
+  }
+
+  return writer.Flush();
+}
+
+bool IPSF::ImportCar(int fd, std::vector<std::string>& roots)
+{
+  roots.clear();
+
+  CFdReader reader(fd);
+
+  uint64_t size;
+  bool bEof;
+  std::string header;
+  if (!reader.ReadVarint(size, bEof) || size > MAX_HEADER_SIZE ||
+      !reader.Read(static_cast<size_t>(size), header) || !ParseHeader(header, roots))
+    return false;
+
+  // Only roots that are part of the archive can be pinned without fetching
+  std::unordered_set<std::string> importedRoots;
+
+  // The previous batch is stored while the next one is read
+  BlockBatch batch;
+  size_t batchBytes = 0;
+  BlockBatch storing;
+  std::thread storer;
+  bool bStored = true;
+  bool bOk = true;
+
+  while (true)
+  {
+    std::string section;
+    if (!reader.ReadVarint(size, bEof))
+    {
+      bOk = bEof;
+      break;
+    }
+
+    size_t cidLength;
+    std::string multihash;
+    if (size > MAX_SECTION_SIZE || !reader.Read(static_cast<size_t>(size), section) ||
+        !ParseCid(section, cidLength, multihash) || cidLength > section.size())
+    {
+      bOk = false;
+      break;
+    }
+
+    if (std::find(roots.begin(), roots.end(), multihash) != roots.end())
+      importedRoots.insert(multihash);
+
+    section.erase(0, cidLength);
+    batchBytes += section.size();
+    batch.push_back(std::make_pair(multihash, std::string()));
+    batch.back().second.swap(section);
+
+    if (batch.size() >= BATCH_BLOCKS || batchBytes >= BATCH_BYTES)
+    {
+      if (storer.joinable())
+        storer.join();
+      if (!bStored)
+        break;
+
+      storing.swap(batch);
+      batch.clear();
+      batchBytes = 0;
+
+      const PriorityClass priority = GetThreadPriority();
+      const std::string repoPath = GetThreadRepo();
+      storer = std::thread([&storing, &bStored, priority, repoPath]()
+      {
+        SetThreadPriority(priority);
+        SelectThreadRepo(repoPath);
+        bStored = StoreBatch(storing);
+      });
+    }
+  }
+
+  if (storer.joinable())
+    storer.join();
+
+  if (!bOk || !bStored || !StoreBatch(batch))
+    return false;
+
+  for (std::unordered_set<std::string>::const_iterator it = importedRoots.begin(); it != importedRoots.end(); ++it)
+  {
+    std::string output;
+    if (!invoke("ipfs pin add " + EncodeBase58(*it) + " -r true", output) || output.find("pinned") == std::string::npos)
+      return false;
+  }
+
+  return true;
+}
@@ -0,0 +1,53 @@
+/*
+ *    Copyright (C) 2015 juztamau5
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *    The above copyright notice and this permission notice shall be included in
+ *    all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+#ifndef __IPSF_CAR_H__
+#define __IPSF_CAR_H__
+
+#include <string>
+#include <vector>
+
+namespace IPSF
+{
+  /*!
+   * \brief Write the DAG under <rootMultihash> to <fd> as a CARv1 archive
+   *
+   * The header names the root, and every block of the DAG follows once, in
+   * depth-first order. The children of each node are read in parallel, from
+   * the blockstore or the daemon's API. Without a daemon, the whole DAG must
+   * be in the repo.
+   */
+  bool ExportCar(const std::string& rootMultihash, int fd);
+
+  /*!
+   * \brief Read a CARv1 archive from <fd> into the repo
+   *
+   * Blocks are verified against their keys on the worker pool and stored in
+   * large batches, while the next batch is being read. Roots named by the
+   * header whose blocks are in the archive are pinned.
+   *
+   * \param roots Receives the binary multihashes of the roots
+   */
+  bool ImportCar(int fd, std::vector<std::string>& roots);
+}
+
+#endif // __IPSF_CAR_H__
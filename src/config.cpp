@@ -0,0 +1,297 @@
+/*
+ *    Copyright (C) 2015 juztamau5
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *    The above copyright notice and this permission notice shall be included in
+ *    all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include "config.h"
+
+#if defined(TARGET_POSIX)
+#include "api.h"
+#endif
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+
+#if defined(TARGET_POSIX)
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+using namespace IPSF;
+
+namespace
+{
+#if defined(TARGET_POSIX)
+  // Time the daemon gets to accept the changed config
+  const unsigned int NOTIFY_TIMEOUT_MS = 10 * 1000;
+#endif
+
+  bool ReadConfig(const std::string& path, CJsonValue& document)
+  {
+    std::ifstream file(path.c_str());
+    if (!file)
+      return false;
+
+    std::stringstream contents;
+    contents << file.rdbuf();
+
+    return CJsonValue::Parse(contents.str(), document) && document.GetType() == CJsonValue::TypeObject;
+  }
+
+#if defined(TARGET_POSIX)
+  bool WriteAll(int fd, const std::string& data)
+  {
+    size_t written = 0;
+    while (written < data.size())
+    {
+      ssize_t result = write(fd, data.data() + written, data.size() - written);
+      if (result <= 0)
+        return false;
+      written += static_cast<size_t>(result);
+    }
+    return true;
+  }
+#endif
+
+  /*!
+   * \brief Replace a file with write-to-temp, fsync and rename
+   *
+   * The config holds the node's private key, so the file is only readable by
+   * its owner.
+   */
+  bool WriteConfig(const std::string& repoPath, const std::string& data)
+  {
+    const std::string path = repoPath + "/config";
+    const std::string tmpPath = path + ".tmp";
+
+#if defined(TARGET_POSIX)
+    int fd = open(tmpPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    if (fd < 0)
+      return false;
+
+    bool bOk = WriteAll(fd, data);
+    bOk = (fsync(fd) == 0) && bOk;
+    bOk = (close(fd) == 0) && bOk;
+#else
+    std::ofstream file(tmpPath.c_str(), std::ios::binary | std::ios::trunc);
+    file << data;
+    file.close();
+
+    bool bOk = !file.fail();
+
+    // rename() doesn't replace existing files here
+    if (bOk)
+      std::remove(path.c_str());
+#endif
+
+    if (!bOk || std::rename(tmpPath.c_str(), path.c_str()) != 0)
+    {
+      std::remove(tmpPath.c_str());
+      return false;
+    }
+
+#if defined(TARGET_POSIX)
+    // Make the rename itself durable
+    int dirFd = open(repoPath.c_str(), O_RDONLY);
+    if (dirFd >= 0)
+    {
+      fsync(dirFd);
+      close(dirFd);
+    }
+#endif
+
+    return true;
+  }
+}
+
+namespace
+{
+  std::mutex  repoMutex;
+  std::string selectedRepo;
+
+  thread_local std::string threadRepo;
+}
+
+std::string IPSF::GetRepoPath(void)
+{
+  std::string repoPath;
+  if (GetSelectedRepo(repoPath))
+    return repoPath;
+
+  const char* ipfsPath = std::getenv("IPFS_PATH");
+  if (ipfsPath && *ipfsPath != '\0')
+    return ipfsPath;
+
+  const char* home = std::getenv("HOME");
+  return std::string(home ? home : "") + "/.ipfs";
+}
+
+void IPSF::SelectRepo(const std::string& repoPath)
+{
+  std::unique_lock<std::mutex> lock(repoMutex);
+  selectedRepo = repoPath;
+}
+
+bool IPSF::GetSelectedRepo(std::string& repoPath)
+{
+  if (!threadRepo.empty())
+  {
+    repoPath = threadRepo;
+    return true;
+  }
+
+  std::unique_lock<std::mutex> lock(repoMutex);
+  repoPath = selectedRepo;
+  return !repoPath.empty();
+}
+
+void IPSF::SelectThreadRepo(const std::string& repoPath)
+{
+  threadRepo = repoPath;
+}
+
+const std::string& IPSF::GetThreadRepo(void)
+{
+  return threadRepo;
+}
+
+bool CConfig::Load(const std::string& repoPath)
+{
+  m_repoPath = repoPath;
+  m_document = CJsonValue();
+  m_staged.clear();
+
+  return ReadConfig(m_repoPath + "/config", m_document);
+}
+
+const CJsonValue* CConfig::Get(const std::string& key) const
+{
+  const CJsonValue* value = &m_document;
+
+  size_t begin = 0;
+  while (value != NULL)
+  {
+    const size_t end = key.find('.', begin);
+    value = value->Find(key.substr(begin, end == std::string::npos ? end : end - begin));
+
+    if (end == std::string::npos)
+      break;
+    begin = end + 1;
+  }
+
+  return value;
+}
+
+bool CConfig::Set(const std::string& key, const CJsonValue& value)
+{
+  if (!Apply(m_document, key, value))
+    return false;
+
+  m_staged.push_back(std::make_pair(key, value));
+  return true;
+}
+
+bool CConfig::Apply(CJsonValue& document, const std::string& key, const CJsonValue& value)
+{
+  CJsonValue* parent = &document;
+
+  size_t begin = 0;
+  size_t end;
+  while ((end = key.find('.', begin)) != std::string::npos)
+  {
+    const std::string name = key.substr(begin, end - begin);
+
+    CJsonValue* child = parent->Find(name);
+    if (child == NULL)
+    {
+      CJsonValue object;
+      object.SetObject();
+      child = &parent->SetMember(name, object);
+    }
+    else if (child->GetType() == CJsonValue::TypeNull)
+    {
+      child->SetObject();
+    }
+    else if (child->GetType() != CJsonValue::TypeObject)
+    {
+      return false;
+    }
+
+    parent = child;
+    begin = end + 1;
+  }
+
+  const std::string name = key.substr(begin);
+  if (name.empty())
+    return false;
+
+  parent->SetMember(name, value);
+  return true;
+}
+
+bool CConfig::Commit(bool bNotifyNode)
+{
+  if (m_staged.empty())
+    return true;
+
+  CJsonValue document;
+  if (!ReadConfig(m_repoPath + "/config", document))
+    return false;
+
+  for (std::vector<std::pair<std::string, CJsonValue>>::const_iterator it = m_staged.begin(); it != m_staged.end(); ++it)
+  {
+    if (!Apply(document, it->first, it->second))
+      return false;
+  }
+
+  const std::string data = document.Serialize(true);
+
+  bool bOk = true;
+  bool bWritten = false;
+
+#if defined(TARGET_POSIX)
+  // The daemon's copy is only written back through its config commands.
+  // go-ipfs applies no key without a restart, so instead of one command per
+  // key the daemon gets the whole file in one replace, which it writes.
+  ApiEndpoint endpoint;
+  if (bNotifyNode && GetDaemonEndpoint(m_repoPath, endpoint))
+  {
+    CApiRequest request("config/replace");
+    request.AddFile(data);
+    request.SetTimeout(NOTIFY_TIMEOUT_MS);
+
+    std::string response;
+    bWritten = request.Execute(endpoint, response);
+    bOk = bWritten;
+  }
+#endif
+
+  if (!bWritten && !WriteConfig(m_repoPath, data))
+    return false;
+
+  m_staged.clear();
+  m_document = document;
+
+  return bOk;
+}
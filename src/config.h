@@ -0,0 +1,117 @@
+/*
+ *    Copyright (C) 2015 juztamau5
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *    The above copyright notice and this permission notice shall be included in
+ *    all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+#ifndef __IPSF_CONFIG_H__
+#define __IPSF_CONFIG_H__
+
+#include "json.h"
+
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace IPSF
+{
+  /*!
+   * \brief Get the path of the IPFS repo
+   *
+   * This is the calling thread's repo if it chose one with
+   * SelectThreadRepo(), then the repo chosen with SelectRepo(), and
+   * $IPFS_PATH (default ~/.ipfs) if none was.
+   */
+  std::string GetRepoPath(void);
+
+  /*!
+   * \brief Choose the repo used by all commands. Empty restores the default.
+   */
+  void SelectRepo(const std::string& repoPath);
+
+  /*!
+   * \brief Get the repo chosen with SelectThreadRepo() or SelectRepo()
+   *
+   * \return false if commands use the default repo
+   */
+  bool GetSelectedRepo(std::string& repoPath);
+
+  /*!
+   * \brief Choose the repo used by the commands of the calling thread,
+   *        overriding SelectRepo(). Empty clears the choice.
+   *
+   * Each node hosted by the process has its own repo, and a thread works on
+   * one node at a time. Work handed to the worker pool keeps the repo of the
+   * thread that submitted it.
+   */
+  void SelectThreadRepo(const std::string& repoPath);
+  const std::string& GetThreadRepo(void);
+
+  /*!
+   * \brief A repo's config file, loaded once and edited in memory
+   *
+   * Keys are dotted paths such as "Addresses.API". Set() only changes the
+   * in-memory copy. Commit() writes all staged changes with a single atomic
+   * replace of the file.
+   *
+   * A config isn't thread-safe.
+   */
+  class CConfig
+  {
+  public:
+    bool Load(const std::string& repoPath);
+
+    /*!
+     * \brief Value at a dotted key, or NULL if there is none
+     */
+    const CJsonValue* Get(const std::string& key) const;
+
+    /*!
+     * \brief Stage a change, creating missing parent objects
+     *
+     * \return false if a parent of <key> exists but isn't an object
+     */
+    bool Set(const std::string& key, const CJsonValue& value);
+
+    bool HasChanges(void) const { return !m_staged.empty(); }
+
+    /*!
+     * \brief Write the staged changes to the config file
+     *
+     * The file is read again and the changes are applied on top, so values
+     * written by someone else since Load() are kept. If <bNotifyNode> is set
+     * and a daemon is serving the repo, the result is handed to the daemon in
+     * a single config replace instead, so its copy of the config agrees, and
+     * the daemon writes the file.
+     *
+     * \return false if the file couldn't be written or the daemon rejected
+     *         the config. The file is written either way.
+     */
+    bool Commit(bool bNotifyNode);
+
+  private:
+    static bool Apply(CJsonValue& document, const std::string& key, const CJsonValue& value);
+
+    std::string                                     m_repoPath;
+    CJsonValue                                      m_document;
+    std::vector<std::pair<std::string, CJsonValue>> m_staged;
+  };
+}
+
+#endif // __IPSF_CONFIG_H__
@@ -0,0 +1,145 @@
+/*
+ *    Copyright (C) 2015 juztamau5
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *    The above copyright notice and this permission notice shall be included in
+ *    all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include "dagbuilder.h"
+#include "multihash.h"
+#include "node.h"
+#include "threadpool.h"
+
+#include <algorithm>
+
+using namespace IPSF;
+
+namespace
+{
+  // Nodes encoded per task
+  const size_t ENCODE_CHUNK_SIZE = 256;
+}
+
+unsigned int CDagBuilder::AddNode(void)
+{
+  m_nodes.push_back(Node());
+  return static_cast<unsigned int>(m_nodes.size() - 1);
+}
+
+bool CDagBuilder::SetData(unsigned int node, const std::string& data)
+{
+  if (node >= m_nodes.size())
+    return false;
+
+  m_nodes[node].data = data;
+  return true;
+}
+
+bool CDagBuilder::AddLink(unsigned int node, const DagLink& link)
+{
+  if (node >= m_nodes.size())
+    return false;
+
+  m_nodes[node].links.push_back(link);
+  return true;
+}
+
+bool CDagBuilder::AddChild(unsigned int node, unsigned int child, const std::string& name)
+{
+  // Children come first, which also rules out cycles
+  if (node >= m_nodes.size() || child >= node)
+    return false;
+
+  DagLink link;
+  link.name = name;
+  link.size = 0;
+
+  Node& parent = m_nodes[node];
+  parent.children.push_back(std::make_pair(parent.links.size(), child));
+  parent.links.push_back(link);
+  return true;
+}
+
+bool CDagBuilder::Flush(unsigned int root, std::string& rootMultihash)
+{
+  if (root >= m_nodes.size())
+    return false;
+
+  // Level of a node is one above its highest child, so each level only
+  // depends on finished ones
+  std::vector<unsigned int> levels(m_nodes.size(), 0);
+  unsigned int levelCount = 1;
+  for (size_t i = 0; i < m_nodes.size(); i++)
+  {
+    const std::vector<std::pair<size_t, unsigned int>>& children = m_nodes[i].children;
+    for (std::vector<std::pair<size_t, unsigned int>>::const_iterator it = children.begin(); it != children.end(); ++it)
+      levels[i] = std::max(levels[i], levels[it->second] + 1);
+    levelCount = std::max(levelCount, levels[i] + 1);
+  }
+
+  std::vector<std::vector<unsigned int>> nodesByLevel(levelCount);
+  for (size_t i = 0; i < m_nodes.size(); i++)
+    nodesByLevel[levels[i]].push_back(static_cast<unsigned int>(i));
+
+  // (multihash, encoded node) per node, ready to store
+  std::vector<std::pair<std::string, std::string>> blocks(m_nodes.size());
+  std::vector<uint64_t> cumulativeSizes(m_nodes.size(), 0);
+
+  for (std::vector<std::vector<unsigned int>>::const_iterator level = nodesByLevel.begin(); level != nodesByLevel.end(); ++level)
+  {
+    CTaskGroup tasks(GetWorkerPool());
+
+    for (size_t begin = 0; begin < level->size(); begin += ENCODE_CHUNK_SIZE)
+    {
+      const size_t end = std::min(begin + ENCODE_CHUNK_SIZE, level->size());
+
+      tasks.Run([this, level, begin, end, &blocks, &cumulativeSizes]()
+      {
+        for (size_t i = begin; i < end; i++)
+        {
+          const unsigned int id = (*level)[i];
+          Node& node = m_nodes[id];
+
+          for (std::vector<std::pair<size_t, unsigned int>>::const_iterator it = node.children.begin(); it != node.children.end(); ++it)
+          {
+            node.links[it->first].hash = blocks[it->second].first;
+            node.links[it->first].size = cumulativeSizes[it->second];
+          }
+
+          std::string& encoded = blocks[id].second;
+          encoded = EncodeDagNode(node.links, node.data);
+          blocks[id].first = Multihash(encoded.data(), encoded.size());
+
+          uint64_t cumulativeSize = encoded.size();
+          for (std::vector<DagLink>::const_iterator it = node.links.begin(); it != node.links.end(); ++it)
+            cumulativeSize += it->size;
+          cumulativeSizes[id] = cumulativeSize;
+        }
+      });
+    }
+  }
+
+  if (!PutBlocks(blocks))
+    return false;
+
+  rootMultihash = blocks[root].first;
+  m_nodes.clear();
+
+  return true;
+}
@@ -0,0 +1,80 @@
+/*
+ *    Copyright (C) 2015 juztamau5
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *    The above copyright notice and this permission notice shall be included in
+ *    all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+#ifndef __IPSF_DAGBUILDER_H__
+#define __IPSF_DAGBUILDER_H__
+
+#include "merkledag.h"
+
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace IPSF
+{
+  /*!
+   * \brief Builds DAG nodes in memory and stores them all at once
+   *
+   * Nodes are identified by the order they were added in. A node can link to
+   * existing blocks by key, or to nodes added before it, whose keys are only
+   * known at Flush(). Flush() encodes the nodes on the worker pool, one level
+   * of the DAG at a time starting from the leaves, and stores them in one
+   * batch with PutBlocks().
+   *
+   * A builder isn't thread-safe.
+   */
+  class CDagBuilder
+  {
+  public:
+    unsigned int AddNode(void);
+
+    bool SetData(unsigned int node, const std::string& data);
+    bool AddLink(unsigned int node, const DagLink& link);
+
+    /*!
+     * \brief Link <node> to <child>, which must have been added before it
+     */
+    bool AddChild(unsigned int node, unsigned int child, const std::string& name);
+
+    /*!
+     * \brief Encode and store every node, then empty the builder
+     *
+     * \param root The node whose key is returned
+     * \param rootMultihash Receives the binary multihash of <root>
+     */
+    bool Flush(unsigned int root, std::string& rootMultihash);
+
+  private:
+    struct Node
+    {
+      std::string          data;
+      std::vector<DagLink> links;
+
+      // Links whose hash and size come from another node: (link, child)
+      std::vector<std::pair<size_t, unsigned int>> children;
+    };
+
+    std::vector<Node> m_nodes;
+  };
+}
+
+#endif // __IPSF_DAGBUILDER_H__
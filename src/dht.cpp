@@ -0,0 +1,90 @@
+/*
+ *    Copyright (C) 2015 juztamau5
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *    The above copyright notice and this permission notice shall be included in
+ *    all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include "dht.h"
+#include "api.h"
+#include "json.h"
+
+#include <set>
+#include <string>
+#include <vector>
+
+using namespace IPSF;
+
+namespace
+{
+  // Type of the routing query events reported by `dht findprovs`
+  const int64_t QUERY_EVENT_PROVIDER = 4;
+}
+
+int IPSF::FindProvidersStream(const char* key, unsigned int maxProviders, ipfs_provider_cb callback, void* context)
+{
+  ApiEndpoint endpoint;
+  if (!key || *key == '\0' || !callback || !GetApiEndpoint(endpoint))
+    return -1;
+
+  // Events are streamed one JSON object per line. findprovs has no limit
+  // option, so the query is cancelled by hanging up once enough are found.
+  CApiRequest request("dht/findprovs");
+  request.AddArgument(key);
+  request.AddOption("encoding", "json");
+  request.AddOption("stream-channels", "true");
+
+  std::set<std::string> seen;
+  unsigned int delivered = 0;
+
+  bool bOk = request.Execute(endpoint, [&](const std::string& line)
+  {
+    CJsonValue event;
+    if (!CJsonValue::Parse(line, event) || event["Type"].AsInteger() != QUERY_EVENT_PROVIDER)
+      return true;
+
+    const CJsonValue& responses = event["Responses"];
+    for (size_t i = 0; i < responses.Size(); i++)
+    {
+      const std::string& peerId = responses[i]["ID"].AsString();
+      if (peerId.empty() || !seen.insert(peerId).second)
+        continue;
+
+      const CJsonValue& addrs = responses[i]["Addrs"];
+      std::vector<const char*> addrList;
+      for (size_t j = 0; j < addrs.Size(); j++)
+        addrList.push_back(addrs[j].AsString().c_str());
+
+      delivered++;
+
+      // Returning false closes the connection, which cancels the query
+      if (!callback(peerId.c_str(), addrList.empty() ? NULL : addrList.data(), static_cast<unsigned int>(addrList.size()), context))
+        return false;
+      if (maxProviders > 0 && delivered >= maxProviders)
+        return false;
+    }
+
+    return true;
+  });
+
+  if (!bOk && delivered == 0)
+    return -1;
+
+  return static_cast<int>(delivered);
+}
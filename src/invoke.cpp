@@ -0,0 +1,262 @@
+/*
+ *    Copyright (C) 2015 juztamau5
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *    The above copyright notice and this permission notice shall be included in
+ *    all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include "invoke.h"
+#include "config.h"
+#include "scheduler.h"
+
+// Go generated include file
+#include "ipfs.h"
+
+#include <atomic>
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#if defined(TARGET_POSIX)
+#include <errno.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+  std::atomic<unsigned int> g_invokeGeneration(0);
+
+  // go-ipfs keeps the state of a command line in globals, so runMain is
+  // only ever called by one command at a time
+  std::mutex g_commandMutex;
+
+  // The standard descriptors
+  const int OUTPUT_FD = 1;
+  const int ERROR_FD  = 2;
+
+  void runCommand(const std::string& cmd)
+  {
+    // Point go-ipfs at the repo chosen by the library instead of $IPFS_PATH
+    std::string cmdLine = cmd;
+    std::string repoPath;
+    if (IPSF::GetSelectedRepo(repoPath) && cmdLine.compare(0, 5, "ipfs ") == 0)
+      cmdLine.insert(4, " -c " + repoPath);
+
+    GoString str;
+    str.p = const_cast<char*>(cmdLine.c_str());
+    str.n = static_cast<GoInt>(cmdLine.length());
+    runMain(str);
+
+    g_invokeGeneration++;
+  }
+
+#if defined(TARGET_POSIX)
+  typedef std::function<void(const char* data, size_t size)> Sink;
+
+  /*!
+   * \brief Redirects a standard descriptor to a sink until it's restored
+   */
+  class CRedirect
+  {
+  public:
+    /*!
+     * \param bPassThrough Also write everything to where <fd> pointed before
+     */
+    CRedirect(int fd, bool bPassThrough, const Sink& sink) :
+      m_fd(fd),
+      m_savedFd(-1),
+      m_readFd(-1),
+      m_sink(sink)
+    {
+      int pipeFds[2];
+      if (pipe(pipeFds) != 0)
+        return;
+
+      std::fflush(GetStream());
+
+      m_savedFd = dup(fd);
+      if (m_savedFd < 0 || dup2(pipeFds[1], fd) < 0)
+      {
+        if (m_savedFd >= 0)
+          close(m_savedFd);
+        close(pipeFds[0]);
+        close(pipeFds[1]);
+        return;
+      }
+      close(pipeFds[1]);
+
+      m_readFd = pipeFds[0];
+
+      // Drain the pipe while the command runs so it can't fill up and block
+      m_reader = std::thread([this, bPassThrough]()
+      {
+        char buffer[4096];
+        bool bWrite = bPassThrough;
+        while (true)
+        {
+          ssize_t bytesRead = read(m_readFd, buffer, sizeof(buffer));
+          if (bytesRead < 0 && errno == EINTR)
+            continue;
+          if (bytesRead <= 0)
+            break;
+
+          m_sink(buffer, static_cast<size_t>(bytesRead));
+
+          if (bWrite && write(m_savedFd, buffer, static_cast<size_t>(bytesRead)) < 0)
+            bWrite = false;
+        }
+      });
+    }
+
+    ~CRedirect(void)
+    {
+      if (!IsRedirected())
+        return;
+
+      // Restoring the descriptor closes the last write end, ending the reader
+      std::fflush(GetStream());
+      dup2(m_savedFd, m_fd);
+
+      m_reader.join();
+      close(m_savedFd);
+      close(m_readFd);
+    }
+
+    bool IsRedirected(void) const { return m_readFd >= 0; }
+
+  private:
+    std::FILE* GetStream(void) const { return m_fd == ERROR_FD ? stderr : stdout; }
+
+    const int   m_fd;
+    int         m_savedFd;
+    int         m_readFd;
+    const Sink  m_sink;
+    std::thread m_reader;
+  };
+
+  /*!
+   * \brief Run a command, capturing its stdout to <output> and watching its
+   *        stderr for errors if they aren't NULL
+   *
+   * The redirections are process-wide, so nothing else may run a command
+   * meanwhile.
+   */
+  bool captureCommand(const std::string& cmd, std::string* output, bool* bError)
+  {
+    // Take the slot before the command lock, so the scheduler rather than
+    // the lock decides who goes first
+    IPSF::CScheduledSlot slot(IPSF::GetCommandScheduler());
+    std::unique_lock<std::mutex> lock(g_commandMutex);
+
+    std::unique_ptr<CRedirect> outputRedirect;
+    if (output)
+    {
+      output->clear();
+      outputRedirect.reset(new CRedirect(OUTPUT_FD, false, [output](const char* data, size_t size)
+      {
+        output->append(data, size);
+      }));
+      if (!outputRedirect->IsRedirected())
+        return false;
+    }
+
+    std::unique_ptr<CRedirect> errorRedirect;
+    if (bError)
+    {
+      // go-ipfs reports a failed command on a line starting with "Error: "
+      static const char prefix[] = "Error: ";
+
+      *bError = false;
+      size_t column = 0;
+      bool bMatching = true;
+      errorRedirect.reset(new CRedirect(ERROR_FD, true, [bError, column, bMatching](const char* data, size_t size) mutable
+      {
+        for (size_t i = 0; i < size; i++)
+        {
+          if (data[i] == '\n')
+          {
+            column = 0;
+            bMatching = true;
+            continue;
+          }
+
+          if (bMatching && column < sizeof(prefix) - 1)
+          {
+            bMatching = (data[i] == prefix[column]);
+            if (bMatching && column == sizeof(prefix) - 2)
+              *bError = true;
+          }
+          column++;
+        }
+      }));
+      if (!errorRedirect->IsRedirected())
+        return false;
+    }
+
+    runCommand(cmd);
+
+    return true;
+  }
+#else
+  bool captureCommand(const std::string& cmd, std::string* output, bool* bError)
+  {
+    (void)cmd;
+    (void)output;
+    (void)bError;
+    return false;
+  }
+#endif
+}
+
+namespace IPSF
+{
+  void invoke(const std::string& cmd)
+  {
+    CScheduledSlot slot(GetCommandScheduler());
+    std::unique_lock<std::mutex> lock(g_commandMutex);
+    runCommand(cmd);
+  }
+
+  void invokeService(const std::string& cmd)
+  {
+    runCommand(cmd);
+  }
+
+  bool invoke(const std::string& cmd, std::string& output)
+  {
+    return captureCommand(cmd, &output, NULL);
+  }
+
+  bool invoke(const std::string& cmd, std::string& output, bool& bError)
+  {
+    return captureCommand(cmd, &output, &bError);
+  }
+
+  bool invokeWatched(const std::string& cmd, bool& bError)
+  {
+    return captureCommand(cmd, NULL, &bError);
+  }
+
+  unsigned int GetInvokeGeneration(void)
+  {
+    return g_invokeGeneration;
+  }
+}
@@ -0,0 +1,90 @@
+/*
+ *    Copyright (C) 2015 juztamau5
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *    The above copyright notice and this permission notice shall be included in
+ *    all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+#ifndef __IPSF_INVOKE_H__
+#define __IPSF_INVOKE_H__
+
+#include <string>
+
+namespace IPSF
+{
+  /*!
+   * \brief Run an IPFS command line through go-ipfs
+   *
+   * Output is written to the process's stdout and stderr. The command waits
+   * for a slot of the command scheduler in the priority of the calling
+   * thread. Commands run one at a time, as go-ipfs keeps the state of a
+   * command line in globals.
+   */
+  void invoke(const std::string& cmd);
+
+  /*!
+   * \brief Run a command that serves for as long as the node runs, like the
+   *        daemon, without holding a slot of the command scheduler
+   *
+   * The service isn't serialized with other commands, which would never get
+   * to run otherwise.
+   */
+  void invokeService(const std::string& cmd);
+
+  /*!
+   * \brief Run an IPFS command line and capture what it writes to stdout
+   *
+   * Anything else the process writes to stdout while the command runs is
+   * captured as well.
+   *
+   * \return true if the output could be captured
+   */
+  bool invoke(const std::string& cmd, std::string& output);
+
+  /*!
+   * \brief Run an IPFS command line, capture its stdout and watch its stderr
+   *        like invokeWatched()
+   *
+   * Tells a command that failed from one that wrote nothing.
+   *
+   * \param bError Set if go-ipfs reported an error
+   */
+  bool invoke(const std::string& cmd, std::string& output, bool& bError);
+
+  /*!
+   * \brief Run an IPFS command line and watch what it writes to stderr
+   *
+   * Everything is passed through to stderr. go-ipfs doesn't return an exit
+   * status, so a failure is recognized by the "Error: " line it writes.
+   *
+   * \param bError Set if go-ipfs reported an error
+   *
+   * \return true if stderr could be watched
+   */
+  bool invokeWatched(const std::string& cmd, bool& bError);
+
+  /*!
+   * \brief Get the number of commands that have finished
+   *
+   * Anything caching the state of the repo compares this to notice that
+   * go-ipfs may have changed it.
+   */
+  unsigned int GetInvokeGeneration(void);
+}
+
+#endif // __IPSF_INVOKE_H__
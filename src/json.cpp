@@ -0,0 +1,504 @@
+/*
+ *    Copyright (C) 2015 juztamau5
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *    The above copyright notice and this permission notice shall be included in
+ *    all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include "json.h"
+
+#include <cstdlib>
+#include <sstream>
+
+using namespace IPSF;
+
+namespace IPSF
+{
+  class CJsonParser
+  {
+  public:
+    CJsonParser(const std::string& text) : m_text(text), m_pos(0) { }
+
+    bool ParseDocument(CJsonValue& value)
+    {
+      if (!ParseValue(value, 0))
+        return false;
+
+      SkipWhitespace();
+      return m_pos == m_text.size();
+    }
+
+  private:
+    // Deeper documents are rejected instead of exhausting the stack
+    static const unsigned int MAX_DEPTH = 256;
+
+    void SkipWhitespace(void)
+    {
+      while (m_pos < m_text.size() &&
+             (m_text[m_pos] == ' ' || m_text[m_pos] == '\t' || m_text[m_pos] == '\r' || m_text[m_pos] == '\n'))
+        m_pos++;
+    }
+
+    bool Consume(const char* literal)
+    {
+      for (size_t i = 0; literal[i] != '\0'; i++)
+      {
+        if (m_pos + i >= m_text.size() || m_text[m_pos + i] != literal[i])
+          return false;
+      }
+      m_pos += std::char_traits<char>::length(literal);
+      return true;
+    }
+
+    bool ParseValue(CJsonValue& value, unsigned int depth)
+    {
+      if (depth > MAX_DEPTH)
+        return false;
+
+      SkipWhitespace();
+      if (m_pos >= m_text.size())
+        return false;
+
+      switch (m_text[m_pos])
+      {
+      case '{':
+        return ParseObject(value, depth);
+      case '[':
+        return ParseArray(value, depth);
+      case '"':
+        value.m_type = CJsonValue::TypeString;
+        return ParseString(value.m_string);
+      case 't':
+        value.m_type = CJsonValue::TypeBool;
+        value.m_bool = true;
+        return Consume("true");
+      case 'f':
+        value.m_type = CJsonValue::TypeBool;
+        value.m_bool = false;
+        return Consume("false");
+      case 'n':
+        value.m_type = CJsonValue::TypeNull;
+        return Consume("null");
+      default:
+        return ParseNumber(value);
+      }
+    }
+
+    bool ParseObject(CJsonValue& value, unsigned int depth)
+    {
+      value.m_type = CJsonValue::TypeObject;
+      m_pos++;
+
+      SkipWhitespace();
+      if (m_pos < m_text.size() && m_text[m_pos] == '}')
+      {
+        m_pos++;
+        return true;
+      }
+
+      while (true)
+      {
+        std::pair<std::string, CJsonValue> member;
+
+        SkipWhitespace();
+        if (m_pos >= m_text.size() || m_text[m_pos] != '"' || !ParseString(member.first))
+          return false;
+
+        SkipWhitespace();
+        if (!Consume(":") || !ParseValue(member.second, depth + 1))
+          return false;
+
+        value.m_members.push_back(member);
+
+        SkipWhitespace();
+        if (Consume("}"))
+          return true;
+        if (!Consume(","))
+          return false;
+      }
+    }
+
+    bool ParseArray(CJsonValue& value, unsigned int depth)
+    {
+      value.m_type = CJsonValue::TypeArray;
+      m_pos++;
+
+      SkipWhitespace();
+      if (m_pos < m_text.size() && m_text[m_pos] == ']')
+      {
+        m_pos++;
+        return true;
+      }
+
+      while (true)
+      {
+        std::pair<std::string, CJsonValue> element;
+        if (!ParseValue(element.second, depth + 1))
+          return false;
+
+        value.m_members.push_back(element);
+
+        SkipWhitespace();
+        if (Consume("]"))
+          return true;
+        if (!Consume(","))
+          return false;
+      }
+    }
+
+    bool ParseHex4(unsigned int& codePoint)
+    {
+      if (m_pos + 4 > m_text.size())
+        return false;
+
+      codePoint = 0;
+      for (unsigned int i = 0; i < 4; i++)
+      {
+        const char c = m_text[m_pos++];
+        codePoint <<= 4;
+        if ('0' <= c && c <= '9')
+          codePoint |= c - '0';
+        else if ('a' <= c && c <= 'f')
+          codePoint |= c - 'a' + 10;
+        else if ('A' <= c && c <= 'F')
+          codePoint |= c - 'A' + 10;
+        else
+          return false;
+      }
+      return true;
+    }
+
+    static void AppendUtf8(std::string& str, unsigned int codePoint)
+    {
+      if (codePoint < 0x80)
+      {
+        str.push_back(static_cast<char>(codePoint));
+      }
+      else if (codePoint < 0x800)
+      {
+        str.push_back(static_cast<char>(0xc0 | (codePoint >> 6)));
+        str.push_back(static_cast<char>(0x80 | (codePoint & 0x3f)));
+      }
+      else if (codePoint < 0x10000)
+      {
+        str.push_back(static_cast<char>(0xe0 | (codePoint >> 12)));
+        str.push_back(static_cast<char>(0x80 | ((codePoint >> 6) & 0x3f)));
+        str.push_back(static_cast<char>(0x80 | (codePoint & 0x3f)));
+      }
+      else
+      {
+        str.push_back(static_cast<char>(0xf0 | (codePoint >> 18)));
+        str.push_back(static_cast<char>(0x80 | ((codePoint >> 12) & 0x3f)));
+        str.push_back(static_cast<char>(0x80 | ((codePoint >> 6) & 0x3f)));
+        str.push_back(static_cast<char>(0x80 | (codePoint & 0x3f)));
+      }
+    }
+
+    bool ParseString(std::string& str)
+    {
+      m_pos++; // Opening quote
+
+      while (m_pos < m_text.size())
+      {
+        const char c = m_text[m_pos++];
+        if (c == '"')
+          return true;
+
+        if (c != '\\')
+        {
+          str.push_back(c);
+          continue;
+        }
+
+        if (m_pos >= m_text.size())
+          return false;
+
+        const char escape = m_text[m_pos++];
+        switch (escape)
+        {
+        case '"':  str.push_back('"'); break;
+        case '\\': str.push_back('\\'); break;
+        case '/':  str.push_back('/'); break;
+        case 'b':  str.push_back('\b'); break;
+        case 'f':  str.push_back('\f'); break;
+        case 'n':  str.push_back('\n'); break;
+        case 'r':  str.push_back('\r'); break;
+        case 't':  str.push_back('\t'); break;
+        case 'u':
+        {
+          unsigned int codePoint;
+          if (!ParseHex4(codePoint))
+            return false;
+
+          // Surrogate pair
+          if (0xd800 <= codePoint && codePoint < 0xdc00)
+          {
+            unsigned int low;
+            if (!Consume("\\u") || !ParseHex4(low) || low < 0xdc00 || low >= 0xe000)
+              return false;
+            codePoint = 0x10000 + ((codePoint - 0xd800) << 10) + (low - 0xdc00);
+          }
+
+          AppendUtf8(str, codePoint);
+          break;
+        }
+        default:
+          return false;
+        }
+      }
+
+      return false;
+    }
+
+    bool ParseNumber(CJsonValue& value)
+    {
+      const size_t begin = m_pos;
+
+      if (m_pos < m_text.size() && m_text[m_pos] == '-')
+        m_pos++;
+
+      bool bDigits = false;
+      while (m_pos < m_text.size() && (('0' <= m_text[m_pos] && m_text[m_pos] <= '9') ||
+             m_text[m_pos] == '.' || m_text[m_pos] == 'e' || m_text[m_pos] == 'E' ||
+             m_text[m_pos] == '+' || m_text[m_pos] == '-'))
+      {
+        bDigits = true;
+        m_pos++;
+      }
+
+      if (!bDigits)
+        return false;
+
+      value.m_type = CJsonValue::TypeNumber;
+      value.m_string = m_text.substr(begin, m_pos - begin);
+      return true;
+    }
+
+    const std::string& m_text;
+    size_t             m_pos;
+  };
+}
+
+bool CJsonValue::Parse(const std::string& text, CJsonValue& value)
+{
+  value = CJsonValue();
+
+  CJsonParser parser(text);
+  return parser.ParseDocument(value);
+}
+
+int64_t CJsonValue::AsInteger(void) const
+{
+  if (m_type == TypeBool)
+    return m_bool ? 1 : 0;
+
+  if (m_string.find_first_of(".eE") != std::string::npos)
+    return static_cast<int64_t>(std::strtod(m_string.c_str(), NULL));
+
+  return std::strtoll(m_string.c_str(), NULL, 10);
+}
+
+double CJsonValue::AsDouble(void) const
+{
+  if (m_type == TypeBool)
+    return m_bool ? 1.0 : 0.0;
+
+  return std::strtod(m_string.c_str(), NULL);
+}
+
+const CJsonValue& CJsonValue::operator[](const std::string& key) const
+{
+  static const CJsonValue null;
+
+  const CJsonValue* member = Find(key);
+  return member ? *member : null;
+}
+
+const CJsonValue* CJsonValue::Find(const std::string& key) const
+{
+  return const_cast<CJsonValue*>(this)->Find(key);
+}
+
+CJsonValue* CJsonValue::Find(const std::string& key)
+{
+  if (m_type == TypeObject)
+  {
+    for (std::vector<std::pair<std::string, CJsonValue>>::iterator it = m_members.begin(); it != m_members.end(); ++it)
+    {
+      if (it->first == key)
+        return &it->second;
+    }
+  }
+
+  return NULL;
+}
+
+void CJsonValue::SetNull(void)
+{
+  *this = CJsonValue();
+}
+
+void CJsonValue::SetBool(bool value)
+{
+  SetNull();
+  m_type = TypeBool;
+  m_bool = value;
+}
+
+void CJsonValue::SetInteger(int64_t value)
+{
+  SetNull();
+  m_type = TypeNumber;
+
+  std::ostringstream text;
+  text << value;
+  m_string = text.str();
+}
+
+void CJsonValue::SetString(const std::string& value)
+{
+  SetNull();
+  m_type = TypeString;
+  m_string = value;
+}
+
+void CJsonValue::SetArray(void)
+{
+  SetNull();
+  m_type = TypeArray;
+}
+
+void CJsonValue::SetObject(void)
+{
+  SetNull();
+  m_type = TypeObject;
+}
+
+void CJsonValue::Append(const CJsonValue& element)
+{
+  m_members.push_back(std::make_pair(std::string(), element));
+}
+
+CJsonValue& CJsonValue::SetMember(const std::string& key, const CJsonValue& value)
+{
+  CJsonValue* member = Find(key);
+  if (member)
+  {
+    *member = value;
+    return *member;
+  }
+
+  m_members.push_back(std::make_pair(key, value));
+  return m_members.back().second;
+}
+
+std::string CJsonValue::Serialize(bool bIndent) const
+{
+  std::string text;
+  Serialize(text, bIndent, 0);
+  return text;
+}
+
+namespace
+{
+  void SerializeString(std::string& text, const std::string& str)
+  {
+    static const char hex[] = "0123456789abcdef";
+
+    text.push_back('"');
+    for (std::string::const_iterator it = str.begin(); it != str.end(); ++it)
+    {
+      const unsigned char c = static_cast<unsigned char>(*it);
+      switch (c)
+      {
+      case '"':  text += "\\\""; break;
+      case '\\': text += "\\\\"; break;
+      case '\n': text += "\\n"; break;
+      case '\r': text += "\\r"; break;
+      case '\t': text += "\\t"; break;
+      default:
+        if (c < 0x20)
+        {
+          text += "\\u00";
+          text.push_back(hex[c >> 4]);
+          text.push_back(hex[c & 0xf]);
+        }
+        else
+        {
+          text.push_back(static_cast<char>(c));
+        }
+        break;
+      }
+    }
+    text.push_back('"');
+  }
+
+  void NewLine(std::string& text, bool bIndent, unsigned int depth)
+  {
+    if (bIndent)
+    {
+      text.push_back('\n');
+      text.append(depth * 2, ' ');
+    }
+  }
+}
+
+void CJsonValue::Serialize(std::string& text, bool bIndent, unsigned int depth) const
+{
+  switch (m_type)
+  {
+  case TypeNull:
+    text += "null";
+    break;
+  case TypeBool:
+    text += m_bool ? "true" : "false";
+    break;
+  case TypeNumber:
+    text += m_string;
+    break;
+  case TypeString:
+    SerializeString(text, m_string);
+    break;
+  case TypeArray:
+  case TypeObject:
+  {
+    const bool bObject = (m_type == TypeObject);
+
+    text.push_back(bObject ? '{' : '[');
+    for (size_t i = 0; i < m_members.size(); i++)
+    {
+      if (i > 0)
+        text.push_back(',');
+      NewLine(text, bIndent, depth + 1);
+
+      if (bObject)
+      {
+        SerializeString(text, m_members[i].first);
+        text += bIndent ? ": " : ":";
+      }
+
+      m_members[i].second.Serialize(text, bIndent, depth + 1);
+    }
+    if (!m_members.empty())
+      NewLine(text, bIndent, depth);
+    text.push_back(bObject ? '}' : ']');
+    break;
+  }
+  }
+}
@@ -0,0 +1,134 @@
+/*
+ *    Copyright (C) 2015 juztamau5
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *    The above copyright notice and this permission notice shall be included in
+ *    all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+#ifndef __IPSF_JSON_H__
+#define __IPSF_JSON_H__
+
+#include <stdint.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace IPSF
+{
+  /*!
+   * \brief A parsed JSON document or one of its values
+   *
+   * Object members keep their document order. Numbers keep their source
+   * text, so 64-bit integers such as durations in nanoseconds are exact.
+   */
+  class CJsonValue
+  {
+  public:
+    enum Type
+    {
+      TypeNull,
+      TypeBool,
+      TypeNumber,
+      TypeString,
+      TypeArray,
+      TypeObject,
+    };
+
+    CJsonValue(void) : m_type(TypeNull), m_bool(false) { }
+
+    /*!
+     * \brief Parse a complete JSON document
+     */
+    static bool Parse(const std::string& text, CJsonValue& value);
+
+    Type GetType(void) const { return m_type; }
+    bool IsNull(void) const { return m_type == TypeNull; }
+
+    bool AsBool(void) const { return m_bool; }
+    int64_t AsInteger(void) const;
+    double AsDouble(void) const;
+
+    /*!
+     * \brief The text of a string, or the source text of a number
+     */
+    const std::string& AsString(void) const { return m_string; }
+
+    /*!
+     * \brief Number of array elements or object members
+     */
+    size_t Size(void) const { return m_members.size(); }
+
+    /*!
+     * \brief Array element or object member value by position
+     */
+    const CJsonValue& operator[](size_t index) const { return m_members[index].second; }
+
+    /*!
+     * \brief Object member by name, or a null value if there is none
+     */
+    const CJsonValue& operator[](const std::string& key) const;
+
+    const std::string& GetKey(size_t index) const { return m_members[index].first; }
+
+    /*!
+     * \brief Object member by name, or NULL if there is none
+     */
+    const CJsonValue* Find(const std::string& key) const;
+    CJsonValue* Find(const std::string& key);
+
+    void SetNull(void);
+    void SetBool(bool value);
+    void SetInteger(int64_t value);
+    void SetString(const std::string& value);
+
+    /*!
+     * \brief Replace the value with an empty array or object
+     */
+    void SetArray(void);
+    void SetObject(void);
+
+    /*!
+     * \brief Add an element to an array
+     */
+    void Append(const CJsonValue& element);
+
+    /*!
+     * \brief Set an object member, adding it after the others if it is new
+     */
+    CJsonValue& SetMember(const std::string& key, const CJsonValue& value);
+
+    /*!
+     * \brief Write the value as JSON text
+     *
+     * Indented output matches the layout go-ipfs uses for its config file.
+     */
+    std::string Serialize(bool bIndent) const;
+
+  private:
+    friend class CJsonParser;
+
+    void Serialize(std::string& text, bool bIndent, unsigned int depth) const;
+
+    Type                                            m_type;
+    bool                                            m_bool;
+    std::string                                     m_string;
+    std::vector<std::pair<std::string, CJsonValue>> m_members;
+  };
+}
+
+#endif // __IPSF_JSON_H__
@@ -22,22 +22,318 @@
  */
 
 #include "ipfs/libipfs.h"
-
-// Go generated include file
-#include "ipfs.h"
-
+#include "add.h"
+#include "config.h"
+#include "invoke.h"
+#include "runtime.h"
+#include "scheduler.h"
+#include "stringutils.h"
+
+#if defined(TARGET_POSIX)
+#include "addindex.h"
+#include "api.h"
+#include "archive.h"
+#include "blockstore.h"
+#include "car.h"
+#include "dagbuilder.h"
+#include "dht.h"
+#include "merkledag.h"
+#include "multihash.h"
+#include "namecache.h"
+#include "node.h"
+#include "ping.h"
+#include "swarm.h"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
 #include <sstream>
 #include <string>
+#include <thread>
+#include <vector>
+
+struct ipfs_config
+{
+  IPSF::CConfig config;
+};
+
+#if defined(TARGET_POSIX)
+struct ipfs_dag_builder
+{
+  IPSF::CDagBuilder builder;
+};
+
+struct ipfs_view_handle
+{
+  std::vector<IPSF::BlockRef> refs;
+  std::vector<ipfs_piece_t>   pieces;
+};
+
+struct ipfs_node
+{
+  ipfs_node(void) : node(false) { }
+
+  IPSF::CNode node;
+};
+#endif
 
 namespace IPSF
 {
-  void invoke(const std::string& cmd)
+  std::string getDefaultOutPath(std::string ipfsPath)
+  {
+    // go-ipfs stores the object at ./<last path component>
+    while (!ipfsPath.empty() && ipfsPath[ipfsPath.size() - 1] == '/')
+      ipfsPath.erase(ipfsPath.size() - 1);
+
+    size_t pos = ipfsPath.rfind('/');
+    return pos == std::string::npos ? ipfsPath : ipfsPath.substr(pos + 1);
+  }
+
+  const CJsonValue* getConfigValue(const ipfs_config_t* config, const char* key)
   {
-    GoString str;
-    str.p = const_cast<char*>(cmd.c_str());
-    str.n = static_cast<GoInt>(cmd.length());
-    runMain(str);
+    if (!config || !key)
+      return NULL;
+
+    return config->config.Get(key);
   }
+
+  bool getPriorityClass(ipfs_priority_t priority, PriorityClass& priorityClass)
+  {
+    switch (priority)
+    {
+    case IPFS_PRIORITY_INTERACTIVE:
+      priorityClass = PriorityInteractive;
+      return true;
+    case IPFS_PRIORITY_NORMAL:
+      priorityClass = PriorityNormal;
+      return true;
+    case IPFS_PRIORITY_BULK:
+      priorityClass = PriorityBulk;
+      return true;
+    default:
+      return false;
+    }
+  }
+
+  CScheduler* getScheduler(ipfs_scheduler_t scheduler)
+  {
+    switch (scheduler)
+    {
+    case IPFS_SCHEDULER_COMMANDS:
+      return &GetCommandScheduler();
+    case IPFS_SCHEDULER_API:
+      return &GetApiScheduler();
+    case IPFS_SCHEDULER_DISK:
+      return &GetDiskScheduler();
+    default:
+      return NULL;
+    }
+  }
+
+  bool copyString(const std::string& str, char* buffer, size_t bufferSize)
+  {
+    if (!buffer || str.size() >= bufferSize)
+      return false;
+
+    str.copy(buffer, str.size());
+    buffer[str.size()] = '\0';
+
+    return true;
+  }
+
+  /*!
+   * \brief Memory for a result, taken from the caller's allocator
+   *
+   * The memory goes back to the allocator unless it's released to the caller.
+   */
+  class CResultMemory
+  {
+  public:
+    CResultMemory(const ipfs_allocator_t& allocator) :
+      m_allocator(allocator),
+      m_data(NULL),
+      m_size(0)
+    {
+    }
+
+    ~CResultMemory(void)
+    {
+      if (m_data && m_allocator.free)
+        m_allocator.free(m_data, m_size, m_allocator.context);
+    }
+
+    char* Allocate(size_t size)
+    {
+      if (m_data || size == 0)
+        return NULL;
+
+      m_data = static_cast<char*>(m_allocator.alloc(size, m_allocator.context));
+      m_size = m_data ? size : 0;
+      return m_data;
+    }
+
+    bool Assign(const std::string& value)
+    {
+      if (value.empty())
+        return true;
+
+      char* buffer = Allocate(value.size());
+      if (!buffer)
+        return false;
+
+      value.copy(buffer, value.size());
+      return true;
+    }
+
+    void Release(void** data, size_t* size)
+    {
+      *data = m_data;
+      *size = m_size;
+      m_data = NULL;
+    }
+
+  private:
+    const ipfs_allocator_t& m_allocator;
+    char*                   m_data;
+    size_t                  m_size;
+  };
+
+#if defined(TARGET_POSIX)
+  /*!
+   * \brief Hand borrowed pieces to the caller in a view
+   */
+  void setView(const std::vector<BlockRef>& refs, ipfs_view_t* view)
+  {
+    ipfs_view_handle* handle = new ipfs_view_handle;
+    handle->refs = refs;
+
+    view->size = 0;
+    for (std::vector<BlockRef>::const_iterator it = refs.begin(); it != refs.end(); ++it)
+    {
+      if (it->size == 0)
+        continue;
+
+      ipfs_piece_t piece;
+      piece.data = it->data;
+      piece.size = it->size;
+      handle->pieces.push_back(piece);
+
+      view->size += it->size;
+    }
+
+    view->pieces = handle->pieces.empty() ? NULL : handle->pieces.data();
+    view->piece_count = handle->pieces.size();
+    view->handle = handle;
+  }
+
+  /*!
+   * \brief Borrow data fetched into memory
+   */
+  BlockRef ownedRef(const std::shared_ptr<std::string>& data)
+  {
+    BlockRef ref;
+    ref.data = data->data();
+    ref.size = data->size();
+    ref.mapping = data;
+    return ref;
+  }
+#endif
+
+  void clearView(ipfs_view_t* view)
+  {
+    view->pieces = NULL;
+    view->piece_count = 0;
+    view->size = 0;
+    view->handle = NULL;
+  }
+
+  bool isValidAllocator(const ipfs_allocator_t* allocator, void** data, size_t* size)
+  {
+    if (!allocator || !allocator->alloc || !data || !size)
+      return false;
+
+    *data = NULL;
+    *size = 0;
+    return true;
+  }
+
+#if defined(TARGET_POSIX)
+  /*!
+   * \brief Run a command with one argument and collect its output
+   *
+   * Goes through the daemon's API if one serves the repo. Otherwise go-ipfs
+   * doesn't return an exit status, so a failure is recognized by the error
+   * it writes to stderr.
+   */
+  bool captureOutput(const std::string& command, const std::string& argument, std::string& output)
+  {
+    ApiEndpoint endpoint;
+    if (GetDaemonEndpoint(GetRepoPath(), endpoint))
+    {
+      CApiRequest request(command);
+      request.AddArgument(argument);
+      return request.Execute(endpoint, output);
+    }
+
+    // API commands name subcommands with slashes
+    std::string subcommand = command;
+    std::replace(subcommand.begin(), subcommand.end(), '/', ' ');
+
+    // Output may be empty, so failures are told by what go-ipfs writes to
+    // stderr
+    bool bError;
+    return invoke("ipfs " + subcommand + " " + argument, output, bError) && !bError;
+  }
+#endif
+
+  /*!
+   * \brief Bring up the network for a command that needs it
+   *
+   * Failures are left for the command to report.
+   */
+  bool startNetwork(void)
+  {
+#if defined(TARGET_POSIX)
+    return GetNode().EnsureOnline();
+#else
+    return true;
+#endif
+  }
+
+#if defined(TARGET_POSIX)
+  /*!
+   * \brief Read a block from the local blockstore, if commands are served
+   *        locally
+   *
+   * A block that isn't in the repo is fetched from the network, so a miss
+   * starts the node's daemon.
+   *
+   * \return false if the command must go through go-ipfs
+   */
+  bool getLocalBlock(const char* key, std::string& block)
+  {
+    CBlockstore* blockstore = GetNode().GetLocalBlockstore();
+    if (!blockstore)
+      return false;
+
+    // go-ipfs reports invalid keys
+    std::string multihash;
+    if (!key || !DecodeKey(key, multihash))
+      return false;
+
+    if (blockstore->Get(multihash, block))
+      return true;
+
+    startNetwork();
+    return false;
+  }
+#endif
 }
 
 using namespace IPSF;
@@ -58,23 +354,217 @@ void ipfs_init(unsigned int bits, const char* passphrase, bool force)
   invoke(cmd.str());
 }
 
+bool ipfs_open(const char* repo_path, ipfs_open_mode_t mode)
+{
+#if defined(TARGET_POSIX)
+  return GetDefaultNode().Open(repo_path ? repo_path : "", mode == IPFS_OPEN_LOCAL);
+#else
+  if (mode == IPFS_OPEN_LOCAL)
+    return false;
+
+  SelectRepo(repo_path ? repo_path : "");
+  return true;
+#endif
+}
+
+void ipfs_close(void)
+{
+#if defined(TARGET_POSIX)
+  GetDefaultNode().Close();
+#else
+  SelectRepo("");
+#endif
+}
+
+ipfs_node_t* ipfs_node_new(const char* repo_path, ipfs_open_mode_t mode)
+{
+#if defined(TARGET_POSIX)
+  if (!repo_path || *repo_path == '\0')
+    return NULL;
+
+  ipfs_node_t* node = new ipfs_node_t;
+  if (!node->node.Open(repo_path, mode == IPFS_OPEN_LOCAL))
+  {
+    delete node;
+    return NULL;
+  }
+
+  return node;
+#else
+  return NULL;
+#endif
+}
+
+void ipfs_node_free(ipfs_node_t* node)
+{
+#if defined(TARGET_POSIX)
+  if (!node)
+    return;
+
+  if (GetThreadRepo() == node->node.GetRepo())
+    SelectThreadRepo("");
+
+  delete node;
+#endif
+}
+
+bool ipfs_node_set_ports(ipfs_node_t* node, unsigned short swarm_port, unsigned short api_port, unsigned short gateway_port)
+{
+#if defined(TARGET_POSIX)
+  return node && node->node.SetPorts(swarm_port, api_port, gateway_port);
+#else
+  return false;
+#endif
+}
+
+bool ipfs_node_start(ipfs_node_t* node)
+{
+#if defined(TARGET_POSIX)
+  return node && node->node.Start();
+#else
+  return false;
+#endif
+}
+
+void ipfs_node_use(ipfs_node_t* node)
+{
+#if defined(TARGET_POSIX)
+  SelectThreadRepo(node ? node->node.GetRepo() : "");
+#endif
+}
+
 void ipfs_add(const char* path, bool recursive, bool quiet, bool progress, bool wrap_with_directory, bool trickle)
 {
-  std::stringstream cmd;
+  CPriorityScope priority(PriorityBulk);
 
-  cmd << "ipfs add";
-  cmd << " " << (path ? path : "");
-  cmd << " -r " << (recursive ? "true" : "false");
-  cmd << " -q " << (quiet ? "true" : "false");
-  cmd << " -p " << (progress ? "true" : "false");
-  cmd << " -w " << (wrap_with_directory ? "true" : "false");
-  cmd << " -t " << (trickle ? "true" : "false");
+  ipfs_add_options_t options;
+  ipfs_add_options_init(&options);
 
-  invoke(cmd.str());
+  options.recursive = recursive;
+  options.quiet = quiet;
+  options.progress = progress;
+  options.wrap_with_directory = wrap_with_directory;
+  options.trickle = trickle;
+
+  ipfs_add_ex(path, &options);
+}
+
+void ipfs_add_options_init(ipfs_add_options_t* options)
+{
+  if (!options)
+    return;
+
+  options->recursive = false;
+  options->quiet = false;
+  options->progress = false;
+  options->wrap_with_directory = false;
+  options->trickle = false;
+  options->chunker = IPFS_CHUNKER_FIXED;
+  options->chunk_size = 0;
+  options->chunk_min = 0;
+  options->chunk_avg = 0;
+  options->chunk_max = 0;
+  options->only_hash = false;
+}
+
+bool ipfs_add_ex(const char* path, const ipfs_add_options_t* options)
+{
+  CPriorityScope priority(PriorityBulk);
+
+  ipfs_add_options_t defaults;
+  if (!options)
+  {
+    ipfs_add_options_init(&defaults);
+    options = &defaults;
+  }
+
+  std::string cmd;
+  if (!GetAddCommand(path ? path : "", *options, cmd))
+    return false;
+
+  invoke(cmd);
+
+  return true;
+}
+
+bool ipfs_add_hash(const char* path, const ipfs_add_options_t* options, char* cid, size_t cid_size)
+{
+  CPriorityScope priority(PriorityBulk);
+
+  if (!cid || cid_size == 0)
+    return false;
+
+  ipfs_add_options_t hashOptions;
+  if (options)
+    hashOptions = *options;
+  else
+    ipfs_add_options_init(&hashOptions);
+
+  hashOptions.quiet = true;
+  hashOptions.progress = false;
+  hashOptions.only_hash = true;
+
+  std::string root;
+
+#if defined(TARGET_POSIX)
+  // Fixed-size chunks are cut and hashed in C++
+  if (hashOptions.chunker == IPFS_CHUNKER_FIXED)
+  {
+    if (!path || *path == '\0' || !AddHashOnly(path, hashOptions, root))
+      return false;
+  }
+  else
+#endif
+  {
+    std::string cmd;
+    std::string output;
+    if (!GetAddCommand(path ? path : "", hashOptions, cmd) || !invoke(cmd, output))
+      return false;
+
+    // Quiet mode prints one key per line, the root last
+    root = StringUtils::LastLine(output);
+  }
+
+  if (root.empty() || root.size() >= cid_size)
+    return false;
+
+  root.copy(cid, root.size());
+  cid[root.size()] = '\0';
+
+  return true;
+}
+
+bool ipfs_add_incremental(const char* path, const char* index_path, const ipfs_add_options_t* options, char* cid, size_t cid_size)
+{
+  CPriorityScope priority(PriorityBulk);
+
+#if defined(TARGET_POSIX)
+  if (!path || *path == '\0' || !index_path || *index_path == '\0' || !cid || cid_size == 0)
+    return false;
+
+  ipfs_add_options_t addOptions;
+  if (options)
+    addOptions = *options;
+  else
+    ipfs_add_options_init(&addOptions);
+
+  std::string root;
+  if (!AddIncremental(path, index_path, addOptions, root) || root.size() >= cid_size)
+    return false;
+
+  root.copy(cid, root.size());
+  cid[root.size()] = '\0';
+
+  return true;
+#else
+  return false;
+#endif
 }
 
 void ipfs_cat(const char* ipfs_path)
 {
+  CPriorityScope priority(PriorityInteractive);
+
   std::stringstream cmd;
 
   cmd << "ipfs cat";
@@ -83,8 +573,153 @@ void ipfs_cat(const char* ipfs_path)
   invoke(cmd.str());
 }
 
+bool ipfs_cat_alloc(const char* ipfs_path, const ipfs_allocator_t* allocator, void** data, size_t* size)
+{
+  CPriorityScope priority(PriorityInteractive);
+
+  if (!ipfs_path || !isValidAllocator(allocator, data, size))
+    return false;
+
+#if defined(TARGET_POSIX)
+  std::string output;
+  if (!captureOutput("cat", ipfs_path, output))
+    return false;
+
+  CResultMemory result(*allocator);
+  if (!result.Assign(output))
+    return false;
+
+  result.Release(data, size);
+  return true;
+#else
+  return false;
+#endif
+}
+
+bool ipfs_cat_view(const char* ipfs_path, ipfs_view_t* view)
+{
+  CPriorityScope priority(PriorityInteractive);
+
+  if (!ipfs_path || !view)
+    return false;
+
+  clearView(view);
+
+#if defined(TARGET_POSIX)
+  std::vector<BlockRef> pieces;
+  if (!MapFile(ipfs_path, pieces))
+  {
+    std::shared_ptr<std::string> output = std::make_shared<std::string>();
+    if (!captureOutput("cat", ipfs_path, *output))
+      return false;
+
+    pieces.assign(1, ownedRef(output));
+  }
+
+  setView(pieces, view);
+  return true;
+#else
+  return false;
+#endif
+}
+
+void ipfs_view_release(ipfs_view_t* view)
+{
+  if (!view)
+    return;
+
+#if defined(TARGET_POSIX)
+  delete static_cast<ipfs_view_handle*>(view->handle);
+#endif
+
+  clearView(view);
+}
+
 void ipfs_get(const char* ipfs_path, const char* output, bool archive, bool compress, unsigned int compression_level)
 {
+#if defined(TARGET_POSIX)
+  // Fetch a plain TAR archive from IPFS and do the expensive part (unpacking
+  // or compression) on the worker pool
+  bool bExtract = !archive && !compress;
+#if defined(HAVE_ZLIB)
+  bool bCompress = archive && compress;
+#else
+  bool bCompress = false;
+#endif
+
+  if (bExtract || bCompress)
+  {
+    std::string outPath = (output && *output != '\0') ? output : getDefaultOutPath(ipfs_path ? ipfs_path : "");
+
+    if (bCompress)
+    {
+      // Same naming as go-ipfs
+      if (!StringUtils::EndsWith(outPath, ".tar") && !StringUtils::EndsWith(outPath, ".tar.gz"))
+        outPath += ".tar";
+      if (!StringUtils::EndsWith(outPath, ".gz"))
+        outPath += ".gz";
+    }
+
+    // go-ipfs only writes archives to a path. It gets a pipe, which is
+    // unpacked or compressed while the archive arrives. The name must end
+    // in .tar or go-ipfs appends it.
+    char tmpDir[] = "/tmp/libipfs-get-XXXXXX";
+    if (mkdtemp(tmpDir) == NULL)
+    {
+      std::cerr << "Error: failed to create a temporary directory" << std::endl;
+      return;
+    }
+
+    const std::string pipePath = std::string(tmpDir) + "/archive.tar";
+    if (mkfifo(pipePath.c_str(), 0600) != 0)
+    {
+      std::cerr << "Error: failed to create a pipe" << std::endl;
+      rmdir(tmpDir);
+      return;
+    }
+
+    bool bSuccess = false;
+    std::thread reader([&pipePath, &outPath, bCompress, compression_level, &bSuccess]()
+    {
+      int fd = open(pipePath.c_str(), O_RDONLY);
+      if (fd < 0)
+        return;
+
+      bSuccess = bCompress ? GzipTar(fd, outPath, static_cast<int>(compression_level)) :
+                             ExtractTar(fd, outPath);
+      close(fd);
+    });
+
+    // Hold a write end for the whole command, so the reader only sees the
+    // end of the stream once go-ipfs is done, even if it never opened the
+    // pipe
+    int writeFd = open(pipePath.c_str(), O_WRONLY);
+
+    std::stringstream cmd;
+
+    cmd << "ipfs get";
+    cmd << " " << (ipfs_path ? ipfs_path : "");
+    cmd << " -o " << pipePath;
+    cmd << " -a true";
+    cmd << " -C false";
+
+    invoke(cmd.str());
+
+    if (writeFd >= 0)
+      close(writeFd);
+    reader.join();
+
+    unlink(pipePath.c_str());
+    rmdir(tmpDir);
+
+    // go-ipfs has reported its own errors
+    if (!bSuccess)
+      std::cerr << "Error: failed to write " << outPath << std::endl;
+
+    return;
+  }
+#endif
+
   std::stringstream cmd;
 
   cmd << "ipfs get";
@@ -101,6 +736,8 @@ void ipfs_get(const char* ipfs_path, const char* output, bool archive, bool comp
 
 void ipfs_ls(const char* ipfs_path)
 {
+  CPriorityScope priority(PriorityInteractive);
+
   std::stringstream cmd;
 
   cmd << "ipfs ls";
@@ -135,6 +772,23 @@ void ipfs_refs_local(void)
 
 void ipfs_block_put(const char* data)
 {
+#if defined(TARGET_POSIX)
+  CBlockstore* blockstore = GetNode().GetLocalBlockstore();
+  if (blockstore)
+  {
+    std::ifstream file(data ? data : "", std::ios::binary);
+    std::stringstream block;
+    block << file.rdbuf();
+
+    std::string multihash;
+    if (!file || !blockstore->Put(block.str(), multihash))
+      std::cerr << "Error: failed to store block" << std::endl;
+    else
+      std::cout << EncodeBase58(multihash) << std::endl;
+    return;
+  }
+#endif
+
   std::stringstream cmd;
 
   cmd << "ipfs block put";
@@ -145,6 +799,17 @@ void ipfs_block_put(const char* data)
 
 void ipfs_block_stat(const char* key)
 {
+  CPriorityScope priority(PriorityInteractive);
+
+#if defined(TARGET_POSIX)
+  std::string block;
+  if (getLocalBlock(key, block))
+  {
+    std::cout << "Key: " << key << std::endl << "Size: " << block.size() << std::endl;
+    return;
+  }
+#endif
+
   std::stringstream cmd;
 
   cmd << "ipfs block stat";
@@ -155,6 +820,17 @@ void ipfs_block_stat(const char* key)
 
 void ipfs_block_get(const char* key)
 {
+  CPriorityScope priority(PriorityInteractive);
+
+#if defined(TARGET_POSIX)
+  std::string block;
+  if (getLocalBlock(key, block))
+  {
+    std::cout.write(block.data(), block.size()).flush();
+    return;
+  }
+#endif
+
   std::stringstream cmd;
 
   cmd << "ipfs block get";
@@ -163,8 +839,149 @@ void ipfs_block_get(const char* key)
   invoke(cmd.str());
 }
 
+bool ipfs_block_put_data(const void* data, size_t size, char* key, size_t key_size)
+{
+  if ((!data && size > 0) || !key || key_size == 0)
+    return false;
+
+#if defined(TARGET_POSIX)
+  std::string multihash;
+  return PutBlock(std::string(static_cast<const char*>(data), size), multihash) &&
+         copyString(EncodeBase58(multihash), key, key_size);
+#else
+  return false;
+#endif
+}
+
+bool ipfs_block_get_data(const char* key, void* buffer, size_t buffer_size, size_t* size)
+{
+  CPriorityScope priority(PriorityInteractive);
+
+  if (!key || !size)
+    return false;
+
+#if defined(TARGET_POSIX)
+  std::string multihash;
+  std::string block;
+  if (!DecodeKey(key, multihash) || !GetBlock(multihash, block))
+    return false;
+
+  *size = block.size();
+  if (!buffer || block.size() > buffer_size)
+    return false;
+
+  block.copy(static_cast<char*>(buffer), block.size());
+  return true;
+#else
+  return false;
+#endif
+}
+
+bool ipfs_block_get_alloc(const char* key, const ipfs_allocator_t* allocator, void** data, size_t* size)
+{
+  CPriorityScope priority(PriorityInteractive);
+
+  if (!key || !isValidAllocator(allocator, data, size))
+    return false;
+
+#if defined(TARGET_POSIX)
+  std::string multihash;
+  if (!DecodeKey(key, multihash))
+    return false;
+
+  CResultMemory result(*allocator);
+  if (!GetBlock(multihash, [&result](size_t blockSize) { return result.Allocate(blockSize); }))
+    return false;
+
+  result.Release(data, size);
+  return true;
+#else
+  return false;
+#endif
+}
+
+bool ipfs_block_get_view(const char* key, ipfs_view_t* view)
+{
+  CPriorityScope priority(PriorityInteractive);
+
+  if (!key || !view)
+    return false;
+
+  clearView(view);
+
+#if defined(TARGET_POSIX)
+  std::string multihash;
+  if (!DecodeKey(key, multihash))
+    return false;
+
+  std::vector<BlockRef> refs(1);
+  if (!MapBlock(multihash, refs[0]))
+  {
+    std::shared_ptr<std::string> block = std::make_shared<std::string>();
+    if (!GetBlock(multihash, *block))
+      return false;
+
+    refs[0] = ownedRef(block);
+  }
+
+  setView(refs, view);
+  return true;
+#else
+  return false;
+#endif
+}
+
+bool ipfs_block_has(const char* key)
+{
+  bool result = false;
+  return ipfs_block_has_many(&key, 1, &result) == 1;
+}
+
+size_t ipfs_block_has_many(const char* const* keys, size_t count, bool* results)
+{
+  CPriorityScope priority(PriorityInteractive);
+
+  if (!keys || !results)
+    return 0;
+
+  size_t found = 0;
+
+#if defined(TARGET_POSIX)
+  CBlockstore* blockstore = GetNode().GetBlockstore();
+
+  for (size_t i = 0; i < count; i++)
+  {
+    std::string multihash;
+    results[i] = blockstore && keys[i] && DecodeKey(keys[i], multihash) && blockstore->Has(multihash);
+    if (results[i])
+      found++;
+  }
+#else
+  for (size_t i = 0; i < count; i++)
+    results[i] = false;
+#endif
+
+  return found;
+}
+
 void ipfs_object_data(const char* key)
 {
+  CPriorityScope priority(PriorityInteractive);
+
+#if defined(TARGET_POSIX)
+  std::string block;
+  if (getLocalBlock(key, block))
+  {
+    std::vector<DagLink> links;
+    std::string data;
+    if (!DecodeDagNode(block, links, data))
+      std::cerr << "Error: invalid DAG node" << std::endl;
+    else
+      std::cout.write(data.data(), data.size()).flush();
+    return;
+  }
+#endif
+
   std::stringstream cmd;
 
   cmd << "ipfs object data";
@@ -173,8 +990,53 @@ void ipfs_object_data(const char* key)
   invoke(cmd.str());
 }
 
+bool ipfs_object_data_alloc(const char* key, const ipfs_allocator_t* allocator, void** data, size_t* size)
+{
+  CPriorityScope priority(PriorityInteractive);
+
+  if (!key || !isValidAllocator(allocator, data, size))
+    return false;
+
+#if defined(TARGET_POSIX)
+  std::string multihash;
+  std::string block;
+  std::vector<DagLink> links;
+  std::string nodeData;
+  if (!DecodeKey(key, multihash) || !GetBlock(multihash, block) || !DecodeDagNode(block, links, nodeData))
+    return false;
+
+  CResultMemory result(*allocator);
+  if (!result.Assign(nodeData))
+    return false;
+
+  result.Release(data, size);
+  return true;
+#else
+  return false;
+#endif
+}
+
 void ipfs_object_links(const char* key)
 {
+  CPriorityScope priority(PriorityInteractive);
+
+#if defined(TARGET_POSIX)
+  std::string block;
+  if (getLocalBlock(key, block))
+  {
+    std::vector<DagLink> links;
+    std::string data;
+    if (!DecodeDagNode(block, links, data))
+      std::cerr << "Error: invalid DAG node" << std::endl;
+    else
+    {
+      for (std::vector<DagLink>::const_iterator it = links.begin(); it != links.end(); ++it)
+        std::cout << EncodeBase58(it->hash) << " " << it->size << " " << it->name << std::endl;
+    }
+    return;
+  }
+#endif
+
   std::stringstream cmd;
 
   cmd << "ipfs object links";
@@ -185,6 +1047,8 @@ void ipfs_object_links(const char* key)
 
 void ipfs_object_get(const char* key)
 {
+  CPriorityScope priority(PriorityInteractive);
+
   std::stringstream cmd;
 
   cmd << "ipfs object get";
@@ -193,6 +1057,29 @@ void ipfs_object_get(const char* key)
   invoke(cmd.str());
 }
 
+bool ipfs_object_get_alloc(const char* key, const ipfs_allocator_t* allocator, void** json, size_t* size)
+{
+  CPriorityScope priority(PriorityInteractive);
+
+  if (!key || !isValidAllocator(allocator, json, size))
+    return false;
+
+#if defined(TARGET_POSIX)
+  std::string output;
+  if (!captureOutput("object/get", key, output))
+    return false;
+
+  CResultMemory result(*allocator);
+  if (!result.Assign(output))
+    return false;
+
+  result.Release(json, size);
+  return true;
+#else
+  return false;
+#endif
+}
+
 void ipfs_object_put(const char* data)
 {
   std::stringstream cmd;
@@ -205,6 +1092,32 @@ void ipfs_object_put(const char* data)
 
 void ipfs_object_stat(const char* key)
 {
+  CPriorityScope priority(PriorityInteractive);
+
+#if defined(TARGET_POSIX)
+  std::string block;
+  if (getLocalBlock(key, block))
+  {
+    std::vector<DagLink> links;
+    std::string data;
+    if (!DecodeDagNode(block, links, data))
+      std::cerr << "Error: invalid DAG node" << std::endl;
+    else
+    {
+      uint64_t cumulativeSize = block.size();
+      for (std::vector<DagLink>::const_iterator it = links.begin(); it != links.end(); ++it)
+        cumulativeSize += it->size;
+
+      std::cout << "NumLinks: " << links.size() << std::endl
+                << "BlockSize: " << block.size() << std::endl
+                << "LinksSize: " << block.size() - data.size() << std::endl
+                << "DataSize: " << data.size() << std::endl
+                << "CumulativeSize: " << cumulativeSize << std::endl;
+    }
+    return;
+  }
+#endif
+
   std::stringstream cmd;
 
   cmd << "ipfs object stat";
@@ -213,6 +1126,124 @@ void ipfs_object_stat(const char* key)
   invoke(cmd.str());
 }
 
+bool ipfs_dag_export(const char* root, int fd)
+{
+  CPriorityScope priority(PriorityBulk);
+
+#if defined(TARGET_POSIX)
+  std::string multihash;
+  return root && fd >= 0 && DecodeKey(root, multihash) && ExportCar(multihash, fd);
+#else
+  return false;
+#endif
+}
+
+int ipfs_dag_import(int fd, char* roots, size_t roots_size)
+{
+  CPriorityScope priority(PriorityBulk);
+
+#if defined(TARGET_POSIX)
+  std::vector<std::string> rootKeys;
+  if (fd < 0 || !ImportCar(fd, rootKeys))
+    return -1;
+
+  if (roots)
+  {
+    std::string rootList;
+    for (std::vector<std::string>::const_iterator it = rootKeys.begin(); it != rootKeys.end(); ++it)
+      rootList += (it == rootKeys.begin() ? "" : "\n") + EncodeBase58(*it);
+
+    if (!copyString(rootList, roots, roots_size))
+      return -1;
+  }
+
+  return static_cast<int>(rootKeys.size());
+#else
+  return -1;
+#endif
+}
+
+ipfs_dag_builder_t* ipfs_dag_builder_new(void)
+{
+#if defined(TARGET_POSIX)
+  return new ipfs_dag_builder_t;
+#else
+  return NULL;
+#endif
+}
+
+void ipfs_dag_builder_free(ipfs_dag_builder_t* builder)
+{
+#if defined(TARGET_POSIX)
+  delete builder;
+#endif
+}
+
+int ipfs_dag_node_new(ipfs_dag_builder_t* builder)
+{
+#if defined(TARGET_POSIX)
+  if (!builder)
+    return -1;
+
+  return static_cast<int>(builder->builder.AddNode());
+#else
+  return -1;
+#endif
+}
+
+bool ipfs_dag_node_set_data(ipfs_dag_builder_t* builder, int node, const void* data, size_t size)
+{
+#if defined(TARGET_POSIX)
+  if (!builder || node < 0 || (!data && size > 0))
+    return false;
+
+  return builder->builder.SetData(node, std::string(static_cast<const char*>(data), size));
+#else
+  return false;
+#endif
+}
+
+bool ipfs_dag_node_add_link(ipfs_dag_builder_t* builder, int node, const char* key, const char* name, unsigned long long size)
+{
+#if defined(TARGET_POSIX)
+  DagLink link;
+  if (!builder || node < 0 || !key || !DecodeKey(key, link.hash))
+    return false;
+
+  link.name = name ? name : "";
+  link.size = size;
+
+  return builder->builder.AddLink(node, link);
+#else
+  return false;
+#endif
+}
+
+bool ipfs_dag_node_add_child(ipfs_dag_builder_t* builder, int node, int child, const char* name)
+{
+#if defined(TARGET_POSIX)
+  if (!builder || node < 0 || child < 0)
+    return false;
+
+  return builder->builder.AddChild(node, child, name ? name : "");
+#else
+  return false;
+#endif
+}
+
+bool ipfs_dag_builder_flush(ipfs_dag_builder_t* builder, int root, char* key, size_t key_size)
+{
+#if defined(TARGET_POSIX)
+  std::string multihash;
+  if (!builder || root < 0 || !builder->builder.Flush(root, multihash))
+    return false;
+
+  return !key || copyString(EncodeBase58(multihash), key, key_size);
+#else
+  return false;
+#endif
+}
+
 void ipfs_daemon(bool init, const char* routing, bool mount, bool writable, const char* mount_ipfs, const char* mount_ipns)
 {
   std::stringstream cmd;
@@ -228,7 +1259,7 @@ void ipfs_daemon(bool init, const char* routing, bool mount, bool writable, cons
   if (mount_ipns && *mount_ipns != '\0')
     cmd << " -mount-ipns " << mount_ipns;
 
-  invoke(cmd.str());
+  invokeService(cmd.str());
 }
 
 void ipfs_mount(const char* f, const char* n)
@@ -241,7 +1272,8 @@ void ipfs_mount(const char* f, const char* n)
   if (n && *n != '\0')
     cmd << " -n " << n;
 
-  invoke(cmd.str());
+  startNetwork();
+  invokeService(cmd.str());
 }
 
 void ipfs_name_publish(const char* name, const char* ipfs_path)
@@ -254,20 +1286,91 @@ void ipfs_name_publish(const char* name, const char* ipfs_path)
   if (ipfs_path && *ipfs_path != '\0')
     cmd << " " << ipfs_path;
 
+  startNetwork();
   invoke(cmd.str());
+
+#if defined(TARGET_POSIX)
+  // Without a name the node publishes to its own
+  if (name && *name != '\0')
+    GetNameCache().Invalidate(name);
+  else
+    GetNameCache().Clear();
+#endif
 }
 
 void ipfs_name_resolve(const char* name)
 {
+  CPriorityScope priority(PriorityInteractive);
+
+#if defined(TARGET_POSIX)
+  if (name && *name != '\0')
+  {
+    std::string path;
+    if (GetNameCache().Resolve(name, path))
+      std::cout << path << std::endl;
+    else
+      std::cerr << "Error: could not resolve name" << std::endl;
+    return;
+  }
+#endif
+
   std::stringstream cmd;
 
   cmd << "ipfs name resolve";
   if (name && *name != '\0')
     cmd << " " << name;
 
+  startNetwork();
   invoke(cmd.str());
 }
 
+bool ipfs_name_resolve_path(const char* name, char* path, size_t path_size)
+{
+  CPriorityScope priority(PriorityInteractive);
+
+  if (!name || *name == '\0' || !path)
+    return false;
+
+#if defined(TARGET_POSIX)
+  std::string resolved;
+  return GetNameCache().Resolve(name, resolved) && copyString(resolved, path, path_size);
+#else
+  return false;
+#endif
+}
+
+void ipfs_name_cache_configure(unsigned int ttl_ms, unsigned int max_entries)
+{
+#if defined(TARGET_POSIX)
+  GetNameCache().Configure(ttl_ms, max_entries);
+#else
+  (void)ttl_ms;
+  (void)max_entries;
+#endif
+}
+
+bool ipfs_name_cache_stats(ipfs_name_cache_stats_t* stats)
+{
+  if (!stats)
+    return false;
+
+#if defined(TARGET_POSIX)
+  NameCacheStats cacheStats;
+  GetNameCache().GetStats(cacheStats);
+
+  stats->hits = cacheStats.hits;
+  stats->stale_hits = cacheStats.staleHits;
+  stats->misses = cacheStats.misses;
+  stats->coalesced = cacheStats.coalesced;
+  stats->refreshes = cacheStats.refreshes;
+  stats->failures = cacheStats.failures;
+  stats->entries = cacheStats.entries;
+  return true;
+#else
+  return false;
+#endif
+}
+
 void ipfs_pin_rm(const char* ipfs_path, bool recursive)
 {
   std::stringstream cmd;
@@ -293,6 +1396,8 @@ void ipfs_pin_ls(const char* type)
 
 void ipfs_pin_add(const char* ipfs_path, bool recursive)
 {
+  CPriorityScope priority(PriorityBulk);
+
   std::stringstream cmd;
 
   cmd << "ipfs pin add";
@@ -305,12 +1410,50 @@ void ipfs_pin_add(const char* ipfs_path, bool recursive)
 
 void ipfs_repo_gc(bool quiet)
 {
+  CPriorityScope priority(PriorityBulk);
+
   std::stringstream cmd;
 
   cmd << "ipfs repo gc";
   cmd << " -q " << (quiet ? "true" : "false");
 
   invoke(cmd.str());
+
+#if defined(TARGET_POSIX)
+  GetNode().RebuildBlockFilter();
+#endif
+}
+
+bool ipfs_repo_pack(const char* const* roots, size_t count, unsigned long long* block_count)
+{
+  CPriorityScope priority(PriorityBulk);
+
+  if (block_count)
+    *block_count = 0;
+
+  if (!roots)
+    return false;
+
+#if defined(TARGET_POSIX)
+  std::vector<std::string> multihashes;
+  for (size_t i = 0; i < count; i++)
+  {
+    std::string multihash;
+    if (!roots[i] || !DecodeKey(roots[i], multihash))
+      return false;
+    multihashes.push_back(multihash);
+  }
+
+  uint64_t packed;
+  if (!GetNode().PackBlocks(multihashes, packed))
+    return false;
+
+  if (block_count)
+    *block_count = packed;
+  return true;
+#else
+  return false;
+#endif
 }
 
 void ipfs_network_id(const char* peer_id)
@@ -365,6 +1508,7 @@ void ipfs_swarm_disconnect(const char* address)
   if (address && *address != '\0')
     cmd << " " << address;
 
+  startNetwork();
   invoke(cmd.str());
 }
 
@@ -374,6 +1518,7 @@ void ipfs_swarm_peers(void)
 
   cmd << "ipfs swarm peers";
 
+  startNetwork();
   invoke(cmd.str());
 }
 
@@ -383,6 +1528,7 @@ void ipfs_swarm_addrs(void)
 
   cmd << "ipfs swarm addrs";
 
+  startNetwork();
   invoke(cmd.str());
 }
 
@@ -394,9 +1540,28 @@ void ipfs_swarm_connect(const char* address)
   if (address && *address != '\0')
     cmd << " " << address;
 
+  startNetwork();
   invoke(cmd.str());
 }
 
+unsigned int ipfs_swarm_connect_many(const char* const* addrs, unsigned int n, unsigned int max_concurrency, unsigned int timeout_ms, ipfs_swarm_connect_result_t* results)
+{
+  if (!addrs || !results || n == 0)
+    return 0;
+
+#if defined(TARGET_POSIX)
+  startNetwork();
+  return ConnectPeers(addrs, n, max_concurrency, timeout_ms, results);
+#else
+  for (unsigned int i = 0; i < n; i++)
+  {
+    results[i].status = IPFS_CONNECT_FAILED;
+    results[i].latency_ns = 0;
+  }
+  return 0;
+#endif
+}
+
 void ipfs_dht_query(const char* peer_id, bool verbose)
 {
   std::stringstream cmd;
@@ -406,6 +1571,7 @@ void ipfs_dht_query(const char* peer_id, bool verbose)
     cmd << " " << peer_id;
   cmd << " -v " << (verbose ? "true" : "false");
 
+  startNetwork();
   invoke(cmd.str());
 }
 
@@ -418,9 +1584,20 @@ void ipfs_dht_findprovs(const char* key, bool verbose)
     cmd << " " << key;
   cmd << " -v " << (verbose ? "true" : "false");
 
+  startNetwork();
   invoke(cmd.str());
 }
 
+int ipfs_dht_findprovs_stream(const char* key, unsigned int max_providers, ipfs_provider_cb cb, void* context)
+{
+#if defined(TARGET_POSIX)
+  startNetwork();
+  return FindProvidersStream(key, max_providers, cb, context);
+#else
+  return -1;
+#endif
+}
+
 void ipfs_dht_findpeer(const char* peer_id)
 {
   std::stringstream cmd;
@@ -429,6 +1606,7 @@ void ipfs_dht_findpeer(const char* peer_id)
   if (peer_id && *peer_id != '\0')
     cmd << " " << peer_id;
 
+  startNetwork();
   invoke(cmd.str());
 }
 
@@ -442,9 +1620,108 @@ void ipfs_ping(const char* peer_id, unsigned int count)
   if (count > 0)
     cmd << " -n " << count;
 
+  startNetwork();
   invoke(cmd.str());
 }
 
+int ipfs_ping_samples(const char* peer_id, unsigned int count, unsigned long long* rtts_ns, ipfs_ping_stats_t* stats)
+{
+  if (stats)
+  {
+    stats->sent = 0;
+    stats->received = 0;
+    stats->min_ns = 0;
+    stats->mean_ns = 0;
+    stats->p99_ns = 0;
+  }
+
+#if defined(TARGET_POSIX)
+  std::vector<uint64_t> rtts;
+  unsigned int sent;
+  if (!peer_id || !startNetwork() || !Ping(peer_id, count, 0, rtts, sent))
+    return -1;
+
+  // The daemon doesn't send more probes than asked, but don't trust it with the caller's array
+  const unsigned int capacity = (count > 0 ? count : DEFAULT_PING_COUNT);
+  if (rtts.size() > capacity)
+    rtts.resize(capacity);
+
+  if (rtts_ns)
+    std::copy(rtts.begin(), rtts.end(), rtts_ns);
+
+  if (stats && !rtts.empty())
+  {
+    stats->sent = sent;
+    stats->received = static_cast<unsigned int>(rtts.size());
+
+    unsigned long long total = 0;
+    for (std::vector<uint64_t>::const_iterator it = rtts.begin(); it != rtts.end(); ++it)
+      total += *it;
+    stats->mean_ns = total / rtts.size();
+
+    std::sort(rtts.begin(), rtts.end());
+    stats->min_ns = rtts.front();
+    stats->p99_ns = rtts[(rtts.size() * 99 + 99) / 100 - 1];
+  }
+  else if (stats)
+  {
+    stats->sent = sent;
+  }
+
+  return static_cast<int>(rtts.size());
+#else
+  return -1;
+#endif
+}
+
+bool ipfs_ping_monitor_start(const char* const* peer_ids, unsigned int n, unsigned int interval_ms, double alpha)
+{
+#if defined(TARGET_POSIX)
+  if (!peer_ids)
+    return false;
+
+  std::vector<std::string> peers;
+  for (unsigned int i = 0; i < n; i++)
+  {
+    if (peer_ids[i] && *peer_ids[i] != '\0')
+      peers.push_back(peer_ids[i]);
+  }
+
+  if (!startNetwork())
+    return false;
+
+  LatencyTable::SetAlpha(alpha);
+  return LatencyTable::StartMonitor(peers, interval_ms);
+#else
+  return false;
+#endif
+}
+
+void ipfs_ping_monitor_stop(void)
+{
+#if defined(TARGET_POSIX)
+  LatencyTable::StopMonitor();
+#endif
+}
+
+bool ipfs_ping_latency(const char* peer_id, unsigned long long* ewma_ns, unsigned int* samples)
+{
+#if defined(TARGET_POSIX)
+  uint64_t ewma;
+  unsigned int sampleCount;
+  if (!peer_id || !ewma_ns || !LatencyTable::GetLatency(peer_id, ewma, sampleCount))
+    return false;
+
+  *ewma_ns = ewma;
+  if (samples)
+    *samples = sampleCount;
+
+  return true;
+#else
+  return false;
+#endif
+}
+
 void ipfs_diag_net(unsigned int timeout)
 {
   std::stringstream cmd;
@@ -452,6 +1729,7 @@ void ipfs_diag_net(unsigned int timeout)
   cmd << "ipfs diag net";
   cmd << " -timeout " << timeout;
 
+  startNetwork();
   invoke(cmd.str());
 }
 
@@ -508,6 +1786,136 @@ void ipfs_config_replace(const char* file)
   invoke(cmd.str());
 }
 
+ipfs_config_t* ipfs_config_open(const char* repo_path)
+{
+  ipfs_config_t* config = new ipfs_config_t;
+
+  if (!config->config.Load(repo_path ? repo_path : GetRepoPath()))
+  {
+    delete config;
+    return NULL;
+  }
+
+  return config;
+}
+
+void ipfs_config_close(ipfs_config_t* config)
+{
+  delete config;
+}
+
+bool ipfs_config_get_int(const ipfs_config_t* config, const char* key, long long* value)
+{
+  const CJsonValue* entry = getConfigValue(config, key);
+  if (!entry || entry->GetType() != CJsonValue::TypeNumber || !value)
+    return false;
+
+  *value = entry->AsInteger();
+  return true;
+}
+
+bool ipfs_config_get_bool(const ipfs_config_t* config, const char* key, bool* value)
+{
+  const CJsonValue* entry = getConfigValue(config, key);
+  if (!entry || entry->GetType() != CJsonValue::TypeBool || !value)
+    return false;
+
+  *value = entry->AsBool();
+  return true;
+}
+
+bool ipfs_config_get_string(const ipfs_config_t* config, const char* key, char* value, size_t value_size)
+{
+  const CJsonValue* entry = getConfigValue(config, key);
+  if (!entry || entry->GetType() != CJsonValue::TypeString)
+    return false;
+
+  return copyString(entry->AsString(), value, value_size);
+}
+
+int ipfs_config_get_array_size(const ipfs_config_t* config, const char* key)
+{
+  const CJsonValue* entry = getConfigValue(config, key);
+  if (!entry || entry->GetType() != CJsonValue::TypeArray)
+    return -1;
+
+  return static_cast<int>(entry->Size());
+}
+
+bool ipfs_config_get_array_string(const ipfs_config_t* config, const char* key, unsigned int index, char* value, size_t value_size)
+{
+  const CJsonValue* entry = getConfigValue(config, key);
+  if (!entry || entry->GetType() != CJsonValue::TypeArray || index >= entry->Size())
+    return false;
+
+  const CJsonValue& element = (*entry)[index];
+  if (element.GetType() != CJsonValue::TypeString)
+    return false;
+
+  return copyString(element.AsString(), value, value_size);
+}
+
+bool ipfs_config_set_int(ipfs_config_t* config, const char* key, long long value)
+{
+  CJsonValue entry;
+  entry.SetInteger(value);
+
+  return config && key && config->config.Set(key, entry);
+}
+
+bool ipfs_config_set_bool(ipfs_config_t* config, const char* key, bool value)
+{
+  CJsonValue entry;
+  entry.SetBool(value);
+
+  return config && key && config->config.Set(key, entry);
+}
+
+bool ipfs_config_set_string(ipfs_config_t* config, const char* key, const char* value)
+{
+  if (!value)
+    return false;
+
+  CJsonValue entry;
+  entry.SetString(value);
+
+  return config && key && config->config.Set(key, entry);
+}
+
+bool ipfs_config_set_strings(ipfs_config_t* config, const char* key, const char* const* values, unsigned int n)
+{
+  if (!values && n > 0)
+    return false;
+
+  CJsonValue entry;
+  entry.SetArray();
+  for (unsigned int i = 0; i < n; i++)
+  {
+    if (!values[i])
+      return false;
+
+    CJsonValue element;
+    element.SetString(values[i]);
+    entry.Append(element);
+  }
+
+  return config && key && config->config.Set(key, entry);
+}
+
+bool ipfs_config_set_json(ipfs_config_t* config, const char* key, const char* json)
+{
+  CJsonValue entry;
+  if (!json || !CJsonValue::Parse(json, entry))
+    return false;
+
+  return config && key && config->config.Set(key, entry);
+}
+
+bool ipfs_config_commit(ipfs_config_t* config, bool notify_node)
+{
+  return config && config->config.Commit(notify_node);
+}
+
 void ipfs_version(void)
 {
   std::stringstream cmd;
@@ -517,4 +1925,55 @@ void ipfs_version(void)
   invoke(cmd.str());
 }
 
+bool ipfs_runtime_configure(unsigned int max_procs, int gc_percent, unsigned long long memory_limit_bytes)
+{
+  return ConfigureRuntime(max_procs, gc_percent, memory_limit_bytes);
+}
+
+bool ipfs_runtime_stats(ipfs_runtime_stats_t* stats)
+{
+  if (stats == NULL)
+    return false;
+
+  return GetRuntimeStats(*stats);
+}
+
+void ipfs_set_priority(ipfs_priority_t priority)
+{
+  PriorityClass priorityClass;
+  if (getPriorityClass(priority, priorityClass))
+    SetThreadPriority(priorityClass);
+  else
+    ClearThreadPriority();
+}
+
+bool ipfs_scheduler_configure(ipfs_scheduler_t scheduler, ipfs_priority_t priority, unsigned int weight, unsigned int max_running)
+{
+  CScheduler* resource = getScheduler(scheduler);
+  PriorityClass priorityClass;
+  if (!resource || !getPriorityClass(priority, priorityClass))
+    return false;
+
+  return resource->Configure(priorityClass, weight, max_running);
+}
+
+bool ipfs_scheduler_stats(ipfs_scheduler_t scheduler, ipfs_priority_t priority, ipfs_scheduler_stats_t* stats)
+{
+  CScheduler* resource = getScheduler(scheduler);
+  PriorityClass priorityClass;
+  if (!resource || !getPriorityClass(priority, priorityClass) || !stats)
+    return false;
+
+  SchedulerStats schedulerStats;
+  resource->GetStats(priorityClass, schedulerStats);
+
+  stats->queued = schedulerStats.queued;
+  stats->running = schedulerStats.running;
+  stats->admitted = schedulerStats.admitted;
+  stats->wait_total_ns = schedulerStats.waitTotalNs;
+  stats->wait_max_ns = schedulerStats.waitMaxNs;
+
+  return true;
+}
+
 } // extern "C"
@@ -21,14 +21,326 @@
  *
  */
 
+#include "api.h"
+#include "config.h"
+#include "invoke.h"
+
 // Go generated include file
 #include "ipfs.h"
 
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
 #include <sstream>
 #include <string>
+#include <thread>
+
+#if defined(TARGET_POSIX)
+#include <signal.h>
+#include <spawn.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+extern char** environ;
+#endif
+
+namespace
+{
+  const char* const BATCH_COMMAND = "batch";
+
+  const char* const BATCH_USAGE =
+    "Usage: ipfs_ctrl batch [-0] [-n] [-f <file>]\n"
+    "\n"
+    "Runs IPFS commands read from <file>, or from stdin, in one process.\n"
+    "Commands are one per line, with or without the leading \"ipfs\". Empty\n"
+    "lines and lines starting with '#' are skipped.\n"
+    "\n"
+    "  -0         Commands are separated by NUL instead of newlines\n"
+    "  -n         Don't start a daemon, every command opens the repo itself\n"
+    "  -f <file>  Read commands from <file> instead of stdin\n"
+    "\n"
+    "Unless a daemon already serves the repo, one is started in a child process\n"
+    "for the batch and stopped after it, so the repo is opened once and commands\n"
+    "go through the daemon's API. go-ipfs keeps the state of its command line in\n"
+    "globals, so commands run one at a time.\n"
+    "\n"
+    "A tab-separated line is written to stderr after each command:\n"
+    "\n"
+    "  <number> <status> <milliseconds> <command>\n"
+    "\n"
+    "<status> is \"ok\" or \"error\". go-ipfs doesn't return an exit status, so\n"
+    "errors are recognized by the \"Error: \" line go-ipfs writes to stderr. If\n"
+    "stderr can't be watched, \"done\" is reported instead.\n";
+
+  void RunCommand(const std::string& cmdLine)
+  {
+    GoString str;
+    str.p = const_cast<char*>(cmdLine.c_str());
+    str.n = static_cast<GoInt>(cmdLine.length());
+    runMain(str);
+  }
+
+  // How long a batch waits for the daemon it started
+  const unsigned int DAEMON_START_TIMEOUT_MS   = 60 * 1000;
+  const unsigned int DAEMON_STOP_TIMEOUT_MS    = 10 * 1000;
+  const unsigned int DAEMON_POLL_MS            = 100;
+  const unsigned int DAEMON_REQUEST_TIMEOUT_MS = 2000;
+
+  struct BatchOptions
+  {
+    BatchOptions(void) : delimiter('\n'), bStartDaemon(true) { }
+
+    char        delimiter;
+    bool        bStartDaemon;
+    std::string file;
+  };
+
+  bool ParseBatchOptions(int argc, const char* argv[], BatchOptions& options)
+  {
+    for (int i = 2; i < argc; i++)
+    {
+      const std::string arg = argv[i];
+      if (arg == "-0")
+      {
+        options.delimiter = '\0';
+      }
+      else if (arg == "-n")
+      {
+        options.bStartDaemon = false;
+      }
+      else if (arg == "-f" && i + 1 < argc)
+      {
+        options.file = argv[++i];
+      }
+      else
+      {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  /*!
+   * \brief Runs the commands of a batch and reports how they went
+   */
+  class CBatch
+  {
+  public:
+    CBatch(std::istream& input, char delimiter) :
+      m_input(input),
+      m_delimiter(delimiter),
+      m_count(0),
+      m_failed(0)
+    {
+    }
+
+    void Run(void)
+    {
+      std::string cmdLine;
+      while (NextCommand(cmdLine))
+      {
+        const unsigned int number = ++m_count;
+        const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+        bool bError = false;
+        const bool bWatched = IPSF::invokeWatched(cmdLine, bError);
+        if (!bWatched)
+          IPSF::invoke(cmdLine);
+
+        const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        if (bError)
+          m_failed++;
+
+        const char* status = bWatched ? (bError ? "error" : "ok") : "done";
+        std::fprintf(stderr, "%u\t%s\t%.3f\t%s\n", number, status, ms, cmdLine.c_str());
+        std::fflush(stderr);
+      }
+    }
+
+    unsigned int Failed(void) const { return m_failed; }
+
+  private:
+    bool NextCommand(std::string& cmdLine)
+    {
+      std::string line;
+      while (std::getline(m_input, line, m_delimiter))
+      {
+        if (m_delimiter == '\n' && !line.empty() && line[line.size() - 1] == '\r')
+          line.erase(line.size() - 1);
+
+        const size_t start = line.find_first_not_of(" \t");
+        if (start == std::string::npos || line[start] == '#')
+          continue;
+
+        // go-ipfs skips the program name
+        cmdLine = line.substr(start);
+        if (cmdLine.compare(0, 5, "ipfs ") != 0 && cmdLine != "ipfs")
+          cmdLine = "ipfs " + cmdLine;
+
+        return true;
+      }
+      return false;
+    }
+
+    std::istream& m_input;
+    const char    m_delimiter;
+    unsigned int  m_count;
+    unsigned int  m_failed;
+  };
+
+  /*!
+   * \brief A daemon that keeps the repo open for a batch
+   *
+   * go-ipfs's command line state is global, so the daemon can't run next to
+   * the batch's commands in this process. It runs in a child process of this
+   * program instead, and the commands find its API in the repo.
+   */
+  class CBatchDaemon
+  {
+  public:
+    CBatchDaemon(void) : m_pid(-1) { }
+    ~CBatchDaemon(void) { Stop(); }
+
+    /*!
+     * \brief Start the daemon unless one already serves the repo, and wait
+     *        for its API
+     */
+    bool Start(const char* argv0)
+    {
+#if defined(TARGET_POSIX)
+      const std::string repoPath = IPSF::GetRepoPath();
+      if (IsReady(repoPath))
+        return true;
+
+      char* const args[] = { const_cast<char*>(argv0), const_cast<char*>("daemon"), NULL };
+      if (posix_spawnp(&m_pid, argv0, NULL, NULL, args, environ) != 0)
+      {
+        m_pid = -1;
+        return false;
+      }
+
+      const std::chrono::steady_clock::time_point deadline =
+        std::chrono::steady_clock::now() + std::chrono::milliseconds(DAEMON_START_TIMEOUT_MS);
+
+      while (std::chrono::steady_clock::now() < deadline)
+      {
+        if (IsReady(repoPath))
+          return true;
+
+        // Quit early, e.g. because the repo is locked
+        if (waitpid(m_pid, NULL, WNOHANG) == m_pid)
+        {
+          m_pid = -1;
+          return false;
+        }
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(DAEMON_POLL_MS));
+      }
+
+      Stop();
+      return false;
+#else
+      (void)argv0;
+      return false;
+#endif
+    }
+
+    /*!
+     * \brief Stop the daemon if it was started by Start()
+     *
+     * go-ipfs shuts down cleanly on SIGINT. A daemon that doesn't is killed.
+     */
+    void Stop(void)
+    {
+#if defined(TARGET_POSIX)
+      if (m_pid <= 0)
+        return;
+
+      kill(m_pid, SIGINT);
+
+      const std::chrono::steady_clock::time_point deadline =
+        std::chrono::steady_clock::now() + std::chrono::milliseconds(DAEMON_STOP_TIMEOUT_MS);
+
+      while (waitpid(m_pid, NULL, WNOHANG) == 0)
+      {
+        if (std::chrono::steady_clock::now() >= deadline)
+        {
+          kill(m_pid, SIGKILL);
+          waitpid(m_pid, NULL, 0);
+          break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(DAEMON_POLL_MS));
+      }
+
+      m_pid = -1;
+#endif
+    }
+
+  private:
+    static bool IsReady(const std::string& repoPath)
+    {
+      IPSF::ApiEndpoint endpoint;
+      if (!IPSF::GetDaemonEndpoint(repoPath, endpoint))
+        return false;
+
+      IPSF::CApiRequest request("id");
+      request.SetTimeout(DAEMON_REQUEST_TIMEOUT_MS);
+
+      std::string response;
+      return request.Execute(endpoint, response);
+    }
+
+#if defined(TARGET_POSIX)
+    pid_t m_pid;
+#else
+    int   m_pid;
+#endif
+  };
+
+  int RunBatch(const char* argv0, const BatchOptions& options)
+  {
+    std::ifstream file;
+    if (!options.file.empty())
+    {
+      file.open(options.file.c_str(), std::ios::binary);
+      if (!file)
+      {
+        std::fprintf(stderr, "Error: can't open %s\n", options.file.c_str());
+        return 1;
+      }
+    }
+
+    CBatchDaemon daemon;
+    if (options.bStartDaemon && !daemon.Start(argv0))
+      std::fputs("Warning: can't start a daemon, commands open the repo themselves\n", stderr);
+
+    CBatch batch(options.file.empty() ? std::cin : file, options.delimiter);
+    batch.Run();
+
+    daemon.Stop();
+
+    return batch.Failed() > 0 ? 1 : 0;
+  }
+}
 
 int main(int argc, const char* argv[])
 {
+  // The Go runtime is started once for all commands of a batch
+  if (argc >= 2 && std::strcmp(argv[1], BATCH_COMMAND) == 0)
+  {
+    BatchOptions options;
+    if (!ParseBatchOptions(argc, argv, options))
+    {
+      std::fputs(BATCH_USAGE, stderr);
+      return 2;
+    }
+
+    return RunBatch(argv[0], options);
+  }
+
   std::stringstream args;
 
   for (int i = 0; i < argc; i++)
@@ -40,10 +352,7 @@ int main(int argc, const char* argv[])
 
   std::string strArgs(args.str());
 
-  GoString str;
-  str.p = const_cast<char*>(strArgs.c_str());
-  str.n = static_cast<GoInt>(strArgs.length());
-  runMain(str);
+  RunCommand(strArgs);
 
   return 0;
 }
@@ -0,0 +1,304 @@
+/*
+ *    Copyright (C) 2015 juztamau5
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *    The above copyright notice and this permission notice shall be included in
+ *    all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include "merkledag.h"
+
+using namespace IPSF;
+
+namespace
+{
+  // Protobuf wire types
+  const unsigned int WIRE_VARINT = 0;
+  const unsigned int WIRE_BYTES  = 2;
+
+  // unixfs.proto DataType
+  const uint64_t UNIXFS_RAW       = 0;
+  const uint64_t UNIXFS_DIRECTORY = 1;
+  const uint64_t UNIXFS_FILE      = 2;
+  const uint64_t UNIXFS_SYMLINK   = 4;
+
+  void AppendVarint(std::string& buffer, uint64_t value)
+  {
+    while (value >= 0x80)
+    {
+      buffer.push_back(static_cast<char>((value & 0x7f) | 0x80));
+      value >>= 7;
+    }
+    buffer.push_back(static_cast<char>(value));
+  }
+
+  void AppendTag(std::string& buffer, unsigned int field, unsigned int wireType)
+  {
+    AppendVarint(buffer, (field << 3) | wireType);
+  }
+
+  void AppendBytes(std::string& buffer, unsigned int field, const std::string& bytes)
+  {
+    AppendTag(buffer, field, WIRE_BYTES);
+    AppendVarint(buffer, bytes.size());
+    buffer.append(bytes);
+  }
+
+  void AppendUint(std::string& buffer, unsigned int field, uint64_t value)
+  {
+    AppendTag(buffer, field, WIRE_VARINT);
+    AppendVarint(buffer, value);
+  }
+
+  bool ReadVarint(const char* buffer, size_t size, size_t& pos, uint64_t& value)
+  {
+    value = 0;
+    for (unsigned int shift = 0; shift < 64 && pos < size; shift += 7)
+    {
+      const uint8_t byte = static_cast<uint8_t>(buffer[pos++]);
+      value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+      if ((byte & 0x80) == 0)
+        return true;
+    }
+    return false;
+  }
+
+  /*!
+   * \brief Read the next field of a message without copying it. Bytes fields
+   *        start at <bytesPos> and their size is returned in <value>, varints
+   *        are returned in <value>.
+   */
+  bool ReadSpan(const char* buffer, size_t size, size_t& pos, unsigned int& field, unsigned int& wireType, uint64_t& value, size_t& bytesPos)
+  {
+    uint64_t tag;
+    if (!ReadVarint(buffer, size, pos, tag))
+      return false;
+
+    field = static_cast<unsigned int>(tag >> 3);
+    wireType = static_cast<unsigned int>(tag & 0x7);
+
+    if (wireType == WIRE_VARINT)
+      return ReadVarint(buffer, size, pos, value);
+
+    if (wireType != WIRE_BYTES || !ReadVarint(buffer, size, pos, value) || value > size - pos)
+      return false;
+
+    bytesPos = pos;
+    pos += static_cast<size_t>(value);
+    return true;
+  }
+
+  /*!
+   * \brief Read the next field of a message. Bytes fields are returned in
+   *        <bytes>, varints in <value>.
+   */
+  bool ReadField(const std::string& buffer, size_t& pos, unsigned int& field, unsigned int& wireType, uint64_t& value, std::string& bytes)
+  {
+    size_t bytesPos;
+    if (!ReadSpan(buffer.data(), buffer.size(), pos, field, wireType, value, bytesPos))
+      return false;
+
+    if (wireType == WIRE_BYTES)
+      bytes.assign(buffer, bytesPos, static_cast<size_t>(value));
+
+    return true;
+  }
+}
+
+std::string IPSF::EncodeDagNode(const std::vector<DagLink>& links, const std::string& data)
+{
+  std::string node;
+
+  for (std::vector<DagLink>::const_iterator it = links.begin(); it != links.end(); ++it)
+  {
+    // PBLink: Hash = 1, Name = 2, Tsize = 3. go-ipfs always sets Name and Tsize.
+    std::string link;
+    AppendBytes(link, 1, it->hash);
+    AppendBytes(link, 2, it->name);
+    AppendUint(link, 3, it->size);
+
+    // PBNode: Links = 2
+    AppendBytes(node, 2, link);
+  }
+
+  // PBNode: Data = 1, omitted when empty
+  if (!data.empty())
+    AppendBytes(node, 1, data);
+
+  return node;
+}
+
+bool IPSF::DecodeDagNode(const std::string& node, std::vector<DagLink>& links, std::string& data)
+{
+  links.clear();
+  data.clear();
+
+  size_t pos = 0;
+  while (pos < node.size())
+  {
+    unsigned int field;
+    unsigned int wireType;
+    uint64_t value;
+    std::string bytes;
+    if (!ReadField(node, pos, field, wireType, value, bytes))
+      return false;
+
+    if (field == 1 && wireType == WIRE_BYTES)
+    {
+      data.swap(bytes);
+    }
+    else if (field == 2 && wireType == WIRE_BYTES)
+    {
+      DagLink link;
+      link.size = 0;
+
+      size_t linkPos = 0;
+      while (linkPos < bytes.size())
+      {
+        unsigned int linkField;
+        unsigned int linkWireType;
+        uint64_t linkValue;
+        std::string linkBytes;
+        if (!ReadField(bytes, linkPos, linkField, linkWireType, linkValue, linkBytes))
+          return false;
+
+        if (linkField == 1 && linkWireType == WIRE_BYTES)
+          link.hash.swap(linkBytes);
+        else if (linkField == 2 && linkWireType == WIRE_BYTES)
+          link.name.swap(linkBytes);
+        else if (linkField == 3 && linkWireType == WIRE_VARINT)
+          link.size = linkValue;
+      }
+
+      links.push_back(link);
+    }
+  }
+
+  return true;
+}
+
+std::string IPSF::UnixfsDirectoryData(void)
+{
+  std::string data;
+  AppendUint(data, 1, UNIXFS_DIRECTORY);
+  return data;
+}
+
+std::string IPSF::UnixfsSymlinkData(const std::string& target)
+{
+  std::string data;
+  AppendUint(data, 1, UNIXFS_SYMLINK);
+  AppendBytes(data, 2, target);
+  return data;
+}
+
+std::string IPSF::UnixfsFileData(const std::string& contents, const std::vector<uint64_t>& blockSizes)
+{
+  uint64_t fileSize = contents.size();
+  for (std::vector<uint64_t>::const_iterator it = blockSizes.begin(); it != blockSizes.end(); ++it)
+    fileSize += *it;
+
+  // unixfs Data: Type = 1, Data = 2, filesize = 3, blocksizes = 4 (unpacked)
+  std::string data;
+  AppendUint(data, 1, UNIXFS_FILE);
+  if (!contents.empty())
+    AppendBytes(data, 2, contents);
+  AppendUint(data, 3, fileSize);
+  for (std::vector<uint64_t>::const_iterator it = blockSizes.begin(); it != blockSizes.end(); ++it)
+    AppendUint(data, 4, *it);
+  return data;
+}
+
+bool IPSF::DecodeUnixfsFile(const char* node, size_t nodeSize, std::vector<std::string>& children, size_t& offset, size_t& size)
+{
+  children.clear();
+  offset = 0;
+  size = 0;
+
+  bool bHasData = false;
+  size_t dataPos = 0;
+  size_t dataSize = 0;
+
+  size_t pos = 0;
+  while (pos < nodeSize)
+  {
+    unsigned int field;
+    unsigned int wireType;
+    uint64_t value;
+    size_t bytesPos;
+    if (!ReadSpan(node, nodeSize, pos, field, wireType, value, bytesPos))
+      return false;
+
+    if (field == 1 && wireType == WIRE_BYTES)
+    {
+      bHasData = true;
+      dataPos = bytesPos;
+      dataSize = static_cast<size_t>(value);
+    }
+    else if (field == 2 && wireType == WIRE_BYTES)
+    {
+      // PBLink: Hash = 1
+      const char* link = node + bytesPos;
+      const size_t linkSize = static_cast<size_t>(value);
+
+      size_t linkPos = 0;
+      while (linkPos < linkSize)
+      {
+        unsigned int linkField;
+        unsigned int linkWireType;
+        uint64_t linkValue;
+        size_t linkBytesPos;
+        if (!ReadSpan(link, linkSize, linkPos, linkField, linkWireType, linkValue, linkBytesPos))
+          return false;
+
+        if (linkField == 1 && linkWireType == WIRE_BYTES)
+          children.push_back(std::string(link + linkBytesPos, static_cast<size_t>(linkValue)));
+      }
+    }
+  }
+
+  if (!bHasData)
+    return false;
+
+  // unixfs Data: Type = 1, Data = 2
+  const char* data = node + dataPos;
+
+  bool bFile = false;
+  pos = 0;
+  while (pos < dataSize)
+  {
+    unsigned int field;
+    unsigned int wireType;
+    uint64_t value;
+    size_t bytesPos;
+    if (!ReadSpan(data, dataSize, pos, field, wireType, value, bytesPos))
+      return false;
+
+    if (field == 1 && wireType == WIRE_VARINT)
+    {
+      bFile = (value == UNIXFS_FILE || value == UNIXFS_RAW);
+    }
+    else if (field == 2 && wireType == WIRE_BYTES)
+    {
+      offset = dataPos + bytesPos;
+      size = static_cast<size_t>(value);
+    }
+  }
+
+  return bFile;
+}
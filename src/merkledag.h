@@ -0,0 +1,89 @@
+/*
+ *    Copyright (C) 2015 juztamau5
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *    The above copyright notice and this permission notice shall be included in
+ *    all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+#ifndef __IPSF_MERKLEDAG_H__
+#define __IPSF_MERKLEDAG_H__
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace IPSF
+{
+  /*!
+   * \brief Link from a DAG node to a child
+   */
+  struct DagLink
+  {
+    std::string hash; ///< Binary multihash of the child
+    std::string name;
+    uint64_t    size; ///< Cumulative size of the child and its descendants
+  };
+
+  /*!
+   * \brief Serialize a node to the merkledag protobuf format
+   *
+   * The encoding matches go-ipfs byte for byte (links before data), so the
+   * multihash of the result is the node's key.
+   */
+  std::string EncodeDagNode(const std::vector<DagLink>& links, const std::string& data);
+
+  /*!
+   * \brief Parse a node in the merkledag protobuf format
+   *
+   * \return false if <node> isn't a valid encoding
+   */
+  bool DecodeDagNode(const std::string& node, std::vector<DagLink>& links, std::string& data);
+
+  /*!
+   * \brief Get the unixfs data of a file node
+   *
+   * \param contents The part of the file held by the node itself
+   * \param blockSizes The file size under each child, in link order
+   */
+  std::string UnixfsFileData(const std::string& contents, const std::vector<uint64_t>& blockSizes);
+
+  /*!
+   * \brief Find the contents of a unixfs file in a node, without copying them
+   *
+   * A file is the contents held by its node followed by the contents of its
+   * <children>, in order.
+   *
+   * \param offset Receives where the contents held by <node> start
+   * \param size Receives the size of the contents held by <node>
+   *
+   * \return false if <node> isn't a unixfs file or raw node
+   */
+  bool DecodeUnixfsFile(const char* node, size_t nodeSize, std::vector<std::string>& children, size_t& offset, size_t& size);
+
+  /*!
+   * \brief Get the unixfs data of a directory node
+   */
+  std::string UnixfsDirectoryData(void);
+
+  /*!
+   * \brief Get the unixfs data of a symlink node pointing to <target>
+   */
+  std::string UnixfsSymlinkData(const std::string& target);
+}
+
+#endif // __IPSF_MERKLEDAG_H__
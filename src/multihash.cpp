@@ -0,0 +1,583 @@
+/*
+ *    Copyright (C) 2015 juztamau5
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *    The above copyright notice and this permission notice shall be included in
+ *    all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include "multihash.h"
+
+#include <atomic>
+#include <cstring>
+#include <vector>
+
+#if defined(__x86_64__) && (defined(__clang__) || (defined(__GNUC__) && __GNUC__ >= 5))
+#define HAVE_SHA256_X86  1
+#include <cpuid.h>
+#include <immintrin.h>
+#endif
+
+using namespace IPSF;
+
+namespace
+{
+  const char BASE58_ALPHABET[] = "123456789ABCDEFGHJKLMNPQRSTUVWXYZabcdefghijkmnopqrstuvwxyz";
+  const char BASE32_ALPHABET[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZ234567";
+
+  const uint8_t MULTIHASH_SHA2_256 = 0x12;
+
+  const uint32_t SHA256_K[64] =
+  {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+  };
+
+  const uint32_t SHA256_H[8] =
+  {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+  };
+
+  inline uint32_t RotateRight(uint32_t x, unsigned int n)
+  {
+    return (x >> n) | (x << (32 - n));
+  }
+
+  void Sha256Transform(uint32_t state[8], const uint8_t* blocks, size_t blockCount)
+  {
+    for (; blockCount > 0; blockCount--, blocks += 64)
+    {
+      uint32_t w[64];
+      for (unsigned int i = 0; i < 16; i++)
+      {
+        w[i] = (static_cast<uint32_t>(blocks[i * 4]) << 24) |
+               (static_cast<uint32_t>(blocks[i * 4 + 1]) << 16) |
+               (static_cast<uint32_t>(blocks[i * 4 + 2]) << 8) |
+               (static_cast<uint32_t>(blocks[i * 4 + 3]));
+      }
+      for (unsigned int i = 16; i < 64; i++)
+      {
+        uint32_t s0 = RotateRight(w[i - 15], 7) ^ RotateRight(w[i - 15], 18) ^ (w[i - 15] >> 3);
+        uint32_t s1 = RotateRight(w[i - 2], 17) ^ RotateRight(w[i - 2], 19) ^ (w[i - 2] >> 10);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+      }
+
+      uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+      uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+
+      for (unsigned int i = 0; i < 64; i++)
+      {
+        uint32_t s1 = RotateRight(e, 6) ^ RotateRight(e, 11) ^ RotateRight(e, 25);
+        uint32_t ch = (e & f) ^ (~e & g);
+        uint32_t t1 = h + s1 + ch + SHA256_K[i] + w[i];
+        uint32_t s0 = RotateRight(a, 2) ^ RotateRight(a, 13) ^ RotateRight(a, 22);
+        uint32_t maj = (a & b) ^ (a & c) ^ (b & c);
+        uint32_t t2 = s0 + maj;
+
+        h = g;
+        g = f;
+        f = e;
+        e = d + t1;
+        d = c;
+        c = b;
+        b = a;
+        a = t1 + t2;
+      }
+
+      state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+      state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+    }
+  }
+
+  /*!
+   * \brief Pad the remainder of a message with 0x80, zeros and the bit length
+   *
+   * \return The size of the padded remainder, 64 or 128 bytes
+   */
+  size_t PadTail(const uint8_t* bytes, size_t size, uint8_t tail[128])
+  {
+    const size_t remainder = size % 64;
+    std::memset(tail, 0, 128);
+    if (remainder > 0)
+      std::memcpy(tail, bytes + (size - remainder), remainder);
+    tail[remainder] = 0x80;
+
+    const size_t tailSize = (remainder < 56) ? 64 : 128;
+    const uint64_t bitLength = static_cast<uint64_t>(size) * 8;
+    for (unsigned int i = 0; i < 8; i++)
+      tail[tailSize - 1 - i] = static_cast<uint8_t>(bitLength >> (8 * i));
+
+    return tailSize;
+  }
+
+  void StoreDigest(const uint32_t state[8], uint8_t digest[SHA256_DIGEST_SIZE])
+  {
+    for (unsigned int i = 0; i < 8; i++)
+    {
+      digest[i * 4]     = static_cast<uint8_t>(state[i] >> 24);
+      digest[i * 4 + 1] = static_cast<uint8_t>(state[i] >> 16);
+      digest[i * 4 + 2] = static_cast<uint8_t>(state[i] >> 8);
+      digest[i * 4 + 3] = static_cast<uint8_t>(state[i]);
+    }
+  }
+
+  std::string MakeMultihash(const uint8_t digest[SHA256_DIGEST_SIZE])
+  {
+    std::string multihash;
+    multihash.reserve(2 + SHA256_DIGEST_SIZE);
+    multihash.push_back(static_cast<char>(MULTIHASH_SHA2_256));
+    multihash.push_back(static_cast<char>(SHA256_DIGEST_SIZE));
+    multihash.append(reinterpret_cast<const char*>(digest), SHA256_DIGEST_SIZE);
+
+    return multihash;
+  }
+
+#if defined(HAVE_SHA256_X86)
+  const unsigned int SHA256_LANES = 8;
+
+  /*!
+   * \brief Transform with the SHA extensions, four rounds per step
+   *
+   * The state is kept as ABEF and CDGH, the order sha256rnds2 expects.
+   */
+  __attribute__((target("sha,sse4.1")))
+  void Sha256TransformShaNi(uint32_t state[8], const uint8_t* blocks, size_t blockCount)
+  {
+    const __m128i byteSwap = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+
+    __m128i dcba = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&state[0]));
+    __m128i hgfe = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&state[4]));
+    __m128i cdab = _mm_shuffle_epi32(dcba, 0xb1);
+    __m128i efgh = _mm_shuffle_epi32(hgfe, 0x1b);
+    __m128i abef = _mm_alignr_epi8(cdab, efgh, 8);
+    __m128i cdgh = _mm_blend_epi16(efgh, cdab, 0xf0);
+
+    for (; blockCount > 0; blockCount--, blocks += 64)
+    {
+      const __m128i abefSaved = abef;
+      const __m128i cdghSaved = cdgh;
+
+      __m128i w[4];
+      for (unsigned int i = 0; i < 4; i++)
+        w[i] = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(blocks + i * 16)), byteSwap);
+
+      for (unsigned int i = 0; i < 16; i++)
+      {
+        __m128i message = _mm_add_epi32(w[i % 4], _mm_loadu_si128(reinterpret_cast<const __m128i*>(&SHA256_K[i * 4])));
+        cdgh = _mm_sha256rnds2_epu32(cdgh, abef, message);
+        message = _mm_shuffle_epi32(message, 0x0e);
+        abef = _mm_sha256rnds2_epu32(abef, cdgh, message);
+
+        // Schedule the words of step i + 4 into the slot just used
+        if (i < 12)
+        {
+          __m128i next = _mm_sha256msg1_epu32(w[i % 4], w[(i + 1) % 4]);
+          next = _mm_add_epi32(next, _mm_alignr_epi8(w[(i + 3) % 4], w[(i + 2) % 4], 4));
+          w[i % 4] = _mm_sha256msg2_epu32(next, w[(i + 3) % 4]);
+        }
+      }
+
+      abef = _mm_add_epi32(abef, abefSaved);
+      cdgh = _mm_add_epi32(cdgh, cdghSaved);
+    }
+
+    __m128i feba = _mm_shuffle_epi32(abef, 0x1b);
+    __m128i dchg = _mm_shuffle_epi32(cdgh, 0xb1);
+    dcba = _mm_blend_epi16(feba, dchg, 0xf0);
+    hgfe = _mm_alignr_epi8(dchg, feba, 8);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(&state[0]), dcba);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(&state[4]), hgfe);
+  }
+
+  __attribute__((target("avx2")))
+  inline __m256i RotateRight8(__m256i x, int n)
+  {
+    return _mm256_or_si256(_mm256_srli_epi32(x, n), _mm256_slli_epi32(x, 32 - n));
+  }
+
+  __attribute__((target("avx2")))
+  inline __m256i LoadWord8(const uint8_t* const blocks[SHA256_LANES], unsigned int offset)
+  {
+    uint32_t words[SHA256_LANES];
+    for (unsigned int lane = 0; lane < SHA256_LANES; lane++)
+    {
+      uint32_t word;
+      std::memcpy(&word, blocks[lane] + offset, sizeof(word));
+      words[lane] = __builtin_bswap32(word);
+    }
+    return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(words));
+  }
+
+  /*!
+   * \brief Hash eight messages of <size> bytes, one per 32-bit lane
+   */
+  __attribute__((target("avx2")))
+  void Sha256Lanes(const uint8_t* const messages[SHA256_LANES], size_t size, uint8_t digests[SHA256_LANES][SHA256_DIGEST_SIZE])
+  {
+    __m256i state[8];
+    for (unsigned int i = 0; i < 8; i++)
+      state[i] = _mm256_set1_epi32(static_cast<int>(SHA256_H[i]));
+
+    uint8_t tails[SHA256_LANES][128];
+    size_t tailSize = 0;
+    for (unsigned int lane = 0; lane < SHA256_LANES; lane++)
+      tailSize = PadTail(messages[lane], size, tails[lane]);
+
+    const size_t fullBlocks = size / 64;
+    const size_t blockCount = fullBlocks + tailSize / 64;
+
+    for (size_t block = 0; block < blockCount; block++)
+    {
+      const uint8_t* blocks[SHA256_LANES];
+      for (unsigned int lane = 0; lane < SHA256_LANES; lane++)
+      {
+        blocks[lane] = (block < fullBlocks) ? messages[lane] + block * 64 :
+                                              tails[lane] + (block - fullBlocks) * 64;
+      }
+
+      __m256i w[64];
+      for (unsigned int i = 0; i < 16; i++)
+        w[i] = LoadWord8(blocks, i * 4);
+      for (unsigned int i = 16; i < 64; i++)
+      {
+        __m256i s0 = _mm256_xor_si256(_mm256_xor_si256(RotateRight8(w[i - 15], 7), RotateRight8(w[i - 15], 18)), _mm256_srli_epi32(w[i - 15], 3));
+        __m256i s1 = _mm256_xor_si256(_mm256_xor_si256(RotateRight8(w[i - 2], 17), RotateRight8(w[i - 2], 19)), _mm256_srli_epi32(w[i - 2], 10));
+        w[i] = _mm256_add_epi32(_mm256_add_epi32(w[i - 16], s0), _mm256_add_epi32(w[i - 7], s1));
+      }
+
+      __m256i a = state[0], b = state[1], c = state[2], d = state[3];
+      __m256i e = state[4], f = state[5], g = state[6], h = state[7];
+
+      for (unsigned int i = 0; i < 64; i++)
+      {
+        __m256i s1 = _mm256_xor_si256(_mm256_xor_si256(RotateRight8(e, 6), RotateRight8(e, 11)), RotateRight8(e, 25));
+        __m256i ch = _mm256_xor_si256(_mm256_and_si256(e, f), _mm256_andnot_si256(e, g));
+        __m256i t1 = _mm256_add_epi32(_mm256_add_epi32(h, s1),
+                                      _mm256_add_epi32(_mm256_add_epi32(ch, _mm256_set1_epi32(static_cast<int>(SHA256_K[i]))), w[i]));
+        __m256i s0 = _mm256_xor_si256(_mm256_xor_si256(RotateRight8(a, 2), RotateRight8(a, 13)), RotateRight8(a, 22));
+        __m256i maj = _mm256_xor_si256(_mm256_xor_si256(_mm256_and_si256(a, b), _mm256_and_si256(a, c)), _mm256_and_si256(b, c));
+        __m256i t2 = _mm256_add_epi32(s0, maj);
+
+        h = g;
+        g = f;
+        f = e;
+        e = _mm256_add_epi32(d, t1);
+        d = c;
+        c = b;
+        b = a;
+        a = _mm256_add_epi32(t1, t2);
+      }
+
+      state[0] = _mm256_add_epi32(state[0], a); state[1] = _mm256_add_epi32(state[1], b);
+      state[2] = _mm256_add_epi32(state[2], c); state[3] = _mm256_add_epi32(state[3], d);
+      state[4] = _mm256_add_epi32(state[4], e); state[5] = _mm256_add_epi32(state[5], f);
+      state[6] = _mm256_add_epi32(state[6], g); state[7] = _mm256_add_epi32(state[7], h);
+    }
+
+    uint32_t words[8][SHA256_LANES];
+    for (unsigned int i = 0; i < 8; i++)
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(words[i]), state[i]);
+
+    for (unsigned int lane = 0; lane < SHA256_LANES; lane++)
+    {
+      uint32_t laneState[8];
+      for (unsigned int i = 0; i < 8; i++)
+        laneState[i] = words[i][lane];
+      StoreDigest(laneState, digests[lane]);
+    }
+  }
+#endif
+
+  bool HasKernel(Sha256Kernel kernel)
+  {
+    if (kernel == Sha256Scalar)
+      return true;
+
+#if defined(HAVE_SHA256_X86)
+    unsigned int eax, ebx, ecx, edx;
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+      return false;
+
+    const bool bSse41 = (ecx & bit_SSE4_1) != 0;
+    const bool bOsAvx = (ecx & bit_OSXSAVE) != 0 && (ecx & bit_AVX) != 0;
+
+    if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx))
+      return false;
+
+    // Leaf 7 isn't named the same by every <cpuid.h>
+    const unsigned int CPUID_AVX2 = 1u << 5;
+    const unsigned int CPUID_SHA = 1u << 29;
+
+    if (kernel == Sha256ShaNi)
+      return (ebx & CPUID_SHA) != 0 && bSse41;
+
+    if (kernel == Sha256Avx2 && (ebx & CPUID_AVX2) != 0 && bOsAvx)
+    {
+      // The OS must save the YMM registers
+      unsigned int xcr0Low, xcr0High;
+      __asm__("xgetbv" : "=a"(xcr0Low), "=d"(xcr0High) : "c"(0));
+      return (xcr0Low & 0x6) == 0x6;
+    }
+#endif
+
+    return false;
+  }
+
+  Sha256Kernel DetectKernel(void)
+  {
+    if (HasKernel(Sha256ShaNi))
+      return Sha256ShaNi;
+    if (HasKernel(Sha256Avx2))
+      return Sha256Avx2;
+    return Sha256Scalar;
+  }
+
+  std::atomic<int> g_kernel(-1);
+}
+
+Sha256Kernel IPSF::GetSha256Kernel(void)
+{
+  int kernel = g_kernel.load();
+  if (kernel < 0)
+  {
+    kernel = DetectKernel();
+    g_kernel.store(kernel);
+  }
+  return static_cast<Sha256Kernel>(kernel);
+}
+
+bool IPSF::SetSha256Kernel(Sha256Kernel kernel)
+{
+  if (!HasKernel(kernel))
+    return false;
+
+  g_kernel.store(kernel);
+  return true;
+}
+
+void IPSF::Sha256(const void* data, size_t size, uint8_t digest[SHA256_DIGEST_SIZE])
+{
+  uint32_t state[8];
+  std::memcpy(state, SHA256_H, sizeof(state));
+
+  const uint8_t* bytes = static_cast<const uint8_t*>(data);
+  const size_t fullBlocks = size / 64;
+
+  uint8_t tail[128];
+  const size_t tailSize = PadTail(bytes, size, tail);
+
+#if defined(HAVE_SHA256_X86)
+  if (GetSha256Kernel() == Sha256ShaNi)
+  {
+    Sha256TransformShaNi(state, bytes, fullBlocks);
+    Sha256TransformShaNi(state, tail, tailSize / 64);
+  }
+  else
+#endif
+  {
+    Sha256Transform(state, bytes, fullBlocks);
+    Sha256Transform(state, tail, tailSize / 64);
+  }
+
+  StoreDigest(state, digest);
+}
+
+std::string IPSF::Multihash(const void* data, size_t size)
+{
+  uint8_t digest[SHA256_DIGEST_SIZE];
+  Sha256(data, size, digest);
+
+  return MakeMultihash(digest);
+}
+
+void IPSF::MultihashMany(const std::vector<std::string>& blocks, std::vector<std::string>& multihashes)
+{
+  multihashes.resize(blocks.size());
+
+  size_t i = 0;
+#if defined(HAVE_SHA256_X86)
+  if (GetSha256Kernel() == Sha256Avx2)
+  {
+    while (i < blocks.size())
+    {
+      // Take a run of up to eight blocks of the same size
+      size_t count = 1;
+      while (count < SHA256_LANES && i + count < blocks.size() &&
+             blocks[i + count].size() == blocks[i].size())
+        count++;
+
+      if (count == 1)
+      {
+        multihashes[i] = Multihash(blocks[i].data(), blocks[i].size());
+        i++;
+        continue;
+      }
+
+      // Unused lanes hash the first block again
+      const uint8_t* lanes[SHA256_LANES];
+      for (unsigned int lane = 0; lane < SHA256_LANES; lane++)
+        lanes[lane] = reinterpret_cast<const uint8_t*>(blocks[lane < count ? i + lane : i].data());
+
+      uint8_t digests[SHA256_LANES][SHA256_DIGEST_SIZE];
+      Sha256Lanes(lanes, blocks[i].size(), digests);
+
+      for (size_t lane = 0; lane < count; lane++)
+        multihashes[i + lane] = MakeMultihash(digests[lane]);
+      i += count;
+    }
+  }
+#endif
+
+  for (; i < blocks.size(); i++)
+    multihashes[i] = Multihash(blocks[i].data(), blocks[i].size());
+}
+
+std::string IPSF::EncodeBase58(const std::string& data)
+{
+  // Leading zero bytes are encoded as '1'
+  size_t zeros = 0;
+  while (zeros < data.size() && data[zeros] == '\0')
+    zeros++;
+
+  // Repeated division of the big-endian number by 58
+  std::vector<uint8_t> digits((data.size() - zeros) * 138 / 100 + 1, 0);
+  size_t length = 0;
+
+  for (size_t i = zeros; i < data.size(); i++)
+  {
+    unsigned int carry = static_cast<uint8_t>(data[i]);
+    size_t j = 0;
+    for (std::vector<uint8_t>::reverse_iterator it = digits.rbegin(); (carry != 0 || j < length) && it != digits.rend(); ++it, ++j)
+    {
+      carry += 256 * (*it);
+      *it = static_cast<uint8_t>(carry % 58);
+      carry /= 58;
+    }
+    length = j;
+  }
+
+  std::vector<uint8_t>::const_iterator it = digits.begin() + (digits.size() - length);
+  while (it != digits.end() && *it == 0)
+    ++it;
+
+  std::string str(zeros, '1');
+  for (; it != digits.end(); ++it)
+    str.push_back(BASE58_ALPHABET[*it]);
+
+  return str;
+}
+
+bool IPSF::DecodeBase58(const std::string& str, std::string& data)
+{
+  size_t ones = 0;
+  while (ones < str.size() && str[ones] == '1')
+    ones++;
+
+  std::vector<uint8_t> bytes((str.size() - ones) * 733 / 1000 + 1, 0);
+  size_t length = 0;
+
+  for (size_t i = ones; i < str.size(); i++)
+  {
+    const char* digit = std::strchr(BASE58_ALPHABET, str[i]);
+    if (digit == NULL || *digit == '\0')
+      return false;
+
+    unsigned int carry = static_cast<unsigned int>(digit - BASE58_ALPHABET);
+    size_t j = 0;
+    for (std::vector<uint8_t>::reverse_iterator it = bytes.rbegin(); (carry != 0 || j < length) && it != bytes.rend(); ++it, ++j)
+    {
+      carry += 58 * (*it);
+      *it = static_cast<uint8_t>(carry % 256);
+      carry /= 256;
+    }
+    length = j;
+  }
+
+  std::vector<uint8_t>::const_iterator it = bytes.begin() + (bytes.size() - length);
+  while (it != bytes.end() && *it == 0)
+    ++it;
+
+  data.assign(ones, '\0');
+  data.append(it, std::vector<uint8_t>::const_iterator(bytes.end()));
+
+  return true;
+}
+
+std::string IPSF::EncodeBase32(const std::string& data)
+{
+  std::string str;
+  str.reserve((data.size() * 8 + 4) / 5);
+
+  unsigned int buffer = 0;
+  unsigned int bits = 0;
+  for (std::string::const_iterator it = data.begin(); it != data.end(); ++it)
+  {
+    buffer = (buffer << 8) | static_cast<uint8_t>(*it);
+    bits += 8;
+    while (bits >= 5)
+    {
+      bits -= 5;
+      str.push_back(BASE32_ALPHABET[(buffer >> bits) & 0x1f]);
+    }
+  }
+
+  if (bits > 0)
+    str.push_back(BASE32_ALPHABET[(buffer << (5 - bits)) & 0x1f]);
+
+  return str;
+}
+
+bool IPSF::DecodeBase32(const std::string& str, std::string& data)
+{
+  data.clear();
+  data.reserve(str.size() * 5 / 8);
+
+  unsigned int buffer = 0;
+  unsigned int bits = 0;
+  for (std::string::const_iterator it = str.begin(); it != str.end(); ++it)
+  {
+    const char* digit = std::strchr(BASE32_ALPHABET, *it);
+    if (digit == NULL || *digit == '\0')
+      return false;
+
+    buffer = (buffer << 5) | static_cast<unsigned int>(digit - BASE32_ALPHABET);
+    bits += 5;
+    if (bits >= 8)
+    {
+      bits -= 8;
+      data.push_back(static_cast<char>((buffer >> bits) & 0xff));
+    }
+  }
+
+  // Leftover bits are padding and must be zero
+  return (buffer & ((1u << bits) - 1)) == 0;
+}
+
+bool IPSF::DecodeKey(const std::string& key, std::string& multihash)
+{
+  return DecodeBase58(key, multihash) &&
+         multihash.size() == 2 + SHA256_DIGEST_SIZE &&
+         static_cast<uint8_t>(multihash[0]) == MULTIHASH_SHA2_256 &&
+         static_cast<uint8_t>(multihash[1]) == SHA256_DIGEST_SIZE;
+}
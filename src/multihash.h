@@ -0,0 +1,109 @@
+/*
+ *    Copyright (C) 2015 juztamau5
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *    The above copyright notice and this permission notice shall be included in
+ *    all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+#ifndef __IPSF_MULTIHASH_H__
+#define __IPSF_MULTIHASH_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace IPSF
+{
+  const unsigned int SHA256_DIGEST_SIZE = 32;
+
+  /*!
+   * \brief SHA-256 implementations
+   *
+   * The fastest one the CPU supports is used unless another is chosen.
+   */
+  enum Sha256Kernel
+  {
+    Sha256Scalar,
+    Sha256Avx2,  // Eight equal-sized messages side by side, scalar otherwise
+    Sha256ShaNi, // x86 SHA extensions
+  };
+
+  Sha256Kernel GetSha256Kernel(void);
+
+  /*!
+   * \brief Choose the SHA-256 implementation, e.g. to compare them
+   *
+   * \return false if the CPU doesn't support <kernel>
+   */
+  bool SetSha256Kernel(Sha256Kernel kernel);
+
+  /*!
+   * \brief Compute the SHA-256 digest of <size> bytes at <data>
+   */
+  void Sha256(const void* data, size_t size, uint8_t digest[SHA256_DIGEST_SIZE]);
+
+  /*!
+   * \brief Compute the sha2-256 multihash (0x12 0x20 <digest>) of a block
+   *
+   * \return The binary multihash, which is the block's key
+   */
+  std::string Multihash(const void* data, size_t size);
+
+  /*!
+   * \brief Compute the multihashes of several blocks
+   *
+   * Blocks of the same size, like the leaves of a file, are hashed side by
+   * side if the AVX2 kernel is used.
+   */
+  void MultihashMany(const std::vector<std::string>& blocks, std::vector<std::string>& multihashes);
+
+  /*!
+   * \brief Encode binary data with the Bitcoin base58 alphabet used for keys
+   */
+  std::string EncodeBase58(const std::string& data);
+
+  /*!
+   * \brief Decode a base58 string
+   *
+   * \return false if <str> contains characters outside the alphabet
+   */
+  bool DecodeBase58(const std::string& str, std::string& data);
+
+  /*!
+   * \brief Encode binary data as unpadded upper-case RFC 4648 base32, the
+   *        encoding go-ipfs uses for block file names
+   */
+  std::string EncodeBase32(const std::string& data);
+
+  /*!
+   * \brief Decode unpadded upper-case base32
+   *
+   * \return false if <str> isn't valid base32
+   */
+  bool DecodeBase32(const std::string& str, std::string& data);
+
+  /*!
+   * \brief Get the binary multihash of a base58 key
+   *
+   * \return false if <key> isn't a sha2-256 multihash
+   */
+  bool DecodeKey(const std::string& key, std::string& multihash);
+}
+
+#endif // __IPSF_MULTIHASH_H__
@@ -0,0 +1,426 @@
+/*
+ *    Copyright (C) 2015 juztamau5
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *    The above copyright notice and this permission notice shall be included in
+ *    all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include "namecache.h"
+#include "api.h"
+#include "config.h"
+#include "invoke.h"
+#include "json.h"
+#include "node.h"
+#include "stringutils.h"
+
+#include <algorithm>
+
+using namespace IPSF;
+
+namespace
+{
+  // go-ipfs's default record TTL
+  const unsigned int DEFAULT_TTL_MS = 60 * 1000;
+  const unsigned int DEFAULT_MAX_ENTRIES = 4096;
+
+  // How long a failed resolution is remembered, and how long a failed
+  // refresh waits before the next try
+  const unsigned int NEGATIVE_TTL_MS = 5 * 1000;
+
+  // A caller waits longer than a background refresh
+  const unsigned int RESOLVE_TIMEOUT_MS = 60 * 1000;
+  const unsigned int REFRESH_TIMEOUT_MS = 10 * 1000;
+
+  const unsigned int REFRESH_THREADS = 4;
+
+  const char* const IPNS_PREFIX = "/ipns/";
+
+  std::string GetCacheName(const std::string& name)
+  {
+    const size_t prefixLength = std::string(IPNS_PREFIX).size();
+    if (name.compare(0, prefixLength, IPNS_PREFIX) == 0)
+      return name.substr(prefixLength);
+    return name;
+  }
+
+  // Nodes may see different values of a name, so entries are kept per repo.
+  // Paths can't contain NUL, which separates the two.
+  std::string GetCacheKey(const std::string& repoPath, const std::string& name)
+  {
+    return repoPath + '\0' + GetCacheName(name);
+  }
+
+  std::string GetKeyRepo(const std::string& key)
+  {
+    return key.substr(0, key.find('\0'));
+  }
+
+  std::string GetKeyName(const std::string& key)
+  {
+    return key.substr(key.find('\0') + 1);
+  }
+}
+
+CNameCache::CNameCache(void) :
+  m_nextEpoch(0),
+  m_ttlMs(DEFAULT_TTL_MS),
+  m_maxEntries(DEFAULT_MAX_ENTRIES),
+  m_stats(),
+  m_bStopping(false)
+{
+}
+
+CNameCache::~CNameCache(void)
+{
+  // Nodes stop their refreshes when they close, and the cache outlives them,
+  // so only idle refreshers are left
+  {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_bStopping = true;
+    m_refreshQueue.clear();
+  }
+  m_refreshReady.notify_all();
+
+  for (std::vector<std::thread>::iterator it = m_refreshers.begin(); it != m_refreshers.end(); ++it)
+    it->join();
+}
+
+void CNameCache::Configure(unsigned int ttlMs, unsigned int maxEntries)
+{
+  std::unique_lock<std::mutex> lock(m_mutex);
+
+  m_ttlMs = ttlMs;
+  m_maxEntries = std::max(maxEntries, 1u);
+
+  if (m_ttlMs == 0)
+    m_entries.clear();
+  else
+    Evict();
+}
+
+bool CNameCache::Resolve(const std::string& name, std::string& path)
+{
+  const std::string key = GetCacheKey(GetRepoPath(), name);
+
+  std::unique_lock<std::mutex> lock(m_mutex);
+
+  if (m_ttlMs == 0)
+  {
+    m_stats.misses++;
+    lock.unlock();
+
+    const bool bResolved = ResolveName(GetCacheName(name), RESOLVE_TIMEOUT_MS, path);
+    if (!bResolved)
+    {
+      lock.lock();
+      m_stats.failures++;
+    }
+    return bResolved;
+  }
+
+  bool bCounted = false;
+
+  while (true)
+  {
+    const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    const std::chrono::milliseconds ttl(m_ttlMs);
+
+    EntryMap::iterator it = m_entries.find(key);
+    if (it == m_entries.end())
+    {
+      Entry entry;
+      entry.bValid = false;
+      entry.bResolving = false;
+      entry.epoch = m_nextEpoch++;
+      it = m_entries.insert(std::make_pair(key, entry)).first;
+    }
+
+    Entry& entry = it->second;
+    entry.lastUsed = now;
+
+    if (entry.bValid && now < entry.expires)
+    {
+      if (!bCounted)
+        m_stats.hits++;
+
+      // Keep names in use from expiring
+      if (!entry.path.empty() && now >= entry.expires - ttl / 4)
+        QueueRefresh(key, entry);
+
+      path = entry.path;
+      return !path.empty();
+    }
+
+    if (entry.bValid && !entry.path.empty() && now < entry.expires + ttl)
+    {
+      if (!bCounted)
+        m_stats.staleHits++;
+
+      QueueRefresh(key, entry);
+
+      path = entry.path;
+      return true;
+    }
+
+    if (!bCounted)
+    {
+      m_stats.misses++;
+      bCounted = true;
+
+      if (entry.bResolving)
+        m_stats.coalesced++;
+    }
+
+    if (entry.bResolving)
+    {
+      // Wait for the running resolution, then look again. The entry may have
+      // been invalidated meanwhile.
+      const uint64_t epoch = entry.epoch;
+      m_resolved.wait(lock, [this, &key, epoch]()
+      {
+        EntryMap::const_iterator waited = m_entries.find(key);
+        return waited == m_entries.end() || waited->second.epoch != epoch || !waited->second.bResolving;
+      });
+      continue;
+    }
+
+    entry.bResolving = true;
+    const uint64_t epoch = entry.epoch;
+
+    Evict();
+    lock.unlock();
+
+    std::string resolved;
+    const bool bResolved = ResolveName(GetKeyName(key), RESOLVE_TIMEOUT_MS, resolved);
+
+    lock.lock();
+    Store(key, epoch, bResolved, resolved, false);
+
+    path = resolved;
+    return bResolved;
+  }
+}
+
+void CNameCache::QueueRefresh(const std::string& key, Entry& entry)
+{
+  if (entry.bResolving || std::chrono::steady_clock::now() < entry.retryAfter)
+    return;
+
+  entry.bResolving = true;
+  m_stats.refreshes++;
+
+  Refresh refresh;
+  refresh.key = key;
+  refresh.epoch = entry.epoch;
+  refresh.repoPath = GetKeyRepo(key);
+  refresh.threadRepo = GetThreadRepo();
+  m_refreshQueue.push_back(refresh);
+
+  while (m_refreshers.size() < REFRESH_THREADS)
+    m_refreshers.push_back(std::thread(&CNameCache::ProcessRefreshes, this));
+
+  m_refreshReady.notify_one();
+}
+
+void CNameCache::ProcessRefreshes(void)
+{
+  std::unique_lock<std::mutex> lock(m_mutex);
+
+  while (true)
+  {
+    m_refreshReady.wait(lock, [this]() { return m_bStopping || !m_refreshQueue.empty(); });
+    if (m_bStopping)
+      break;
+
+    const Refresh refresh = m_refreshQueue.front();
+    m_refreshQueue.pop_front();
+
+    // Closing the node waits for this
+    m_activeRefreshes[refresh.repoPath]++;
+
+    lock.unlock();
+
+    SelectThreadRepo(refresh.threadRepo);
+
+    std::string path;
+    const bool bResolved = ResolveName(GetKeyName(refresh.key), REFRESH_TIMEOUT_MS, path);
+
+    lock.lock();
+
+    RepoCounts::iterator active = m_activeRefreshes.find(refresh.repoPath);
+    if (--active->second == 0)
+      m_activeRefreshes.erase(active);
+
+    Store(refresh.key, refresh.epoch, bResolved, path, true);
+  }
+}
+
+void CNameCache::Store(const std::string& key, uint64_t epoch, bool bResolved, const std::string& path, bool bRefresh)
+{
+  if (!bResolved)
+    m_stats.failures++;
+
+  // Results for names invalidated while they were resolved are dropped
+  EntryMap::iterator it = m_entries.find(key);
+  if (it != m_entries.end() && it->second.epoch == epoch)
+  {
+    Entry& entry = it->second;
+    const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+
+    entry.bResolving = false;
+
+    if (bResolved)
+    {
+      entry.path = path;
+      entry.bValid = true;
+      entry.expires = now + std::chrono::milliseconds(m_ttlMs);
+    }
+    else if (bRefresh)
+    {
+      // Keep answering with the old value until it's too stale
+      entry.retryAfter = now + std::chrono::milliseconds(NEGATIVE_TTL_MS);
+    }
+    else
+    {
+      entry.path.clear();
+      entry.bValid = true;
+      entry.expires = now + std::chrono::milliseconds(NEGATIVE_TTL_MS);
+    }
+  }
+
+  m_resolved.notify_all();
+}
+
+void CNameCache::Evict(void)
+{
+  if (m_entries.size() <= m_maxEntries)
+    return;
+
+  // Drop the least recently used tenth at once, so the scan isn't repeated
+  // for every new name
+  std::vector<std::pair<std::chrono::steady_clock::time_point, std::string>> idle;
+  for (EntryMap::const_iterator it = m_entries.begin(); it != m_entries.end(); ++it)
+  {
+    if (!it->second.bResolving)
+      idle.push_back(std::make_pair(it->second.lastUsed, it->first));
+  }
+
+  const size_t target = m_maxEntries - m_maxEntries / 10;
+  size_t count = std::min(idle.size(), m_entries.size() - std::min<size_t>(m_entries.size(), target));
+
+  std::nth_element(idle.begin(), idle.begin() + count, idle.end());
+  for (size_t i = 0; i < count; i++)
+    m_entries.erase(idle[i].second);
+}
+
+void CNameCache::Invalidate(const std::string& name)
+{
+  std::unique_lock<std::mutex> lock(m_mutex);
+
+  // A new value reaches the nodes of all repos
+  const std::string cacheName = GetCacheName(name);
+  for (EntryMap::iterator it = m_entries.begin(); it != m_entries.end(); )
+  {
+    if (GetKeyName(it->first) == cacheName)
+      it = m_entries.erase(it);
+    else
+      ++it;
+  }
+
+  m_resolved.notify_all();
+}
+
+void CNameCache::Clear(void)
+{
+  std::unique_lock<std::mutex> lock(m_mutex);
+
+  m_entries.clear();
+  m_resolved.notify_all();
+}
+
+void CNameCache::CloseRepo(const std::string& repoPath)
+{
+  std::unique_lock<std::mutex> lock(m_mutex);
+
+  for (std::deque<Refresh>::iterator it = m_refreshQueue.begin(); it != m_refreshQueue.end(); )
+  {
+    if (it->repoPath == repoPath)
+      it = m_refreshQueue.erase(it);
+    else
+      ++it;
+  }
+
+  m_resolved.wait(lock, [this, &repoPath]()
+  {
+    return m_activeRefreshes.find(repoPath) == m_activeRefreshes.end();
+  });
+
+  for (EntryMap::iterator it = m_entries.begin(); it != m_entries.end(); )
+  {
+    if (GetKeyRepo(it->first) == repoPath)
+      it = m_entries.erase(it);
+    else
+      ++it;
+  }
+
+  m_resolved.notify_all();
+}
+
+void CNameCache::GetStats(NameCacheStats& stats)
+{
+  std::unique_lock<std::mutex> lock(m_mutex);
+
+  stats = m_stats;
+  stats.entries = static_cast<unsigned int>(m_entries.size());
+}
+
+CNameCache& IPSF::GetNameCache(void)
+{
+  static CNameCache cache;
+  return cache;
+}
+
+bool IPSF::ResolveName(const std::string& name, unsigned int timeoutMs, std::string& path)
+{
+  GetNode().EnsureOnline();
+
+  ApiEndpoint endpoint;
+  if (GetDaemonEndpoint(GetRepoPath(), endpoint))
+  {
+    CApiRequest request("name/resolve");
+    request.AddArgument(name);
+    request.SetTimeout(timeoutMs);
+
+    std::string body;
+    CJsonValue response;
+    if (!request.Execute(endpoint, body) || !CJsonValue::Parse(body, response))
+      return false;
+
+    const CJsonValue* value = response.Find("Path");
+    path = value ? value->AsString() : "";
+    return !path.empty();
+  }
+
+  std::string output;
+  if (!invoke("ipfs name resolve " + name, output))
+    return false;
+
+  path = StringUtils::LastLine(output);
+  return !path.empty() && path[0] == '/';
+}
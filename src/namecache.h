@@ -0,0 +1,151 @@
+/*
+ *    Copyright (C) 2015 juztamau5
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *    The above copyright notice and this permission notice shall be included in
+ *    all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+#ifndef __IPSF_NAMECACHE_H__
+#define __IPSF_NAMECACHE_H__
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <stdint.h>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace IPSF
+{
+  struct NameCacheStats
+  {
+    uint64_t     hits;      // Answered from a fresh entry
+    uint64_t     staleHits; // Answered from an expired entry being refreshed
+    uint64_t     misses;    // Waited for a resolution
+    uint64_t     coalesced; // Misses that joined a resolution already running
+    uint64_t     refreshes; // Background refreshes started
+    uint64_t     failures;  // Resolutions that failed
+    unsigned int entries;
+  };
+
+  /*!
+   * \brief Cache of IPNS resolutions
+   *
+   * Entries are fresh for the TTL. Entries used in the last quarter of their
+   * TTL are refreshed in the background, so names in steady use never expire.
+   * Expired entries are still answered for one more TTL while a refresh runs.
+   * Concurrent lookups of a name that isn't cached share one resolution, and
+   * failures are remembered for a few seconds.
+   *
+   * go-ipfs doesn't report the TTL of the records it resolves, so one TTL
+   * applies to all names. The cache is shared by all nodes in the process,
+   * with separate entries per repo, and refreshes run on the node whose
+   * lookup started them.
+   */
+  class CNameCache
+  {
+  public:
+    CNameCache(void);
+    ~CNameCache(void);
+
+    /*!
+     * \brief Set the TTL of entries, 0 disables the cache, and the number of
+     *        names to keep
+     */
+    void Configure(unsigned int ttlMs, unsigned int maxEntries);
+
+    bool Resolve(const std::string& name, std::string& path);
+
+    /*!
+     * \brief Forget a name, e.g. after publishing a new value for it
+     */
+    void Invalidate(const std::string& name);
+    void Clear(void);
+
+    /*!
+     * \brief Stop refreshing the names of a repo and drop them
+     *
+     * Called when its node closes. Waits for refreshes already running,
+     * which end within their timeout.
+     */
+    void CloseRepo(const std::string& repoPath);
+
+    void GetStats(NameCacheStats& stats);
+
+  private:
+    struct Entry
+    {
+      std::string                           path; // Empty if resolution failed
+      bool                                  bValid;
+      bool                                  bResolving;
+      uint64_t                              epoch;
+      std::chrono::steady_clock::time_point expires;
+      std::chrono::steady_clock::time_point retryAfter;
+      std::chrono::steady_clock::time_point lastUsed;
+    };
+
+    typedef std::unordered_map<std::string, Entry> EntryMap;
+
+    typedef std::unordered_map<std::string, unsigned int> RepoCounts;
+
+    struct Refresh
+    {
+      std::string key;
+      uint64_t    epoch;
+      std::string repoPath;   // Repo of the entry
+      std::string threadRepo; // Repo chosen by the thread whose lookup queued it
+    };
+
+    void QueueRefresh(const std::string& key, Entry& entry);
+    void ProcessRefreshes(void);
+    void Store(const std::string& key, uint64_t epoch, bool bResolved, const std::string& path, bool bRefresh);
+    void Evict(void);
+
+    EntryMap                 m_entries;
+    RepoCounts               m_activeRefreshes;
+    uint64_t                 m_nextEpoch;
+    std::deque<Refresh>      m_refreshQueue;
+    std::vector<std::thread> m_refreshers;
+    unsigned int             m_ttlMs;
+    unsigned int             m_maxEntries;
+    NameCacheStats           m_stats;
+    bool                     m_bStopping;
+    std::mutex               m_mutex;
+    std::condition_variable  m_resolved;
+    std::condition_variable  m_refreshReady;
+  };
+
+  /*!
+   * \brief Get the cache used by all library calls
+   */
+  CNameCache& GetNameCache(void);
+
+  /*!
+   * \brief Resolve an IPNS name without the cache
+   *
+   * Goes through the daemon's API when one serves the repo, so lookups don't
+   * queue behind other commands, and through go-ipfs otherwise.
+   */
+  bool ResolveName(const std::string& name, unsigned int timeoutMs, std::string& path);
+}
+
+#endif // __IPSF_NAMECACHE_H__
@@ -0,0 +1,886 @@
+/*
+ *    Copyright (C) 2015 juztamau5
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *    The above copyright notice and this permission notice shall be included in
+ *    all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include "node.h"
+#include "api.h"
+#include "config.h"
+#include "invoke.h"
+#include "json.h"
+#include "merkledag.h"
+#include "multihash.h"
+#include "namecache.h"
+#include "scheduler.h"
+#include "stringutils.h"
+#include "threadpool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <unordered_set>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace IPSF;
+
+namespace
+{
+  // Time the daemon gets to open the repo and start its API
+  const unsigned int DAEMON_START_TIMEOUT_MS = 60 * 1000;
+  const unsigned int DAEMON_POLL_MS = 50;
+  const unsigned int DAEMON_REQUEST_TIMEOUT_MS = 5 * 1000;
+
+  // Time the daemon gets to close the repo once it accepted a shutdown
+  const unsigned int DAEMON_STOP_TIMEOUT_MS = 10 * 1000;
+
+  // How stale the block filter may get while a daemon writes to the repo
+  const unsigned int BLOCK_FILTER_REFRESH_MS = 1000;
+
+  // How long a replaced block pack may still be served
+  const unsigned int BLOCK_PACK_CHECK_MS = 1000;
+
+  const char* const BLOCK_PACK_FILE = "libipfs-blocks.pack";
+
+  // Blocks read or uploaded per task
+  const size_t BLOCK_CHUNK_SIZE = 64;
+
+  // Nodes other than the default one, by repo
+  std::mutex                    g_nodesMutex;
+  std::map<std::string, CNode*> g_nodes;
+
+  // go-ipfs keeps the state of its commands in globals, so the process can
+  // only run one daemon. Set until it returns, even after its node let go,
+  // as it still holds the lock of its repo until then.
+  bool                          g_bDaemonRunning = false;
+
+  bool IsDaemonReady(const std::string& repoPath)
+  {
+    ApiEndpoint endpoint;
+    if (!GetDaemonEndpoint(repoPath, endpoint))
+      return false;
+
+    CApiRequest request("id");
+    request.SetTimeout(DAEMON_REQUEST_TIMEOUT_MS);
+
+    std::string response;
+    return request.Execute(endpoint, response);
+  }
+}
+
+/*!
+ * \brief Whether the daemon thread has returned
+ *
+ * Shared with the thread, which may outlive the node.
+ */
+struct CNode::DaemonState
+{
+  DaemonState(void) : bExited(false) { }
+
+  std::mutex              mutex;
+  std::condition_variable exited;
+  bool                    bExited;
+
+  bool HasExited(void)
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    return bExited;
+  }
+};
+
+CNode::CNode(bool bDefault) :
+  m_bDefault(bDefault),
+  m_bLocal(false),
+  m_bBlockstoreOpen(false),
+  m_invokeGeneration(0),
+  m_bDaemonOwnsRepo(false),
+  m_bRefreshPending(false),
+  m_bStopRefresher(false),
+  m_packInode(0),
+  m_packMtime(0)
+{
+  // Refreshes of the name cache run on nodes, so the cache has to outlive
+  // the static default node
+  GetNameCache();
+}
+
+bool CNode::Open(const std::string& repoPath, bool bLocal)
+{
+  Close();
+
+  std::unique_lock<std::mutex> lock(m_mutex);
+
+  if (m_bDefault)
+  {
+    SelectRepo(repoPath);
+    m_repoPath = GetRepoPath();
+  }
+  else
+  {
+    // Two nodes on one repo would fight over its lock
+    std::unique_lock<std::mutex> nodesLock(g_nodesMutex);
+    if (repoPath.empty() || !g_nodes.insert(std::make_pair(repoPath, this)).second)
+      return false;
+
+    m_repoPath = repoPath;
+  }
+
+  if (bLocal)
+  {
+    if (!m_blockstore.Open(m_repoPath))
+    {
+      Release();
+      return false;
+    }
+
+    ApiEndpoint endpoint;
+    m_bDaemonOwnsRepo = GetDaemonEndpoint(m_repoPath, endpoint);
+    m_blockstore.SetConfirmMisses(m_bDaemonOwnsRepo);
+
+    m_blockstoreRepo = m_repoPath;
+    m_bBlockstoreOpen = true;
+    m_invokeGeneration = GetInvokeGeneration();
+    m_lastRefresh = std::chrono::steady_clock::now();
+  }
+
+  m_bLocal = bLocal;
+  return true;
+}
+
+void CNode::Close(void)
+{
+  // Refreshes may be waiting for the node, so they're stopped before it's
+  // locked. Before it's opened, the default node serves $IPFS_PATH.
+  std::string repoPath = GetRepo();
+  if (repoPath.empty() && m_bDefault)
+    repoPath = GetRepoPath();
+  if (!repoPath.empty())
+    GetNameCache().CloseRepo(repoPath);
+
+  std::unique_lock<std::mutex> startLock(m_startMutex);
+  std::unique_lock<std::mutex> lock(m_mutex);
+
+  StopRefresher(lock);
+  StopDaemon();
+
+  if (m_bBlockstoreOpen)
+  {
+    m_blockstore.Close();
+    m_bBlockstoreOpen = false;
+  }
+
+  if (!m_repoPath.empty())
+    Release();
+
+  m_bLocal = false;
+}
+
+void CNode::Release(void)
+{
+  if (m_bDefault)
+  {
+    SelectRepo("");
+  }
+  else
+  {
+    std::unique_lock<std::mutex> nodesLock(g_nodesMutex);
+    g_nodes.erase(m_repoPath);
+  }
+
+  m_repoPath.clear();
+}
+
+std::string CNode::GetActiveRepo(void) const
+{
+  return m_repoPath.empty() ? GetRepoPath() : m_repoPath;
+}
+
+std::string CNode::GetRepo(void)
+{
+  std::unique_lock<std::mutex> lock(m_mutex);
+  return m_repoPath;
+}
+
+bool CNode::SetPorts(unsigned short swarmPort, unsigned short apiPort, unsigned short gatewayPort)
+{
+  CConfig config;
+  if (!config.Load(GetRepo()))
+    return false;
+
+  // The addresses go-ipfs uses by default, on other ports
+  bool bOk = true;
+  if (swarmPort != 0)
+  {
+    CJsonValue addresses;
+    addresses.SetArray();
+    CJsonValue address;
+    address.SetString("/ip4/0.0.0.0/tcp/" + std::to_string(swarmPort));
+    addresses.Append(address);
+    address.SetString("/ip6/::/tcp/" + std::to_string(swarmPort));
+    addresses.Append(address);
+    bOk = config.Set("Addresses.Swarm", addresses) && bOk;
+  }
+  if (apiPort != 0)
+  {
+    CJsonValue address;
+    address.SetString("/ip4/127.0.0.1/tcp/" + std::to_string(apiPort));
+    bOk = config.Set("Addresses.API", address) && bOk;
+  }
+  if (gatewayPort != 0)
+  {
+    CJsonValue address;
+    address.SetString("/ip4/127.0.0.1/tcp/" + std::to_string(gatewayPort));
+    bOk = config.Set("Addresses.Gateway", address) && bOk;
+  }
+
+  return bOk && config.Commit(false);
+}
+
+void CNode::StopDaemon(void)
+{
+  if (!m_daemon.joinable())
+    return;
+
+  bool bStopping = false;
+
+  ApiEndpoint endpoint;
+  if (!m_daemonState->HasExited() && GetDaemonEndpoint(m_repoPath, endpoint))
+  {
+    CApiRequest request("shutdown");
+    request.SetTimeout(DAEMON_REQUEST_TIMEOUT_MS);
+
+    std::string response;
+    bStopping = request.Execute(endpoint, response);
+  }
+
+  std::shared_ptr<DaemonState> state = m_daemonState;
+  m_daemonState.reset();
+
+  {
+    std::unique_lock<std::mutex> lock(state->mutex);
+    if (bStopping)
+      state->exited.wait_for(lock, std::chrono::milliseconds(DAEMON_STOP_TIMEOUT_MS), [&state]() { return state->bExited; });
+
+    // go-ipfs versions without a shutdown command, like the one the library
+    // is built with, keep the daemon running until the process exits. The
+    // thread doesn't use the node, so it's left to finish on its own.
+    if (!state->bExited)
+    {
+      m_daemon.detach();
+      return;
+    }
+  }
+
+  m_daemon.join();
+}
+
+CBlockstore* CNode::GetLocalBlockstore(void)
+{
+  std::unique_lock<std::mutex> lock(m_mutex);
+
+  if (!m_bLocal || m_daemon.joinable())
+    return NULL;
+
+  // Someone else may have started a daemon on the repo
+  ApiEndpoint endpoint;
+  if (GetDaemonEndpoint(m_repoPath, endpoint))
+    return NULL;
+
+  return &m_blockstore;
+}
+
+CBlockstore* CNode::GetBlockstore(void)
+{
+  std::unique_lock<std::mutex> lock(m_mutex);
+
+  const std::string repoPath = GetActiveRepo();
+  if (!m_bBlockstoreOpen || m_blockstoreRepo != repoPath)
+  {
+    // The refresher works on the open blockstore
+    StopRefresher(lock);
+
+    if (m_bBlockstoreOpen)
+      m_blockstore.Close();
+
+    m_bBlockstoreOpen = m_blockstore.Open(repoPath);
+    if (!m_bBlockstoreOpen)
+      return NULL;
+
+    ApiEndpoint endpoint;
+    m_bDaemonOwnsRepo = GetDaemonEndpoint(repoPath, endpoint);
+    m_blockstore.SetConfirmMisses(m_bDaemonOwnsRepo);
+
+    m_blockstoreRepo = repoPath;
+    m_invokeGeneration = GetInvokeGeneration();
+    m_lastRefresh = std::chrono::steady_clock::now();
+    return &m_blockstore;
+  }
+
+  bool bRefresh = false;
+
+  const unsigned int generation = GetInvokeGeneration();
+  const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+  if (generation != m_invokeGeneration)
+  {
+    m_invokeGeneration = generation;
+    bRefresh = true;
+  }
+
+  if (now - m_lastRefresh >= std::chrono::milliseconds(BLOCK_FILTER_REFRESH_MS))
+  {
+    m_lastRefresh = now;
+
+    // Catch up on what a daemon wrote once it's gone
+    ApiEndpoint endpoint;
+    const bool bDaemon = GetDaemonEndpoint(repoPath, endpoint);
+    if (bDaemon != m_bDaemonOwnsRepo)
+    {
+      m_bDaemonOwnsRepo = bDaemon;
+      bRefresh = true;
+    }
+  }
+
+  if (bRefresh)
+    ScheduleRefresh();
+
+  return &m_blockstore;
+}
+
+void CNode::ScheduleRefresh(void)
+{
+  m_blockstore.SetConfirmMisses(true);
+  m_bRefreshPending = true;
+
+  if (m_refresher.joinable())
+    m_refreshCondition.notify_one();
+  else
+    m_refresher = std::thread(&CNode::RunRefresher, this);
+}
+
+void CNode::StopRefresher(std::unique_lock<std::mutex>& lock)
+{
+  while (m_refresher.joinable())
+  {
+    std::thread refresher;
+    refresher.swap(m_refresher);
+
+    m_bStopRefresher = true;
+    m_refreshCondition.notify_one();
+
+    lock.unlock();
+    refresher.join();
+    lock.lock();
+
+    m_bStopRefresher = false;
+  }
+
+  m_bRefreshPending = false;
+}
+
+void CNode::RunRefresher(void)
+{
+  // Scans of the block directories give way to the reads they catch up with
+  SetThreadPriority(PriorityBulk);
+
+  std::unique_lock<std::mutex> lock(m_mutex);
+
+  while (!m_bStopRefresher)
+  {
+    if (!m_bRefreshPending)
+    {
+      m_refreshCondition.wait(lock);
+      continue;
+    }
+
+    m_bRefreshPending = false;
+    lock.unlock();
+
+    m_blockstore.RefreshFilter(false);
+
+    lock.lock();
+
+    // Misses can be trusted again unless more was written meanwhile
+    if (!m_bRefreshPending && !m_bDaemonOwnsRepo)
+      m_blockstore.SetConfirmMisses(false);
+  }
+}
+
+void CNode::RebuildBlockFilter(void)
+{
+  std::unique_lock<std::mutex> lock(m_mutex);
+
+  if (!m_bBlockstoreOpen)
+    return;
+
+  m_invokeGeneration = GetInvokeGeneration();
+  m_lastRefresh = std::chrono::steady_clock::now();
+  lock.unlock();
+
+  m_blockstore.RefreshFilter(true);
+}
+
+std::shared_ptr<CBlockPack> CNode::GetBlockPack(void)
+{
+  std::unique_lock<std::mutex> lock(m_mutex);
+
+  const std::string repoPath = GetActiveRepo();
+  const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+  if (repoPath == m_packRepo && now - m_lastPackCheck < std::chrono::milliseconds(BLOCK_PACK_CHECK_MS))
+    return m_pack;
+
+  m_lastPackCheck = now;
+
+  const std::string path = repoPath + "/" + BLOCK_PACK_FILE;
+
+  struct stat st;
+  if (stat(path.c_str(), &st) != 0)
+  {
+    m_pack.reset();
+  }
+  else if (!m_pack || repoPath != m_packRepo ||
+           static_cast<uint64_t>(st.st_ino) != m_packInode || static_cast<int64_t>(st.st_mtime) != m_packMtime)
+  {
+    // Packs are replaced by rename, so a new inode is a new pack
+    std::shared_ptr<CBlockPack> pack = std::make_shared<CBlockPack>();
+    if (pack->Open(path))
+      m_pack = pack;
+    else
+      m_pack.reset();
+
+    m_packInode = static_cast<uint64_t>(st.st_ino);
+    m_packMtime = static_cast<int64_t>(st.st_mtime);
+  }
+
+  m_packRepo = repoPath;
+  return m_pack;
+}
+
+bool CNode::PackBlocks(const std::vector<std::string>& roots, uint64_t& blockCount)
+{
+  blockCount = 0;
+
+  CBlockstore* blockstore = GetBlockstore();
+  if (!blockstore || roots.empty())
+    return false;
+
+  std::string repoPath;
+  {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    repoPath = GetActiveRepo();
+  }
+
+  CBlockPackWriter writer;
+  if (!writer.Open(repoPath + "/" + BLOCK_PACK_FILE))
+    return false;
+
+  // Depth first with children in link order, so files are laid out the way
+  // they're read
+  std::vector<std::string> pending(roots.rbegin(), roots.rend());
+  std::unordered_set<std::string> packed;
+
+  while (!pending.empty())
+  {
+    const std::string multihash = pending.back();
+    pending.pop_back();
+
+    if (!packed.insert(multihash).second)
+      continue;
+
+    std::string block;
+    if (!blockstore->Get(multihash, block) || !writer.Add(multihash, block))
+      return false;
+
+    // Leaves that aren't DAG nodes have no links
+    std::vector<DagLink> links;
+    std::string data;
+    if (DecodeDagNode(block, links, data))
+    {
+      for (std::vector<DagLink>::const_reverse_iterator it = links.rbegin(); it != links.rend(); ++it)
+        pending.push_back(it->hash);
+    }
+  }
+
+  if (!writer.Commit())
+    return false;
+
+  blockCount = writer.BlockCount();
+
+  // Serve the new pack right away
+  std::unique_lock<std::mutex> lock(m_mutex);
+  m_packRepo.clear();
+  return true;
+}
+
+bool CNode::EnsureOnline(void)
+{
+  {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if (!m_bLocal)
+      return true;
+  }
+
+  return Start();
+}
+
+bool CNode::Start(void)
+{
+  // Concurrent callers wait for the same daemon
+  std::unique_lock<std::mutex> startLock(m_startMutex);
+
+  std::string repoPath;
+  std::shared_ptr<DaemonState> state;
+  {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if (m_repoPath.empty())
+      return false;
+
+    repoPath = m_repoPath;
+
+    // Try again if an earlier daemon failed to start or has quit
+    if (m_daemon.joinable() && m_daemonState->HasExited())
+    {
+      m_daemon.join();
+      m_daemonState.reset();
+    }
+
+    if (!m_daemon.joinable() && !IsDaemonReady(repoPath))
+    {
+      {
+        std::unique_lock<std::mutex> nodesLock(g_nodesMutex);
+        if (g_bDaemonRunning)
+          return false;
+        g_bDaemonRunning = true;
+      }
+
+      // The default node's repo is chosen for the whole process
+      const std::string threadRepo = m_bDefault ? std::string() : repoPath;
+
+      std::shared_ptr<DaemonState> state = std::make_shared<DaemonState>();
+      m_daemonState = state;
+      m_daemon = std::thread([state, threadRepo]()
+      {
+        SelectThreadRepo(threadRepo);
+        invokeService("ipfs daemon");
+
+        {
+          std::unique_lock<std::mutex> nodesLock(g_nodesMutex);
+          g_bDaemonRunning = false;
+        }
+
+        std::unique_lock<std::mutex> lock(state->mutex);
+        state->bExited = true;
+        state->exited.notify_all();
+      });
+    }
+
+    state = m_daemonState;
+  }
+
+  const std::chrono::steady_clock::time_point deadline =
+    std::chrono::steady_clock::now() + std::chrono::milliseconds(DAEMON_START_TIMEOUT_MS);
+
+  while (!state || !state->HasExited())
+  {
+    if (IsDaemonReady(repoPath))
+      return true;
+
+    if (std::chrono::steady_clock::now() >= deadline)
+      break;
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(DAEMON_POLL_MS));
+  }
+
+  return false;
+}
+
+CNode& IPSF::GetDefaultNode(void)
+{
+  static CNode node(true);
+  return node;
+}
+
+CNode& IPSF::GetNode(void)
+{
+  const std::string& repoPath = GetThreadRepo();
+  if (!repoPath.empty())
+  {
+    std::unique_lock<std::mutex> lock(g_nodesMutex);
+
+    std::map<std::string, CNode*>::const_iterator it = g_nodes.find(repoPath);
+    if (it != g_nodes.end())
+      return *it->second;
+  }
+
+  return GetDefaultNode();
+}
+
+bool IPSF::GetBlock(const std::string& multihash, std::string& block)
+{
+  CBlockstore* blockstore = GetNode().GetLocalBlockstore();
+  if (blockstore)
+  {
+    if (blockstore->Get(multihash, block))
+      return true;
+
+    // Blocks that aren't in the repo come from the network
+    if (!GetNode().EnsureOnline())
+      return false;
+  }
+
+  // Blocks may be empty, so failures are told by what go-ipfs writes to stderr
+  bool bError;
+  return invoke("ipfs block get " + EncodeBase58(multihash), block, bError) && !bError;
+}
+
+bool IPSF::GetBlock(const std::string& multihash, const BlockAllocator& allocate)
+{
+  CBlockstore* blockstore = GetNode().GetLocalBlockstore();
+  if (blockstore)
+  {
+    if (blockstore->Get(multihash, allocate))
+      return true;
+
+    // A block that's in the repo but can't be read isn't fetched instead
+    uint64_t size;
+    if (blockstore->GetSize(multihash, size) || !GetNode().EnsureOnline())
+      return false;
+  }
+
+  std::string block;
+  if (!GetBlock(multihash, block))
+    return false;
+
+  // Nothing is allocated for empty blocks
+  if (block.empty())
+    return true;
+
+  char* buffer = allocate(block.size());
+  if (!buffer)
+    return false;
+
+  block.copy(buffer, block.size());
+  return true;
+}
+
+bool IPSF::GetBlocks(std::vector<std::pair<std::string, std::string>>& blocks)
+{
+  CBlockstore* blockstore = GetNode().GetBlockstore();
+
+  ApiEndpoint endpoint;
+  const bool bDaemon = GetDaemonEndpoint(GetRepoPath(), endpoint);
+
+  std::atomic<bool> bOk(true);
+  {
+    CTaskGroup tasks(GetWorkerPool());
+
+    for (size_t begin = 0; begin < blocks.size(); begin += BLOCK_CHUNK_SIZE)
+    {
+      const size_t end = std::min(begin + BLOCK_CHUNK_SIZE, blocks.size());
+
+      tasks.Run([&blocks, blockstore, bDaemon, &endpoint, &bOk, begin, end]()
+      {
+        for (size_t i = begin; i < end && bOk; i++)
+        {
+          if (blockstore && blockstore->Get(blocks[i].first, blocks[i].second))
+            continue;
+
+          CApiRequest request("block/get");
+          request.AddArgument(EncodeBase58(blocks[i].first));
+          if (!bDaemon || !request.Execute(endpoint, blocks[i].second) ||
+              Multihash(blocks[i].second.data(), blocks[i].second.size()) != blocks[i].first)
+            bOk = false;
+        }
+      });
+    }
+  }
+
+  return bOk;
+}
+
+bool IPSF::MapBlock(const std::string& multihash, BlockRef& ref)
+{
+  CNode& node = GetNode();
+
+  std::shared_ptr<CBlockPack> pack = node.GetBlockPack();
+  if (pack && pack->Find(multihash, ref.data, ref.size))
+  {
+    ref.mapping = pack;
+    return true;
+  }
+
+  // Blockstore files are read instead, as holding a mapping per block would
+  // soon exceed the process's limit on mappings
+  CBlockstore* blockstore = node.GetBlockstore();
+  if (!blockstore)
+    return false;
+
+  std::shared_ptr<std::string> block = std::make_shared<std::string>();
+  if (!blockstore->Get(multihash, *block))
+    return false;
+
+  ref.data = block->data();
+  ref.size = block->size();
+  ref.mapping = block;
+  return true;
+}
+
+bool IPSF::MapFile(const std::string& ipfsPath, std::vector<BlockRef>& pieces)
+{
+  pieces.clear();
+
+  std::vector<std::string> names;
+  for (size_t pos = 0; pos <= ipfsPath.size(); )
+  {
+    size_t end = ipfsPath.find('/', pos);
+    if (end == std::string::npos)
+      end = ipfsPath.size();
+    if (end > pos)
+      names.push_back(ipfsPath.substr(pos, end - pos));
+    pos = end + 1;
+  }
+
+  // Only immutable paths can be walked locally
+  if (!ipfsPath.empty() && ipfsPath[0] == '/')
+  {
+    if (names.empty() || names[0] != "ipfs")
+      return false;
+    names.erase(names.begin());
+  }
+
+  std::string multihash;
+  if (names.empty() || !DecodeKey(names[0], multihash))
+    return false;
+
+  for (size_t i = 1; i < names.size(); i++)
+  {
+    BlockRef ref;
+    std::vector<DagLink> links;
+    std::string data;
+    if (!MapBlock(multihash, ref) || !DecodeDagNode(std::string(ref.data, ref.size), links, data))
+      return false;
+
+    std::vector<DagLink>::const_iterator it = links.begin();
+    while (it != links.end() && it->name != names[i])
+      ++it;
+    if (it == links.end())
+      return false;
+
+    multihash = it->hash;
+  }
+
+  // Each node's own contents come before its children's
+  std::vector<std::string> pending(1, multihash);
+  while (!pending.empty())
+  {
+    BlockRef ref;
+    if (!MapBlock(pending.back(), ref))
+      return false;
+    pending.pop_back();
+
+    std::vector<std::string> children;
+    size_t offset;
+    size_t size;
+    if (!DecodeUnixfsFile(ref.data, ref.size, children, offset, size))
+      return false;
+
+    if (size > 0)
+    {
+      ref.data += offset;
+      ref.size = size;
+      pieces.push_back(ref);
+    }
+
+    pending.insert(pending.end(), children.rbegin(), children.rend());
+  }
+
+  return true;
+}
+
+bool IPSF::PutBlock(const std::string& block, std::string& multihash)
+{
+  CBlockstore* blockstore = GetNode().GetLocalBlockstore();
+  if (blockstore)
+    return blockstore->Put(block, multihash);
+
+  // go-ipfs reads blocks from files
+  char tmpPath[] = "/tmp/libipfs-block-XXXXXX";
+  int fd = mkstemp(tmpPath);
+  if (fd < 0)
+    return false;
+
+  bool bOk = write(fd, block.data(), block.size()) == static_cast<ssize_t>(block.size());
+  bOk = (close(fd) == 0) && bOk;
+
+  std::string output;
+  bOk = bOk && invoke(std::string("ipfs block put ") + tmpPath, output);
+  std::remove(tmpPath);
+
+  return bOk && DecodeKey(StringUtils::LastLine(output), multihash);
+}
+
+bool IPSF::PutBlocks(const std::vector<std::pair<std::string, std::string>>& blocks)
+{
+  CBlockstore* blockstore = GetNode().GetLocalBlockstore();
+  if (blockstore)
+    return blockstore->PutMany(blocks);
+
+  ApiEndpoint endpoint;
+  if (!GetDaemonEndpoint(GetRepoPath(), endpoint))
+  {
+    blockstore = GetNode().GetBlockstore();
+    return blockstore != NULL && blockstore->PutMany(blocks);
+  }
+
+  // Requests don't share state, so several upload at a time
+  std::atomic<bool> bOk(true);
+  {
+    CTaskGroup tasks(GetWorkerPool());
+
+    for (size_t begin = 0; begin < blocks.size(); begin += BLOCK_CHUNK_SIZE)
+    {
+      const size_t end = std::min(begin + BLOCK_CHUNK_SIZE, blocks.size());
+
+      tasks.Run([&blocks, &endpoint, &bOk, begin, end]()
+      {
+        for (size_t i = begin; i < end && bOk; i++)
+        {
+          CApiRequest request("block/put");
+          request.AddFile(blocks[i].second);
+
+          std::string body;
+          CJsonValue response;
+          std::string multihash;
+          if (!request.Execute(endpoint, body) ||
+              !CJsonValue::Parse(body, response) ||
+              !DecodeKey(response["Key"].AsString(), multihash) ||
+              multihash != blocks[i].first)
+            bOk = false;
+        }
+      });
+    }
+  }
+
+  return bOk;
+}
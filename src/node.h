@@ -0,0 +1,258 @@
+/*
+ *    Copyright (C) 2015 juztamau5
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *    The above copyright notice and this permission notice shall be included in
+ *    all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+#ifndef __IPSF_NODE_H__
+#define __IPSF_NODE_H__
+
+#include "blockpack.h"
+#include "blockstore.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace IPSF
+{
+  /*!
+   * \brief A repo the library works on and how its services are started
+   *
+   * In local mode, block and object commands are served straight from the
+   * repo's blockstore. The daemon, which brings up the swarm, the DHT and the
+   * bootstrap connections, is only started the first time a command needs the
+   * network.
+   *
+   * The process can host more nodes next to the default one, each with its
+   * own repo. A thread works on the node whose repo it chose with
+   * SelectThreadRepo(), and on the default node otherwise. All nodes share
+   * the Go runtime and the worker pool. Only one of them can start a daemon
+   * in the process, the others use a daemon started elsewhere on their repo.
+   */
+  class CNode
+  {
+  public:
+    /*!
+     * \param bDefault The default node chooses the repo of the whole process.
+     *                 Other nodes are found by their repo.
+     */
+    explicit CNode(bool bDefault);
+    ~CNode(void) { Close(); }
+
+    bool Open(const std::string& repoPath, bool bLocal);
+    void Close(void);
+
+    std::string GetRepo(void);
+
+    /*!
+     * \brief Set the ports of the swarm, the API and the gateway in the
+     *        repo's config, so daemons on one host don't collide
+     *
+     * 0 leaves a port unchanged. Takes effect when the daemon starts.
+     */
+    bool SetPorts(unsigned short swarmPort, unsigned short apiPort, unsigned short gatewayPort);
+
+    /*!
+     * \brief Start the daemon in any mode and wait for its API
+     *
+     * \return false if another node of the process runs a daemon, as
+     *         go-ipfs can only run one per process
+     */
+    bool Start(void);
+
+    /*!
+     * \brief Get the blockstore for commands that can skip go-ipfs
+     *
+     * \return NULL unless the node is in local mode and no daemon is serving
+     *         the repo. Writing behind a daemon's back would leave its caches
+     *         stale.
+     */
+    CBlockstore* GetLocalBlockstore(void);
+
+    /*!
+     * \brief Get the blockstore for lookups, in any mode
+     *
+     * The blockstore is opened on first use. After commands ran in this
+     * process, its presence filter is brought up to date on a background
+     * thread, and misses are confirmed on disk until that's done. While a
+     * daemon serves the repo, which is checked at most once a second, misses
+     * are always confirmed, as the daemon may have just written the block.
+     *
+     * \return NULL if the repo has no flatfs blockstore
+     */
+    CBlockstore* GetBlockstore(void);
+
+    /*!
+     * \brief Drop removed blocks from the presence filter after a garbage
+     *        collection
+     */
+    void RebuildBlockFilter(void);
+
+    /*!
+     * \brief Get the repo's block pack, if it has one
+     *
+     * The pack is reopened when it's replaced, which is noticed at most a
+     * second later. Mappings handed out stay valid until they're released.
+     */
+    std::shared_ptr<CBlockPack> GetBlockPack(void);
+
+    /*!
+     * \brief Write the blocks of the DAGs under <roots> to the repo's block
+     *        pack, replacing it
+     *
+     * Blocks are packed in the order cat reads them, depth first. Blocks
+     * stay in the blockstore, the pack is a read-only copy that takes their
+     * disk space a second time.
+     *
+     * \return false if a block isn't in the blockstore
+     */
+    bool PackBlocks(const std::vector<std::string>& roots, uint64_t& blockCount);
+
+    /*!
+     * \brief Make sure the network is up before a command needs it
+     *
+     * In local mode this starts the daemon on first use and waits for its
+     * API. Otherwise go-ipfs starts what each command needs by itself.
+     */
+    bool EnsureOnline(void);
+
+  private:
+    struct DaemonState;
+
+    /*!
+     * \brief Ask the daemon to shut down and wait a while for it to exit
+     *
+     * A daemon that doesn't exit keeps running, and keeps the repo locked,
+     * after the node is gone.
+     */
+    void StopDaemon(void);
+
+    // Called with m_mutex held
+    void ScheduleRefresh(void);
+    void StopRefresher(std::unique_lock<std::mutex>& lock);
+    void RunRefresher(void);
+
+    void Release(void);
+    std::string GetActiveRepo(void) const;
+
+    const bool                            m_bDefault;
+    std::mutex                            m_mutex;
+    std::mutex                            m_startMutex;
+    std::string                           m_repoPath;
+    bool                                  m_bLocal;
+    CBlockstore                           m_blockstore;
+    std::string                           m_blockstoreRepo;
+    bool                                  m_bBlockstoreOpen;
+    unsigned int                          m_invokeGeneration;
+    std::chrono::steady_clock::time_point m_lastRefresh;
+    bool                                  m_bDaemonOwnsRepo;
+    std::thread                           m_refresher;
+    std::condition_variable               m_refreshCondition;
+    bool                                  m_bRefreshPending;
+    bool                                  m_bStopRefresher;
+    std::shared_ptr<CBlockPack>           m_pack;
+    std::string                           m_packRepo;
+    uint64_t                              m_packInode;
+    int64_t                               m_packMtime;
+    std::chrono::steady_clock::time_point m_lastPackCheck;
+    std::thread                           m_daemon;
+    std::shared_ptr<DaemonState>          m_daemonState;
+  };
+
+  /*!
+   * \brief Get the node that ipfs_open() opens
+   */
+  CNode& GetDefaultNode(void);
+
+  /*!
+   * \brief Get the node the calling thread works on
+   */
+  CNode& GetNode(void);
+
+  /*!
+   * \brief Read a block from the local blockstore in local mode, and through
+   *        go-ipfs otherwise
+   */
+  bool GetBlock(const std::string& multihash, std::string& block);
+
+  /*!
+   * \brief Read a block into memory from <allocate>
+   *
+   * Blocks in the local blockstore are read straight into the memory.
+   */
+  bool GetBlock(const std::string& multihash, const BlockAllocator& allocate);
+
+  /*!
+   * \brief Read many blocks at once, in parallel
+   *
+   * Blocks are read from the repo's blockstore in any mode, as reading can't
+   * disturb a daemon. Blocks it doesn't have are fetched through the API of
+   * the daemon serving the repo. Without a daemon they aren't fetched from
+   * the network, and the read fails.
+   *
+   * \param blocks (multihash, block) pairs whose blocks are filled in
+   */
+  bool GetBlocks(std::vector<std::pair<std::string, std::string>>& blocks);
+
+  /*!
+   * \brief Store a block in the local blockstore in local mode, and through
+   *        go-ipfs otherwise
+   */
+  bool PutBlock(const std::string& block, std::string& multihash);
+
+  /*!
+   * \brief Store many blocks whose keys are already known
+   *
+   * Blocks go to the local blockstore in local mode, to the daemon's API
+   * while a daemon serves the repo, and straight to the repo's blockstore
+   * otherwise, as no go-ipfs process caches it then.
+   *
+   * \param blocks (multihash, block) pairs
+   *
+   * \return false if a block couldn't be stored or its key doesn't match
+   */
+  bool PutBlocks(const std::vector<std::pair<std::string, std::string>>& blocks);
+
+  /*!
+   * \brief Borrow a block from the repo's block pack, or read it from the
+   *        blockstore into memory the reference owns
+   *
+   * \return false if the block isn't stored locally
+   */
+  bool MapBlock(const std::string& multihash, BlockRef& ref);
+
+  /*!
+   * \brief Borrow the contents of a unixfs file as the pieces held by its
+   *        blocks, in order
+   *
+   * \param ipfsPath /ipfs/<key>[/<name>...] or <key>[/<name>...]
+   *
+   * \return false if the path isn't a file, or a block on the way isn't
+   *         stored locally
+   */
+  bool MapFile(const std::string& ipfsPath, std::vector<BlockRef>& pieces);
+}
+
+#endif // __IPSF_NODE_H__
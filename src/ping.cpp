@@ -0,0 +1,237 @@
+/*
+ *    Copyright (C) 2015 juztamau5
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *    The above copyright notice and this permission notice shall be included in
+ *    all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include "ping.h"
+#include "api.h"
+#include "config.h"
+#include "json.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <unordered_map>
+
+using namespace IPSF;
+
+namespace
+{
+  const double       DEFAULT_ALPHA       = 0.2;
+  const unsigned int MAX_MONITOR_THREADS = 16;
+
+  struct LatencyEntry
+  {
+    double       ewma;
+    unsigned int samples;
+  };
+
+  std::mutex                                    g_tableMutex;
+  std::unordered_map<std::string, LatencyEntry> g_table;
+  double                                        g_alpha = DEFAULT_ALPHA;
+
+  /*!
+   * \brief Background thread pinging a set of peers once per interval
+   */
+  class CPingMonitor
+  {
+  public:
+    CPingMonitor(const std::vector<std::string>& peerIds, unsigned int intervalMs) :
+      m_peerIds(peerIds),
+      m_intervalMs(intervalMs > 0 ? intervalMs : 1000),
+      m_repoPath(GetThreadRepo()),
+      m_bStopping(false)
+    {
+      m_thread = std::thread(&CPingMonitor::Process, this);
+    }
+
+    ~CPingMonitor(void)
+    {
+      {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_bStopping = true;
+      }
+      m_stop.notify_all();
+      m_thread.join();
+    }
+
+  private:
+    void Process(void)
+    {
+      SelectThreadRepo(m_repoPath);
+
+      while (true)
+      {
+        std::chrono::steady_clock::time_point roundEnd = std::chrono::steady_clock::now() + std::chrono::milliseconds(m_intervalMs);
+
+        PingAll();
+
+        std::unique_lock<std::mutex> lock(m_mutex);
+        if (m_stop.wait_until(lock, roundEnd, [this]() { return m_bStopping.load(); }))
+          break;
+      }
+    }
+
+    void PingAll(void)
+    {
+      std::atomic<size_t> next(0);
+
+      auto ping = [this, &next]()
+      {
+        SelectThreadRepo(m_repoPath);
+
+        size_t i;
+        while ((i = next++) < m_peerIds.size() && !m_bStopping)
+        {
+          std::vector<uint64_t> rtts;
+          unsigned int sent;
+          Ping(m_peerIds[i], 1, m_intervalMs, rtts, sent);
+        }
+      };
+
+      const size_t threadCount = std::min<size_t>(m_peerIds.size(), MAX_MONITOR_THREADS);
+
+      std::vector<std::thread> threads;
+      for (size_t i = 1; i < threadCount; i++)
+        threads.push_back(std::thread(ping));
+
+      ping();
+
+      for (std::vector<std::thread>::iterator it = threads.begin(); it != threads.end(); ++it)
+        it->join();
+    }
+
+    const std::vector<std::string> m_peerIds;
+    const unsigned int             m_intervalMs;
+    const std::string              m_repoPath; // Node of the thread that started the monitor
+    std::atomic<bool>              m_bStopping;
+    std::mutex                     m_mutex;
+    std::condition_variable        m_stop;
+    std::thread                    m_thread;
+  };
+
+  std::mutex                    g_monitorMutex;
+  std::unique_ptr<CPingMonitor> g_monitor;
+}
+
+bool IPSF::Ping(const std::string& peerId, unsigned int count, unsigned int timeoutMs, std::vector<uint64_t>& rtts, unsigned int& sent)
+{
+  rtts.clear();
+  sent = 0;
+
+  ApiEndpoint endpoint;
+  if (peerId.empty() || !GetApiEndpoint(endpoint))
+    return false;
+
+  CApiRequest request("ping");
+  request.AddArgument(peerId);
+  request.SetTimeout(timeoutMs);
+
+  std::stringstream countStr;
+  countStr << (count > 0 ? count : DEFAULT_PING_COUNT);
+  request.AddOption("count", countStr.str());
+
+  bool bOk = request.Execute(endpoint, [&rtts, &sent, &peerId](const std::string& line)
+  {
+    // {"Success":true,"Time":<ns>,"Text":""} per answered probe. Messages
+    // carry text, failed probes report "Ping error: ..."
+    CJsonValue result;
+    if (!CJsonValue::Parse(line, result))
+      return true;
+
+    const std::string& text = result["Text"].AsString();
+
+    if (result["Success"].AsBool() && text.empty())
+    {
+      const uint64_t rtt = static_cast<uint64_t>(result["Time"].AsInteger());
+      rtts.push_back(rtt);
+      sent++;
+      LatencyTable::AddSample(peerId, rtt);
+    }
+    else if (text.compare(0, 10, "Ping error") == 0)
+    {
+      sent++;
+    }
+
+    return true;
+  });
+
+  return bOk || sent > 0;
+}
+
+void LatencyTable::SetAlpha(double alpha)
+{
+  std::unique_lock<std::mutex> lock(g_tableMutex);
+  g_alpha = (0.0 < alpha && alpha <= 1.0) ? alpha : DEFAULT_ALPHA;
+}
+
+void LatencyTable::AddSample(const std::string& peerId, uint64_t rttNs)
+{
+  std::unique_lock<std::mutex> lock(g_tableMutex);
+
+  std::unordered_map<std::string, LatencyEntry>::iterator it = g_table.find(peerId);
+  if (it == g_table.end())
+  {
+    LatencyEntry entry = { static_cast<double>(rttNs), 1 };
+    g_table[peerId] = entry;
+  }
+  else
+  {
+    it->second.ewma += g_alpha * (static_cast<double>(rttNs) - it->second.ewma);
+    it->second.samples++;
+  }
+}
+
+bool LatencyTable::GetLatency(const std::string& peerId, uint64_t& ewmaNs, unsigned int& samples)
+{
+  std::unique_lock<std::mutex> lock(g_tableMutex);
+
+  std::unordered_map<std::string, LatencyEntry>::const_iterator it = g_table.find(peerId);
+  if (it == g_table.end())
+    return false;
+
+  ewmaNs = static_cast<uint64_t>(it->second.ewma);
+  samples = it->second.samples;
+  return true;
+}
+
+bool LatencyTable::StartMonitor(const std::vector<std::string>& peerIds, unsigned int intervalMs)
+{
+  std::unique_lock<std::mutex> lock(g_monitorMutex);
+
+  g_monitor.reset();
+  if (peerIds.empty())
+    return false;
+
+  g_monitor.reset(new CPingMonitor(peerIds, intervalMs));
+  return true;
+}
+
+void LatencyTable::StopMonitor(void)
+{
+  std::unique_lock<std::mutex> lock(g_monitorMutex);
+  g_monitor.reset();
+}
@@ -0,0 +1,75 @@
+/*
+ *    Copyright (C) 2015 juztamau5
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *    The above copyright notice and this permission notice shall be included in
+ *    all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+#ifndef __IPSF_PING_H__
+#define __IPSF_PING_H__
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace IPSF
+{
+  // Probes sent when no count is given, as by `ipfs ping`
+  const unsigned int DEFAULT_PING_COUNT = 10;
+
+  /*!
+   * \brief Send <count> pings to <peerId> through the daemon
+   *
+   * \param count The number of probes, or 0 for DEFAULT_PING_COUNT
+   *
+   * \param timeoutMs Give up after this long, or 0 to wait for all probes
+   * \param rtts Receives the round-trip time of each answered probe (ns)
+   * \param sent Receives the number of probes sent
+   *
+   * Every sample also updates the peer's entry in the latency table.
+   *
+   * \return false if the ping couldn't be started
+   */
+  bool Ping(const std::string& peerId, unsigned int count, unsigned int timeoutMs, std::vector<uint64_t>& rtts, unsigned int& sent);
+
+  /*!
+   * \brief Exponentially weighted latency table fed by all pings
+   */
+  namespace LatencyTable
+  {
+    /*!
+     * \brief Set the weight of new samples (0 < alpha <= 1)
+     */
+    void SetAlpha(double alpha);
+
+    void AddSample(const std::string& peerId, uint64_t rttNs);
+
+    bool GetLatency(const std::string& peerId, uint64_t& ewmaNs, unsigned int& samples);
+
+    /*!
+     * \brief Ping <peerIds> every <intervalMs> in the background
+     *
+     * Replaces the peers of a previous call.
+     */
+    bool StartMonitor(const std::vector<std::string>& peerIds, unsigned int intervalMs);
+
+    void StopMonitor(void);
+  }
+}
+
+#endif // __IPSF_PING_H__
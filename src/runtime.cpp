@@ -0,0 +1,82 @@
+/*
+ *    Copyright (C) 2015 juztamau5
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *    The above copyright notice and this permission notice shall be included in
+ *    all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include "runtime.h"
+
+// Go generated include file
+#include "ipfs.h"
+
+#include <climits>
+#include <stdint.h>
+
+namespace IPSF
+{
+  // Order of the values written by ipfsRuntimeStats(), see go/libipfs_runtime.go
+  enum RuntimeStat
+  {
+    StatHeapAlloc,
+    StatHeapSys,
+    StatHeapObjects,
+    StatTotalAlloc,
+    StatSys,
+    StatNextGC,
+    StatNumGC,
+    StatPauseTotalNs,
+    StatPauseLastNs,
+    StatPauseMaxNs,
+    StatGoroutines,
+    StatMaxProcs,
+    StatCount,
+  };
+
+  bool ConfigureRuntime(unsigned int maxProcs, int gcPercent, unsigned long long memoryLimit)
+  {
+    if (maxProcs > static_cast<unsigned int>(INT_MAX) || memoryLimit > static_cast<unsigned long long>(INT64_MAX))
+      return false;
+
+    return ipfsRuntimeConfigure(static_cast<int>(maxProcs), gcPercent, static_cast<int64_t>(memoryLimit)) != 0;
+  }
+
+  bool GetRuntimeStats(ipfs_runtime_stats_t& stats)
+  {
+    uint64_t values[StatCount] = { };
+
+    if (ipfsRuntimeStats(values, StatCount) != StatCount)
+      return false;
+
+    stats.heap_alloc_bytes  = values[StatHeapAlloc];
+    stats.heap_sys_bytes    = values[StatHeapSys];
+    stats.heap_objects      = values[StatHeapObjects];
+    stats.total_alloc_bytes = values[StatTotalAlloc];
+    stats.sys_bytes         = values[StatSys];
+    stats.next_gc_bytes     = values[StatNextGC];
+    stats.num_gc            = values[StatNumGC];
+    stats.gc_pause_total_ns = values[StatPauseTotalNs];
+    stats.gc_pause_last_ns  = values[StatPauseLastNs];
+    stats.gc_pause_max_ns   = values[StatPauseMaxNs];
+    stats.goroutines        = values[StatGoroutines];
+    stats.max_procs         = values[StatMaxProcs];
+
+    return true;
+  }
+}
@@ -0,0 +1,43 @@
+/*
+ *    Copyright (C) 2015 juztamau5
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *    The above copyright notice and this permission notice shall be included in
+ *    all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+#ifndef __IPSF_RUNTIME_H__
+#define __IPSF_RUNTIME_H__
+
+#include "ipfs/libipfs.h"
+
+namespace IPSF
+{
+  /*!
+   * \brief Apply limits to the Go runtime. Zero leaves a setting unchanged.
+   *
+   * \return false if a setting couldn't be applied
+   */
+  bool ConfigureRuntime(unsigned int maxProcs, int gcPercent, unsigned long long memoryLimit);
+
+  /*!
+   * \brief Read memory, collector and scheduler statistics from the Go runtime
+   */
+  bool GetRuntimeStats(ipfs_runtime_stats_t& stats);
+}
+
+#endif // __IPSF_RUNTIME_H__
@@ -0,0 +1,261 @@
+/*
+ *    Copyright (C) 2015 juztamau5
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *    The above copyright notice and this permission notice shall be included in
+ *    all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include "scheduler.h"
+
+#include <algorithm>
+#include <thread>
+
+using namespace IPSF;
+
+namespace
+{
+  const int NO_PRIORITY = -1;
+
+  thread_local int g_threadPriority = NO_PRIORITY;
+
+  // An interactive item gets four turns for every bulk one
+  const unsigned int DEFAULT_WEIGHTS[PRIORITY_CLASS_COUNT] = { 4, 2, 1 };
+
+  // go-ipfs runs one command line at a time, the scheduler only decides
+  // which goes next
+  const unsigned int MAX_RUNNING_COMMANDS = 1;
+
+  // Requests the daemon serves side by side, such as block fetches
+  const unsigned int MAX_RUNNING_REQUESTS = 16;
+}
+
+PriorityClass IPSF::GetThreadPriority(void)
+{
+  return g_threadPriority == NO_PRIORITY ? PriorityNormal : static_cast<PriorityClass>(g_threadPriority);
+}
+
+bool IPSF::HasThreadPriority(void)
+{
+  return g_threadPriority != NO_PRIORITY;
+}
+
+void IPSF::SetThreadPriority(PriorityClass priority)
+{
+  g_threadPriority = priority;
+}
+
+void IPSF::ClearThreadPriority(void)
+{
+  g_threadPriority = NO_PRIORITY;
+}
+
+CPriorityScope::CPriorityScope(PriorityClass defaultPriority) :
+  m_bApplied(!HasThreadPriority())
+{
+  if (m_bApplied)
+    SetThreadPriority(defaultPriority);
+}
+
+CPriorityScope::~CPriorityScope(void)
+{
+  if (m_bApplied)
+    ClearThreadPriority();
+}
+
+CFairShare::CFairShare(void) :
+  m_now(0.0)
+{
+  for (unsigned int i = 0; i < PRIORITY_CLASS_COUNT; i++)
+  {
+    m_weights[i] = DEFAULT_WEIGHTS[i];
+    m_start[i] = 0.0;
+    m_bBacklogged[i] = false;
+  }
+}
+
+void CFairShare::SetWeight(PriorityClass priority, unsigned int weight)
+{
+  m_weights[priority] = std::max(weight, 1u);
+}
+
+int CFairShare::Next(const bool eligible[PRIORITY_CLASS_COUNT])
+{
+  int next = -1;
+  double nextFinish = 0.0;
+
+  for (unsigned int i = 0; i < PRIORITY_CLASS_COUNT; i++)
+  {
+    if (!eligible[i])
+    {
+      m_bBacklogged[i] = false;
+      continue;
+    }
+
+    // A class that has work again starts from the current time, while one
+    // that kept waiting keeps its place
+    if (!m_bBacklogged[i])
+    {
+      m_start[i] = std::max(m_start[i], m_now);
+      m_bBacklogged[i] = true;
+    }
+
+    // Ties go to the more important class
+    const double finish = m_start[i] + 1.0 / m_weights[i];
+    if (next < 0 || finish < nextFinish)
+    {
+      next = static_cast<int>(i);
+      nextFinish = finish;
+    }
+  }
+
+  return next;
+}
+
+void CFairShare::Charge(PriorityClass priority)
+{
+  m_now = m_start[priority];
+  m_start[priority] += 1.0 / m_weights[priority];
+}
+
+CScheduler::CScheduler(unsigned int maxRunning) :
+  m_maxRunning(std::max(maxRunning, 1u)),
+  m_running(0)
+{
+  // Normal and bulk work leave room for interactive work
+  m_classes[PriorityInteractive].maxRunning = m_maxRunning;
+  m_classes[PriorityNormal].maxRunning = std::max(m_maxRunning / 2, 1u);
+  m_classes[PriorityBulk].maxRunning = std::max(m_maxRunning / 4, 1u);
+
+  for (unsigned int i = 0; i < PRIORITY_CLASS_COUNT; i++)
+    m_classes[i].stats = SchedulerStats();
+}
+
+bool CScheduler::Configure(PriorityClass priority, unsigned int weight, unsigned int maxRunning)
+{
+  if (weight == 0 || maxRunning == 0)
+    return false;
+
+  std::unique_lock<std::mutex> lock(m_mutex);
+
+  m_share.SetWeight(priority, weight);
+  m_classes[priority].maxRunning = std::min(maxRunning, m_maxRunning);
+
+  // A higher limit may let waiters in
+  Dispatch();
+
+  return true;
+}
+
+void CScheduler::Acquire(PriorityClass priority)
+{
+  std::unique_lock<std::mutex> lock(m_mutex);
+
+  Waiter waiter;
+  waiter.queued = std::chrono::steady_clock::now();
+  waiter.bAdmitted = false;
+
+  m_classes[priority].waiters.push_back(&waiter);
+  m_classes[priority].stats.queued++;
+
+  Dispatch();
+
+  while (!waiter.bAdmitted)
+    m_admitted.wait(lock);
+}
+
+void CScheduler::Release(PriorityClass priority)
+{
+  std::unique_lock<std::mutex> lock(m_mutex);
+
+  m_classes[priority].stats.running--;
+  m_running--;
+
+  Dispatch();
+}
+
+void CScheduler::Dispatch(void)
+{
+  bool bAdmitted = false;
+
+  while (m_running < m_maxRunning)
+  {
+    bool eligible[PRIORITY_CLASS_COUNT];
+    for (unsigned int i = 0; i < PRIORITY_CLASS_COUNT; i++)
+      eligible[i] = !m_classes[i].waiters.empty() && m_classes[i].stats.running < m_classes[i].maxRunning;
+
+    const int next = m_share.Next(eligible);
+    if (next < 0)
+      break;
+
+    ClassState& state = m_classes[next];
+
+    Waiter* waiter = state.waiters.front();
+    state.waiters.pop_front();
+    waiter->bAdmitted = true;
+
+    const uint64_t waitNs = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now() - waiter->queued).count());
+
+    state.stats.queued--;
+    state.stats.running++;
+    state.stats.admitted++;
+    state.stats.waitTotalNs += waitNs;
+    state.stats.waitMaxNs = std::max(state.stats.waitMaxNs, waitNs);
+
+    m_running++;
+    m_share.Charge(static_cast<PriorityClass>(next));
+
+    bAdmitted = true;
+  }
+
+  if (bAdmitted)
+    m_admitted.notify_all();
+}
+
+void CScheduler::GetStats(PriorityClass priority, SchedulerStats& stats)
+{
+  std::unique_lock<std::mutex> lock(m_mutex);
+  stats = m_classes[priority].stats;
+}
+
+CScheduledSlot::CScheduledSlot(CScheduler& scheduler) :
+  m_scheduler(scheduler),
+  m_priority(GetThreadPriority())
+{
+  m_scheduler.Acquire(m_priority);
+}
+
+CScheduler& IPSF::GetCommandScheduler(void)
+{
+  static CScheduler scheduler(MAX_RUNNING_COMMANDS);
+  return scheduler;
+}
+
+CScheduler& IPSF::GetApiScheduler(void)
+{
+  static CScheduler scheduler(MAX_RUNNING_REQUESTS);
+  return scheduler;
+}
+
+CScheduler& IPSF::GetDiskScheduler(void)
+{
+  // Enough requests in flight to keep an SSD's queue busy
+  static CScheduler scheduler(std::max(std::thread::hardware_concurrency() * 2, 4u));
+  return scheduler;
+}
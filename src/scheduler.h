@@ -0,0 +1,181 @@
+/*
+ *    Copyright (C) 2015 juztamau5
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *    The above copyright notice and this permission notice shall be included in
+ *    all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+#ifndef __IPSF_SCHEDULER_H__
+#define __IPSF_SCHEDULER_H__
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <stdint.h>
+
+namespace IPSF
+{
+  enum PriorityClass
+  {
+    PriorityInteractive,
+    PriorityNormal,
+    PriorityBulk,
+  };
+
+  const unsigned int PRIORITY_CLASS_COUNT = 3;
+
+  /*!
+   * \brief Get the priority of the calling thread's work
+   *
+   * \return PriorityNormal if the thread didn't choose one
+   */
+  PriorityClass GetThreadPriority(void);
+
+  bool HasThreadPriority(void);
+  void SetThreadPriority(PriorityClass priority);
+  void ClearThreadPriority(void);
+
+  /*!
+   * \brief Give a library call its default priority, unless the calling
+   *        thread chose one
+   */
+  class CPriorityScope
+  {
+  public:
+    CPriorityScope(PriorityClass defaultPriority);
+    ~CPriorityScope(void);
+
+  private:
+    const bool m_bApplied;
+  };
+
+  /*!
+   * \brief Weighted fair choice between priority classes
+   *
+   * Every class has a virtual clock that advances by 1 / weight for each item
+   * it's served, and the eligible class whose next item finishes first goes
+   * next. A class that was idle starts from the current time instead of
+   * claiming the share it didn't use.
+   */
+  class CFairShare
+  {
+  public:
+    CFairShare(void);
+
+    void SetWeight(PriorityClass priority, unsigned int weight);
+
+    /*!
+     * \return The class to serve next, or -1 if none is eligible
+     */
+    int Next(const bool eligible[PRIORITY_CLASS_COUNT]);
+
+    void Charge(PriorityClass priority);
+
+  private:
+    double m_weights[PRIORITY_CLASS_COUNT];
+    double m_start[PRIORITY_CLASS_COUNT];  // Virtual start of the class's next item
+    bool   m_bBacklogged[PRIORITY_CLASS_COUNT];
+    double m_now;
+  };
+
+  struct SchedulerStats
+  {
+    unsigned int queued;
+    unsigned int running;
+    uint64_t     admitted;
+    uint64_t     waitTotalNs;
+    uint64_t     waitMaxNs;
+  };
+
+  /*!
+   * \brief Admission control for a shared resource
+   *
+   * At most <maxRunning> holders run at once. By default normal work may take
+   * half of the slots and bulk work a quarter, so interactive work always
+   * finds room. Waiters are admitted in weighted fair order between the
+   * classes and in arrival order within a class.
+   */
+  class CScheduler
+  {
+  public:
+    CScheduler(unsigned int maxRunning);
+
+    bool Configure(PriorityClass priority, unsigned int weight, unsigned int maxRunning);
+
+    void Acquire(PriorityClass priority);
+    void Release(PriorityClass priority);
+
+    void GetStats(PriorityClass priority, SchedulerStats& stats);
+
+  private:
+    void Dispatch(void);
+
+    struct Waiter
+    {
+      std::chrono::steady_clock::time_point queued;
+      bool                                  bAdmitted;
+    };
+
+    struct ClassState
+    {
+      unsigned int        maxRunning;
+      std::deque<Waiter*> waiters;
+      SchedulerStats      stats;
+    };
+
+    const unsigned int      m_maxRunning;
+    unsigned int            m_running;
+    ClassState              m_classes[PRIORITY_CLASS_COUNT];
+    CFairShare              m_share;
+    std::mutex              m_mutex;
+    std::condition_variable m_admitted;
+  };
+
+  /*!
+   * \brief Holds a slot of a scheduler for the priority of the calling thread
+   */
+  class CScheduledSlot
+  {
+  public:
+    CScheduledSlot(CScheduler& scheduler);
+    ~CScheduledSlot(void) { m_scheduler.Release(m_priority); }
+
+  private:
+    CScheduler&         m_scheduler;
+    const PriorityClass m_priority;
+  };
+
+  /*!
+   * \brief Get the scheduler for go-ipfs commands, which do the block
+   *        fetches
+   */
+  CScheduler& GetCommandScheduler(void);
+
+  /*!
+   * \brief Get the scheduler for requests to a daemon's HTTP API
+   */
+  CScheduler& GetApiScheduler(void);
+
+  /*!
+   * \brief Get the scheduler for blockstore reads and writes
+   */
+  CScheduler& GetDiskScheduler(void);
+}
+
+#endif // __IPSF_SCHEDULER_H__
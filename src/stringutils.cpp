@@ -0,0 +1,65 @@
+/*
+ *    Copyright (C) 2015 juztamau5
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *    The above copyright notice and this permission notice shall be included in
+ *    all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include "stringutils.h"
+
+#include <sstream>
+
+using namespace IPSF;
+
+bool StringUtils::EndsWith(const std::string& str, const std::string& suffix)
+{
+  return str.size() >= suffix.size() &&
+         str.compare(str.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+std::string StringUtils::LastLine(const std::string& output)
+{
+  size_t end = output.find_last_not_of(" \t\r\n");
+  if (end == std::string::npos)
+    return "";
+
+  size_t begin = output.find_last_of("\r\n", end);
+  begin = (begin == std::string::npos) ? 0 : begin + 1;
+
+  return output.substr(begin, end + 1 - begin);
+}
+
+bool StringUtils::FindField(const std::string& output, const std::string& key, std::string& value)
+{
+  std::istringstream lines(output);
+  std::string line;
+
+  while (std::getline(lines, line))
+  {
+    if (line.compare(0, key.size(), key) != 0 || line.size() <= key.size() || line[key.size()] != ':')
+      continue;
+
+    size_t begin = line.find_first_not_of(" \t", key.size() + 1);
+    size_t end = line.find_last_not_of(" \t\r");
+    value = (begin == std::string::npos) ? "" : line.substr(begin, end + 1 - begin);
+    return true;
+  }
+
+  return false;
+}
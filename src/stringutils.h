@@ -0,0 +1,48 @@
+/*
+ *    Copyright (C) 2015 juztamau5
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *    The above copyright notice and this permission notice shall be included in
+ *    all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+#ifndef __IPSF_STRINGUTILS_H__
+#define __IPSF_STRINGUTILS_H__
+
+#include <string>
+
+namespace IPSF
+{
+  namespace StringUtils
+  {
+    bool EndsWith(const std::string& str, const std::string& suffix);
+
+    /*!
+     * \brief Get the last non-empty line of command output, without whitespace
+     */
+    std::string LastLine(const std::string& output);
+
+    /*!
+     * \brief Get the value of a "<key>: <value>" line in command output
+     *
+     * \return false if no line starts with <key>
+     */
+    bool FindField(const std::string& output, const std::string& key, std::string& value);
+  }
+}
+
+#endif // __IPSF_STRINGUTILS_H__
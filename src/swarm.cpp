@@ -0,0 +1,158 @@
+/*
+ *    Copyright (C) 2015 juztamau5
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *    The above copyright notice and this permission notice shall be included in
+ *    all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include "swarm.h"
+#include "api.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <set>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace IPSF;
+
+namespace
+{
+  /*!
+   * \brief Get the peer ID from the /ipfs/<id> part of a multiaddr
+   */
+  std::string GetPeerId(const std::string& multiaddr)
+  {
+    size_t pos = multiaddr.rfind("/ipfs/");
+    if (pos == std::string::npos)
+      return "";
+
+    pos += 6;
+    return multiaddr.substr(pos, multiaddr.find('/', pos) - pos);
+  }
+
+  /*!
+   * \brief Get the IDs of the peers the daemon is connected to
+   */
+  std::set<std::string> GetConnectedPeers(const ApiEndpoint& endpoint, unsigned int timeoutMs)
+  {
+    std::set<std::string> peers;
+
+    CApiRequest request("swarm/peers");
+    request.SetTimeout(timeoutMs);
+
+    std::string body;
+    if (!request.Execute(endpoint, body))
+      return peers;
+
+    // {"Strings":["/ip4/.../tcp/4001/ipfs/<id>",...]}
+    size_t pos = 0;
+    while ((pos = body.find("/ipfs/", pos)) != std::string::npos)
+    {
+      size_t end = body.find_first_of("/\"", pos + 6);
+      if (end == std::string::npos)
+        break;
+
+      peers.insert(body.substr(pos + 6, end - pos - 6));
+      pos = end;
+    }
+
+    return peers;
+  }
+}
+
+unsigned int IPSF::ConnectPeers(const char* const* addresses, unsigned int count, unsigned int maxConcurrency,
+                                unsigned int timeoutMs, ipfs_swarm_connect_result_t* results)
+{
+  for (unsigned int i = 0; i < count; i++)
+  {
+    results[i].status = IPFS_CONNECT_FAILED;
+    results[i].latency_ns = 0;
+  }
+
+  ApiEndpoint endpoint;
+  if (!GetApiEndpoint(endpoint))
+    return 0;
+
+  const std::set<std::string> connected = GetConnectedPeers(endpoint, timeoutMs);
+
+  std::atomic<unsigned int> next(0);
+  std::atomic<unsigned int> connectedCount(0);
+
+  auto dial = [&]()
+  {
+    unsigned int i;
+    while ((i = next++) < count)
+    {
+      const std::string address = addresses[i] ? addresses[i] : "";
+      const std::string peerId = GetPeerId(address);
+
+      if (!peerId.empty() && connected.count(peerId) > 0)
+      {
+        results[i].status = IPFS_CONNECT_EXISTING;
+        connectedCount++;
+        continue;
+      }
+
+      CApiRequest request("swarm/connect");
+      request.AddArgument(address);
+      if (timeoutMs > 0)
+      {
+        std::stringstream timeout;
+        timeout << timeoutMs << "ms";
+        request.AddOption("timeout", timeout.str());
+        request.SetTimeout(timeoutMs);
+      }
+
+      std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+      std::string body;
+      const bool bConnected = !address.empty() && request.Execute(endpoint, body);
+
+      results[i].latency_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+
+      if (bConnected)
+      {
+        results[i].status = IPFS_CONNECT_OK;
+        connectedCount++;
+      }
+      else
+      {
+        results[i].status = request.TimedOut() ? IPFS_CONNECT_TIMEOUT : IPFS_CONNECT_FAILED;
+      }
+    }
+  };
+
+  // Dials wait on the network, so they get their own threads instead of the CPU-bound worker pool
+  const unsigned int threadCount = std::min(std::max(maxConcurrency, 1u), count);
+
+  std::vector<std::thread> threads;
+  for (unsigned int i = 1; i < threadCount; i++)
+    threads.push_back(std::thread(dial));
+
+  dial();
+
+  for (std::vector<std::thread>::iterator it = threads.begin(); it != threads.end(); ++it)
+    it->join();
+
+  return connectedCount;
+}
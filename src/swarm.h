@@ -0,0 +1,41 @@
+/*
+ *    Copyright (C) 2015 juztamau5
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *    The above copyright notice and this permission notice shall be included in
+ *    all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+#ifndef __IPSF_SWARM_H__
+#define __IPSF_SWARM_H__
+
+#include "ipfs/libipfs.h"
+
+namespace IPSF
+{
+  /*!
+   * \brief Dial <count> peers from up to <maxConcurrency> threads
+   *
+   * Peers that are already connected aren't dialed again.
+   *
+   * \return The number of peers that are connected afterwards
+   */
+  unsigned int ConnectPeers(const char* const* addresses, unsigned int count, unsigned int maxConcurrency,
+                            unsigned int timeoutMs, ipfs_swarm_connect_result_t* results);
+}
+
+#endif // __IPSF_SWARM_H__
@@ -0,0 +1,155 @@
+/*
+ *    Copyright (C) 2015 juztamau5
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *    The above copyright notice and this permission notice shall be included in
+ *    all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include "threadpool.h"
+#include "config.h"
+
+using namespace IPSF;
+
+CThreadPool::CThreadPool(unsigned int threadCount, unsigned int maxQueued) :
+  m_maxQueued(maxQueued > 0 ? maxQueued : 1),
+  m_bStopping(false)
+{
+  if (threadCount == 0)
+    threadCount = 1;
+
+  for (unsigned int i = 0; i < threadCount; i++)
+    m_threads.push_back(std::thread(&CThreadPool::Process, this));
+}
+
+CThreadPool::~CThreadPool(void)
+{
+  {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_bStopping = true;
+  }
+  m_taskReady.notify_all();
+  m_slotReady.notify_all();
+
+  for (std::vector<std::thread>::iterator it = m_threads.begin(); it != m_threads.end(); ++it)
+    it->join();
+}
+
+void CThreadPool::Submit(const std::function<void()>& task)
+{
+  const PriorityClass priority = GetThreadPriority();
+
+  // Tasks of a node other than the default one work on that node's repo
+  std::function<void()> queuedTask = task;
+  const std::string& repoPath = GetThreadRepo();
+  if (!repoPath.empty())
+  {
+    queuedTask = [task, repoPath]()
+    {
+      SelectThreadRepo(repoPath);
+      task();
+      SelectThreadRepo("");
+    };
+  }
+
+  {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (m_tasks[priority].size() >= m_maxQueued && !m_bStopping)
+      m_slotReady.wait(lock);
+    m_tasks[priority].push_back(queuedTask);
+  }
+  m_taskReady.notify_one();
+}
+
+void CThreadPool::Process(void)
+{
+  while (true)
+  {
+    std::function<void()> task;
+    int priority;
+
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+
+      bool queued[PRIORITY_CLASS_COUNT];
+      while (true)
+      {
+        for (unsigned int i = 0; i < PRIORITY_CLASS_COUNT; i++)
+          queued[i] = !m_tasks[i].empty();
+
+        priority = m_share.Next(queued);
+        if (priority >= 0 || m_bStopping)
+          break;
+
+        m_taskReady.wait(lock);
+      }
+
+      // Finish queued work before exiting
+      if (priority < 0)
+        break;
+
+      m_share.Charge(static_cast<PriorityClass>(priority));
+
+      task = m_tasks[priority].front();
+      m_tasks[priority].pop_front();
+    }
+
+    // Submitters of every class may be waiting for room
+    m_slotReady.notify_all();
+
+    SetThreadPriority(static_cast<PriorityClass>(priority));
+    task();
+    ClearThreadPriority();
+  }
+}
+
+CTaskGroup::CTaskGroup(CThreadPool& pool) :
+  m_pool(pool),
+  m_pending(0)
+{
+}
+
+void CTaskGroup::Run(const std::function<void()>& task)
+{
+  {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_pending++;
+  }
+
+  m_pool.Submit([this, task]()
+  {
+    task();
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if (--m_pending == 0)
+      m_done.notify_all();
+  });
+}
+
+void CTaskGroup::Wait(void)
+{
+  std::unique_lock<std::mutex> lock(m_mutex);
+  while (m_pending > 0)
+    m_done.wait(lock);
+}
+
+CThreadPool& IPSF::GetWorkerPool(void)
+{
+  static CThreadPool pool(std::thread::hardware_concurrency(), std::thread::hardware_concurrency() * 4 + 16);
+  return pool;
+}
@@ -0,0 +1,100 @@
+/*
+ *    Copyright (C) 2015 juztamau5
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *    The above copyright notice and this permission notice shall be included in
+ *    all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+#ifndef __IPSF_THREADPOOL_H__
+#define __IPSF_THREADPOOL_H__
+
+#include "scheduler.h"
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace IPSF
+{
+  /*!
+   * \brief Fixed-size pool of worker threads shared by the library
+   *
+   * Submit() blocks while the queue is full so that producers walking large
+   * inputs (archives, directory trees) can't run ahead of the workers.
+   *
+   * Tasks run with the priority and the repo of the thread that submitted
+   * them. Each priority class has its own queue, and workers take from the
+   * queues in weighted fair order, so a bulk job can't hold up interactive
+   * tasks.
+   */
+  class CThreadPool
+  {
+  public:
+    CThreadPool(unsigned int threadCount, unsigned int maxQueued);
+    ~CThreadPool(void);
+
+    unsigned int ThreadCount(void) const { return static_cast<unsigned int>(m_threads.size()); }
+
+    void Submit(const std::function<void()>& task);
+
+  private:
+    void Process(void);
+
+    std::vector<std::thread>          m_threads;
+    std::deque<std::function<void()>> m_tasks[PRIORITY_CLASS_COUNT];
+    CFairShare                        m_share;
+    const unsigned int                m_maxQueued;
+    bool                              m_bStopping;
+    std::mutex                        m_mutex;
+    std::condition_variable           m_taskReady;
+    std::condition_variable           m_slotReady;
+  };
+
+  /*!
+   * \brief Tracks a set of tasks submitted to a pool so the caller can wait
+   *        for its own work without draining the whole pool
+   */
+  class CTaskGroup
+  {
+  public:
+    CTaskGroup(CThreadPool& pool);
+    ~CTaskGroup(void) { Wait(); }
+
+    void Run(const std::function<void()>& task);
+    void Wait(void);
+
+  private:
+    CThreadPool&            m_pool;
+    unsigned int            m_pending;
+    std::mutex              m_mutex;
+    std::condition_variable m_done;
+  };
+
+  /*!
+   * \brief Get the worker pool shared by all library calls
+   *
+   * The pool is sized to the number of hardware threads and created on first
+   * use.
+   */
+  CThreadPool& GetWorkerPool(void);
+}
+
+#endif // __IPSF_THREADPOOL_H__
@@ -0,0 +1,216 @@
+/*
+ *    Copyright (C) 2015 juztamau5
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *    The above copyright notice and this permission notice shall be included in
+ *    all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include "testserver.h"
+
+#include "add.h"
+#include "invoke.h"
+#include "merkledag.h"
+#include "stringutils.h"
+
+#include "ipfs/libipfs.h"
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <sys/stat.h>
+
+using namespace IPSF;
+using namespace IPSF::Test;
+
+namespace
+{
+  const char* const EMPTY_FILE_KEY = "QmbFMke1KXqnYyBBWxB74N4c5SBnJMVAiMNRcGu6x1AwQH";
+  const char* const EMPTY_DIRECTORY_KEY = "QmUNLLsPACCz1vLxQVkXqqLX5R1X345qqfHbsf67hvA3Nn";
+  const char* const HELLO_WORLD_KEY = "QmT78zSuBmuS4z925WZfrqQ1qHaJ56DQaTfyMUF7F8ff5o"; // "hello world\n"
+
+  void WriteFile(const std::string& path, const std::string& contents)
+  {
+    std::ofstream file(path.c_str(), std::ios::binary);
+    file << contents;
+    TEST_CHECK(file.good());
+  }
+
+  std::string MakeData(size_t size)
+  {
+    std::string data(size, '\0');
+    uint32_t seed = 1;
+    for (size_t i = 0; i < size; i++)
+    {
+      seed = seed * 1664525 + 1013904223;
+      data[i] = static_cast<char>(seed >> 24);
+    }
+    return data;
+  }
+
+  ipfs_add_options_t MakeOptions(unsigned int chunkSize, bool bTrickle)
+  {
+    ipfs_add_options_t options;
+    ipfs_add_options_init(&options);
+    options.recursive = true;
+    options.chunk_size = chunkSize;
+    options.trickle = bTrickle;
+    return options;
+  }
+
+  std::string AddHash(const std::string& path, const ipfs_add_options_t& options)
+  {
+    char cid[64];
+    return ipfs_add_hash(path.c_str(), &options, cid, sizeof(cid)) ? cid : "";
+  }
+
+  /*!
+   * \brief Compare the index to a hash-only add, and to go-ipfs where it's
+   *        linked in
+   */
+  std::string CheckAdd(const std::string& path, const std::string& indexPath, const ipfs_add_options_t& options)
+  {
+    const std::string hashed = AddHash(path, options);
+    TEST_CHECK(!hashed.empty());
+
+    char cid[64];
+    TEST_CHECK(ipfs_add_incremental(path.c_str(), indexPath.c_str(), &options, cid, sizeof(cid)));
+    TEST_CHECK(hashed == cid);
+    TEST_CHECK(ipfs_block_has(cid));
+
+    // Unchanged files come from the index the second time
+    TEST_CHECK(ipfs_add_incremental(path.c_str(), indexPath.c_str(), &options, cid, sizeof(cid)));
+    TEST_CHECK(hashed == cid);
+
+#if defined(HAVE_GO_IPSF)
+    ipfs_add_options_t goOptions = options;
+    goOptions.quiet = true;
+    goOptions.progress = false;
+    goOptions.only_hash = true;
+
+    std::string cmd;
+    std::string output;
+    bool bError = false;
+    TEST_CHECK(GetAddCommand(path, goOptions, cmd));
+    TEST_CHECK(invoke(cmd, output, bError) && !bError);
+    TEST_CHECK(StringUtils::LastLine(output) == hashed);
+#endif
+
+    return hashed;
+  }
+
+  void TestKnownKeys(const std::string& dir, const std::string& repo)
+  {
+    WriteFile(dir + "/empty", "");
+    WriteFile(dir + "/hello", "hello world\n");
+    TEST_CHECK(mkdir((dir + "/emptydir").c_str(), 0755) == 0);
+
+    const ipfs_add_options_t options = MakeOptions(0, false);
+    TEST_CHECK(CheckAdd(dir + "/empty", repo + "/index-empty", options) == EMPTY_FILE_KEY);
+    TEST_CHECK(CheckAdd(dir + "/hello", repo + "/index-hello", options) == HELLO_WORLD_KEY);
+    TEST_CHECK(CheckAdd(dir + "/emptydir", repo + "/index-emptydir", options) == EMPTY_DIRECTORY_KEY);
+
+    // Directories need a recursive add
+    ipfs_add_options_t flat = options;
+    flat.recursive = false;
+    TEST_CHECK(AddHash(dir + "/emptydir", flat).empty());
+  }
+
+  void TestMultiChunk(const std::string& dir, const std::string& repo)
+  {
+    // Five leaves under one root, then enough leaves for two levels
+    WriteFile(dir + "/five", MakeData(4 * 256 * 1024 + 100));
+    WriteFile(dir + "/deep", MakeData(200 * 1024 + 7));
+
+    CheckAdd(dir + "/five", repo + "/index-five", MakeOptions(0, false));
+    CheckAdd(dir + "/five", repo + "/index-five-trickle", MakeOptions(0, true));
+
+    const std::string balanced = CheckAdd(dir + "/deep", repo + "/index-deep", MakeOptions(1024, false));
+    const std::string trickle = CheckAdd(dir + "/deep", repo + "/index-deep-trickle", MakeOptions(1024, true));
+    TEST_CHECK(balanced != trickle);
+  }
+
+  void TestNestedDirectory(const std::string& dir, const std::string& repo)
+  {
+    const std::string tree = dir + "/tree";
+    TEST_CHECK(mkdir(tree.c_str(), 0755) == 0);
+    TEST_CHECK(mkdir((tree + "/a").c_str(), 0755) == 0);
+    WriteFile(tree + "/a/b.txt", "hello world\n");
+    WriteFile(tree + "/c.txt", "ccc\n");
+    WriteFile(tree + "/.hidden", "skipped");
+
+    const std::string key = CheckAdd(tree, repo + "/index-tree", MakeOptions(0, false));
+
+    // The DAG builder encodes the same nodes
+    ipfs_dag_builder_t* builder = ipfs_dag_builder_new();
+    TEST_CHECK(builder != NULL);
+
+    const std::string helloData = UnixfsFileData("hello world\n", std::vector<uint64_t>());
+    const std::string cccData = UnixfsFileData("ccc\n", std::vector<uint64_t>());
+    const std::string directoryData = UnixfsDirectoryData();
+
+    const int hello = ipfs_dag_node_new(builder);
+    const int ccc = ipfs_dag_node_new(builder);
+    const int a = ipfs_dag_node_new(builder);
+    const int root = ipfs_dag_node_new(builder);
+    TEST_CHECK(ipfs_dag_node_set_data(builder, hello, helloData.data(), helloData.size()));
+    TEST_CHECK(ipfs_dag_node_set_data(builder, ccc, cccData.data(), cccData.size()));
+    TEST_CHECK(ipfs_dag_node_set_data(builder, a, directoryData.data(), directoryData.size()));
+    TEST_CHECK(ipfs_dag_node_set_data(builder, root, directoryData.data(), directoryData.size()));
+    TEST_CHECK(ipfs_dag_node_add_child(builder, a, hello, "b.txt"));
+    TEST_CHECK(ipfs_dag_node_add_child(builder, root, a, "a"));
+    TEST_CHECK(ipfs_dag_node_add_child(builder, root, ccc, "c.txt"));
+
+    char cid[64];
+    TEST_CHECK(ipfs_dag_builder_flush(builder, root, cid, sizeof(cid)));
+    TEST_CHECK(key == cid);
+
+    ipfs_dag_builder_free(builder);
+
+    // Wrapping adds one directory with the tree's name
+    ipfs_add_options_t wrapped = MakeOptions(0, false);
+    wrapped.wrap_with_directory = true;
+    const std::string wrappedKey = CheckAdd(tree, repo + "/index-tree-wrapped", wrapped);
+    TEST_CHECK(!wrappedKey.empty() && wrappedKey != key);
+  }
+}
+
+int main(void)
+{
+  const std::string repo = MakeTempRepo();
+  const std::string dir = MakeTempRepo();
+  TEST_CHECK(!repo.empty() && !dir.empty());
+
+  // A local node stores blocks in the repo without a daemon
+  TEST_CHECK(ipfs_open(repo.c_str(), IPFS_OPEN_DEFAULT));
+  ipfs_init(1024, "", false);
+  mkdir((repo + "/blocks").c_str(), 0755);
+  TEST_CHECK(ipfs_open(repo.c_str(), IPFS_OPEN_LOCAL));
+
+  TestKnownKeys(dir, repo);
+  TestMultiChunk(dir, repo);
+  TestNestedDirectory(dir, repo);
+
+  ipfs_close();
+
+  RemoveTree(dir);
+  RemoveTree(repo);
+
+  return 0;
+}
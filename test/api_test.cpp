@@ -0,0 +1,264 @@
+/*
+ *    Copyright (C) 2015 juztamau5
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *    The above copyright notice and this permission notice shall be included in
+ *    all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include "testserver.h"
+
+#include "api.h"
+#include "dht.h"
+#include "json.h"
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+using namespace IPSF;
+using namespace IPSF::Test;
+
+namespace
+{
+  void Handle(const HttpRequest& request, int fd)
+  {
+    const std::string path = request.target.substr(0, request.target.find('?'));
+
+    if (path == "/api/v0/id")
+    {
+      SendResponse(fd, 200, "{\"ID\":\"QmPeer\",\"Latency\":9007199254740993}");
+    }
+    else if (path == "/api/v0/fail")
+    {
+      SendResponse(fd, 500, "{\"Message\":\"no such thing\",\"Code\":0}");
+    }
+    else if (path == "/api/v0/stream")
+    {
+      // The client hangs up after the first line, long before the last
+      SendChunkedHeader(fd);
+      for (int i = 0; i < 50; i++)
+      {
+        if (!SendChunk(fd, "{\"Line\":" + std::to_string(i) + "}\n"))
+          return;
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+      }
+      SendLastChunk(fd, "");
+    }
+    else if (path == "/api/v0/broken")
+    {
+      SendChunkedHeader(fd);
+      SendChunk(fd, "{\"Line\":0}\n");
+      SendLastChunk(fd, "routing failed");
+    }
+    else if (path == "/api/v0/slow")
+    {
+      std::this_thread::sleep_for(std::chrono::milliseconds(500));
+      SendResponse(fd, 200, "{}");
+    }
+    else if (path == "/api/v0/dht/findprovs")
+    {
+      // A peer reported twice, then more than the caller wants
+      SendChunkedHeader(fd);
+      SendChunk(fd, "{\"ID\":\"\",\"Type\":0,\"Responses\":null}\n");
+      SendChunk(fd, "{\"ID\":\"a\",\"Type\":4,\"Responses\":[{\"ID\":\"QmP1\",\"Addrs\":[\"/ip4/1.1.1.1/tcp/1\"]}]}\n");
+      SendChunk(fd, "{\"ID\":\"b\",\"Type\":4,\"Responses\":[{\"ID\":\"QmP1\",\"Addrs\":null},{\"ID\":\"QmP2\",\"Addrs\":[]}]}\n");
+      for (int i = 0; i < 50; i++)
+      {
+        if (!SendChunk(fd, "{\"ID\":\"c\",\"Type\":4,\"Responses\":[{\"ID\":\"QmP" + std::to_string(i + 3) + "\",\"Addrs\":[]}]}\n"))
+          return;
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+      }
+      SendLastChunk(fd, "");
+    }
+    else if (path == "/api/v0/block/put")
+    {
+      SendResponse(fd, 200, "{\"Key\":\"QmBlock\",\"Size\":" + std::to_string(request.body.size()) + "}");
+    }
+    else
+    {
+      SendResponse(fd, 404, "404 page not found");
+    }
+  }
+
+  void TestJson(void)
+  {
+    CJsonValue document;
+    TEST_CHECK(CJsonValue::Parse("{\"a\": [1, \"two\", null, true], \"big\": 9007199254740993, \"s\": \"\\u00e9\\n\"}", document));
+    TEST_CHECK(document.GetType() == CJsonValue::TypeObject);
+    TEST_CHECK(document["a"].Size() == 4);
+    TEST_CHECK(document["a"][0].AsInteger() == 1);
+    TEST_CHECK(document["a"][1].AsString() == "two");
+    TEST_CHECK(document["a"][2].IsNull());
+    TEST_CHECK(document["a"][3].AsBool());
+    TEST_CHECK(document["big"].AsInteger() == 9007199254740993LL);
+    TEST_CHECK(document["s"].AsString() == "\xc3\xa9\n");
+    TEST_CHECK(document["missing"].IsNull());
+
+    CJsonValue reparsed;
+    TEST_CHECK(CJsonValue::Parse(document.Serialize(false), reparsed));
+    TEST_CHECK(reparsed.Serialize(true) == document.Serialize(true));
+
+    TEST_CHECK(!CJsonValue::Parse("{\"a\": }", document));
+    TEST_CHECK(!CJsonValue::Parse("[1, 2", document));
+  }
+
+  void TestEndpoint(CLoopbackServer& server)
+  {
+    const std::string repoPath = MakeTempRepo();
+    TEST_CHECK(!repoPath.empty());
+
+    ApiEndpoint endpoint;
+    TEST_CHECK(!GetDaemonEndpoint(repoPath, endpoint));
+
+    TEST_CHECK(server.WriteApiFile(repoPath));
+    TEST_CHECK(GetDaemonEndpoint(repoPath, endpoint));
+    TEST_CHECK(endpoint.host == "127.0.0.1");
+    TEST_CHECK(endpoint.port == server.GetPort());
+
+    unlink((repoPath + "/api").c_str());
+    rmdir(repoPath.c_str());
+  }
+
+  void TestRequests(CLoopbackServer& server)
+  {
+    ApiEndpoint endpoint;
+    endpoint.host = "127.0.0.1";
+    endpoint.port = server.GetPort();
+
+    // Whole bodies, with arguments encoded into the query
+    CApiRequest id("id");
+    id.AddArgument("a b/c");
+    id.AddOption("encoding", "json");
+
+    std::string body;
+    TEST_CHECK(id.Execute(endpoint, body));
+
+    CJsonValue response;
+    TEST_CHECK(CJsonValue::Parse(body, response));
+    TEST_CHECK(response["ID"].AsString() == "QmPeer");
+
+    const std::vector<HttpRequest> requests = server.GetRequests();
+    TEST_CHECK(!requests.empty());
+    TEST_CHECK(requests.back().target == "/api/v0/id?arg=a%20b%2Fc&encoding=json");
+
+    // Errors carry the daemon's message
+    CApiRequest fail("fail");
+    TEST_CHECK(!fail.Execute(endpoint, body));
+    TEST_CHECK(fail.GetError() == "no such thing");
+
+    // Stopping a stream early closes the connection
+    CApiRequest stream("stream");
+    unsigned int lines = 0;
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    TEST_CHECK(stream.Execute(endpoint, [&lines](const std::string& line)
+    {
+      CJsonValue event;
+      TEST_CHECK(CJsonValue::Parse(line, event));
+      TEST_CHECK(event["Line"].AsInteger() == 0);
+      lines++;
+      return false;
+    }));
+    TEST_CHECK(lines == 1);
+    TEST_CHECK(std::chrono::steady_clock::now() - start < std::chrono::milliseconds(500));
+
+    // Errors after the response started come in a trailer
+    CApiRequest broken("broken");
+    TEST_CHECK(!broken.Execute(endpoint, [](const std::string&) { return true; }));
+    TEST_CHECK(broken.GetError() == "routing failed");
+
+    CApiRequest slow("slow");
+    slow.SetTimeout(100);
+    TEST_CHECK(!slow.Execute(endpoint, body));
+    TEST_CHECK(slow.TimedOut());
+
+    // Files are uploaded as multipart form data
+    const std::string block("\x0a\x02\x08\x01--libipfs-boundary", 22);
+    CApiRequest put("block/put");
+    put.AddFile(block);
+    TEST_CHECK(put.Execute(endpoint, body));
+    TEST_CHECK(CJsonValue::Parse(body, response));
+
+    const HttpRequest upload = server.GetRequests().back();
+    TEST_CHECK(upload.contentType.compare(0, 30, "multipart/form-data; boundary=") == 0);
+
+    const std::string boundary = upload.contentType.substr(30);
+    TEST_CHECK(block.find(boundary) == std::string::npos);
+    TEST_CHECK(upload.body.compare(0, boundary.size() + 4, "--" + boundary + "\r\n") == 0);
+    TEST_CHECK(upload.body.find("\r\n\r\n" + block + "\r\n--" + boundary + "--\r\n") != std::string::npos);
+  }
+
+  struct Providers
+  {
+    std::vector<std::string> peers;
+    unsigned int             addrs;
+  };
+
+  bool OnProvider(const char* peer_id, const char* const* addrs, unsigned int addr_count, void* context)
+  {
+    Providers* providers = static_cast<Providers*>(context);
+    providers->peers.push_back(peer_id);
+    providers->addrs += addr_count;
+    TEST_CHECK(addr_count == 0 || addrs != NULL);
+    return true;
+  }
+
+  void TestFindProviders(CLoopbackServer& server)
+  {
+    const std::string repoPath = MakeTempRepo();
+    TEST_CHECK(!repoPath.empty());
+    TEST_CHECK(server.WriteApiFile(repoPath));
+    setenv("IPFS_PATH", repoPath.c_str(), 1);
+
+    Providers providers;
+    providers.addrs = 0;
+
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    TEST_CHECK(FindProvidersStream("QmKey", 3, OnProvider, &providers) == 3);
+    TEST_CHECK(std::chrono::steady_clock::now() - start < std::chrono::milliseconds(500));
+
+    TEST_CHECK(providers.peers.size() == 3);
+    TEST_CHECK(providers.peers[0] == "QmP1");
+    TEST_CHECK(providers.peers[1] == "QmP2");
+    TEST_CHECK(providers.peers[2] == "QmP3");
+    TEST_CHECK(providers.addrs == 1);
+
+    // The daemon only knows the options go-ipfs defines for findprovs
+    const HttpRequest request = server.GetRequests().back();
+    TEST_CHECK(request.target == "/api/v0/dht/findprovs?arg=QmKey&encoding=json&stream-channels=true");
+
+    unlink((repoPath + "/api").c_str());
+    rmdir(repoPath.c_str());
+  }
+}
+
+int main(void)
+{
+  TestJson();
+
+  CLoopbackServer server(Handle);
+  TEST_CHECK(server.Start());
+
+  TestEndpoint(server);
+  TestRequests(server);
+  TestFindProviders(server);
+
+  server.Stop();
+
+  return 0;
+}
@@ -0,0 +1,288 @@
+/*
+ *    Copyright (C) 2015 juztamau5
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *    The above copyright notice and this permission notice shall be included in
+ *    all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include "testserver.h"
+
+#include "archive.h"
+
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+
+using namespace IPSF;
+using namespace IPSF::Test;
+
+namespace
+{
+  const size_t TAR_BLOCK_SIZE = 512;
+
+  void WriteOctal(char* field, size_t size, uint64_t value)
+  {
+    std::snprintf(field, size, "%0*llo", static_cast<int>(size - 1), static_cast<unsigned long long>(value));
+  }
+
+  /*!
+   * \brief Append a ustar entry to <tar>
+   */
+  void AddEntry(std::string& tar, const std::string& name, char type, const std::string& contents = "",
+                const std::string& linkName = "")
+  {
+    char header[TAR_BLOCK_SIZE] = { };
+    std::strncpy(header, name.c_str(), 100);
+    WriteOctal(header + 100, 8, type == '5' ? 0755 : 0644);
+    WriteOctal(header + 108, 8, 0);
+    WriteOctal(header + 116, 8, 0);
+    WriteOctal(header + 124, 12, contents.size());
+    WriteOctal(header + 136, 12, 0);
+    header[156] = type;
+    std::strncpy(header + 157, linkName.c_str(), 100);
+    std::memcpy(header + 257, "ustar\0" "00", 8);
+
+    std::memset(header + 148, ' ', 8);
+    unsigned int sum = 0;
+    for (size_t i = 0; i < TAR_BLOCK_SIZE; i++)
+      sum += static_cast<unsigned char>(header[i]);
+    WriteOctal(header + 148, 7, sum);
+
+    tar.append(header, sizeof(header));
+    tar += contents;
+    tar.append((TAR_BLOCK_SIZE - contents.size() % TAR_BLOCK_SIZE) % TAR_BLOCK_SIZE, '\0');
+  }
+
+  void EndArchive(std::string& tar)
+  {
+    tar.append(2 * TAR_BLOCK_SIZE, '\0');
+  }
+
+  /*!
+   * \brief Feed <data> to a function reading a file descriptor
+   */
+  template<typename T>
+  bool WithInput(const std::string& dir, const std::string& data, T function)
+  {
+    const std::string path = dir + "/input";
+    {
+      std::ofstream file(path.c_str(), std::ios::binary);
+      file.write(data.data(), data.size());
+    }
+
+    int fd = open(path.c_str(), O_RDONLY);
+    TEST_CHECK(fd >= 0);
+    const bool bResult = function(fd);
+    close(fd);
+    unlink(path.c_str());
+    return bResult;
+  }
+
+  bool Extract(const std::string& dir, const std::string& tar, const std::string& outPath)
+  {
+    return WithInput(dir, tar, [&outPath](int fd) { return ExtractTar(fd, outPath); });
+  }
+
+  std::string ReadFile(const std::string& path)
+  {
+    std::ifstream file(path.c_str(), std::ios::binary);
+    std::stringstream contents;
+    contents << file.rdbuf();
+    return contents.str();
+  }
+
+  bool Exists(const std::string& path)
+  {
+    struct stat st;
+    return lstat(path.c_str(), &st) == 0;
+  }
+
+  void TestExtract(const std::string& dir)
+  {
+    // Larger than one range written by a task
+    std::string large(3 * 1024 * 1024 + 7, '\0');
+    for (size_t i = 0; i < large.size(); i++)
+      large[i] = static_cast<char>(i * 131 + i / 4096);
+
+    std::string tar;
+    AddEntry(tar, "QmRoot", '5');
+    AddEntry(tar, "QmRoot/a.txt", '0', "alpha");
+    AddEntry(tar, "QmRoot/sub", '5');
+    AddEntry(tar, "QmRoot/sub/large.bin", '0', large);
+    AddEntry(tar, "QmRoot/sub/link", '2', "", "../a.txt");
+    EndArchive(tar);
+
+    const std::string outPath = dir + "/out";
+    TEST_CHECK(Extract(dir, tar, outPath));
+    TEST_CHECK(ReadFile(outPath + "/a.txt") == "alpha");
+    TEST_CHECK(ReadFile(outPath + "/sub/large.bin") == large);
+    TEST_CHECK(ReadFile(outPath + "/sub/link") == "alpha");
+
+    // Absolute names are taken relative to the root like any other
+    tar.clear();
+    AddEntry(tar, "/QmRoot", '5');
+    AddEntry(tar, "/QmRoot/b.txt", '0', "beta");
+    EndArchive(tar);
+
+    TEST_CHECK(Extract(dir, tar, outPath));
+    TEST_CHECK(ReadFile(outPath + "/b.txt") == "beta");
+
+    RemoveTree(outPath);
+  }
+
+  void TestEscapes(const std::string& dir)
+  {
+    const std::string outPath = dir + "/out";
+
+    // Climbing out with ".."
+    std::string tar;
+    AddEntry(tar, "QmRoot", '5');
+    AddEntry(tar, "QmRoot/../escaped.txt", '0', "evil");
+    EndArchive(tar);
+
+    TEST_CHECK(!Extract(dir, tar, outPath));
+    TEST_CHECK(!Exists(dir + "/escaped.txt"));
+    RemoveTree(outPath);
+
+    // Symlinks pointing outside, relative or absolute
+    tar.clear();
+    AddEntry(tar, "QmRoot", '5');
+    AddEntry(tar, "QmRoot/up", '2', "", "../..");
+    EndArchive(tar);
+
+    TEST_CHECK(!Extract(dir, tar, outPath));
+    RemoveTree(outPath);
+
+    tar.clear();
+    AddEntry(tar, "QmRoot", '5');
+    AddEntry(tar, "QmRoot/abs", '2', "", dir);
+    EndArchive(tar);
+
+    TEST_CHECK(!Extract(dir, tar, outPath));
+    RemoveTree(outPath);
+
+    // Writing through a symlink that points inside the tree
+    tar.clear();
+    AddEntry(tar, "QmRoot", '5');
+    AddEntry(tar, "QmRoot/sub", '5');
+    AddEntry(tar, "QmRoot/link", '2', "", "sub");
+    AddEntry(tar, "QmRoot/link/through.txt", '0', "evil");
+    EndArchive(tar);
+
+    TEST_CHECK(!Extract(dir, tar, outPath));
+    TEST_CHECK(!Exists(outPath + "/sub/through.txt"));
+    RemoveTree(outPath);
+
+    // A file entry replaces a symlink instead of following it
+    const std::string target = dir + "/target.txt";
+    {
+      std::ofstream file(target.c_str());
+      file << "untouched";
+    }
+    TEST_CHECK(mkdir(outPath.c_str(), 0755) == 0);
+    TEST_CHECK(symlink(target.c_str(), (outPath + "/c.txt").c_str()) == 0);
+
+    tar.clear();
+    AddEntry(tar, "QmRoot", '5');
+    AddEntry(tar, "QmRoot/c.txt", '0', "gamma");
+    EndArchive(tar);
+
+    TEST_CHECK(Extract(dir, tar, outPath));
+    TEST_CHECK(ReadFile(outPath + "/c.txt") == "gamma");
+    TEST_CHECK(ReadFile(target) == "untouched");
+
+    unlink(target.c_str());
+    RemoveTree(outPath);
+  }
+
+  void TestTruncated(const std::string& dir)
+  {
+    std::string tar;
+    AddEntry(tar, "QmRoot", '5');
+    AddEntry(tar, "QmRoot/a.txt", '0', std::string(2000, 'a'));
+    EndArchive(tar);
+
+    const std::string outPath = dir + "/out";
+
+    // Cut inside a file, and before the end-of-archive marker
+    TEST_CHECK(!Extract(dir, tar.substr(0, 3 * TAR_BLOCK_SIZE), outPath));
+    RemoveTree(outPath);
+    TEST_CHECK(!Extract(dir, tar.substr(0, tar.size() - 2 * TAR_BLOCK_SIZE), outPath));
+    RemoveTree(outPath);
+
+#if defined(HAVE_ZLIB)
+    const std::string gzPath = dir + "/cut.tar.gz";
+    TEST_CHECK(!WithInput(dir, tar.substr(0, tar.size() - 2 * TAR_BLOCK_SIZE), [&gzPath](int fd)
+    {
+      return GzipTar(fd, gzPath, 6);
+    }));
+    TEST_CHECK(!Exists(gzPath));
+#endif
+  }
+
+  void TestGzip(const std::string& dir)
+  {
+#if defined(HAVE_ZLIB)
+    // Many blocks of the compressor, compressible and not
+    std::string contents;
+    uint32_t state = 1;
+    for (size_t i = 0; i < 5 * 1024 * 1024; i++)
+    {
+      state = state * 1103515245 + 12345;
+      contents += (i / 65536) % 2 ? static_cast<char>(state >> 24) : static_cast<char>('a' + i % 7);
+    }
+
+    std::string tar;
+    AddEntry(tar, "QmRoot", '5');
+    AddEntry(tar, "QmRoot/data.bin", '0', contents);
+    EndArchive(tar);
+
+    const std::string gzPath = dir + "/out.tar.gz";
+    TEST_CHECK(WithInput(dir, tar, [&gzPath](int fd) { return GzipTar(fd, gzPath, 6); }));
+
+    const std::string command = "gunzip -c " + gzPath + " > " + dir + "/out.tar";
+    TEST_CHECK(std::system(command.c_str()) == 0);
+    TEST_CHECK(ReadFile(dir + "/out.tar") == tar);
+
+    unlink(gzPath.c_str());
+    unlink((dir + "/out.tar").c_str());
+#else
+    (void)dir;
+#endif
+  }
+}
+
+int main(void)
+{
+  const std::string dir = MakeTempRepo();
+  TEST_CHECK(!dir.empty());
+
+  TestExtract(dir);
+  TestEscapes(dir);
+  TestTruncated(dir);
+  TestGzip(dir);
+
+  RemoveTree(dir);
+
+  return 0;
+}
@@ -0,0 +1,243 @@
+/*
+ *    Copyright (C) 2015 juztamau5
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *    The above copyright notice and this permission notice shall be included in
+ *    all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include "testserver.h"
+
+#include "blockstore.h"
+#include "multihash.h"
+
+#include <atomic>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <sys/stat.h>
+
+using namespace IPSF;
+using namespace IPSF::Test;
+
+namespace
+{
+  std::string MakeBlock(const std::string& tag, unsigned int i)
+  {
+    return tag + " " + std::to_string(i);
+  }
+
+  /*!
+   * \brief Make a repo with an empty block directory, in the base32 layout
+   *        if <sharding> is given
+   */
+  std::string MakeRepo(const char* sharding)
+  {
+    const std::string repo = MakeTempRepo();
+    TEST_CHECK(!repo.empty());
+    TEST_CHECK(mkdir((repo + "/blocks").c_str(), 0755) == 0);
+
+    // Thousands of synced writes would only slow the test down
+    {
+      std::ofstream config((repo + "/config").c_str());
+      config << "{ \"Datastore\": { \"NoSync\": true } }\n";
+      TEST_CHECK(config.good());
+    }
+
+    if (sharding)
+    {
+      std::ofstream file((repo + "/blocks/SHARDING").c_str());
+      file << sharding << "\n";
+      TEST_CHECK(file.good());
+    }
+
+    return repo;
+  }
+
+  void TestPersistence(const char* sharding)
+  {
+    const std::string repo = MakeRepo(sharding);
+
+    std::vector<std::string> keys;
+    {
+      CBlockstore store;
+      TEST_CHECK(store.Open(repo));
+
+      for (unsigned int i = 0; i < 500; i++)
+      {
+        std::string multihash;
+        TEST_CHECK(store.Put(MakeBlock("saved", i), multihash));
+        keys.push_back(multihash);
+      }
+
+      std::string block;
+      TEST_CHECK(store.Get(keys[7], block) && block == MakeBlock("saved", 7));
+      TEST_CHECK(!store.Has(std::string(34, 'x')));
+
+      store.Close();
+    }
+
+    // The saved filter knows every block
+    CBlockstore store;
+    TEST_CHECK(store.Open(repo));
+    for (std::vector<std::string>::const_iterator it = keys.begin(); it != keys.end(); ++it)
+      TEST_CHECK(store.Has(*it));
+
+    RemoveTree(repo);
+  }
+
+  void TestOtherWriter(const char* sharding)
+  {
+    const std::string repo = MakeRepo(sharding);
+
+    CBlockstore store;
+    TEST_CHECK(store.Open(repo));
+
+    // Blocks written behind the store's back, as by a daemon
+    CBlockstore other;
+    TEST_CHECK(other.Open(repo));
+
+    std::vector<std::string> keys;
+    for (unsigned int i = 0; i < 50; i++)
+    {
+      std::string multihash;
+      TEST_CHECK(other.Put(MakeBlock("other", i), multihash));
+      keys.push_back(multihash);
+    }
+
+    // Reads go to the disk, but only confirmed misses find them
+    std::string block;
+    TEST_CHECK(store.Get(keys[0], block));
+
+    store.SetConfirmMisses(true);
+    for (std::vector<std::string>::const_iterator it = keys.begin(); it != keys.end(); ++it)
+      TEST_CHECK(store.Has(*it));
+    store.SetConfirmMisses(false);
+
+    // A refresh scans the directories that changed
+    TEST_CHECK(store.RefreshFilter(false));
+    for (std::vector<std::string>::const_iterator it = keys.begin(); it != keys.end(); ++it)
+      TEST_CHECK(store.Has(*it));
+
+    // So does reopening
+    other.Close();
+    store.Close();
+
+    CBlockstore reopened;
+    TEST_CHECK(reopened.Open(repo));
+    for (std::vector<std::string>::const_iterator it = keys.begin(); it != keys.end(); ++it)
+      TEST_CHECK(reopened.Has(*it));
+
+    RemoveTree(repo);
+  }
+
+  void TestWriteDuringRebuild(const char* sharding)
+  {
+    const std::string repo = MakeRepo(sharding);
+
+    CBlockstore store;
+    TEST_CHECK(store.Open(repo));
+
+    // Enough blocks that a rebuild takes a while
+    for (unsigned int i = 0; i < 3000; i++)
+    {
+      std::string multihash;
+      TEST_CHECK(store.Put(MakeBlock("existing", i), multihash));
+    }
+
+    // Blocks put while the filter is rebuilt are found as soon as Put returns
+    std::atomic<bool> bWriting(true);
+    std::vector<std::string> written;
+    std::thread writer([&store, &bWriting, &written]()
+    {
+      for (unsigned int i = 0; i < 2000; i++)
+      {
+        std::string multihash;
+        TEST_CHECK(store.Put(MakeBlock("during", i), multihash));
+        TEST_CHECK(store.Has(multihash));
+        written.push_back(multihash);
+      }
+      bWriting = false;
+    });
+
+    unsigned int rebuilds = 0;
+    while (bWriting || rebuilds < 2)
+    {
+      TEST_CHECK(store.RefreshFilter(rebuilds % 2 == 0));
+      rebuilds++;
+    }
+
+    writer.join();
+
+    // Including once every rebuild has finished
+    for (std::vector<std::string>::const_iterator it = written.begin(); it != written.end(); ++it)
+      TEST_CHECK(store.Has(*it));
+
+    RemoveTree(repo);
+  }
+
+  void TestPutMany(void)
+  {
+    const std::string repo = MakeRepo(NULL);
+
+    CBlockstore store;
+    TEST_CHECK(store.Open(repo));
+
+    // Single and batched puts mixed, with a duplicate in the batch
+    std::vector<std::string> keys;
+    std::vector<std::pair<std::string, std::string>> batch;
+    for (unsigned int i = 0; i < 2000; i++)
+    {
+      const std::string block = MakeBlock("batched", i);
+      std::string multihash;
+      if (i % 2 == 0)
+      {
+        TEST_CHECK(store.Put(block, multihash));
+      }
+      else
+      {
+        multihash = Multihash(block.data(), block.size());
+        batch.push_back(std::make_pair(multihash, block));
+      }
+      keys.push_back(multihash);
+    }
+    batch.push_back(batch.front());
+    TEST_CHECK(store.PutMany(batch));
+
+    for (std::vector<std::string>::const_iterator it = keys.begin(); it != keys.end(); ++it)
+      TEST_CHECK(store.Has(*it));
+
+    RemoveTree(repo);
+  }
+}
+
+int main(void)
+{
+  const char* const layouts[] = { NULL, "/repo/flatfs/shard/v1/next-to-last/2" };
+
+  for (unsigned int i = 0; i < 2; i++)
+  {
+    TestPersistence(layouts[i]);
+    TestOtherWriter(layouts[i]);
+    TestWriteDuringRebuild(layouts[i]);
+  }
+  TestPutMany();
+
+  return 0;
+}
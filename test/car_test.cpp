@@ -0,0 +1,251 @@
+/*
+ *    Copyright (C) 2015 juztamau5
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *    The above copyright notice and this permission notice shall be included in
+ *    all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include "testserver.h"
+
+#include "merkledag.h"
+#include "multihash.h"
+
+#include "ipfs/libipfs.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+
+using namespace IPSF;
+using namespace IPSF::Test;
+
+namespace
+{
+  void* Alloc(size_t size, void*) { return std::malloc(size); }
+  void Free(void* ptr, size_t, void*) { std::free(ptr); }
+
+  const ipfs_allocator_t ALLOCATOR = { Alloc, Free, NULL };
+
+  ipfs_node_t* MakeLocalNode(const std::string& repo)
+  {
+    ipfs_node_t* node = ipfs_node_new(repo.c_str(), IPFS_OPEN_DEFAULT);
+    TEST_CHECK(node != NULL);
+    ipfs_node_use(node);
+    ipfs_init(1024, "", false);
+    ipfs_node_use(NULL);
+    ipfs_node_free(node);
+
+    mkdir((repo + "/blocks").c_str(), 0755);
+
+    node = ipfs_node_new(repo.c_str(), IPFS_OPEN_LOCAL);
+    TEST_CHECK(node != NULL);
+    return node;
+  }
+
+  std::string ReadAll(int fd)
+  {
+    TEST_CHECK(lseek(fd, 0, SEEK_SET) == 0);
+
+    std::string data;
+    char buffer[65536];
+    ssize_t result;
+    while ((result = read(fd, buffer, sizeof(buffer))) > 0)
+      data.append(buffer, static_cast<size_t>(result));
+    return data;
+  }
+
+  int WriteTemp(const std::string& dir, const std::string& name, const std::string& data)
+  {
+    int fd = open((dir + "/" + name).c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    TEST_CHECK(fd >= 0);
+    TEST_CHECK(write(fd, data.data(), data.size()) == static_cast<ssize_t>(data.size()));
+    TEST_CHECK(lseek(fd, 0, SEEK_SET) == 0);
+    return fd;
+  }
+
+  std::string GetBlock(const std::string& key)
+  {
+    void* data = NULL;
+    size_t size = 0;
+    TEST_CHECK(ipfs_block_get_alloc(key.c_str(), &ALLOCATOR, &data, &size));
+
+    std::string block(static_cast<char*>(data), size);
+    std::free(data);
+    return block;
+  }
+
+  /*!
+   * \brief Build a DAG with a shared child, an empty node and a large leaf
+   */
+  std::string BuildDag(std::vector<std::string>& keys)
+  {
+    ipfs_dag_builder_t* builder = ipfs_dag_builder_new();
+    TEST_CHECK(builder != NULL);
+
+    std::string large(300 * 1024, '\0');
+    for (size_t i = 0; i < large.size(); i++)
+      large[i] = static_cast<char>(i * 7);
+
+    const int shared = ipfs_dag_node_new(builder);
+    const int empty = ipfs_dag_node_new(builder);
+    const int leaf = ipfs_dag_node_new(builder);
+    const int left = ipfs_dag_node_new(builder);
+    const int right = ipfs_dag_node_new(builder);
+    const int root = ipfs_dag_node_new(builder);
+    TEST_CHECK(ipfs_dag_node_set_data(builder, shared, "shared", 6));
+    TEST_CHECK(ipfs_dag_node_set_data(builder, leaf, large.data(), large.size()));
+    TEST_CHECK(ipfs_dag_node_add_child(builder, left, shared, "s"));
+    TEST_CHECK(ipfs_dag_node_add_child(builder, left, leaf, "l"));
+    TEST_CHECK(ipfs_dag_node_add_child(builder, right, shared, "s"));
+    TEST_CHECK(ipfs_dag_node_add_child(builder, right, empty, "e"));
+    TEST_CHECK(ipfs_dag_node_add_child(builder, root, left, "left"));
+    TEST_CHECK(ipfs_dag_node_add_child(builder, root, right, "right"));
+
+    char key[64];
+    TEST_CHECK(ipfs_dag_builder_flush(builder, root, key, sizeof(key)));
+    ipfs_dag_builder_free(builder);
+
+    // Every block the archive must carry, found by walking the DAG
+    keys.clear();
+    std::vector<std::string> pending(1, key);
+    while (!pending.empty())
+    {
+      const std::string next = pending.back();
+      pending.pop_back();
+      if (std::find(keys.begin(), keys.end(), next) != keys.end())
+        continue;
+      keys.push_back(next);
+
+      std::vector<DagLink> links;
+      std::string data;
+      TEST_CHECK(DecodeDagNode(GetBlock(next), links, data));
+      for (std::vector<DagLink>::const_iterator it = links.begin(); it != links.end(); ++it)
+        pending.push_back(EncodeBase58(it->hash));
+    }
+    TEST_CHECK(keys.size() == 6);
+
+    return key;
+  }
+
+  void TestRoundTrip(const std::string& dir, ipfs_node_t* source, ipfs_node_t* target)
+  {
+    ipfs_node_use(source);
+
+    std::vector<std::string> keys;
+    const std::string root = BuildDag(keys);
+
+    int fd = WriteTemp(dir, "dag.car", "");
+    TEST_CHECK(ipfs_dag_export(root.c_str(), fd));
+    const std::string archive = ReadAll(fd);
+
+    // Each block is stored once, even if it's linked twice
+    size_t payload = 0;
+    for (std::vector<std::string>::const_iterator it = keys.begin(); it != keys.end(); ++it)
+      payload += GetBlock(*it).size();
+    TEST_CHECK(archive.size() > payload && archive.size() < payload + 1024);
+
+    ipfs_node_use(target);
+    for (std::vector<std::string>::const_iterator it = keys.begin(); it != keys.end(); ++it)
+      TEST_CHECK(!ipfs_block_has(it->c_str()));
+
+    TEST_CHECK(lseek(fd, 0, SEEK_SET) == 0);
+    char roots[128];
+    TEST_CHECK(ipfs_dag_import(fd, roots, sizeof(roots)) == 1);
+    TEST_CHECK(root == roots);
+    close(fd);
+
+    // The target has the same blocks and exports the same archive
+    for (std::vector<std::string>::const_iterator it = keys.begin(); it != keys.end(); ++it)
+    {
+      const std::string block = GetBlock(*it);
+      TEST_CHECK(EncodeBase58(Multihash(block.data(), block.size())) == *it);
+    }
+
+    fd = WriteTemp(dir, "again.car", "");
+    TEST_CHECK(ipfs_dag_export(root.c_str(), fd));
+    TEST_CHECK(ReadAll(fd) == archive);
+    close(fd);
+
+    ipfs_node_use(source);
+
+    // A block that doesn't match its key fails the import
+    std::string corrupt = archive;
+    corrupt[corrupt.size() - 100] ^= 1;
+    fd = WriteTemp(dir, "corrupt.car", corrupt);
+    TEST_CHECK(ipfs_dag_import(fd, NULL, 0) == -1);
+    close(fd);
+
+    // So does an archive cut off in a block
+    fd = WriteTemp(dir, "truncated.car", archive.substr(0, archive.size() - 10));
+    TEST_CHECK(ipfs_dag_import(fd, NULL, 0) == -1);
+    close(fd);
+
+    ipfs_node_use(NULL);
+  }
+
+  void TestMissingBlock(const std::string& dir, ipfs_node_t* node)
+  {
+    ipfs_node_use(node);
+
+    // Linked, but never stored
+    const std::string absent = EncodeDagNode(std::vector<DagLink>(), "absent");
+    const std::string absentKey = EncodeBase58(Multihash(absent.data(), absent.size()));
+
+    ipfs_dag_builder_t* builder = ipfs_dag_builder_new();
+    const int root = ipfs_dag_node_new(builder);
+    TEST_CHECK(ipfs_dag_node_add_link(builder, root, absentKey.c_str(), "absent", absent.size()));
+
+    char key[64];
+    TEST_CHECK(ipfs_dag_builder_flush(builder, root, key, sizeof(key)));
+    ipfs_dag_builder_free(builder);
+
+    int fd = WriteTemp(dir, "missing.car", "");
+    TEST_CHECK(!ipfs_dag_export(key, fd));
+    close(fd);
+
+    ipfs_node_use(NULL);
+  }
+}
+
+int main(void)
+{
+  const std::string dir = MakeTempRepo();
+  const std::string sourceRepo = MakeTempRepo();
+  const std::string targetRepo = MakeTempRepo();
+  TEST_CHECK(!dir.empty() && !sourceRepo.empty() && !targetRepo.empty());
+
+  ipfs_node_t* source = MakeLocalNode(sourceRepo);
+  ipfs_node_t* target = MakeLocalNode(targetRepo);
+
+  TestRoundTrip(dir, source, target);
+  TestMissingBlock(dir, source);
+
+  ipfs_node_free(target);
+  ipfs_node_free(source);
+
+  RemoveTree(targetRepo);
+  RemoveTree(sourceRepo);
+  RemoveTree(dir);
+
+  return 0;
+}
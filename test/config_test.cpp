@@ -0,0 +1,128 @@
+/*
+ *    Copyright (C) 2015 juztamau5
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *    The above copyright notice and this permission notice shall be included in
+ *    all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include "testserver.h"
+
+#include "config.h"
+#include "json.h"
+
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace IPSF;
+using namespace IPSF::Test;
+
+namespace
+{
+  std::string ReadFile(const std::string& path)
+  {
+    std::ifstream file(path.c_str());
+    std::stringstream contents;
+    contents << file.rdbuf();
+    return contents.str();
+  }
+
+  void Handle(const HttpRequest& request, int fd)
+  {
+    SendResponse(fd, request.target == "/api/v0/config/replace" ? 200 : 404, "");
+  }
+
+  CJsonValue MakeString(const std::string& value)
+  {
+    CJsonValue json;
+    json.SetString(value);
+    return json;
+  }
+
+  CJsonValue MakeInteger(int64_t value)
+  {
+    CJsonValue json;
+    json.SetInteger(value);
+    return json;
+  }
+}
+
+int main(void)
+{
+  const std::string repoPath = MakeTempRepo();
+  TEST_CHECK(!repoPath.empty());
+
+  {
+    std::ofstream file((repoPath + "/config").c_str());
+    file << "{\"Addresses\": {\"API\": \"/ip4/127.0.0.1/tcp/5001\"}, \"Bootstrap\": []}";
+  }
+
+  // Without a daemon, changes are written to the file
+  CConfig config;
+  TEST_CHECK(config.Load(repoPath));
+  TEST_CHECK(config.Set("Addresses.Gateway", MakeString("/ip4/127.0.0.1/tcp/8080")));
+  TEST_CHECK(config.Set("Datastore.StorageMax", MakeString("10GB")));
+  TEST_CHECK(!config.Set("Addresses.API.Port", MakeInteger(1)));
+  TEST_CHECK(config.Get("Datastore.StorageMax")->AsString() == "10GB");
+  TEST_CHECK(config.Commit(true));
+
+  CJsonValue written;
+  TEST_CHECK(CJsonValue::Parse(ReadFile(repoPath + "/config"), written));
+  TEST_CHECK(written["Addresses"]["Gateway"].AsString() == "/ip4/127.0.0.1/tcp/8080");
+  TEST_CHECK(written["Addresses"]["API"].AsString() == "/ip4/127.0.0.1/tcp/5001");
+  TEST_CHECK(written["Datastore"]["StorageMax"].AsString() == "10GB");
+
+  // With a daemon, every change goes out in one replace
+  CLoopbackServer server(Handle);
+  TEST_CHECK(server.Start());
+  TEST_CHECK(server.WriteApiFile(repoPath));
+
+  TEST_CHECK(config.Set("Addresses.Swarm", MakeString("/ip4/0.0.0.0/tcp/4002")));
+  TEST_CHECK(config.Set("Datastore.StorageMax", MakeString("20GB")));
+  TEST_CHECK(config.Set("Discovery.MDNS.Enabled", MakeInteger(0)));
+  TEST_CHECK(config.Commit(true));
+
+  const std::vector<HttpRequest> requests = server.GetRequests();
+  TEST_CHECK(requests.size() == 1);
+  TEST_CHECK(requests[0].target == "/api/v0/config/replace");
+
+  const size_t begin = requests[0].body.find("\r\n\r\n") + 4;
+  const size_t end = requests[0].body.rfind("\r\n--", requests[0].body.size() - 3);
+  CJsonValue replaced;
+  TEST_CHECK(CJsonValue::Parse(requests[0].body.substr(begin, end - begin), replaced));
+  TEST_CHECK(replaced["Datastore"]["StorageMax"].AsString() == "20GB");
+  TEST_CHECK(replaced["Addresses"]["Swarm"].AsString() == "/ip4/0.0.0.0/tcp/4002");
+  TEST_CHECK(replaced["Addresses"]["Gateway"].AsString() == "/ip4/127.0.0.1/tcp/8080");
+
+  // Without notifying, the daemon isn't contacted
+  TEST_CHECK(config.Set("Datastore.StorageMax", MakeString("30GB")));
+  TEST_CHECK(config.Commit(false));
+  TEST_CHECK(server.GetRequests().size() == 1);
+  TEST_CHECK(CJsonValue::Parse(ReadFile(repoPath + "/config"), written));
+  TEST_CHECK(written["Datastore"]["StorageMax"].AsString() == "30GB");
+
+  server.Stop();
+
+  unlink((repoPath + "/api").c_str());
+  unlink((repoPath + "/config").c_str());
+  rmdir(repoPath.c_str());
+
+  return 0;
+}
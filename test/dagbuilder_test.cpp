@@ -0,0 +1,195 @@
+/*
+ *    Copyright (C) 2015 juztamau5
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *    The above copyright notice and this permission notice shall be included in
+ *    all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include "testserver.h"
+
+#include "merkledag.h"
+#include "multihash.h"
+
+#include "ipfs/libipfs.h"
+
+#include <string>
+#include <vector>
+
+#include <sys/stat.h>
+
+using namespace IPSF;
+using namespace IPSF::Test;
+
+namespace
+{
+  std::string GetBlock(const std::string& key)
+  {
+    std::vector<char> buffer(1024 * 1024);
+    size_t size;
+    TEST_CHECK(ipfs_block_get_data(key.c_str(), buffer.data(), buffer.size(), &size));
+    return std::string(buffer.data(), size);
+  }
+
+  void TestErrors(void)
+  {
+    ipfs_dag_builder_t* builder = ipfs_dag_builder_new();
+    TEST_CHECK(builder != NULL);
+
+    TEST_CHECK(ipfs_dag_node_new(builder) == 0);
+    TEST_CHECK(ipfs_dag_node_new(builder) == 1);
+
+    // Children must come first, so there are no cycles
+    TEST_CHECK(!ipfs_dag_node_add_child(builder, 0, 1, "later"));
+    TEST_CHECK(!ipfs_dag_node_add_child(builder, 1, 1, "self"));
+    TEST_CHECK(!ipfs_dag_node_add_child(builder, 2, 0, "unknown"));
+    TEST_CHECK(!ipfs_dag_node_set_data(builder, 2, "x", 1));
+    TEST_CHECK(!ipfs_dag_node_set_data(builder, 0, NULL, 1));
+    TEST_CHECK(!ipfs_dag_node_add_link(builder, 0, "QmNotAKey", "bad", 1));
+    TEST_CHECK(!ipfs_dag_builder_flush(builder, 2, NULL, 0));
+
+    // A key that doesn't fit is an error, but the nodes were stored
+    char key[8];
+    TEST_CHECK(!ipfs_dag_builder_flush(builder, 1, key, sizeof(key)));
+
+    // Flushing empties the builder
+    TEST_CHECK(!ipfs_dag_builder_flush(builder, 0, NULL, 0));
+    TEST_CHECK(ipfs_dag_node_new(builder) == 0);
+
+    ipfs_dag_builder_free(builder);
+  }
+
+  void TestWideLevel(void)
+  {
+    // More leaves than one encoding task takes, plus a link to a stored block
+    const unsigned int LEAF_COUNT = 1000;
+
+    const std::string stored = EncodeDagNode(std::vector<DagLink>(), "stored");
+    char storedKey[64];
+    TEST_CHECK(ipfs_block_put_data(stored.data(), stored.size(), storedKey, sizeof(storedKey)));
+
+    ipfs_dag_builder_t* builder = ipfs_dag_builder_new();
+
+    std::vector<DagLink> expectedLinks;
+    for (unsigned int i = 0; i < LEAF_COUNT; i++)
+    {
+      const std::string data = "leaf " + std::to_string(i);
+      const int leaf = ipfs_dag_node_new(builder);
+      TEST_CHECK(ipfs_dag_node_set_data(builder, leaf, data.data(), data.size()));
+
+      const std::string block = EncodeDagNode(std::vector<DagLink>(), data);
+      DagLink link;
+      link.hash = Multihash(block.data(), block.size());
+      link.name = std::to_string(i);
+      link.size = block.size();
+      expectedLinks.push_back(link);
+    }
+
+    const int root = ipfs_dag_node_new(builder);
+    for (unsigned int i = 0; i < LEAF_COUNT; i++)
+      TEST_CHECK(ipfs_dag_node_add_child(builder, root, static_cast<int>(i), std::to_string(i).c_str()));
+    TEST_CHECK(ipfs_dag_node_add_link(builder, root, storedKey, "stored", stored.size()));
+    TEST_CHECK(ipfs_dag_node_set_data(builder, root, "root", 4));
+
+    DagLink storedLink;
+    TEST_CHECK(DecodeKey(storedKey, storedLink.hash));
+    storedLink.name = "stored";
+    storedLink.size = stored.size();
+    expectedLinks.push_back(storedLink);
+
+    char key[64];
+    TEST_CHECK(ipfs_dag_builder_flush(builder, root, key, sizeof(key)));
+    ipfs_dag_builder_free(builder);
+
+    // Links keep their order, with the children's keys and cumulative sizes
+    const std::string expected = EncodeDagNode(expectedLinks, "root");
+    TEST_CHECK(EncodeBase58(Multihash(expected.data(), expected.size())) == key);
+
+    std::vector<DagLink> links;
+    std::string data;
+    const std::string rootBlock = GetBlock(key);
+    TEST_CHECK(DecodeDagNode(rootBlock, links, data) && data == "root");
+    TEST_CHECK(links.size() == LEAF_COUNT + 1);
+
+    // Every leaf was stored
+    for (unsigned int i = 0; i < LEAF_COUNT; i += 97)
+    {
+      const std::string leaf = GetBlock(EncodeBase58(links[i].hash));
+      TEST_CHECK(leaf.size() == links[i].size);
+    }
+  }
+
+  void TestDeepChain(void)
+  {
+    // Each level holds one node, and sizes add up along the chain
+    ipfs_dag_builder_t* builder = ipfs_dag_builder_new();
+
+    const int DEPTH = 50;
+    int previous = ipfs_dag_node_new(builder);
+    TEST_CHECK(ipfs_dag_node_set_data(builder, previous, "bottom", 6));
+    for (int i = 1; i < DEPTH; i++)
+    {
+      const int node = ipfs_dag_node_new(builder);
+      TEST_CHECK(ipfs_dag_node_add_child(builder, node, previous, "down"));
+      previous = node;
+    }
+
+    char key[64];
+    TEST_CHECK(ipfs_dag_builder_flush(builder, previous, key, sizeof(key)));
+    ipfs_dag_builder_free(builder);
+
+    uint64_t expectedSize = EncodeDagNode(std::vector<DagLink>(), "bottom").size();
+    std::string next = key;
+    std::vector<uint64_t> sizes;
+    for (int i = 1; i < DEPTH; i++)
+    {
+      std::vector<DagLink> links;
+      std::string data;
+      TEST_CHECK(DecodeDagNode(GetBlock(next), links, data) && links.size() == 1);
+      sizes.push_back(links[0].size);
+      next = EncodeBase58(links[0].hash);
+    }
+    TEST_CHECK(GetBlock(next) == EncodeDagNode(std::vector<DagLink>(), "bottom"));
+
+    // From the bottom up, each link covers the node below and its links
+    TEST_CHECK(sizes.back() == expectedSize);
+    for (size_t i = sizes.size() - 1; i > 0; i--)
+      TEST_CHECK(sizes[i - 1] > sizes[i]);
+  }
+}
+
+int main(void)
+{
+  const std::string repo = MakeTempRepo();
+  TEST_CHECK(!repo.empty());
+
+  TEST_CHECK(ipfs_open(repo.c_str(), IPFS_OPEN_DEFAULT));
+  ipfs_init(1024, "", false);
+  mkdir((repo + "/blocks").c_str(), 0755);
+  TEST_CHECK(ipfs_open(repo.c_str(), IPFS_OPEN_LOCAL));
+
+  TestErrors();
+  TestWideLevel();
+  TestDeepChain();
+
+  ipfs_close();
+
+  RemoveTree(repo);
+
+  return 0;
+}
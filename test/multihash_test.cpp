@@ -0,0 +1,148 @@
+/*
+ *    Copyright (C) 2015 juztamau5
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *    The above copyright notice and this permission notice shall be included in
+ *    all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include "testserver.h"
+
+#include "multihash.h"
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace IPSF;
+using namespace IPSF::Test;
+
+namespace
+{
+  const Sha256Kernel KERNELS[] = { Sha256Scalar, Sha256Avx2, Sha256ShaNi };
+
+  std::string HexDigest(const std::string& data)
+  {
+    uint8_t digest[SHA256_DIGEST_SIZE];
+    Sha256(data.data(), data.size(), digest);
+
+    static const char HEX[] = "0123456789abcdef";
+    std::string hex;
+    for (unsigned int i = 0; i < SHA256_DIGEST_SIZE; i++)
+    {
+      hex.push_back(HEX[digest[i] >> 4]);
+      hex.push_back(HEX[digest[i] & 0xf]);
+    }
+    return hex;
+  }
+
+  /*!
+   * \brief Deterministic filler, so failures can be reproduced
+   */
+  std::string MakeData(size_t size, uint32_t seed)
+  {
+    std::string data(size, '\0');
+    for (size_t i = 0; i < size; i++)
+    {
+      seed = seed * 1664525 + 1013904223;
+      data[i] = static_cast<char>(seed >> 24);
+    }
+    return data;
+  }
+
+  /*!
+   * \brief Messages around the padding boundaries and a whole chunk
+   */
+  std::vector<std::string> MakeMessages(void)
+  {
+    std::vector<std::string> messages;
+    for (size_t size = 0; size <= 200; size++)
+      messages.push_back(MakeData(size, static_cast<uint32_t>(size)));
+    messages.push_back(MakeData(256 * 1024, 1));
+    messages.push_back(MakeData(256 * 1024 + 14, 2));
+    return messages;
+  }
+
+  void TestVectors(void)
+  {
+    for (unsigned int i = 0; i < sizeof(KERNELS) / sizeof(KERNELS[0]); i++)
+    {
+      if (!SetSha256Kernel(KERNELS[i]))
+        continue;
+
+      TEST_CHECK(GetSha256Kernel() == KERNELS[i]);
+      TEST_CHECK(HexDigest("") == "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855");
+      TEST_CHECK(HexDigest("abc") == "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad");
+      TEST_CHECK(HexDigest("abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq") ==
+                 "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1");
+      TEST_CHECK(HexDigest(std::string(1000000, 'a')) == "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0");
+    }
+  }
+
+  void TestKernelsAgree(void)
+  {
+    const std::vector<std::string> messages = MakeMessages();
+
+    TEST_CHECK(SetSha256Kernel(Sha256Scalar));
+    std::vector<std::string> expected;
+    for (size_t i = 0; i < messages.size(); i++)
+      expected.push_back(Multihash(messages[i].data(), messages[i].size()));
+
+    for (unsigned int i = 0; i < sizeof(KERNELS) / sizeof(KERNELS[0]); i++)
+    {
+      if (!SetSha256Kernel(KERNELS[i]))
+        continue;
+
+      for (size_t j = 0; j < messages.size(); j++)
+        TEST_CHECK(Multihash(messages[j].data(), messages[j].size()) == expected[j]);
+
+      std::vector<std::string> multihashes;
+      MultihashMany(messages, multihashes);
+      TEST_CHECK(multihashes == expected);
+
+      // Runs of equal sizes longer and shorter than the lanes
+      std::vector<std::string> leaves;
+      for (unsigned int j = 0; j < 19; j++)
+        leaves.push_back(MakeData(j < 11 ? 1000 : 64, 100 + j));
+      leaves.push_back(MakeData(55, 200));
+
+      std::vector<std::string> leafHashes;
+      MultihashMany(leaves, leafHashes);
+      TEST_CHECK(leafHashes.size() == leaves.size());
+      for (size_t j = 0; j < leaves.size(); j++)
+      {
+        SetSha256Kernel(Sha256Scalar);
+        const std::string leafHash = Multihash(leaves[j].data(), leaves[j].size());
+        SetSha256Kernel(KERNELS[i]);
+        TEST_CHECK(leafHashes[j] == leafHash);
+      }
+    }
+  }
+}
+
+int main(void)
+{
+  const Sha256Kernel kernel = GetSha256Kernel();
+
+  TestVectors();
+  TestKernelsAgree();
+
+  TEST_CHECK(SetSha256Kernel(kernel));
+
+  return 0;
+}
@@ -0,0 +1,149 @@
+/*
+ *    Copyright (C) 2015 juztamau5
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *    The above copyright notice and this permission notice shall be included in
+ *    all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include "testserver.h"
+
+#include "ipfs/libipfs.h"
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <vector>
+
+using namespace IPSF::Test;
+
+namespace
+{
+  const char* const NAME = "QmName";
+  const char* const SLOW_NAME = "QmSlowName";
+
+  /*!
+   * \brief Answers resolutions with a new value each time
+   */
+  struct Resolver
+  {
+    explicit Resolver(const std::string& tag) : tag(tag), count(0), bAnswered(false) { }
+
+    void Handle(const HttpRequest& request, int fd)
+    {
+      if (request.target.compare(0, 21, "/api/v0/name/resolve?") != 0)
+      {
+        SendResponse(fd, 200, "");
+        return;
+      }
+
+      const int value = ++count;
+      if (request.target.find(SLOW_NAME) != std::string::npos)
+        std::this_thread::sleep_for(std::chrono::milliseconds(300));
+
+      SendResponse(fd, 200, "{\"Path\":\"/ipfs/Qm" + tag + std::to_string(value) + "\"}");
+      bAnswered = true;
+    }
+
+    const std::string tag;
+    std::atomic<int>  count;
+    std::atomic<bool> bAnswered;
+  };
+
+  std::string Resolve(const char* name)
+  {
+    char path[256];
+    return ipfs_name_resolve_path(name, path, sizeof(path)) ? path : "";
+  }
+
+  unsigned int CountEntries(void)
+  {
+    ipfs_name_cache_stats_t stats;
+    return ipfs_name_cache_stats(&stats) ? stats.entries : 0;
+  }
+}
+
+int main(void)
+{
+  const std::string repoA = MakeTempRepo();
+  const std::string repoB = MakeTempRepo();
+  TEST_CHECK(!repoA.empty() && !repoB.empty());
+
+  Resolver resolverA("A");
+  Resolver resolverB("B");
+  CLoopbackServer serverA([&resolverA](const HttpRequest& request, int fd) { resolverA.Handle(request, fd); });
+  CLoopbackServer serverB([&resolverB](const HttpRequest& request, int fd) { resolverB.Handle(request, fd); });
+  TEST_CHECK(serverA.Start() && serverA.WriteApiFile(repoA));
+  TEST_CHECK(serverB.Start() && serverB.WriteApiFile(repoB));
+
+  TEST_CHECK(ipfs_open(repoA.c_str(), IPFS_OPEN_DEFAULT));
+
+  // The second lookup is answered from the cache
+  TEST_CHECK(Resolve(NAME) == "/ipfs/QmA1");
+  TEST_CHECK(Resolve((std::string("/ipns/") + NAME).c_str()) == "/ipfs/QmA1");
+  TEST_CHECK(resolverA.count == 1);
+
+  // Another node keeps its own entries
+  ipfs_node_t* nodeB = ipfs_node_new(repoB.c_str(), IPFS_OPEN_DEFAULT);
+  TEST_CHECK(nodeB != NULL);
+
+  ipfs_node_use(nodeB);
+  TEST_CHECK(Resolve(NAME) == "/ipfs/QmB1");
+  ipfs_node_use(NULL);
+  TEST_CHECK(Resolve(NAME) == "/ipfs/QmA1");
+  TEST_CHECK(CountEntries() == 2);
+
+  // Publishing drops the name on every node
+  ipfs_name_publish(NAME, "/ipfs/QmValue");
+  TEST_CHECK(CountEntries() == 0);
+  TEST_CHECK(Resolve(NAME) == "/ipfs/QmA2");
+  ipfs_node_use(nodeB);
+  TEST_CHECK(Resolve(NAME) == "/ipfs/QmB2");
+
+  // Using an entry late in its TTL refreshes it in the background
+  ipfs_name_cache_configure(400, 4096);
+  TEST_CHECK(Resolve(SLOW_NAME) == "/ipfs/QmB3");
+  std::this_thread::sleep_for(std::chrono::milliseconds(320));
+  resolverB.bAnswered = false;
+  TEST_CHECK(Resolve(SLOW_NAME) == "/ipfs/QmB3");
+
+  const std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+  while (resolverB.count < 4 && std::chrono::steady_clock::now() < deadline)
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  TEST_CHECK(resolverB.count == 4);
+  TEST_CHECK(CountEntries() == 3);
+
+  // Freeing the node waits for its refresh and drops its entries
+  ipfs_node_use(NULL);
+  ipfs_node_free(nodeB);
+  TEST_CHECK(resolverB.bAnswered);
+  TEST_CHECK(CountEntries() == 1);
+
+  ipfs_close();
+  TEST_CHECK(CountEntries() == 0);
+
+  serverA.Stop();
+  serverB.Stop();
+
+  unlink((repoA + "/api").c_str());
+  unlink((repoB + "/api").c_str());
+  rmdir(repoA.c_str());
+  rmdir(repoB.c_str());
+
+  return 0;
+}
@@ -0,0 +1,363 @@
+/*
+ *    Copyright (C) 2015 juztamau5
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *    The above copyright notice and this permission notice shall be included in
+ *    all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include "testserver.h"
+
+#include "merkledag.h"
+#include "multihash.h"
+
+#include "ipfs/libipfs.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include <sys/stat.h>
+
+using namespace IPSF;
+using namespace IPSF::Test;
+
+namespace
+{
+  void* Alloc(size_t size, void*) { return std::malloc(size); }
+  void Free(void* ptr, size_t, void*) { std::free(ptr); }
+
+  const ipfs_allocator_t ALLOCATOR = { Alloc, Free, NULL };
+
+  /*!
+   * \brief Counts what it hands out and what the library gives back
+   */
+  struct AllocCounts
+  {
+    unsigned int allocs;
+    unsigned int frees;
+  };
+
+  void* CountedAlloc(size_t size, void* context)
+  {
+    static_cast<AllocCounts*>(context)->allocs++;
+    return std::malloc(size);
+  }
+
+  void CountedFree(void* ptr, size_t, void* context)
+  {
+    static_cast<AllocCounts*>(context)->frees++;
+    std::free(ptr);
+  }
+
+  std::string PutBlock(const std::string& block)
+  {
+    char key[64];
+    TEST_CHECK(ipfs_block_put_data(block.data(), block.size(), key, sizeof(key)));
+    return key;
+  }
+
+  bool GetBlock(const std::string& key, std::string& block)
+  {
+    std::vector<char> buffer(1024);
+    size_t size;
+    if (!ipfs_block_get_data(key.c_str(), buffer.data(), buffer.size(), &size))
+      return false;
+
+    block.assign(buffer.data(), size);
+    return true;
+  }
+
+  ipfs_node_t* MakeLocalNode(const std::string& repo)
+  {
+    ipfs_node_t* node = ipfs_node_new(repo.c_str(), IPFS_OPEN_DEFAULT);
+    TEST_CHECK(node != NULL);
+    ipfs_node_use(node);
+    ipfs_init(1024, "", false);
+    ipfs_node_use(NULL);
+    ipfs_node_free(node);
+
+    mkdir((repo + "/blocks").c_str(), 0755);
+
+    node = ipfs_node_new(repo.c_str(), IPFS_OPEN_LOCAL);
+    TEST_CHECK(node != NULL);
+    return node;
+  }
+
+  void TestLocalHit(void)
+  {
+    // Blocks are read and written without go-ipfs
+    const std::string block = EncodeDagNode(std::vector<DagLink>(), UnixfsFileData("local", std::vector<uint64_t>()));
+    const std::string key = PutBlock(block);
+
+    std::string read;
+    TEST_CHECK(GetBlock(key, read) && read == block);
+    TEST_CHECK(ipfs_block_has(key.c_str()));
+
+    void* data = NULL;
+    size_t size = 0;
+    TEST_CHECK(ipfs_block_get_alloc(key.c_str(), &ALLOCATOR, &data, &size));
+    TEST_CHECK(size == block.size() && std::string(static_cast<char*>(data), size) == block);
+    std::free(data);
+
+    std::vector<DagLink> links;
+    std::string nodeData;
+    TEST_CHECK(DecodeDagNode(block, links, nodeData));
+    TEST_CHECK(ipfs_object_data_alloc(key.c_str(), &ALLOCATOR, &data, &size));
+    TEST_CHECK(size == nodeData.size() && std::string(static_cast<char*>(data), size) == nodeData);
+    std::free(data);
+
+    TEST_CHECK(!GetBlock("QmNotAKey", read));
+  }
+
+  void TestEmptyAlloc(void)
+  {
+    AllocCounts counts = { 0, 0 };
+    const ipfs_allocator_t allocator = { CountedAlloc, CountedFree, &counts };
+
+    // Empty results succeed without taking memory
+    const std::string emptyKey = PutBlock("");
+
+    void* data = &counts;
+    size_t size = 1;
+    TEST_CHECK(ipfs_block_get_alloc(emptyKey.c_str(), &allocator, &data, &size));
+    TEST_CHECK(data == NULL && size == 0);
+
+    const std::string emptyNode = PutBlock(EncodeDagNode(std::vector<DagLink>(), ""));
+
+    data = &counts;
+    size = 1;
+    TEST_CHECK(ipfs_object_data_alloc(emptyNode.c_str(), &allocator, &data, &size));
+    TEST_CHECK(data == NULL && size == 0);
+
+    TEST_CHECK(counts.allocs == 0);
+  }
+
+  /*!
+   * \brief Store a unixfs node and get the link to it
+   */
+  DagLink PutFileNode(const std::vector<DagLink>& links, const std::string& contents,
+                      const std::vector<uint64_t>& blockSizes, const std::string& name)
+  {
+    const std::string block = EncodeDagNode(links, UnixfsFileData(contents, blockSizes));
+
+    uint64_t size = block.size();
+    for (std::vector<DagLink>::const_iterator it = links.begin(); it != links.end(); ++it)
+      size += it->size;
+
+    DagLink link;
+    TEST_CHECK(DecodeKey(PutBlock(block), link.hash));
+    link.name = name;
+    link.size = size;
+    return link;
+  }
+
+  void TestMultiBlockView(void)
+  {
+    // A file of two levels whose blocks are only in the blockstore, the
+    // repo has no block pack
+    const std::string parts[] = { "first leaf, ", "second leaf, ", "third leaf, ", "last leaf" };
+
+    std::vector<DagLink> leaves;
+    for (unsigned int i = 0; i < 4; i++)
+      leaves.push_back(PutFileNode(std::vector<DagLink>(), parts[i], std::vector<uint64_t>(), ""));
+
+    std::vector<uint64_t> innerSizes;
+    innerSizes.push_back(parts[1].size());
+    innerSizes.push_back(parts[2].size());
+    const DagLink inner = PutFileNode(std::vector<DagLink>(leaves.begin() + 1, leaves.begin() + 3), "", innerSizes, "");
+
+    std::vector<DagLink> rootLinks;
+    rootLinks.push_back(leaves[0]);
+    rootLinks.push_back(inner);
+    rootLinks.push_back(leaves[3]);
+
+    std::vector<uint64_t> rootSizes;
+    rootSizes.push_back(parts[0].size());
+    rootSizes.push_back(parts[1].size() + parts[2].size());
+    rootSizes.push_back(parts[3].size());
+    const DagLink root = PutFileNode(rootLinks, "", rootSizes, "file");
+
+    std::vector<DagLink> entries(1, root);
+    const std::string dir = PutBlock(EncodeDagNode(entries, UnixfsDirectoryData()));
+
+    const std::string contents = parts[0] + parts[1] + parts[2] + parts[3];
+    const std::string paths[] = { EncodeBase58(root.hash), "/ipfs/" + EncodeBase58(root.hash), "/ipfs/" + dir + "/file" };
+
+    for (unsigned int i = 0; i < 3; i++)
+    {
+      // One piece per leaf, in file order, read without go-ipfs
+      ipfs_view_t view;
+      TEST_CHECK(ipfs_cat_view(paths[i].c_str(), &view));
+      TEST_CHECK(view.piece_count == 4);
+      TEST_CHECK(view.size == contents.size());
+
+      std::string read;
+      for (size_t j = 0; j < view.piece_count; j++)
+      {
+        TEST_CHECK(view.pieces[j].size == parts[j].size());
+        read.append(static_cast<const char*>(view.pieces[j].data), view.pieces[j].size);
+      }
+      TEST_CHECK(read == contents);
+
+      ipfs_view_release(&view);
+      TEST_CHECK(view.pieces == NULL && view.piece_count == 0 && view.handle == NULL);
+    }
+  }
+
+  void TestEmptyAllocThroughApi(void)
+  {
+    // Output collected from a daemon, on a node of its own so the API file
+    // doesn't take the other node's blockstore away
+    CLoopbackServer server([](const HttpRequest& request, int fd)
+    {
+      if (request.target.find("QmFull") != std::string::npos)
+        SendResponse(fd, 200, "full");
+      else if (request.target.find("QmMissing") != std::string::npos)
+        SendResponse(fd, 500, "{\"Message\":\"not found\",\"Code\":0}");
+      else
+        SendResponse(fd, 200, "");
+    });
+    TEST_CHECK(server.Start());
+
+    const std::string repo = MakeTempRepo();
+    TEST_CHECK(!repo.empty() && server.WriteApiFile(repo));
+
+    ipfs_node_t* node = ipfs_node_new(repo.c_str(), IPFS_OPEN_DEFAULT);
+    TEST_CHECK(node != NULL);
+    ipfs_node_use(node);
+
+    AllocCounts counts = { 0, 0 };
+    const ipfs_allocator_t allocator = { CountedAlloc, CountedFree, &counts };
+
+    void* data = &counts;
+    size_t size = 1;
+    TEST_CHECK(ipfs_cat_alloc("/ipfs/QmEmpty", &allocator, &data, &size));
+    TEST_CHECK(data == NULL && size == 0);
+
+    data = &counts;
+    size = 1;
+    TEST_CHECK(ipfs_object_get_alloc("QmEmpty", &allocator, &data, &size));
+    TEST_CHECK(data == NULL && size == 0);
+
+    TEST_CHECK(counts.allocs == 0);
+
+    // Unlike full and failed ones
+    TEST_CHECK(ipfs_cat_alloc("/ipfs/QmFull", &allocator, &data, &size));
+    TEST_CHECK(size == 4 && std::string(static_cast<char*>(data), size) == "full");
+    std::free(data);
+    TEST_CHECK(counts.allocs == 1);
+
+    TEST_CHECK(!ipfs_cat_alloc("/ipfs/QmMissing", &allocator, &data, &size));
+    TEST_CHECK(data == NULL && size == 0);
+    TEST_CHECK(counts.allocs == counts.frees + 1);
+
+    ipfs_node_use(NULL);
+    ipfs_node_free(node);
+
+    server.Stop();
+    RemoveTree(repo);
+  }
+
+#if defined(HAVE_GO_IPSF)
+  /*!
+   * \brief Get a port nothing listens on, for the daemon
+   */
+  unsigned short GetFreePort(void)
+  {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    TEST_CHECK(fd >= 0);
+
+    struct sockaddr_in addr = { };
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t length = sizeof(addr);
+    TEST_CHECK(bind(fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) == 0);
+    TEST_CHECK(getsockname(fd, reinterpret_cast<struct sockaddr*>(&addr), &length) == 0);
+    close(fd);
+
+    return ntohs(addr.sin_port);
+  }
+
+  void TestMissFallsBack(const std::string& repo, ipfs_node_t* node)
+  {
+    const std::string data = "only in the daemon";
+    const std::string block = EncodeDagNode(std::vector<DagLink>(), data);
+
+    // Beside any daemon of the host
+    TEST_CHECK(ipfs_node_set_ports(node, GetFreePort(), GetFreePort(), GetFreePort()));
+
+    // The key is known before the block exists anywhere
+    const std::string key = EncodeBase58(Multihash(block.data(), block.size()));
+
+    // A miss starts the daemon and waits for the block through it
+    std::string fetched;
+    bool bFetched = false;
+    std::thread reader([node, &key, &fetched, &bFetched]()
+    {
+      ipfs_node_use(node);
+      bFetched = GetBlock(key, fetched);
+    });
+
+    const std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::seconds(60);
+    struct stat st;
+    while (stat((repo + "/api").c_str(), &st) != 0 && std::chrono::steady_clock::now() < deadline)
+      std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+    // Uploaded to the daemon's API, which hands it to the waiting get. The
+    // get holds go-ipfs's command line, so the block can't go through it.
+    ipfs_dag_builder_t* builder = ipfs_dag_builder_new();
+    const int root = ipfs_dag_node_new(builder);
+    TEST_CHECK(ipfs_dag_node_set_data(builder, root, data.data(), data.size()));
+
+    char builtKey[64];
+    TEST_CHECK(ipfs_dag_builder_flush(builder, root, builtKey, sizeof(builtKey)));
+    TEST_CHECK(key == builtKey);
+    ipfs_dag_builder_free(builder);
+
+    reader.join();
+    TEST_CHECK(bFetched && fetched == block);
+  }
+#endif
+}
+
+int main(void)
+{
+  const std::string repo = MakeTempRepo();
+  TEST_CHECK(!repo.empty());
+
+  ipfs_node_t* node = MakeLocalNode(repo);
+  ipfs_node_use(node);
+
+  TestLocalHit();
+  TestEmptyAlloc();
+  TestMultiBlockView();
+#if defined(HAVE_GO_IPSF)
+  TestMissFallsBack(repo, node);
+#endif
+
+  ipfs_node_use(NULL);
+  ipfs_node_free(node);
+
+  RemoveTree(repo);
+
+  TestEmptyAllocThroughApi();
+
+  return 0;
+}
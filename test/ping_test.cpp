@@ -0,0 +1,214 @@
+/*
+ *    Copyright (C) 2015 juztamau5
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *    The above copyright notice and this permission notice shall be included in
+ *    all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include "testserver.h"
+
+#include "ipfs/libipfs.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+using namespace IPSF::Test;
+
+namespace
+{
+  const unsigned long long SENTINEL = 0xdeadbeefULL;
+
+  std::string GetQueryValue(const std::string& target, const std::string& name)
+  {
+    size_t pos = target.find("?" + name + "=");
+    if (pos == std::string::npos)
+      pos = target.find("&" + name + "=");
+    if (pos == std::string::npos)
+      return "";
+
+    pos += name.size() + 2;
+    return target.substr(pos, target.find('&', pos) - pos);
+  }
+
+  std::string Probe(unsigned long long rttNs)
+  {
+    return "{\"Success\":true,\"Time\":" + std::to_string(rttNs) + ",\"Text\":\"\"}\n";
+  }
+
+  /*!
+   * \brief Answers pings as the daemon does, with a few misbehaving peers
+   */
+  void Handle(const HttpRequest& request, int fd)
+  {
+    if (request.target.compare(0, 13, "/api/v0/ping?") != 0)
+    {
+      SendResponse(fd, 404, "");
+      return;
+    }
+
+    const std::string peer = GetQueryValue(request.target, "arg");
+    const int count = std::atoi(GetQueryValue(request.target, "count").c_str());
+
+    SendChunkedHeader(fd);
+    SendChunk(fd, "{\"Success\":false,\"Time\":0,\"Text\":\"Looking up peer " + peer + "\"}\n");
+
+    if (peer == "QmMixed")
+    {
+      // One probe in four is lost
+      for (int i = 0; i < count; i++)
+      {
+        if (i % 4 == 2)
+          SendChunk(fd, "{\"Success\":false,\"Time\":0,\"Text\":\"Ping error: timeout\"}\n");
+        else
+          SendChunk(fd, Probe(1000 * (i + 1)));
+      }
+    }
+    else if (peer == "QmGreedy")
+    {
+      // More probes than asked for
+      for (int i = 0; i < count + 5; i++)
+        SendChunk(fd, Probe(1000));
+    }
+    else if (peer == "QmRamp")
+    {
+      for (int i = 0; i < count; i++)
+        SendChunk(fd, Probe(1000000 * (count - i)));
+    }
+    else
+    {
+      const unsigned long long rtt = (peer == "QmSteady") ? 5000 : 2000 + 1000 * std::atoi(peer.c_str() + 2);
+      for (int i = 0; i < count; i++)
+        SendChunk(fd, Probe(rtt));
+    }
+
+    SendLastChunk(fd, "");
+  }
+
+  void TestSamples(void)
+  {
+    unsigned long long rtts[9];
+    ipfs_ping_stats_t stats;
+
+    TEST_CHECK(ipfs_ping_samples("QmMixed", 8, rtts, &stats) == 6);
+    TEST_CHECK(stats.sent == 8);
+    TEST_CHECK(stats.received == 6);
+    TEST_CHECK(rtts[0] == 1000 && rtts[1] == 2000 && rtts[2] == 4000 && rtts[5] == 8000);
+    TEST_CHECK(stats.min_ns == 1000);
+    TEST_CHECK(stats.mean_ns == (1000 + 2000 + 4000 + 5000 + 6000 + 8000) / 6);
+    TEST_CHECK(stats.p99_ns == 8000);
+
+    // Samples arrive slowest first, but the percentile is taken in order
+    std::vector<unsigned long long> ramp(100);
+    TEST_CHECK(ipfs_ping_samples("QmRamp", 100, ramp.data(), &stats) == 100);
+    TEST_CHECK(ramp.front() == 100000000ULL && ramp.back() == 1000000ULL);
+    TEST_CHECK(stats.min_ns == 1000000ULL);
+    TEST_CHECK(stats.mean_ns == 50500000ULL);
+    TEST_CHECK(stats.p99_ns == 99000000ULL);
+
+    // Without an array only the stats are filled in
+    TEST_CHECK(ipfs_ping_samples("QmMixed", 4, NULL, &stats) == 3);
+    TEST_CHECK(stats.sent == 4);
+
+    TEST_CHECK(ipfs_ping_samples(NULL, 4, rtts, &stats) == -1);
+  }
+
+  void TestCapacity(void)
+  {
+    // A daemon answering more probes than asked can't write past the array
+    unsigned long long rtts[11];
+    for (unsigned int i = 0; i < 11; i++)
+      rtts[i] = SENTINEL;
+
+    TEST_CHECK(ipfs_ping_samples("QmGreedy", 4, rtts, NULL) == 4);
+    TEST_CHECK(rtts[3] == 1000 && rtts[4] == SENTINEL);
+
+    // No count means ten probes and room for ten samples
+    TEST_CHECK(ipfs_ping_samples("QmGreedy", 0, rtts, NULL) == 10);
+    TEST_CHECK(rtts[9] == 1000 && rtts[10] == SENTINEL);
+  }
+
+  void TestLatencyTable(void)
+  {
+    unsigned long long ewma;
+    unsigned int samples;
+    TEST_CHECK(!ipfs_ping_latency("QmNever", &ewma, &samples));
+
+    // The first sample is taken as is, later ones are weighted by 0.2
+    TEST_CHECK(ipfs_ping_samples("Qm0", 1, NULL, NULL) == 1);
+    TEST_CHECK(ipfs_ping_latency("Qm0", &ewma, &samples));
+    TEST_CHECK(ewma == 2000 && samples == 1);
+
+    TEST_CHECK(ipfs_ping_samples("Qm0", 2, NULL, NULL) == 2);
+    TEST_CHECK(ipfs_ping_latency("Qm0", &ewma, NULL));
+    TEST_CHECK(ewma == 2000);
+
+    TEST_CHECK(ipfs_ping_samples("QmMixed", 2, NULL, NULL) == 2);
+    TEST_CHECK(ipfs_ping_latency("QmMixed", &ewma, &samples));
+    TEST_CHECK(samples > 2);
+
+    // The monitor pings in the background with its own weight
+    const char* const peers[] = { "QmSteady", "Qm8" };
+    TEST_CHECK(ipfs_ping_monitor_start(peers, 2, 10, 0.5));
+
+    const std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (!(ipfs_ping_latency("Qm8", &ewma, &samples) && samples >= 3) && std::chrono::steady_clock::now() < deadline)
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+    ipfs_ping_monitor_stop();
+
+    TEST_CHECK(ipfs_ping_latency("Qm8", &ewma, &samples) && samples >= 3);
+    TEST_CHECK(ewma == 10000);
+    TEST_CHECK(ipfs_ping_latency("QmSteady", &ewma, &samples) && ewma == 5000);
+
+    // Stopped means no more samples
+    unsigned int stopped;
+    ipfs_ping_latency("Qm8", &ewma, &stopped);
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    ipfs_ping_latency("Qm8", &ewma, &samples);
+    TEST_CHECK(samples == stopped);
+
+    // 2000 then 4000 with a weight of 0.5
+    TEST_CHECK(ipfs_ping_samples("Qm0", 1, NULL, NULL) == 1);
+    TEST_CHECK(ipfs_ping_samples("Qm2", 1, NULL, NULL) == 1);
+    TEST_CHECK(ipfs_ping_latency("Qm2", &ewma, NULL) && ewma == 4000);
+  }
+}
+
+int main(void)
+{
+  const std::string repo = MakeTempRepo();
+  TEST_CHECK(!repo.empty());
+
+  CLoopbackServer server(Handle);
+  TEST_CHECK(server.Start() && server.WriteApiFile(repo));
+  TEST_CHECK(ipfs_open(repo.c_str(), IPFS_OPEN_DEFAULT));
+
+  TestSamples();
+  TestCapacity();
+  TestLatencyTable();
+
+  ipfs_close();
+  server.Stop();
+
+  RemoveTree(repo);
+
+  return 0;
+}
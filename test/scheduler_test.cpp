@@ -0,0 +1,324 @@
+/*
+ *    Copyright (C) 2015 juztamau5
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *    The above copyright notice and this permission notice shall be included in
+ *    all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include "testserver.h"
+
+#include "api.h"
+#include "scheduler.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <vector>
+
+using namespace IPSF;
+using namespace IPSF::Test;
+
+namespace
+{
+  const PriorityClass CLASSES[PRIORITY_CLASS_COUNT] = { PriorityInteractive, PriorityNormal, PriorityBulk };
+
+  /*!
+   * \brief Holds the threads that got a slot until they're let go
+   */
+  class CGate
+  {
+  public:
+    CGate(void) : m_bOpen(false) { }
+
+    void Wait(void)
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      while (!m_bOpen)
+        m_opened.wait(lock);
+    }
+
+    void Open(void)
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_bOpen = true;
+      m_opened.notify_all();
+    }
+
+  private:
+    bool                    m_bOpen;
+    std::mutex              m_mutex;
+    std::condition_variable m_opened;
+  };
+
+  SchedulerStats GetStats(CScheduler& scheduler, PriorityClass priority)
+  {
+    SchedulerStats stats;
+    scheduler.GetStats(priority, stats);
+    return stats;
+  }
+
+  /*!
+   * \brief Wait until <queued> of the class wait and <running> hold a slot
+   */
+  bool WaitForStats(CScheduler& scheduler, PriorityClass priority, unsigned int queued, unsigned int running)
+  {
+    for (unsigned int i = 0; i < 5000; i++)
+    {
+      const SchedulerStats stats = GetStats(scheduler, priority);
+      if (stats.queued == queued && stats.running == running)
+        return true;
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return false;
+  }
+
+  void TestFairShare(void)
+  {
+    CFairShare share;
+    const bool eligible[PRIORITY_CLASS_COUNT] = { true, true, true };
+
+    // Shares follow the weights 4, 2 and 1 while every class has work
+    unsigned int served[PRIORITY_CLASS_COUNT] = { 0, 0, 0 };
+    for (unsigned int i = 0; i < 700; i++)
+    {
+      const int next = share.Next(eligible);
+      TEST_CHECK(next >= 0);
+      served[next]++;
+      share.Charge(static_cast<PriorityClass>(next));
+    }
+    TEST_CHECK(served[PriorityInteractive] == 400);
+    TEST_CHECK(served[PriorityNormal] == 200);
+    TEST_CHECK(served[PriorityBulk] == 100);
+
+    // A class that was idle doesn't get to catch up
+    const bool bulkOnly[PRIORITY_CLASS_COUNT] = { false, false, true };
+    for (unsigned int i = 0; i < 100; i++)
+    {
+      TEST_CHECK(share.Next(bulkOnly) == PriorityBulk);
+      share.Charge(PriorityBulk);
+    }
+
+    for (unsigned int i = 0; i < PRIORITY_CLASS_COUNT; i++)
+      served[i] = 0;
+    for (unsigned int i = 0; i < 70; i++)
+    {
+      const int next = share.Next(eligible);
+      served[next]++;
+      share.Charge(static_cast<PriorityClass>(next));
+    }
+    TEST_CHECK(served[PriorityInteractive] <= 42);
+    TEST_CHECK(served[PriorityNormal] <= 22);
+    TEST_CHECK(served[PriorityBulk] >= 8);
+
+    const bool none[PRIORITY_CLASS_COUNT] = { false, false, false };
+    TEST_CHECK(share.Next(none) == -1);
+  }
+
+  void TestAdmissionOrder(void)
+  {
+    CScheduler scheduler(1);
+
+    // Hold the only slot while every class queues up
+    scheduler.Acquire(PriorityNormal);
+
+    const unsigned int perClass = 8;
+
+    // The slot held meanwhile was normal's turn
+    std::mutex orderMutex;
+    std::vector<PriorityClass> order(1, PriorityNormal);
+
+    std::vector<std::thread> threads;
+    for (unsigned int c = 0; c < PRIORITY_CLASS_COUNT; c++)
+    {
+      for (unsigned int i = 0; i < perClass; i++)
+      {
+        const PriorityClass priority = CLASSES[c];
+        threads.push_back(std::thread([&scheduler, &orderMutex, &order, priority]()
+        {
+          scheduler.Acquire(priority);
+          {
+            std::unique_lock<std::mutex> lock(orderMutex);
+            order.push_back(priority);
+          }
+          scheduler.Release(priority);
+        }));
+      }
+      TEST_CHECK(WaitForStats(scheduler, CLASSES[c], perClass, CLASSES[c] == PriorityNormal ? 1 : 0));
+    }
+
+    scheduler.Release(PriorityNormal);
+
+    for (std::vector<std::thread>::iterator it = threads.begin(); it != threads.end(); ++it)
+      it->join();
+
+    // Every seven slots go 4, 2 and 1 to the classes
+    TEST_CHECK(order.size() == PRIORITY_CLASS_COUNT * perClass + 1);
+    for (unsigned int window = 0; window < 2; window++)
+    {
+      unsigned int served[PRIORITY_CLASS_COUNT] = { 0, 0, 0 };
+      for (unsigned int i = 0; i < 7; i++)
+        served[order[window * 7 + i]]++;
+      TEST_CHECK(served[PriorityInteractive] == 4);
+      TEST_CHECK(served[PriorityNormal] == 2);
+      TEST_CHECK(served[PriorityBulk] == 1);
+    }
+
+    // Weights can be changed
+    TEST_CHECK(scheduler.Configure(PriorityBulk, 4, 1));
+    TEST_CHECK(!scheduler.Configure(PriorityBulk, 0, 1));
+    TEST_CHECK(!scheduler.Configure(PriorityBulk, 1, 0));
+  }
+
+  void TestClassLimits(void)
+  {
+    CScheduler scheduler(8);
+    CGate gate;
+
+    // Bulk work gets a quarter of the slots, normal work half
+    std::vector<std::thread> threads;
+    for (unsigned int i = 0; i < 6; i++)
+    {
+      threads.push_back(std::thread([&scheduler, &gate]()
+      {
+        CScheduledSlot slot(scheduler);
+        gate.Wait();
+      }));
+    }
+
+    // Threads have the normal class unless they choose one
+    TEST_CHECK(WaitForStats(scheduler, PriorityNormal, 2, 4));
+
+    for (unsigned int i = 0; i < 4; i++)
+    {
+      threads.push_back(std::thread([&scheduler, &gate]()
+      {
+        SetThreadPriority(PriorityBulk);
+        CScheduledSlot slot(scheduler);
+        gate.Wait();
+      }));
+    }
+    TEST_CHECK(WaitForStats(scheduler, PriorityBulk, 2, 2));
+
+    // Interactive work finds the slots the others leave
+    for (unsigned int i = 0; i < 3; i++)
+    {
+      threads.push_back(std::thread([&scheduler, &gate]()
+      {
+        SetThreadPriority(PriorityInteractive);
+        CScheduledSlot slot(scheduler);
+        gate.Wait();
+      }));
+    }
+    TEST_CHECK(WaitForStats(scheduler, PriorityInteractive, 1, 2));
+
+    // A limit is never higher than the resource
+    TEST_CHECK(scheduler.Configure(PriorityBulk, 1, 100));
+    TEST_CHECK(WaitForStats(scheduler, PriorityBulk, 2, 2));
+
+    gate.Open();
+    for (std::vector<std::thread>::iterator it = threads.begin(); it != threads.end(); ++it)
+      it->join();
+
+    for (unsigned int c = 0; c < PRIORITY_CLASS_COUNT; c++)
+      TEST_CHECK(WaitForStats(scheduler, CLASSES[c], 0, 0));
+  }
+
+  void TestStats(void)
+  {
+    CScheduler scheduler(1);
+
+    TEST_CHECK(GetStats(scheduler, PriorityBulk).admitted == 0);
+
+    // Queue two bulk waiters behind a slot held for a while
+    scheduler.Acquire(PriorityInteractive);
+
+    std::vector<std::thread> threads;
+    for (unsigned int i = 0; i < 2; i++)
+    {
+      threads.push_back(std::thread([&scheduler]()
+      {
+        scheduler.Acquire(PriorityBulk);
+        scheduler.Release(PriorityBulk);
+      }));
+    }
+    TEST_CHECK(WaitForStats(scheduler, PriorityBulk, 2, 0));
+
+    const std::chrono::milliseconds held(50);
+    std::this_thread::sleep_for(held);
+    scheduler.Release(PriorityInteractive);
+
+    for (std::vector<std::thread>::iterator it = threads.begin(); it != threads.end(); ++it)
+      it->join();
+
+    const uint64_t heldNs = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(held).count());
+
+    const SchedulerStats bulk = GetStats(scheduler, PriorityBulk);
+    TEST_CHECK(bulk.queued == 0);
+    TEST_CHECK(bulk.running == 0);
+    TEST_CHECK(bulk.admitted == 2);
+    TEST_CHECK(bulk.waitMaxNs >= heldNs);
+    TEST_CHECK(bulk.waitTotalNs >= 2 * heldNs);
+    TEST_CHECK(bulk.waitTotalNs <= 2 * bulk.waitMaxNs);
+
+    const SchedulerStats interactive = GetStats(scheduler, PriorityInteractive);
+    TEST_CHECK(interactive.admitted == 1);
+    TEST_CHECK(interactive.waitMaxNs < heldNs);
+  }
+
+  void TestApiRequests(void)
+  {
+    CLoopbackServer server([](const HttpRequest& request, int fd)
+    {
+      (void)request;
+      SendResponse(fd, 200, "{}");
+    });
+    TEST_CHECK(server.Start());
+
+    ApiEndpoint endpoint;
+    endpoint.host = "127.0.0.1";
+    endpoint.port = server.GetPort();
+
+    // Requests to the daemon are admitted in the calling thread's class
+    const uint64_t before = GetStats(GetApiScheduler(), PriorityBulk).admitted;
+
+    SetThreadPriority(PriorityBulk);
+    CApiRequest request("id");
+    std::string body;
+    TEST_CHECK(request.Execute(endpoint, body) && body == "{}");
+    ClearThreadPriority();
+
+    TEST_CHECK(GetStats(GetApiScheduler(), PriorityBulk).admitted == before + 1);
+    TEST_CHECK(GetStats(GetApiScheduler(), PriorityBulk).running == 0);
+
+    server.Stop();
+  }
+}
+
+int main(void)
+{
+  TestFairShare();
+  TestAdmissionOrder();
+  TestClassLimits();
+  TestStats();
+  TestApiRequests();
+
+  return 0;
+}
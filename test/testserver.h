@@ -0,0 +1,293 @@
+/*
+ *    Copyright (C) 2015 juztamau5
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *    The above copyright notice and this permission notice shall be included in
+ *    all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+#ifndef __IPSF_TESTSERVER_H__
+#define __IPSF_TESTSERVER_H__
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <ftw.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#define TEST_CHECK(condition) \
+  do \
+  { \
+    if (!(condition)) \
+    { \
+      std::fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+      std::exit(1); \
+    } \
+  } while (0)
+
+namespace IPSF
+{
+  namespace Test
+  {
+    /*!
+     * \brief A request received by the loopback server
+     */
+    struct HttpRequest
+    {
+      std::string target; ///< Path and query, such as /api/v0/id?arg=x
+      std::string contentType;
+      std::string body;
+    };
+
+    inline bool SendAll(int fd, const std::string& data)
+    {
+      size_t sent = 0;
+      while (sent < data.size())
+      {
+        ssize_t result = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+        if (result <= 0)
+          return false;
+        sent += static_cast<size_t>(result);
+      }
+      return true;
+    }
+
+    /*!
+     * \brief Send a whole response with a Content-Length
+     */
+    inline bool SendResponse(int fd, int status, const std::string& body)
+    {
+      std::stringstream response;
+      response << "HTTP/1.1 " << status << " " << (status == 200 ? "OK" : "Error") << "\r\n";
+      response << "Content-Type: application/json\r\n";
+      response << "Content-Length: " << body.size() << "\r\n";
+      response << "\r\n";
+      response << body;
+      return SendAll(fd, response.str());
+    }
+
+    /*!
+     * \brief Send a chunked response header, followed by SendChunk() calls and
+     *        SendLastChunk()
+     */
+    inline bool SendChunkedHeader(int fd)
+    {
+      return SendAll(fd, "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\nTrailer: X-Stream-Error\r\n\r\n");
+    }
+
+    inline bool SendChunk(int fd, const std::string& data)
+    {
+      std::stringstream chunk;
+      chunk << std::hex << data.size() << "\r\n" << data << "\r\n";
+      return SendAll(fd, chunk.str());
+    }
+
+    inline bool SendLastChunk(int fd, const std::string& streamError)
+    {
+      std::string last = "0\r\n";
+      if (!streamError.empty())
+        last += "X-Stream-Error: " + streamError + "\r\n";
+      last += "\r\n";
+      return SendAll(fd, last);
+    }
+
+    /*!
+     * \brief HTTP server on 127.0.0.1 standing in for the daemon's API
+     *
+     * Every connection is served on its own thread by the handler, which
+     * writes the response to the socket.
+     */
+    class CLoopbackServer
+    {
+    public:
+      typedef std::function<void(const HttpRequest& request, int fd)> Handler;
+
+      CLoopbackServer(const Handler& handler) : m_handler(handler), m_fd(-1), m_port(0) { }
+      ~CLoopbackServer(void) { Stop(); }
+
+      bool Start(void)
+      {
+        m_fd = socket(AF_INET, SOCK_STREAM, 0);
+        if (m_fd < 0)
+          return false;
+
+        struct sockaddr_in address = { };
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        address.sin_port = 0;
+
+        socklen_t length = sizeof(address);
+        if (bind(m_fd, reinterpret_cast<struct sockaddr*>(&address), sizeof(address)) != 0 ||
+            listen(m_fd, 16) != 0 ||
+            getsockname(m_fd, reinterpret_cast<struct sockaddr*>(&address), &length) != 0)
+          return false;
+
+        m_port = ntohs(address.sin_port);
+        m_acceptor = std::thread(&CLoopbackServer::Accept, this);
+        return true;
+      }
+
+      void Stop(void)
+      {
+        if (m_fd >= 0)
+        {
+          shutdown(m_fd, SHUT_RDWR);
+          close(m_fd);
+          m_fd = -1;
+        }
+        if (m_acceptor.joinable())
+          m_acceptor.join();
+
+        for (std::vector<std::thread>::iterator it = m_connections.begin(); it != m_connections.end(); ++it)
+          it->join();
+        m_connections.clear();
+      }
+
+      unsigned short GetPort(void) const { return m_port; }
+
+      /*!
+       * \brief Write the "api" file a daemon serving <repoPath> would write
+       */
+      bool WriteApiFile(const std::string& repoPath) const
+      {
+        std::ofstream file((repoPath + "/api").c_str());
+        file << "/ip4/127.0.0.1/tcp/" << m_port;
+        return file.good();
+      }
+
+      std::vector<HttpRequest> GetRequests(void)
+      {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        return m_requests;
+      }
+
+    private:
+      void Accept(void)
+      {
+        while (true)
+        {
+          int fd = accept(m_fd, NULL, NULL);
+          if (fd < 0)
+            break;
+
+          std::unique_lock<std::mutex> lock(m_mutex);
+          m_connections.push_back(std::thread(&CLoopbackServer::Serve, this, fd));
+        }
+      }
+
+      void Serve(int fd)
+      {
+        HttpRequest request;
+        if (ReadRequest(fd, request))
+        {
+          {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_requests.push_back(request);
+          }
+          m_handler(request, fd);
+        }
+        close(fd);
+      }
+
+      static bool ReadRequest(int fd, HttpRequest& request)
+      {
+        std::string data;
+        size_t headerEnd;
+        while ((headerEnd = data.find("\r\n\r\n")) == std::string::npos)
+        {
+          if (!Receive(fd, data))
+            return false;
+        }
+
+        // POST <target> HTTP/1.1
+        const size_t targetBegin = data.find(' ') + 1;
+        request.target = data.substr(targetBegin, data.find(' ', targetBegin) - targetBegin);
+
+        size_t contentLength = 0;
+        std::stringstream headers(data.substr(0, headerEnd));
+        std::string header;
+        while (std::getline(headers, header))
+        {
+          if (header.compare(0, 16, "Content-Length: ") == 0)
+            contentLength = std::strtoul(header.c_str() + 16, NULL, 10);
+          else if (header.compare(0, 14, "Content-Type: ") == 0)
+            request.contentType = header.substr(14, header.find('\r') - 14);
+        }
+
+        while (data.size() < headerEnd + 4 + contentLength)
+        {
+          if (!Receive(fd, data))
+            return false;
+        }
+        request.body = data.substr(headerEnd + 4, contentLength);
+
+        return true;
+      }
+
+      static bool Receive(int fd, std::string& data)
+      {
+        char buffer[4096];
+        ssize_t bytesRead = recv(fd, buffer, sizeof(buffer), 0);
+        if (bytesRead <= 0)
+          return false;
+        data.append(buffer, static_cast<size_t>(bytesRead));
+        return true;
+      }
+
+      const Handler            m_handler;
+      int                      m_fd;
+      unsigned short           m_port;
+      std::thread              m_acceptor;
+      std::vector<std::thread> m_connections;
+      std::vector<HttpRequest> m_requests;
+      std::mutex               m_mutex;
+    };
+
+    /*!
+     * \brief Create an empty directory to stand in for a repo
+     */
+    inline std::string MakeTempRepo(void)
+    {
+      char path[] = "/tmp/libipfs-test-XXXXXX";
+      return mkdtemp(path) ? path : "";
+    }
+
+    /*!
+     * \brief Remove a directory and everything in it, without following
+     *        symlinks
+     */
+    inline void RemoveTree(const std::string& path)
+    {
+      nftw(path.c_str(), [](const char* entry, const struct stat*, int, struct FTW*)
+      {
+        return remove(entry);
+      }, 16, FTW_DEPTH | FTW_PHYS);
+    }
+  }
+}
+
+#endif // __IPSF_TESTSERVER_H__